@@ -0,0 +1,68 @@
+#include <iostream>
+
+#include <boost/program_options.hpp>
+
+#include "hdf5model.h"
+#include "gzipstream.h"
+
+using namespace mht;
+
+int main(int argc, char** argv) {
+	namespace po = boost::program_options;
+
+	std::string inputFilename;
+	std::string outputFilename;
+
+	// Declare the supported options.
+	po::options_description description("Convert a model between the JSON, binary and HDF5 formats. The output format is deduced from the extension (.json, .h5 or .hdf5), other extensions convert JSON to binary and the other formats to JSON");
+	description.add_options()
+	    ("help", "produce help message")
+	    ("input,i", po::value<std::string>(&inputFilename), "filename of the model stored as Json, binary or HDF5 file")
+	    ("output,o", po::value<std::string>(&outputFilename), "filename where the converted model will be stored")
+	;
+
+	po::variables_map variableMap;
+	po::store(po::parse_command_line(argc, argv, description), variableMap);
+	po::notify(variableMap);
+
+	if (variableMap.count("help"))
+	{
+	    std::cout << description << std::endl;
+	    return 1;
+	}
+
+	if (!variableMap.count("input") || !variableMap.count("output"))
+	{
+	    std::cout << "Input and output filenames have to be specified!" << std::endl;
+	    std::cout << description << std::endl;
+	    return 1;
+	}
+
+	Hdf5Model model;
+	bool inputIsJson = !Hdf5Model::isHdf5File(inputFilename) && !BinaryModel::isBinaryModelFile(inputFilename);
+	model.readFromFile(inputFilename);
+
+	// the output format is given by the extension, otherwise JSON is converted to binary and everything else to JSON.
+	// Compressed output (.gz) is always JSON
+	const std::string jsonExtension = ".json";
+	bool outputIsJson = helpers::hasGzipExtension(outputFilename) || (outputFilename.size() >= jsonExtension.size() 
+		&& outputFilename.compare(outputFilename.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0);
+
+	if(Hdf5Model::hasHdf5Extension(outputFilename))
+	{
+		model.saveToHdf5(outputFilename);
+		std::cout << "Converted model to HDF5 file " << outputFilename << std::endl;
+	}
+	else if(outputIsJson || !inputIsJson)
+	{
+		model.saveModelToJson(outputFilename);
+		std::cout << "Converted model to JSON file " << outputFilename << std::endl;
+	}
+	else
+	{
+		model.saveToBinary(outputFilename);
+		std::cout << "Converted model to binary file " << outputFilename << std::endl;
+	}
+
+	return 0;
+}
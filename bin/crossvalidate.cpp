@@ -0,0 +1,186 @@
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <limits>
+
+#include <boost/program_options.hpp>
+
+#include "hdf5model.h"
+#include "helpers.h"
+#include "featurenormalization.h"
+#include "parallel.h"
+
+using namespace mht;
+using namespace helpers;
+
+/**
+ * @brief A model that is parsed once and then shared between all folds and grid points.
+ * @details The OpenGM model is rebuilt whenever the model is used, so every use must hold the mutex
+ */
+struct CachedModel
+{
+	Hdf5Model model;
+	std::mutex mutex;
+};
+
+int main(int argc, char** argv) {
+	namespace po = boost::program_options;
+
+	std::vector<std::string> modelFilenames;
+	std::vector<std::string> groundtruthFilenames;
+	std::vector<double> regularizerWeights;
+	std::string weightsFilename("weights.json");
+	size_t numFolds = 3;
+	size_t numThreads = 1;
+
+	// Declare the supported options.
+	po::options_description description("Allowed options");
+	description.add_options()
+	    ("help", "produce help message")
+	    ("model,m", po::value<std::vector<std::string> >(&modelFilenames)->multitoken(), "filenames of models stored as Json, binary or HDF5 files")
+	    ("groundtruth,g", po::value<std::vector<std::string> >(&groundtruthFilenames)->multitoken(), "filenames of ground truths stored as Json or HDF5 files, one per model in the same order")
+	    ("regularizers,r", po::value<std::vector<double> >(&regularizerWeights)->multitoken(), "list of regularizer weights to evaluate (default: 1.0)")
+	    ("folds,k", po::value<size_t>(&numFolds), "number of folds (default: 3)")
+	    ("threads,t", po::value<size_t>(&numThreads), "number of folds and grid points that are processed concurrently, use 0 for all CPU cores (default: 1)")
+	    ("weights,w", po::value<std::string>(&weightsFilename), "filename where the weights learned on all models with the best regularizer will be stored as Json file, or HDF5 if it ends with .h5")
+	;
+
+	po::variables_map variableMap;
+	po::store(po::parse_command_line(argc, argv, description), variableMap);
+	po::notify(variableMap);
+
+	if (variableMap.count("help"))
+	{
+	    std::cout << description << std::endl;
+	    return 1;
+	}
+
+	if (!variableMap.count("model") || !variableMap.count("groundtruth") || modelFilenames.size() != groundtruthFilenames.size())
+	{
+	    std::cout << "Models and Groundtruths have to be specified, and there must be one groundtruth per model!" << std::endl;
+	    std::cout << description << std::endl;
+	    return 1;
+	}
+
+	if(numFolds < 2 || numFolds > modelFilenames.size())
+	{
+		std::cout << "The number of folds must be at least 2 and must not exceed the number of models!" << std::endl;
+		return 1;
+	}
+
+	if(regularizerWeights.empty())
+		regularizerWeights.push_back(1.0);
+
+	// parse every model exactly once
+	std::vector<std::unique_ptr<CachedModel> > models(modelFilenames.size());
+	runInParallel(models.size(), numThreads, [&](size_t i)
+	{
+		models[i].reset(new CachedModel());
+		// models are already read and built concurrently, unless only one thread is used
+		if(numThreads != 1)
+		{
+			models[i]->model.setNumReaderThreads(1);
+			models[i]->model.setNumBuilderThreads(1);
+		}
+		models[i]->model.readFromFile(modelFilenames[i]);
+		models[i]->model.setJsonGtFile(groundtruthFilenames[i]);
+		models[i]->model.computeNumWeights();
+	});
+
+	size_t numWeights = models[0]->model.computeNumWeights();
+	for(size_t i = 1; i < models.size(); i++)
+		if(models[i]->model.computeNumWeights() != numWeights)
+			throw std::runtime_error("Model " + modelFilenames[i] + " needs a different number of weights than " + modelFilenames[0]);
+
+	// standardize all models with the pooled feature statistics, so that the learned weights fit every model
+	std::shared_ptr<FeatureNormalization> normalization;
+	for(size_t i = 0; i < models.size(); i++)
+	{
+		std::shared_ptr<FeatureNormalization> modelNormalization = models[i]->model.getFeatureNormalization();
+		if(!modelNormalization)
+			continue;
+		if(!normalization)
+			normalization = std::make_shared<FeatureNormalization>();
+		normalization->merge(*modelNormalization);
+	}
+
+	if(normalization)
+	{
+		normalization->finalize(models[0]->model.getSettings()->statesShareWeights_);
+		for(size_t i = 0; i < models.size(); i++)
+			models[i]->model.setFeatureNormalization(normalization);
+	}
+
+	// learn on all models that pass the filter with the given regularizer
+	auto learnWeights = [&](double regularizerWeight, const std::function<bool(size_t)>& useModel) -> std::vector<ValueType>
+	{
+		DatasetType dataset;
+		WeightsType initialWeights(numWeights);
+		dataset.setWeights(initialWeights);
+
+		size_t firstModel = models.size();
+		for(size_t i = 0; i < models.size(); i++)
+		{
+			if(!useModel(i))
+				continue;
+			std::lock_guard<std::mutex> lock(models[i]->mutex);
+			models[i]->model.addToDataset(dataset);
+			firstModel = std::min(firstModel, i);
+		}
+
+		return models[firstModel]->model.learn(dataset, regularizerWeight);
+	};
+
+	// every pair of regularizer weight and fold is one task, models are assigned to folds round robin
+	std::vector<double> foldLosses(regularizerWeights.size() * numFolds, 0.0);
+	runInParallel(foldLosses.size(), numThreads, [&](size_t task)
+	{
+		size_t r = task / numFolds;
+		size_t fold = task % numFolds;
+
+		std::vector<ValueType> weights = learnWeights(regularizerWeights[r], [&](size_t i){ return i % numFolds != fold; });
+
+		// evaluate the loss on the held out models
+		double loss = 0.0;
+		size_t numHeldOut = 0;
+		for(size_t i = fold; i < models.size(); i += numFolds)
+		{
+			std::lock_guard<std::mutex> lock(models[i]->mutex);
+			Solution solution = models[i]->model.infer(weights);
+			Solution gt = models[i]->model.getGroundTruth();
+			loss += models[i]->model.computeLoss(solution, gt);
+			numHeldOut++;
+		}
+		foldLosses[task] = loss / numHeldOut;
+	});
+
+	// report mean held out loss per regularizer weight
+	size_t bestRegularizer = 0;
+	double bestLoss = std::numeric_limits<double>::infinity();
+	std::cout << "************************\n" << "Cross validation results:" << std::endl;
+	for(size_t r = 0; r < regularizerWeights.size(); r++)
+	{
+		double meanLoss = 0.0;
+		std::cout << "\tRegularizer " << regularizerWeights[r] << ":";
+		for(size_t fold = 0; fold < numFolds; fold++)
+		{
+			std::cout << " " << foldLosses[r * numFolds + fold];
+			meanLoss += foldLosses[r * numFolds + fold] / numFolds;
+		}
+		std::cout << " -> mean held out loss " << meanLoss << std::endl;
+
+		if(meanLoss < bestLoss)
+		{
+			bestLoss = meanLoss;
+			bestRegularizer = r;
+		}
+	}
+	std::cout << "Best regularizer is " << regularizerWeights[bestRegularizer] << "\n************************" << std::endl;
+
+	// train on all models with the best regularizer
+	std::vector<ValueType> weights = learnWeights(regularizerWeights[bestRegularizer], [](size_t){ return true; });
+	std::vector<std::string> weightDescriptions = models[0]->model.getWeightDescriptions();
+	saveWeightsToFile(weights, weightsFilename, weightDescriptions, normalization.get());
+	return 0;
+}
@@ -2,7 +2,7 @@
 
 #include <boost/program_options.hpp>
 
-#include "jsonmodel.h"
+#include "hdf5model.h"
 #include "helpers.h"
 
 using namespace mht;
@@ -19,7 +19,7 @@ int main(int argc, char** argv) {
 	po::options_description description("Allowed options");
 	description.add_options()
 	    ("help", "produce help message")
-	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json file")
+	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json, binary or HDF5 file")
 	    ("solution,s", po::value<std::string>(&solutionFilename), "(optional) filename where the tracking solution (as links) is stored as Json file")
 	    ("output,o", po::value<std::string>(&outputFilename), "filename where the graphviz DOT print of the graph should go")
 	;
@@ -37,8 +37,8 @@ int main(int argc, char** argv) {
 	    std::cout << "Model and Output filenames have to be specified!" << std::endl;
 	    std::cout << description << std::endl;
 	} else {
-	    JsonModel model;
-		model.readFromJson(modelFilename);
+	    Hdf5Model model;
+		model.readFromFile(modelFilename);
 		WeightsType weights(model.computeNumWeights());
 		model.initializeOpenGMModel(weights);
 
@@ -2,8 +2,9 @@
 
 #include <boost/program_options.hpp>
 
-#include "jsonmodel.h"
+#include "hdf5model.h"
 #include "helpers.h"
+#include "featurenormalization.h"
 
 using namespace mht;
 using namespace helpers;
@@ -19,9 +20,10 @@ int main(int argc, char** argv) {
 	po::options_description description("Allowed options");
 	description.add_options()
 	    ("help", "produce help message")
-	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json file")
-	    ("weights,w", po::value<std::string>(&weightsFilename), "filename of the weights stored as Json file")
-	    ("output,o", po::value<std::string>(&outputFilename), "filename where the resulting tracking (as links) will be stored as Json file")
+	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json, binary or HDF5 file")
+	    ("weights,w", po::value<std::string>(&weightsFilename), "filename of the weights stored as Json or HDF5 file")
+	    ("output,o", po::value<std::string>(&outputFilename), "filename where the resulting tracking (as links) will be stored as Json file, or HDF5 if it ends with .h5")
+	    ("compact,c", "write the Json result without indentation, which is smaller and faster for large results")
 	;
 
 	po::variables_map variableMap;
@@ -41,10 +43,15 @@ int main(int argc, char** argv) {
 	} 
 	else 
 	{
-	    JsonModel model;
-		model.readFromJson(modelFilename);
-		std::vector<double> weights = readWeightsFromJson(weightsFilename);
+	    Hdf5Model model;
+		model.readFromFile(modelFilename);
+		std::vector<double> weights = readWeightsFromFile(weightsFilename);
+		std::shared_ptr<FeatureNormalization> normalization = readFeatureNormalizationFromFile(weightsFilename);
+		if(normalization)
+			model.setFeatureNormalization(normalization);
+		// the model is solved only once, the result is exported from the ids and OpenGM variables of the hypotheses
+		model.setReleaseFeatures(true);
 		Solution solution = model.infer(weights);
-		model.saveResultToJson(outputFilename, solution);
+		model.saveResultToFile(outputFilename, solution, variableMap.count("compact") > 0);
 	}
 }
@@ -1,51 +1,329 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <limits>
 
 #include <boost/program_options.hpp>
 
-#include "jsonmodel.h"
+#include "hdf5model.h"
 #include "helpers.h"
+#include "parallel.h"
 
 using namespace mht;
 using namespace helpers;
 
+/**
+ * @brief Thrown by a learning run that fell too far behind the others
+ */
+struct LearningRunPruned : public std::runtime_error
+{
+	LearningRunPruned(): std::runtime_error("Learning run was pruned") {}
+};
+
+/**
+ * @brief Keeps track of the best primal objective that the learning runs reached after each number of iterations
+ * @details All runs use the same regularizer weight, so their primal objectives λ/2 |w|² + L(w) can be compared.
+ *          After the warmup, a run waits at every iteration until all other runs that are still going have reached it,
+ *          so the decision only depends on the objectives of the runs and not on how the threads were scheduled.
+ *          Runs that finished earlier take part with their final objective. At most numThreads runs compute at the
+ *          same time, waiting runs give their slot to another run.
+ */
+class PruningBoard
+{
+public:
+	/**
+	 * @param factor runs whose best objective is larger than factor times the best objective of all runs at the same iteration are pruned, 0 disables pruning
+	 * @param warmupIterations number of iterations every run is allowed to do before it can be pruned
+	 * @param numRuns number of learning runs, each of them must call startRun() and finishRun() once
+	 * @param numThreads number of runs that may compute at the same time
+	 */
+	PruningBoard(double factor, size_t warmupIterations, size_t numRuns, size_t numThreads):
+		factor_(factor),
+		warmupIterations_(warmupIterations),
+		numFreeSlots_(numThreads),
+		objectives_(numRuns),
+		finished_(numRuns, false),
+		pruned_(numRuns, false)
+	{}
+
+	/**
+	 * @brief Wait until the run may compute
+	 */
+	void startRun()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		acquireSlot(lock);
+	}
+
+	/**
+	 * @brief Record the best objective of a run after the given number of iterations
+	 * @return whether the run should go on
+	 */
+	bool update(size_t run, size_t iteration, double bestObjective)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		objectives_[run].push_back(bestObjective);
+		if(factor_ <= 0.0 || iteration <= warmupIterations_)
+			return true;
+
+		releaseSlot();
+		changed_.wait(lock, [&]() { return allRunsReached(iteration); });
+		acquireSlot(lock);
+
+		double bestObjectiveOfAllRuns = std::numeric_limits<double>::infinity();
+		for(size_t r = 0; r < objectives_.size(); ++r)
+		{
+			if(objectives_[r].size() >= iteration)
+				bestObjectiveOfAllRuns = std::min(bestObjectiveOfAllRuns, objectives_[r][iteration - 1]);
+			else if(finished_[r] && !pruned_[r] && !objectives_[r].empty())
+				bestObjectiveOfAllRuns = std::min(bestObjectiveOfAllRuns, objectives_[r].back());
+		}
+		return bestObjective <= factor_ * bestObjectiveOfAllRuns + 1e-9;
+	}
+
+	/**
+	 * @brief Mark a run as done, because it finished, was pruned or failed
+	 * @param bestObjective the final best objective of a finished run, the others are ignored in later iterations
+	 */
+	void finishRun(size_t run, bool completed, double bestObjective)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		finished_[run] = true;
+		pruned_[run] = !completed;
+		if(completed)
+			objectives_[run].push_back(bestObjective);
+		releaseSlot();
+	}
+
+private:
+	/**
+	 * @return whether all runs that are not done have reported the given iteration
+	 */
+	bool allRunsReached(size_t iteration) const
+	{
+		for(size_t r = 0; r < objectives_.size(); ++r)
+			if(!finished_[r] && objectives_[r].size() < iteration)
+				return false;
+		return true;
+	}
+
+	void acquireSlot(std::unique_lock<std::mutex>& lock)
+	{
+		changed_.wait(lock, [&]() { return numFreeSlots_ > 0; });
+		numFreeSlots_--;
+	}
+
+	void releaseSlot()
+	{
+		numFreeSlots_++;
+		changed_.notify_all();
+	}
+
+private:
+	double factor_;
+	size_t warmupIterations_;
+	size_t numFreeSlots_;
+	// best objective of every run after each of its iterations
+	std::vector<std::vector<double> > objectives_;
+	std::vector<bool> finished_;
+	std::vector<bool> pruned_;
+	std::mutex mutex_;
+	std::condition_variable changed_;
+};
+
+/**
+ * @brief Learning monitor that aborts learning when the run falls behind on the pruning board.
+ * @details The check happens when the oracle is called the next time, so that the previous iteration is reported completely
+ */
+class PruningMonitor : public LearningMonitor
+{
+public:
+	PruningMonitor(PruningBoard& board, size_t run, double regularizerWeight, std::ostream* report):
+		LearningMonitor(regularizerWeight, report),
+		board_(board),
+		run_(run)
+	{}
+
+	virtual void startIteration(const WeightsType& weights)
+	{
+		LearningMonitor::startIteration(weights);
+		if(iterations_.empty())
+			return;
+
+		if(!board_.update(run_, iterations_.size(), iterations_.back().bestPrimal))
+			throw LearningRunPruned();
+	}
+
+private:
+	PruningBoard& board_;
+	size_t run_;
+};
+
+/**
+ * @brief One learning run, which starts from one of the initial weights
+ */
+struct LearningRun
+{
+	size_t initialization;
+	std::vector<double> weights;
+	bool pruned = false;
+	size_t iterations = 0;
+	double risk = std::numeric_limits<double>::infinity();
+	double objective = std::numeric_limits<double>::infinity();
+};
+
 int main(int argc, char** argv) {
 	namespace po = boost::program_options;
 
 	std::string modelFilename;
 	std::string groundtruthFilename;
 	std::string weightsFilename("weights.json");
+	std::string reportFilename;
+	double regularizerWeight = 1.0;
+	std::vector<std::string> initialWeightsFilenames;
+	size_t numThreads = 1;
+	double pruneFactor = 2.0;
+	size_t pruneAfter = 5;
 
 	// Declare the supported options.
 	po::options_description description("Allowed options");
 	description.add_options()
 	    ("help", "produce help message")
-	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json file")
-	    ("groundtruth,g", po::value<std::string>(&groundtruthFilename), "filename of ground truth stored as Json file")
-	    ("weights,w", po::value<std::string>(&weightsFilename), "filename where the resulting weights will be stored as Json file")
+	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json, binary or HDF5 file")
+	    ("groundtruth,g", po::value<std::string>(&groundtruthFilename), "filename of ground truth stored as Json or HDF5 file")
+	    ("weights,w", po::value<std::string>(&weightsFilename), "filename where the resulting weights will be stored as Json file, or HDF5 if it ends with .h5")
+	    ("report,r", po::value<std::string>(&reportFilename), "filename where timings and objectives of every learning iteration will be stored as Json lines")
+	    ("regularizer,l", po::value<double>(&regularizerWeight), "regularizer weight, use crossvalidate to choose it on held-out data (default: 1.0)")
+	    ("initial-weights,i", po::value<std::vector<std::string> >(&initialWeightsFilenames)->multitoken(), "list of Json or HDF5 weight files to start learning from, one learning run is started for each of them (default: all weights zero)")
+	    ("threads,t", po::value<size_t>(&numThreads), "number of learning runs that are processed concurrently, use 0 for all CPU cores (default: 1)")
+	    ("prune-factor,p", po::value<double>(&pruneFactor), "abort runs whose objective is worse than this factor times the best objective of all runs at the same iteration, use 0 to disable (default: 2.0)")
+	    ("prune-after,a", po::value<size_t>(&pruneAfter), "number of iterations before a run can be pruned (default: 5)")
 	;
 
 	po::variables_map variableMap;
 	po::store(po::parse_command_line(argc, argv, description), variableMap);
 	po::notify(variableMap);
 
-	if (variableMap.count("help")) 
+	if (variableMap.count("help"))
 	{
 	    std::cout << description << std::endl;
 	    return 1;
 	}
 
-	if (!variableMap.count("model") || !variableMap.count("groundtruth")) 
+	if (!variableMap.count("model") || !variableMap.count("groundtruth"))
 	{
 	    std::cout << "Model and Groundtruth filenames have to be specified!" << std::endl;
 	    std::cout << description << std::endl;
-	} 
-	else 
+	    return 1;
+	}
+
+	Hdf5Model model;
+	model.readFromFile(modelFilename);
+	model.setJsonGtFile(groundtruthFilename);
+	size_t numWeights = model.computeNumWeights();
+
+	std::vector< std::vector<double> > initializations;
+	for(const std::string& filename : initialWeightsFilenames)
 	{
-	    JsonModel model;
-		model.readFromJson(modelFilename);
-		model.setJsonGtFile(groundtruthFilename);
-		std::vector<double> weights = model.learn();
-		std::vector<std::string> weightDescriptions = model.getWeightDescriptions();
-		saveWeightsToJson(weights, weightsFilename, weightDescriptions);
+		initializations.push_back(readWeightsFromFile(filename));
+		if(initializations.back().size() != numWeights)
+			throw std::runtime_error("Initial weights in " + filename + " do not match the number of weights of the model");
 	}
+	if(initializations.empty())
+		initializations.push_back(std::vector<double>(numWeights, 0.0));
+
+	// the training objectives of different regularizer weights cannot be compared, so all runs use the same one
+	std::vector<LearningRun> runs(initializations.size());
+	for(size_t i = 0; i < initializations.size(); i++)
+		runs[i].initialization = i;
+
+	// all runs share the parsed model, but have their own dataset and thus their own OpenGM weights.
+	// Every run gets its own thread, the board lets only numThreads of them compute at once
+	if(numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::mutex modelMutex;
+	PruningBoard board(runs.size() > 1 ? pruneFactor : 0.0, pruneAfter, runs.size(), numThreads);
+	std::vector<std::stringstream> runReports(runs.size());
+
+	runInParallel(runs.size(), runs.size(), [&](size_t r)
+	{
+		LearningRun& run = runs[r];
+		board.startRun();
+		try
+		{
+			DatasetType dataset;
+			WeightsType initialWeights(numWeights);
+			for(size_t i = 0; i < numWeights; i++)
+				initialWeights.setWeight(i, initializations[run.initialization][i]);
+			dataset.setWeights(initialWeights);
+
+			{
+				// the OpenGM model is rebuilt from the hypotheses against the weights of this dataset
+				std::lock_guard<std::mutex> lock(modelMutex);
+				model.addToDataset(dataset);
+			}
+
+			PruningMonitor monitor(board, r, regularizerWeight, reportFilename.empty() ? nullptr : &runReports[r]);
+			monitor.addReportField("run", Json::Value((Json::UInt64)r));
+			monitor.addReportField("regularizer", Json::Value(regularizerWeight));
+			monitor.addReportField("initialization", Json::Value((Json::UInt64)run.initialization));
+
+			try
+			{
+				run.weights = model.learn(dataset, regularizerWeight, &monitor);
+			}
+			catch(LearningRunPruned&)
+			{
+				run.pruned = true;
+				monitor.addReportField("pruned", Json::Value(true));
+				monitor.finish(dataset.getWeights());
+			}
+
+			run.iterations = monitor.getIterations().size();
+			if(!monitor.getRisks().empty())
+				run.risk = monitor.getRisks().back();
+			if(!monitor.getIterations().empty())
+				run.objective = monitor.getIterations().back().bestPrimal;
+		}
+		catch(...)
+		{
+			// the other runs must not wait for this one
+			board.finishRun(r, false, 0.0);
+			throw;
+		}
+		board.finishRun(r, !run.pruned, run.objective);
+	});
+
+	if(!reportFilename.empty())
+	{
+		std::ofstream report(reportFilename.c_str());
+		if(!report.good())
+			throw std::runtime_error("Could not open report file " + reportFilename);
+		for(const std::stringstream& runReport : runReports)
+			report << runReport.str();
+	}
+
+	// pick the finished run with the lowest objective, ties go to the earlier initialization
+	size_t bestRun = runs.size();
+	std::cout << "************************\n" << "Learning runs with regularizer " << regularizerWeight << ":" << std::endl;
+	for(size_t r = 0; r < runs.size(); r++)
+	{
+		std::cout << "\tInitialization " << runs[r].initialization << ": " << (runs[r].pruned ? "pruned" : "finished")
+			<< " after " << runs[r].iterations << " iterations with objective " << runs[r].objective << " and risk " << runs[r].risk << std::endl;
+		if(!runs[r].pruned && (bestRun == runs.size() || runs[r].objective < runs[bestRun].objective))
+			bestRun = r;
+	}
+
+	if(bestRun == runs.size())
+		throw std::runtime_error("All learning runs were pruned");
+
+	std::cout << "Best run uses initialization " << runs[bestRun].initialization << "\n************************" << std::endl;
+
+	std::vector<std::string> weightDescriptions = model.getWeightDescriptions();
+	saveWeightsToFile(runs[bestRun].weights, weightsFilename, weightDescriptions, model.getFeatureNormalization().get());
+	return 0;
 }
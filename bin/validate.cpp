@@ -2,8 +2,9 @@
 
 #include <boost/program_options.hpp>
 
-#include "jsonmodel.h"
+#include "hdf5model.h"
 #include "helpers.h"
+#include "featurenormalization.h"
 
 using namespace mht;
 using namespace helpers;
@@ -19,9 +20,9 @@ int main(int argc, char** argv) {
 	po::options_description description("Allowed options");
 	description.add_options()
 	    ("help", "produce help message")
-	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json file")
-	    ("solution,s", po::value<std::string>(&solutionFilename), "filename where the tracking solution (as links) is stored as Json file")
-	    ("weights,w", po::value<std::string>(&weightsFilename), "filename of the weights stored as Json file")
+	    ("model,m", po::value<std::string>(&modelFilename), "filename of model stored as Json, binary or HDF5 file")
+	    ("solution,s", po::value<std::string>(&solutionFilename), "filename where the tracking solution (as links) is stored as Json or HDF5 file")
+	    ("weights,w", po::value<std::string>(&weightsFilename), "filename of the weights stored as Json or HDF5 file")
 	;
 
 	po::variables_map variableMap;
@@ -37,15 +38,19 @@ int main(int argc, char** argv) {
 	    std::cout << "Model and Solution filenames have to be specified!" << std::endl;
 	    std::cout << description << std::endl;
 	} else {
-	    JsonModel model;
-		model.readFromJson(modelFilename);
+	    Hdf5Model model;
+		model.readFromFile(modelFilename);
 		WeightsType weights(model.computeNumWeights());
 		
 		if(variableMap.count("weights") > 0)
 		{
-			std::vector<double> weightVec = readWeightsFromJson(weightsFilename);
+			std::vector<double> weightVec = readWeightsFromFile(weightsFilename);
 			for(size_t i = 0; i < weightVec.size(); i++)
 				weights.setWeight(i, weightVec[i]);
+
+			std::shared_ptr<FeatureNormalization> normalization = readFeatureNormalizationFromFile(weightsFilename);
+			if(normalization)
+				model.setFeatureNormalization(normalization);
 		}
 		
 		model.initializeOpenGMModel(weights);
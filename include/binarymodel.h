@@ -0,0 +1,73 @@
+#ifndef BINARY_MODEL_H
+#define BINARY_MODEL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "jsonmodel.h"
+
+namespace mht
+{
+
+/**
+ * @brief Model that can be stored in a compact binary container, which is read by memory mapping the file
+ * @details All values are stored in native byte order, every section starts at a multiple of 8 bytes:
+ *          - BinaryModelHeader, followed by the settings as JSON text
+ *          - the ids of all segmentation hypotheses in the order of their keys (uint32 each, or uint64 offsets and characters for string ids)
+ *          - feature matrices of detections, divisions, appearances and disappearances, one row per segmentation hypothesis
+ *          - links as CSR adjacency: uint64 offsets per source segmentation, uint32 index of the destination segmentation,
+ *            followed by the link feature matrix
+ *          - divisions as CSR adjacency: uint64 offsets per parent segmentation, two uint32 children indices per division,
+ *            followed by the division feature matrix
+ *          - exclusion constraints: uint64 offsets per constraint and uint32 indices of the segmentations
+ *
+ *          A feature matrix consists of uint64 offsets into the states per row, uint64 offsets into the values per state
+ *          and all feature values as one contiguous array of doubles.
+ *          Segmentations are referenced by their index in the id column, so no id lookups are needed while loading.
+ *
+ *          Ground truth and results are read and written as JSON like in JsonModel.
+ */
+class BinaryModel : public JsonModel
+{
+public:
+	struct BinaryModelHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t stringIds;
+		uint64_t numSegmentations;
+		uint64_t numLinks;
+		uint64_t numDivisions;
+		uint64_t numExclusions;
+		uint64_t settingsSize;
+	};
+
+public:
+	/**
+	 * @brief Read a model from a binary container written by saveToBinary()
+	 * @param filename
+	 */
+	void readFromBinary(const std::string& filename);
+
+	/**
+	 * @brief Read a model from a binary container or a JSON file, depending on the contents of the file
+	 * @param filename
+	 */
+	void readFromFile(const std::string& filename);
+
+	/**
+	 * @brief Store all hypotheses, exclusion constraints and the settings in a binary container
+	 * @param filename
+	 */
+	void saveToBinary(const std::string& filename) const;
+
+	/**
+	 * @return whether the given file starts with the magic bytes of a binary model
+	 */
+	static bool isBinaryModelFile(const std::string& filename);
+};
+
+} // end namespace mht
+
+#endif // BINARY_MODEL_H
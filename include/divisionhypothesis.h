@@ -7,6 +7,7 @@
 
 #include <json/json.h>
 #include "helpers.h"
+#include "idtable.h"
 #include "segmentationhypothesis.h"
 #include "variable.h"
 
@@ -18,57 +19,76 @@ namespace mht
  * @details It can be read from Json, be added to an opengm model 
  * (with unary composed of several features that are learnable).
  */
-class DivisionHypothesis : public std::enable_shared_from_this<DivisionHypothesis>
+class DivisionHypothesis
 {
 public:
-	typedef std::tuple<helpers::IdLabelType, helpers::IdLabelType, helpers::IdLabelType> IdType;
+	// keys of parent and the two (sorted) children
+	typedef std::tuple<helpers::IdKey, helpers::IdKey, helpers::IdKey> IdType;
 	
 public:
 	DivisionHypothesis();
 
 	/**
 	 * @brief Construct this hypothesis manually - mainly needed for testing
+	 * @param featureStore the store of the model, the features are copied to its external division arena
 	 */
-	DivisionHypothesis(helpers::IdLabelType parent, const std::vector<helpers::IdLabelType>& children, const helpers::StateFeatureVector& features);
+	DivisionHypothesis(helpers::FeatureStore& featureStore, helpers::IdKey parent, const std::vector<helpers::IdKey>& children,
+		const helpers::StateFeatureVector& features);
 
-	const helpers::IdLabelType getParentId() const { return parentId_; }
-	const std::vector<helpers::IdLabelType>& getChildrenIds() const { return childrenIds_; }
+	/**
+	 * @brief Construct from features that were already added to the external division arena of the given store
+	 */
+	DivisionHypothesis(helpers::FeatureStore& featureStore, helpers::IdKey parent, const std::vector<helpers::IdKey>& children,
+		const helpers::FeatureRowRange& rows);
+
+	helpers::IdKey getParentKey() const { return parentKey_; }
+	const std::vector<helpers::IdKey>& getChildrenKeys() const { return childrenKeys_; }
 
 	/**
-	 * @brief Add this hypothesis to the OpenGM model
-	 * @details also adds the unary factor
+	 * @brief Add the variable of this hypothesis to the OpenGM model
 	 * 
 	 * @param model OpenGM model
+	 */
+	void addVariablesToOpenGMModel(helpers::GraphicalModelType& model);
+
+	/**
+	 * @brief Build the unary factor of this hypothesis, after its variable was added to the OpenGM model
+	 * 
+	 * @param factors buffer for the factors of the OpenGM model
 	 * @param weights OpenGM weight object (if you are running learning this must be a reference to the weight object of the dataset)
 	 * @param statesShareWeights whether there is one weight per feature for all states, or a separate weight for each feature and state
 	 * @param weightIds indices of the weights that are meant to be used together with the features (size must match 2*numFeatures)
+	 * @param energies if not nullptr, the unary is an explicit function of the energies of its variable (see Variable)
 	 */
 	void addToOpenGMModel(
-		helpers::GraphicalModelType& model, 
+		helpers::FactorBuffer& factors, 
 		helpers::WeightsType& weights, 
 		bool statesShareWeights,
-		const std::vector<size_t>& weightIds);
-
-	/**
-	 * @brief notify the three connected segmentation hypotheses about their new incoming/outgoing division link
-	 * 
-	 * @param segmentationHypotheses the map of all segmentation hypotheses
-	 */
-	void registerWithSegmentations(std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses);
+		const std::vector<size_t>& weightIds,
+		const helpers::UnaryEnergies* energies) const;
 
 	/**
 	 * @brief Save this node to an open ostream in the graphviz dot format
+	 * @param idTable the table of the model, to write the ids of the segmentation hypotheses
 	 */
-	void toDot(std::ostream& stream, const helpers::Solution* sol) const;
+	void toDot(std::ostream& stream, const helpers::Solution* sol, const helpers::IdTable& idTable) const;
 
 	/**
 	 * @return opengm variable
 	 */
 	const Variable& getVariable() const { return variable_; }
 
+	/**
+	 * @brief Standardize the features of this hypothesis in place
+	 */
+	void normalizeFeatures(const helpers::FeatureNormalization& normalization)
+	{
+		variable_.normalizeFeatures(normalization, helpers::VariableClass::ExternalDivision);
+	}
+
 private:
-	helpers::IdLabelType parentId_;
-	std::vector<helpers::IdLabelType> childrenIds_;
+	helpers::IdKey parentKey_;
+	std::vector<helpers::IdKey> childrenKeys_;
 	
 	Variable variable_;
 };
@@ -1,11 +1,15 @@
 #ifndef EXCLUSION_CONSTRAINT_H
 #define EXCLUSION_CONSTRAINT_H
 
+#include "idtable.h"
 #include "segmentationhypothesis.h"
 
 namespace mht
 {
 
+// forward declaration
+class HypothesisGraph;
+
 /**
  * @brief An exclusion constraint models that of a set of segmentation hypotheses only one can be active at once.
  */
@@ -17,31 +21,41 @@ public:
 	/**
 	 * @brief Manually create an exclusion constraint disallowing the two hypotheses to be active at the same time
 	 */
-	ExclusionConstraint(const std::vector<helpers::IdLabelType>& ids);
+	ExclusionConstraint(const std::vector<helpers::IdKey>& keys);
 	
 	/**
-	 * @brief Add this constraint to the OpenGM model
+	 * @brief Add an exclusion constraint of the graph to the OpenGM model
+	 * @details the graph may have merged several constraints of the model into one, see HypothesisGraph::mergeExclusionCliques()
 	 * 
 	 * @param model OpenGM model
-	 * @param segmentationHypotheses the map of all segmentation hypotheses by id
+	 * @param factors buffer for the factors of the OpenGM model
+	 * @param graph the graph of the model, after the detection variables were added
+	 * @param index the index of the constraint in the graph
 	 */
-	void addToOpenGMModel(helpers::GraphicalModelType& model, std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses);
+	static void addToOpenGMModel(
+		const helpers::GraphicalModelType& model,
+		helpers::FactorBuffer& factors,
+		const HypothesisGraph& graph,
+		size_t index);
 
 	/**
-	 * @brief Check that the given solution vector obeys this exclusion constraint
-	 * 
-	 * @param sol the opengm solution vector
-	 * @param segmentationHypotheses the map or all segmentation hypotheses by id
+	 * @return the number of variables of the constraint that addToOpenGMModel() adds, one per member and state > 0
 	 */
-	bool verifySolution(const helpers::Solution& sol, const std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses) const;
+	static size_t getNumOpenGMFactorVariables(const helpers::GraphicalModelType& model, const HypothesisGraph& graph, size_t index);
 
 	/**
 	 * @brief Save this constraint as red edges in a graphviz dot graph
+	 * @param idTable the table of the model, to write the ids of the segmentation hypotheses
+	 */
+	void toDot(std::ostream& stream, const helpers::IdTable& idTable) const;
+
+	/**
+	 * @return the keys of the segmentation hypotheses that exclude each other
 	 */
-	void toDot(std::ostream& stream) const;
+	const std::vector<helpers::IdKey>& getKeys() const { return keys_; }
 
 private:
-	std::vector<helpers::IdLabelType> ids_;
+	std::vector<helpers::IdKey> keys_;
 };
 
 } // end namespace mht
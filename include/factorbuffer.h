@@ -0,0 +1,148 @@
+#ifndef FACTOR_BUFFER_H
+#define FACTOR_BUFFER_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "helpers.h"
+
+namespace helpers
+{
+
+/**
+ * @brief Numbers of factors and of the variables they are defined on, to reserve the storage of an OpenGM model before it is built
+ */
+struct FactorCounts
+{
+	size_t numUnaries = 0;
+	size_t numConstraints = 0;
+	size_t numFactorVariables = 0;
+
+	void addUnaries(size_t numVariables) { numUnaries += numVariables; numFactorVariables += numVariables; }
+	void addConstraint(size_t numVariables) { numConstraints++; numFactorVariables += numVariables; }
+	size_t getNumFactors() const { return numUnaries + numConstraints; }
+
+	bool operator==(const FactorCounts& other) const
+	{
+		return numUnaries == other.numUnaries && numConstraints == other.numConstraints && numFactorVariables == other.numFactorVariables;
+	}
+	bool operator!=(const FactorCounts& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Functions and factors that are built apart from the OpenGM model, e.g. on another thread, and are added to it later
+ * @details addToModel() adds the factors in the order in which they were buffered. If the factors of consecutive blocks
+ *          of hypotheses are built in parallel and the buffers are added one after the other, the model is the same
+ *          as if every factor had been added directly.
+ *          Many constraints have the same shape, coefficients, bound and operator, e.g. all pairwise exclusions.
+ *          Such constraint functions are stored once, and all their factors use the same function of the model.
+ */
+class FactorBuffer
+{
+public:
+	/**
+	 * @brief the shape, indicator variables, coefficients, bound and operator of a linear constraint, as numbers
+	 */
+	typedef std::vector<ValueType> ConstraintKey;
+
+	struct ConstraintKeyHash
+	{
+		size_t operator()(const ConstraintKey& key) const;
+	};
+
+	/**
+	 * @brief the constraint functions that were added to a model, shared by all buffers that are added to the same model
+	 */
+	typedef std::unordered_map<ConstraintKey, GraphicalModelType::FunctionIdentifier, ConstraintKeyHash> ConstraintFunctionCache;
+
+public:
+	/**
+	 * @brief buffer a factor of the given function over the variables in [variablesBegin, variablesEnd)
+	 */
+	template<class FUNCTION, class ITERATOR>
+	void addFactor(const FUNCTION& function, ITERATOR variablesBegin, ITERATOR variablesEnd)
+	{
+		FunctionKind kind;
+		size_t functionIndex = storeFunction(function, kind);
+		addFactor(kind, functionIndex, variablesBegin, variablesEnd);
+	}
+
+	/**
+	 * @brief buffer a factor of a linear constraint, whose function is only built if no identical constraint was buffered before
+	 * 
+	 * @param constraint the constraint, its indicator variables reference the positions in the factor variables
+	 * @param constraintShape the number of labels of all variables of the constraint
+	 * @param factorVariables the opengm variables of the constraint
+	 */
+	void addConstraintFactor(
+		const LinearConstraintFunctionType::LinearConstraintType& constraint,
+		const std::vector<LabelType>& constraintShape,
+		const std::vector<LabelType>& factorVariables);
+
+	size_t getNumFactors() const { return factors_.size(); }
+
+	/**
+	 * @brief add the buffered factors to the counts, constraints as constraints and all other factors as unaries
+	 */
+	void countFactors(FactorCounts& counts) const;
+
+	/**
+	 * @brief add all buffered functions and factors to the model, in the order in which they were buffered
+	 * 
+	 * @param model the OpenGM model
+	 * @param cache the constraint functions in the model, constraints that are not yet in there are added to the model and the cache
+	 */
+	void addToModel(GraphicalModelType& model, ConstraintFunctionCache& cache) const;
+
+	/**
+	 * @brief drop all buffered factors
+	 */
+	void clear();
+
+private:
+	enum class FunctionKind {LearnableUnary, LearnableWeightedSum, LinearConstraint, Explicit};
+
+	struct Factor
+	{
+		FunctionKind kind;
+		size_t function;
+		size_t firstVariable;
+		size_t numVariables;
+	};
+
+	template<class ITERATOR>
+	void addFactor(FunctionKind kind, size_t functionIndex, ITERATOR variablesBegin, ITERATOR variablesEnd)
+	{
+		Factor factor;
+		factor.kind = kind;
+		factor.function = functionIndex;
+		factor.firstVariable = variables_.size();
+		variables_.insert(variables_.end(), variablesBegin, variablesEnd);
+		factor.numVariables = variables_.size() - factor.firstVariable;
+		factors_.push_back(factor);
+	}
+
+	/**
+	 * @return the index of the function in the list of its kind, constraints are stored by addConstraintFactor()
+	 */
+	size_t storeFunction(const LearnableUnaryFuncType& function, FunctionKind& kind);
+	size_t storeFunction(const LearnableWeightedSumOfFuncType& function, FunctionKind& kind);
+	size_t storeFunction(const ExplicitFunctionType& function, FunctionKind& kind);
+
+private:
+	std::vector<LearnableUnaryFuncType> learnableUnaries_;
+	std::vector<LearnableWeightedSumOfFuncType> learnableWeightedSums_;
+	std::vector<LinearConstraintFunctionType> linearConstraints_;
+	// the keys of the buffered constraint functions, and their indices
+	std::vector<ConstraintKey> constraintKeys_;
+	std::unordered_map<ConstraintKey, size_t, ConstraintKeyHash> constraintIndices_;
+	std::vector<ExplicitFunctionType> explicitFunctions_;
+
+	// the variables of all factors, one after the other
+	std::vector<IndexType> variables_;
+	std::vector<Factor> factors_;
+};
+
+} // end namespace helpers
+
+#endif // FACTOR_BUFFER_H
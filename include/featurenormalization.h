@@ -0,0 +1,110 @@
+#ifndef FEATURE_NORMALIZATION_H
+#define FEATURE_NORMALIZATION_H
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <json/json.h>
+#include "helpers.h"
+#include "featurestore.h"
+
+namespace helpers
+{
+
+/**
+ * @brief Standardizes features to zero mean and unit variance, separately for every variable class.
+ * @details The statistics are accumulated while a model is loaded, and turned into a transform by finalize().
+ *          If states share weights, the statistics of a feature are pooled over all states,
+ *          otherwise every state/feature combination (=every weight) gets its own mean and scale.
+ *          Features with zero variance (e.g. constant bias features) are left untouched.
+ */
+class FeatureNormalization
+{
+public:
+	/**
+	 * @brief Create an empty normalization that can accumulate statistics
+	 */
+	FeatureNormalization();
+
+	/**
+	 * @brief Load a finalized normalization from a JSON entry, as written by saveToJson()
+	 */
+	FeatureNormalization(const Json::Value& entry);
+
+	/**
+	 * @brief Add the features of one state of a variable to the running statistics of its class
+	 */
+	void accumulate(VariableClass variableClass, size_t state, const FeatureRow& features);
+
+	/**
+	 * @brief Add the running statistics of another (not yet finalized) normalization, e.g. of another model
+	 */
+	void merge(const FeatureNormalization& other);
+
+	/**
+	 * @brief Compute mean and scale of every feature from the accumulated statistics
+	 *
+	 * @param statesShareWeights whether the statistics of a feature should be pooled over all states
+	 */
+	void finalize(bool statesShareWeights);
+
+	/**
+	 * @return whether finalize() was called or the normalization was loaded, and it can be applied
+	 */
+	bool isFinalized() const { return finalized_; }
+
+	/**
+	 * @return whether statistics were pooled over states
+	 */
+	bool getStatesShareWeights() const { return statesShareWeights_; }
+
+	/**
+	 * @brief Standardize the given features of one state of a variable of the given class in place
+	 */
+	void apply(VariableClass variableClass, size_t state, FeatureValueType* features, size_t numFeatures) const;
+
+	/**
+	 * @brief Store the finalized mean and scale to the given JSON entry
+	 */
+	void saveToJson(Json::Value& entry) const;
+
+private:
+	/**
+	 * @brief Running mean and variance of one feature (Welford's algorithm)
+	 */
+	struct RunningStatistics
+	{
+		RunningStatistics(): count(0), mean(0.0), sumOfSquaredDifferences(0.0) {}
+		void add(double value);
+		void merge(const RunningStatistics& other);
+		double standardDeviation() const;
+
+		size_t count;
+		double mean;
+		double sumOfSquaredDifferences;
+	};
+
+	typedef std::vector< std::vector<RunningStatistics> > StateStatistics;
+
+	// accumulated statistics per class, state and feature
+	std::map<VariableClass, StateStatistics> statistics_;
+	// mean and scale per class, state (or a single row if states share weights) and feature
+	std::map<VariableClass, StateFeatureVector> mean_;
+	std::map<VariableClass, StateFeatureVector> scale_;
+
+	bool statesShareWeights_;
+	bool finalized_;
+};
+
+/**
+ * @brief read the feature normalization that was stored together with the weights in a Json file
+ *
+ * @param filename
+ * @return the normalization, or nullptr if the file contains none
+ */
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromJson(const std::string& filename);
+
+} // end namespace helpers
+
+#endif // FEATURE_NORMALIZATION_H
@@ -0,0 +1,202 @@
+#ifndef FEATURE_STORE_H
+#define FEATURE_STORE_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "helpers.h"
+
+namespace helpers
+{
+
+/**
+ * @brief A view of the features of one state of a variable, valid until more features are added to its arena
+ */
+class FeatureRow
+{
+public:
+	FeatureRow(): data_(nullptr), size_(0) {}
+	FeatureRow(const FeatureValueType* data, size_t size): data_(data), size_(size) {}
+
+	const FeatureValueType* data() const { return data_; }
+	const FeatureValueType* begin() const { return data_; }
+	const FeatureValueType* end() const { return data_ + size_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	FeatureValueType operator[](size_t i) const { return data_[i]; }
+
+private:
+	const FeatureValueType* data_;
+	size_t size_;
+};
+
+/**
+ * @brief The rows of the states of one variable in an arena, as returned by FeatureArena::addRows()
+ */
+class FeatureRowRange
+{
+public:
+	FeatureRowRange(size_t firstRow, size_t numRows): firstRow_(firstRow), numRows_(numRows) {}
+
+	size_t getFirstRow() const { return firstRow_; }
+	size_t getNumRows() const { return numRows_; }
+
+private:
+	size_t firstRow_;
+	size_t numRows_;
+};
+
+/**
+ * @return the sum of features[i] * weights[i]
+ * @details uses several independent sums, so that the compiler can vectorize the loop
+ */
+inline ValueType dotProduct(const FeatureValueType* features, const ValueType* weights, size_t size)
+{
+	ValueType sums[4] = {0.0, 0.0, 0.0, 0.0};
+	size_t i = 0;
+	for(; i + 4 <= size; i += 4)
+	{
+		sums[0] += features[i] * weights[i];
+		sums[1] += features[i + 1] * weights[i + 1];
+		sums[2] += features[i + 2] * weights[i + 2];
+		sums[3] += features[i + 3] * weights[i + 3];
+	}
+	for(; i < size; ++i)
+		sums[0] += features[i] * weights[i];
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+/**
+ * @brief Contiguous storage of the features of all variables of one class.
+ * @details Every state of a variable references one row, the references of a variable are stored one after the other.
+ *          Identical rows are stored only once and counted, e.g. if states repeat their features because they must not share
+ *          weights, or if many variables have the same (constant) features. All values live in a single array,
+ *          so a model needs a handful of allocations per variable class instead of one per variable and state.
+ */
+class FeatureArena
+{
+public:
+	FeatureArena(): offsets_(1, 0), numIndexed_(0), released_(false) {}
+
+	/**
+	 * @brief append one row per state of a variable
+	 * @return the index of the first row
+	 */
+	size_t addRows(const StateFeatureVector& features);
+
+	/**
+	 * @brief append one row per state of a variable, taken from features stored as compressed sparse rows
+	 * @details the features of state s are values[featureOffsets[s]] to values[featureOffsets[s + 1] - 1],
+	 *          e.g. a section of a mapped file, so they are copied into the arena without building a StateFeatureVector
+	 * @return the index of the first row
+	 */
+	size_t addRows(const double* values, const uint64_t* featureOffsets, size_t numStates);
+
+	FeatureRow getRow(size_t row) const { return getStoredRow(rows_[row]); }
+
+	/**
+	 * @brief replace the values of a row, e.g. by standardized ones. Other rows with the same values are not changed
+	 */
+	void setRow(size_t row, const FeatureValueType* values, size_t numValues);
+
+	/**
+	 * @return the number of rows, i.e. of states of all variables
+	 */
+	size_t getNumRows() const { return rows_.size(); }
+
+	/**
+	 * @return the number of distinct rows that are actually stored
+	 */
+	size_t getNumStoredRows() const { return refCounts_.size(); }
+
+	size_t getNumValues() const { return values_.size(); }
+
+	/**
+	 * @brief reserve space for the given number of rows, e.g. if a reader knows the size of the model
+	 */
+	void reserve(size_t numRows) { rows_.reserve(rows_.size() + numRows); }
+
+	/**
+	 * @brief drop stored rows that are no longer referenced, and release unused capacity
+	 */
+	void compact();
+
+	/**
+	 * @brief free all rows, e.g. once the OpenGM model holds its own copy of the features. No rows can be read or added afterwards
+	 */
+	void release();
+
+	bool isReleased() const { return released_; }
+
+	/**
+	 * @return the number of bytes allocated by this arena
+	 */
+	size_t getMemoryUsage() const;
+
+private:
+	FeatureRow getStoredRow(uint32_t storedRow) const
+	{
+		return FeatureRow(values_.data() + offsets_[storedRow], offsets_[storedRow + 1] - offsets_[storedRow]);
+	}
+
+	/**
+	 * @return the stored row with the given values, which is added if there is none yet. Its reference count is incremented
+	 */
+	uint32_t intern(const FeatureValueType* values, size_t numValues);
+
+	/**
+	 * @brief rebuild the hash index of the stored rows with the given number of slots (a power of two)
+	 */
+	void rebuildIndex(size_t numSlots);
+
+private:
+	// the stored row referenced by every variable state
+	std::vector<uint32_t> rows_;
+	// distinct rows, as offsets into the values, and how many variable states use them
+	std::vector<uint64_t> offsets_;
+	std::vector<FeatureValueType> values_;
+	std::vector<uint32_t> refCounts_;
+	// open addressing hash table of the stored rows, used to find duplicates
+	std::vector<uint32_t> index_;
+	size_t numIndexed_;
+	bool released_;
+#ifdef USE_FLOAT_FEATURES
+	// a row converted to single precision, before it is interned
+	std::vector<FeatureValueType> converted_;
+#endif
+};
+
+/**
+ * @brief The feature arenas of all variable classes of a model
+ */
+class FeatureStore
+{
+public:
+	FeatureArena& getArena(VariableClass variableClass) { return arenas_[static_cast<size_t>(variableClass)]; }
+	const FeatureArena& getArena(VariableClass variableClass) const { return arenas_[static_cast<size_t>(variableClass)]; }
+
+	/**
+	 * @brief drop the stored rows of all arenas that are no longer referenced
+	 */
+	void compact();
+
+	/**
+	 * @brief free the rows of all arenas, see FeatureArena::release()
+	 */
+	void release();
+
+	bool isReleased() const { return arenas_[0].isReleased(); }
+
+	/**
+	 * @return the number of bytes allocated by all arenas
+	 */
+	size_t getMemoryUsage() const;
+
+private:
+	std::array<FeatureArena, static_cast<size_t>(VariableClass::ExternalDivision) + 1> arenas_;
+};
+
+} // end namespace helpers
+
+#endif // FEATURE_STORE_H
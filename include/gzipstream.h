@@ -0,0 +1,132 @@
+#ifndef GZIP_STREAM_H
+#define GZIP_STREAM_H
+
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+namespace helpers
+{
+
+/**
+ * @brief Stream buffer that decompresses gzip (or zlib) data read from another stream buffer.
+ *        Concatenated gzip members are read as one stream, like gunzip does.
+ */
+class GzipInputStreamBuf : public std::streambuf
+{
+public:
+	GzipInputStreamBuf(std::streambuf& source, size_t bufferSize = 1 << 18);
+	~GzipInputStreamBuf();
+
+	GzipInputStreamBuf(const GzipInputStreamBuf&) = delete;
+	GzipInputStreamBuf& operator=(const GzipInputStreamBuf&) = delete;
+
+protected:
+	virtual int_type underflow();
+
+private:
+	std::streambuf& source_;
+	std::vector<char> compressed_;
+	std::vector<char> decompressed_;
+	z_stream zstream_;
+	bool endOfInput_;
+};
+
+/**
+ * @brief Stream buffer that writes gzip compressed data to another stream buffer.
+ *        The gzip trailer is written by finish(), or on destruction.
+ */
+class GzipOutputStreamBuf : public std::streambuf
+{
+public:
+	GzipOutputStreamBuf(std::streambuf& target, int compressionLevel = Z_DEFAULT_COMPRESSION, size_t bufferSize = 1 << 18);
+	~GzipOutputStreamBuf();
+
+	GzipOutputStreamBuf(const GzipOutputStreamBuf&) = delete;
+	GzipOutputStreamBuf& operator=(const GzipOutputStreamBuf&) = delete;
+
+	/**
+	 * @brief compress all pending data and write the end of the gzip stream
+	 * @return false if writing to the target failed
+	 */
+	bool finish();
+
+protected:
+	virtual int_type overflow(int_type c);
+	virtual int sync();
+
+private:
+	/// compress the buffered data with the given zlib flush mode
+	bool deflateBuffer(int flush);
+
+private:
+	std::streambuf& target_;
+	std::vector<char> uncompressed_;
+	std::vector<char> compressed_;
+	z_stream zstream_;
+	bool finished_;
+};
+
+/**
+ * @brief Input file stream that transparently decompresses gzip files, detected by their magic bytes
+ */
+class InputFileStream : public std::istream
+{
+public:
+	/**
+	 * @param filename the file is opened in binary mode, check good() afterwards.
+	 *        Once it is open, read errors like corrupt compressed data are thrown as std::runtime_error
+	 */
+	InputFileStream(const std::string& filename);
+
+	/**
+	 * @return whether the file is gzip compressed
+	 */
+	bool isCompressed() const { return gzip_ != nullptr; }
+
+private:
+	std::filebuf file_;
+	std::unique_ptr<GzipInputStreamBuf> gzip_;
+};
+
+/**
+ * @brief Output file stream that transparently compresses the data if the filename ends with .gz
+ */
+class OutputFileStream : public std::ostream
+{
+public:
+	/**
+	 * @param filename the file to create, check good() afterwards
+	 */
+	OutputFileStream(const std::string& filename);
+	~OutputFileStream();
+
+	/**
+	 * @brief flush and close the file, the stream state is set to failed if anything could not be written
+	 */
+	void close();
+
+private:
+	std::filebuf file_;
+	std::unique_ptr<GzipOutputStreamBuf> gzip_;
+};
+
+/**
+ * @return whether the given file starts with the gzip magic bytes
+ */
+bool isGzipFile(const std::string& filename);
+
+/**
+ * @return whether the filename ends with .gz
+ */
+bool hasGzipExtension(const std::string& filename);
+
+} // end namespace helpers
+
+#endif // GZIP_STREAM_H
@@ -0,0 +1,139 @@
+#ifndef HDF5_MODEL_H
+#define HDF5_MODEL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binarymodel.h"
+#include "featurenormalization.h"
+
+namespace mht
+{
+
+/**
+ * @brief Model that can additionally be read from and written to HDF5 files, results and ground truth as well.
+ * @details The datasets use the same names as the JSON format:
+ *          - root attribute "settings": the settings as JSON text (optional)
+ *          - "segmentationHypotheses/id": N ids (unsigned integers, or strings if USE_STRING_IDS is defined)
+ *          - "segmentationHypotheses/features", and optionally "divisionFeatures", "appearanceFeatures" and "disappearanceFeatures"
+ *          - "linkingHypotheses/src", "linkingHypotheses/dest" and "linkingHypotheses/features"
+ *          - "divisions/parent", "divisions/children" (D x 2) and "divisions/features"
+ *          - "exclusions/id": the ids of all constraints concatenated, "exclusions/offsets": E+1 start indices into "id"
+ *
+ *          A feature group contains a dataset "values" of shape (rows x states x features) and optionally "numStates" (rows),
+ *          the number of states used by each row. A row with 0 states does not have the variable, e.g. cannot divide.
+ *
+ *          Results and ground truth use the groups "detectionResults" (id, value), "linkingResults" (src, dest, value),
+ *          "divisionResults" (id, value) for divisions within detections and "externalDivisionResults" (parent, children, value).
+ *          Datasets are written chunked and compressed, and large feature datasets are read in blocks of rows.
+ */
+class Hdf5Model : public BinaryModel
+{
+public:
+	/**
+	 * @brief Read a model from an HDF5 file
+	 * @param filename
+	 */
+	void readFromHdf5(const std::string& filename);
+
+	/**
+	 * @brief Read a model from an HDF5, binary or JSON file, depending on the contents of the file
+	 * @param filename
+	 */
+	void readFromFile(const std::string& filename);
+
+	/**
+	 * @brief Store all hypotheses, exclusion constraints and the settings in an HDF5 file
+	 *
+	 * @param filename
+	 * @param compressionLevel gzip level of the datasets, 0 disables compression
+	 */
+	void saveToHdf5(const std::string& filename, int compressionLevel = 4) const;
+
+	/**
+	 * @brief Export a found solution vector to an HDF5 file
+	 *
+	 * @param filename where to save the result
+	 * @param sol the labeling to save
+	 */
+	void saveResultToHdf5(const std::string& filename, const helpers::Solution& sol) const;
+
+	/**
+	 * @brief Export a found solution vector to HDF5 if the filename has an HDF5 extension, otherwise to JSON
+	 * @param compact write JSON without indentation, see saveResultToJson()
+	 */
+	void saveResultToFile(const std::string& filename, const helpers::Solution& sol, bool compact = false) const;
+
+	/**
+	 * @brief get the ground truth for learning from the file given by setJsonGtFile(), which may be an HDF5 or JSON file
+	 * @return the solution vector that fits the initialized OpenGM model
+	 */
+	virtual helpers::Solution getGroundTruth();
+
+	/**
+	 * @return whether the given file exists and is an HDF5 file
+	 */
+	static bool isHdf5File(const std::string& filename);
+
+	/**
+	 * @return whether the filename ends with .h5 or .hdf5
+	 */
+	static bool hasHdf5Extension(const std::string& filename);
+
+private:
+	helpers::Solution readGroundTruthFromHdf5(const std::string& filename);
+};
+
+} // end namespace mht
+
+namespace helpers
+{
+
+/**
+ * @brief save weights to the dataset "weights" of an HDF5 file
+ *
+ * @param weights a vector of weights (not the OpenGM Weight object)
+ * @param filename file to save the weights to
+ * @param weightDescriptions an optional vector that contains a description for each weight, stored as "weightDescriptions"
+ * @param normalization an optional feature normalization, stored as JSON text in the root attribute "featureNormalization"
+ */
+void saveWeightsToHdf5(
+	const std::vector<ValueType>& weights,
+	const std::string& filename,
+	const std::vector<std::string>& weightDescriptions = {},
+	const FeatureNormalization* normalization = nullptr);
+
+/**
+ * @brief read weights from HDF5
+ */
+std::vector<ValueType> readWeightsFromHdf5(const std::string& filename);
+
+/**
+ * @brief read the feature normalization stored with the weights in an HDF5 file
+ * @return the normalization, or nullptr if the file does not contain one
+ */
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromHdf5(const std::string& filename);
+
+/**
+ * @brief save weights to HDF5 if the filename has an HDF5 extension, otherwise to JSON
+ */
+void saveWeightsToFile(
+	const std::vector<ValueType>& weights,
+	const std::string& filename,
+	const std::vector<std::string>& weightDescriptions = {},
+	const FeatureNormalization* normalization = nullptr);
+
+/**
+ * @brief read weights from an HDF5 or JSON file, depending on the contents of the file
+ */
+std::vector<ValueType> readWeightsFromFile(const std::string& filename);
+
+/**
+ * @brief read the feature normalization from an HDF5 or JSON weights file, depending on the contents of the file
+ */
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromFile(const std::string& filename);
+
+} // end namespace helpers
+
+#endif // HDF5_MODEL_H
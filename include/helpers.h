@@ -1,7 +1,9 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
+#include <cstdint>
 #include <iostream>
+#include <string>
 #include <vector>
 
 // opengm
@@ -15,6 +17,8 @@
 #include <opengm/learning/dataset/editabledataset.hxx>
 #include <opengm/learning/loss/hammingloss.hxx>
 
+#include "trackingloss.h"
+
 // json
 #include <json/json.h>
 
@@ -37,7 +41,7 @@ typedef opengm::ExplicitFunction<ValueType, IndexType, LabelType> ExplicitFuncti
 typedef opengm::UnaryLossFunction<ValueType, IndexType, LabelType> UnaryLossFunctionType;
 typedef opengm::meta::TypeListGenerator< LearnableUnaryFuncType, LearnableWeightedSumOfFuncType, LinearConstraintFunctionType, UnaryLossFunctionType, ExplicitFunctionType >::type FunctionTypeList;
 typedef opengm::GraphicalModel<ValueType, opengm::Adder, FunctionTypeList> GraphicalModelType;
-typedef opengm::learning::HammingLoss	LossType;
+typedef TrackingLoss LossType;
 typedef opengm::datasets::EditableDataset<GraphicalModelType, LossType> DatasetType;
 typedef std::vector<LabelType> Solution;
 typedef opengm::learning::Weights<ValueType> WeightsType;
@@ -47,13 +51,23 @@ typedef LinearConstraintFunctionType::LinearConstraintType::IndicatorVariableTyp
 typedef std::vector<ValueType> FeatureVector;
 typedef std::vector<FeatureVector> StateFeatureVector;
 
+// features are stored in single precision with USE_FLOAT_FEATURES, computations still use ValueType
+#ifdef USE_FLOAT_FEATURES
+typedef float FeatureValueType;
+#else
+typedef ValueType FeatureValueType;
+#endif
+
 
+// IdLabelType is the id used in files, IdKey identifies a hypothesis inside a model (see IdTable)
 #ifdef USE_STRING_IDS
 typedef std::string IdLabelType;
+typedef uint32_t IdKey;
 #define asLabelType asString
 #define isLabelType isString
 #else
 typedef unsigned int IdLabelType;
+typedef IdLabelType IdKey;
 #define asLabelType asUInt
 #define isLabelType isUInt
 #endif
@@ -100,7 +114,7 @@ void addOpenGMVariableToConstraint(
 	double coefficient,
 	std::vector<LabelType>& constraintShape,
 	std::vector<LabelType>& factorVariables,
-	GraphicalModelType& model);
+	const GraphicalModelType& model);
 
 /**
  * @brief add the variable's value to the constraint, not just an indicator variable
@@ -118,7 +132,10 @@ void addOpenGMVariableStateToConstraint(
 	double coefficient,
 	std::vector<LabelType>& constraintShape,
 	std::vector<LabelType>& factorVariables,
-	GraphicalModelType& model);
+	const GraphicalModelType& model);
+
+class FactorBuffer;
+struct FactorCounts;
 
 /**
  * @brief add the variable's value to the constraint, not just an indicator variable
@@ -126,13 +143,13 @@ void addOpenGMVariableStateToConstraint(
  * @param constraint the constraint function to add to the model
  * @param constraintShape a vector containing the number of labels of all variables of the constraint
  * @param factorVariables list of opengm variables that this constraint should reason about
- * @param model the opengm model
+ * @param factors the buffer that collects the factors for the opengm model
  */
 void addConstraintToOpenGMModel(
 	LinearConstraintFunctionType::LinearConstraintType& constraint, 
 	std::vector<LabelType>& constraintShape,
 	std::vector<LabelType>& factorVariables,
-	GraphicalModelType& model);
+	FactorBuffer& factors);
 
 // --------------------------------------------------------------
 // json type definitions
@@ -148,6 +165,7 @@ enum class JsonTypes {Segmentations,
 	LinkResults, 
 	DivisionResults,
 	DetectionResults,
+	ExternalDivisionResults,
 	SrcId, 
 	DestId, 
 	Value, 
@@ -158,7 +176,11 @@ enum class JsonTypes {Segmentations,
 	DivisionFeatures,
 	AppearanceFeatures,
 	DisappearanceFeatures,
+	// shorthand for features that are the same for all states
+	Values,
+	NumStates,
 	Weights,
+	WeightDescriptions,
 	// settings-related
 	Settings,
 	StatesShareWeights,
@@ -166,23 +188,54 @@ enum class JsonTypes {Segmentations,
 	OptimizerVerbose,
 	OptimizerNumThreads,
 	AllowPartialMergerAppearance,
-	RequireSeparateChildrenOfDivision
+	RequireSeparateChildrenOfDivision,
+	DetectionLossWeight,
+	LinkLossWeight,
+	DivisionLossWeight,
+	AppearanceLossWeight,
+	DisappearanceLossWeight,
+	TrackingAwareLoss,
+	StandardizeFeatures,
+	MergeExclusionCliques,
+	MaxExclusionCliqueSize,
+	// feature normalization
+	FeatureNormalization,
+	Mean,
+	Scale
 };
 
 /// mapping from JsonTypes to strings which are used in the Json files
 extern std::map<JsonTypes, std::string> JsonTypeNames;
 
+/**
+ * @brief Enumerate the kinds of OpenGM variables, each of them has its own set of weights
+ */
+enum class VariableClass {Link,
+	Detection,
+	Division,
+	Appearance,
+	Disappearance,
+	ExternalDivision
+};
+
+/// mapping from VariableClass to the names used when storing per-class data, e.g. the feature normalization
+extern std::map<VariableClass, std::string> VariableClassNames;
+
+class FeatureNormalization;
+
 /**
  * @brief save weights to Json
  * 
  * @param weights a vector of weights (not the OpenGM Weight object)
  * @param filename file to save the weights to
  * @param weightDescriptions an optional vector that contains a description for each weight
+ * @param normalization an optional feature normalization that was used to learn the weights and must be applied during tracking
  */
 void saveWeightsToJson(
 	const std::vector<ValueType>& weights, 
 	const std::string& filename,
-	const std::vector<std::string>& weightDescriptions = {});
+	const std::vector<std::string>& weightDescriptions = {},
+	const FeatureNormalization* normalization = nullptr);
 
 /**
  * @brief read weights from Json
@@ -194,6 +247,8 @@ std::vector<ValueType> readWeightsFromJson(const std::string& filename);
 
 /**
  * @brief Extract a list of detection/division/disapperance/appearance features for each state from a given entry
+ * @details instead of a list per state, the entry can be an object {"values": [...], "numStates": n}
+ *          with the features that all n states share
  * 
  * @param entry the json root to extract the features from
  * @param type the type of feature to extract (checks for the respectively named member!)
@@ -0,0 +1,192 @@
+#ifndef HYPOTHESIS_GRAPH_H
+#define HYPOTHESIS_GRAPH_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "helpers.h"
+#include "idtable.h"
+#include "segmentationhypothesis.h"
+#include "linkinghypothesis.h"
+#include "divisionhypothesis.h"
+#include "exclusionconstraint.h"
+
+namespace mht
+{
+
+/**
+ * @brief Flat, index based view of the hypotheses of a model, used by all loops that run over the whole graph.
+ * @details Segmentations, links and divisions are numbered in the order of the maps of the model, which is also the order
+ *          in which they are added to OpenGM, so that the variable ids grow with the indices.
+ *          The adjacency of the segmentations and the members of the exclusion constraints are stored as compressed
+ *          sparse rows (an array of offsets and one array of indices), and the OpenGM variable ids in one array per
+ *          variable class. Checking or exporting a solution thus only reads a few dense arrays.
+ *
+ *          The maps of the model still own the hypotheses: readers add them by id in any order, ground truth and results
+ *          are matched by id, and the key order of the maps defines the order of the OpenGM variables. Per element, the maps
+ *          now only hold a tree node (plus a shared_ptr control block for links and divisions) and the variables, the features
+ *          are in the FeatureStore. Measured with 3 states and one feature per variable, a segmentation takes 225 bytes and
+ *          a link 125 bytes (712 and 339 bytes with the adjacency in the hypotheses and the features in the variables),
+ *          and this graph adds 25 bytes per hypothesis.
+ */
+class HypothesisGraph
+{
+public:
+	typedef std::map<helpers::IdKey, SegmentationHypothesis> SegmentationMap;
+	typedef std::map<std::pair<helpers::IdKey, helpers::IdKey>, std::shared_ptr<LinkingHypothesis> > LinkMap;
+	typedef std::map<DivisionHypothesis::IdType, std::shared_ptr<DivisionHypothesis> > DivisionMap;
+
+	/**
+	 * @brief A range of indices in one row of an adjacency, usable in range based for loops
+	 */
+	class IndexRange
+	{
+	public:
+		IndexRange(const uint32_t* begin, const uint32_t* end): begin_(begin), end_(end) {}
+		const uint32_t* begin() const { return begin_; }
+		const uint32_t* end() const { return end_; }
+		size_t size() const { return end_ - begin_; }
+		bool empty() const { return begin_ == end_; }
+
+	private:
+		const uint32_t* begin_;
+		const uint32_t* end_;
+	};
+
+public:
+	/**
+	 * @brief Number all hypotheses and build the adjacency, the variable ids are reset to -1
+	 * @details throws if a link, division or exclusion references an unknown segmentation hypothesis
+	 *
+	 * @param idTable the table of the model, to report unknown ids
+	 */
+	void build(
+		const SegmentationMap& segmentations,
+		const LinkMap& links,
+		const DivisionMap& divisions,
+		const std::vector<ExclusionConstraint>& exclusions,
+		const helpers::IdTable& idTable);
+
+	/**
+	 * @brief Replace the exclusion constraints by cliques of segmentations that all exclude each other pairwise
+	 * @details Two segmentations conflict if they are members of the same exclusion constraint. Starting from the largest
+	 *          constraints, each constraint whose conflicts are not yet covered by a clique is grown by the segmentations that
+	 *          conflict with all of its members. One clique constraint replaces several overlapping ones, which gives the
+	 *          solver fewer constraints and a tighter LP relaxation, while the set of feasible solutions stays the same.
+	 *
+	 * @param maxCliqueSize constraints are not grown beyond this number of members, 0 for no limit
+	 */
+	void mergeExclusionCliques(size_t maxCliqueSize);
+
+	/**
+	 * @brief Copy the OpenGM variable ids of all hypotheses, must be given the same maps as build()
+	 */
+	void updateVariableIds(const SegmentationMap& segmentations, const LinkMap& links, const DivisionMap& divisions);
+
+	size_t getNumSegmentations() const { return keys_.size(); }
+	size_t getNumLinks() const { return linkSources_.size(); }
+	size_t getNumDivisions() const { return divisionParents_.size(); }
+	size_t getNumExclusions() const { return exclusionOffsets_.empty() ? 0 : exclusionOffsets_.size() - 1; }
+
+	/**
+	 * @return the key of the segmentation with the given index
+	 */
+	helpers::IdKey getKey(size_t segmentation) const { return keys_[segmentation]; }
+
+	uint32_t getLinkSource(size_t link) const { return linkSources_[link]; }
+	uint32_t getLinkDestination(size_t link) const { return linkDestinations_[link]; }
+	uint32_t getDivisionParent(size_t division) const { return divisionParents_[division]; }
+	uint32_t getDivisionChild(size_t division, size_t child) const { return divisionChildren_[2 * division + child]; }
+
+	/**
+	 * @return the indices of the links / divisions of a segmentation, ordered by their OpenGM variable ids
+	 */
+	IndexRange getIncomingLinks(size_t segmentation) const { return row(incomingLinkOffsets_, incomingLinks_, segmentation); }
+	IndexRange getOutgoingLinks(size_t segmentation) const { return row(outgoingLinkOffsets_, outgoingLinks_, segmentation); }
+	IndexRange getIncomingDivisions(size_t segmentation) const { return row(incomingDivisionOffsets_, incomingDivisions_, segmentation); }
+	IndexRange getOutgoingDivisions(size_t segmentation) const { return row(outgoingDivisionOffsets_, outgoingDivisions_, segmentation); }
+
+	/**
+	 * @return the indices of the segmentations of an exclusion constraint, ordered by their OpenGM variable ids
+	 */
+	IndexRange getExclusionMembers(size_t exclusion) const { return row(exclusionOffsets_, exclusionMembers_, exclusion); }
+
+	/**
+	 * @return OpenGM variable ids, or -1 if the variable is not part of the OpenGM model
+	 */
+	int getDetectionVariable(size_t segmentation) const { return detectionVariables_[segmentation]; }
+	int getDivisionVariable(size_t segmentation) const { return divisionVariables_[segmentation]; }
+	int getAppearanceVariable(size_t segmentation) const { return appearanceVariables_[segmentation]; }
+	int getDisappearanceVariable(size_t segmentation) const { return disappearanceVariables_[segmentation]; }
+	int getLinkVariable(size_t link) const { return linkVariables_[link]; }
+	int getExternalDivisionVariable(size_t division) const { return externalDivisionVariables_[division]; }
+
+	/**
+	 * @return the number of incoming links and external divisions of a segmentation which are active in the given solution
+	 */
+	size_t getNumActiveIncomingLinks(const helpers::Solution& sol, size_t segmentation) const;
+
+	/**
+	 * @return the number of outgoing links and external divisions of a segmentation which are active in the given solution
+	 */
+	size_t getNumActiveOutgoingLinks(const helpers::Solution& sol, size_t segmentation) const;
+
+	/**
+	 * @brief Check that the given solution obeys the flow conservation and division constraints of a segmentation
+	 * @param idTable the table of the model, to report the id of the segmentation
+	 */
+	bool verifySegmentation(const helpers::Solution& sol, size_t segmentation, const helpers::IdTable& idTable) const;
+
+	/**
+	 * @brief Check that at most one segmentation of an exclusion constraint is active in the given solution
+	 * @param idTable the table of the model, to report the ids of the segmentations
+	 */
+	bool verifyExclusion(const helpers::Solution& sol, size_t exclusion, const helpers::IdTable& idTable) const;
+
+private:
+	static IndexRange row(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& indices, size_t i)
+	{
+		return IndexRange(indices.data() + offsets[i], indices.data() + offsets[i + 1]);
+	}
+
+	/**
+	 * @return the index of the segmentation with the given key
+	 */
+	uint32_t indexOf(helpers::IdKey key, const helpers::IdTable& idTable) const;
+
+private:
+	// segmentations, sorted by key like the map of the model
+	std::vector<helpers::IdKey> keys_;
+	std::vector<int> detectionVariables_;
+	std::vector<int> divisionVariables_;
+	std::vector<int> appearanceVariables_;
+	std::vector<int> disappearanceVariables_;
+
+	// links and external divisions
+	std::vector<uint32_t> linkSources_;
+	std::vector<uint32_t> linkDestinations_;
+	std::vector<int> linkVariables_;
+	std::vector<uint32_t> divisionParents_;
+	std::vector<uint32_t> divisionChildren_;
+	std::vector<int> externalDivisionVariables_;
+
+	// adjacency of the segmentations, as compressed sparse rows
+	std::vector<uint32_t> incomingLinkOffsets_;
+	std::vector<uint32_t> incomingLinks_;
+	std::vector<uint32_t> outgoingLinkOffsets_;
+	std::vector<uint32_t> outgoingLinks_;
+	std::vector<uint32_t> incomingDivisionOffsets_;
+	std::vector<uint32_t> incomingDivisions_;
+	std::vector<uint32_t> outgoingDivisionOffsets_;
+	std::vector<uint32_t> outgoingDivisions_;
+
+	// members of the exclusion constraints
+	std::vector<uint32_t> exclusionOffsets_;
+	std::vector<uint32_t> exclusionMembers_;
+};
+
+} // end namespace mht
+
+#endif // HYPOTHESIS_GRAPH_H
@@ -0,0 +1,79 @@
+#ifndef ID_TABLE_H
+#define ID_TABLE_H
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "helpers.h"
+
+namespace helpers
+{
+
+/**
+ * @brief Maps the ids of the hypotheses in a file (IdLabelType) to the keys used inside a model (IdKey) and back.
+ * @details With USE_STRING_IDS every string is interned once when it is first added, and all containers and lookups
+ *          inside the model use its dense index, so that they compare and copy integers instead of strings.
+ *          The ids are restored only when something is written. Keys are assigned in the order in which ids are interned,
+ *          so this must happen in a deterministic order (e.g. not while parsing on several threads).
+ *          Integer ids are used as keys directly, then this table is empty and does not cost anything.
+ *          Every string is stored once in ids_, the hash index only holds keys and compares through ids_.
+ */
+class IdTable
+{
+public:
+	/**
+	 * @return the key of the given id, a new one if the id was not interned before
+	 */
+	IdKey intern(const IdLabelType& id);
+
+	/**
+	 * @brief look up the key of an id without adding it
+	 * @return false if the id was never interned (only possible with USE_STRING_IDS)
+	 */
+	bool find(const IdLabelType& id, IdKey& key) const;
+
+#ifdef USE_STRING_IDS
+	/**
+	 * @return the id of a key returned by intern()
+	 */
+	const IdLabelType& getId(IdKey key) const { return ids_[key]; }
+
+	/**
+	 * @brief reserve space for the given number of ids
+	 */
+	void reserve(size_t numIds);
+#else
+	IdLabelType getId(IdKey key) const { return key; }
+	void reserve(size_t) {}
+#endif
+
+private:
+#ifdef USE_STRING_IDS
+	/**
+	 * @brief rebuild the hash index of all interned ids with the given number of slots (a power of two)
+	 */
+	void rebuildIndex(size_t numSlots);
+
+	std::vector<IdLabelType> ids_;
+	// open addressing hash table of the keys, hashed and compared by their id
+	std::vector<IdKey> index_;
+#endif
+};
+
+#ifndef USE_STRING_IDS
+inline IdKey IdTable::intern(const IdLabelType& id)
+{
+	return id;
+}
+
+inline bool IdTable::find(const IdLabelType& id, IdKey& key) const
+{
+	key = id;
+	return true;
+}
+#endif
+
+} // end namespace helpers
+
+#endif // ID_TABLE_H
@@ -8,31 +8,63 @@
 
 #include <json/json.h>
 #include "model.h"
+#include "jsonstreamparser.h"
 
 namespace mht
 {
 
 /**
  * @brief Model specialized for Json loading and writing
- * @detail WARNING: at the moment you can only run either learn or infer once on the model. 
- *         Build a new one if you need it multiple times
+ * @detail The OpenGM model is rebuilt from the hypotheses whenever learn(), infer() or initializeOpenGMModel() is called,
+ * 		   so the same parsed model can be used several times. Calls must not overlap though.
  */
 class JsonModel : public Model
 {
 public: 
+    JsonModel();
+
     /**
      * @brief Read a model consisting of segmentation hypotheses and linking hypotheses from a json file
+     * @details With a single reader thread the file is scanned as a stream and the hypotheses are built while reading, 
+     *          so the document itself is never kept in memory. Otherwise the file is memory mapped and the
+     *          segmentation and linking hypothesis arrays are parsed in parts on several threads, see setNumReaderThreads().
      * @param filename
      */
     void readFromJson(const std::string& filename);
 
+    /**
+     * @brief Read a model from a parser that is positioned in front of the top level JSON object
+     * @details hypothesis arrays are only parsed in parallel if the parser reads a document in memory
+     * @param parser
+     */
+    void readFromJson(helpers::JsonStreamParser& parser);
+
+    /**
+     * @brief Set the number of threads used to parse the hypotheses of JSON models
+     * @details The merged model is the same as with a single thread: hypotheses are added in file order
+     *          and the error of the first invalid entry in the file is reported.
+     * @param numThreads number of threads, 0 (the default) uses all CPU cores, 1 reads the file as a stream
+     */
+    void setNumReaderThreads(size_t numThreads) { numReaderThreads_ = numThreads; }
+
+    /**
+     * @brief Save all hypotheses and exclusion constraints together with the settings as json model file,
+     *        which can be read again with readFromJson()
+     * @details every hypothesis is written on its own, so the document is never assembled in memory
+     * 
+     * @param filename where to save the model
+     */
+    void saveModelToJson(const std::string& filename) const;
+
     /**
      * @brief Export a found solution vector as a readable json file
+     * @details the result lists are written while iterating over the hypotheses, without building a Json::Value tree
      * 
      * @param filename where to save the result
      * @param sol the labeling to save
+     * @param compact write everything without indentation and line breaks, which is smaller and faster
      */
-    void saveResultToJson(const std::string& filename, const helpers::Solution& sol) const;
+    void saveResultToJson(const std::string& filename, const helpers::Solution& sol, bool compact = false) const;
 
     /**
      * @brief Read in a ground truth solution (a boolean value per link) from a json file
@@ -50,69 +82,88 @@ public:
 
 private:
     /**
-     * @brief read linking hypothesis from Json and adds it to linkingHypotheses_
+     * @brief a parsed linking hypothesis, whose ids are not interned yet
+     */
+    struct LinkEntry
+    {
+        helpers::IdLabelType srcId;
+        helpers::IdLabelType destId;
+        helpers::StateFeatureVector features;
+    };
+
+    /**
+     * @brief a parsed segmentation hypothesis, whose features are not in the feature store yet
+     */
+    struct SegmentationEntry
+    {
+        helpers::IdLabelType id;
+        helpers::StateFeatureVector detectionFeatures;
+        helpers::StateFeatureVector divisionFeatures;
+        helpers::StateFeatureVector appearanceFeatures;
+        helpers::StateFeatureVector disappearanceFeatures;
+    };
+
+    /**
+     * @brief parse a linking hypothesis from Json, without modifying the model so that it can run concurrently
      * @details expects the json value to contain attributes "src"(helpers::IdLabelType), 
-     *  "dest"(helpers::IdLabelType), and "features"(list of double)
+     *  "dest"(helpers::IdLabelType), and "features"(list of double).
      * 
-     * @param entry json object for this hypothesis
+     * @param parser positioned in front of the json object for this hypothesis
+     */
+    LinkEntry parseLinkingHypothesis(helpers::JsonStreamParser& parser) const;
+
+    /**
+     * @brief intern the ids of a parsed linking hypothesis and add it to linkingHypotheses_ and its feature statistics.
+     *  The link is registered with its segmentations at the end of readFromJson()
      */
-    void readLinkingHypothesis(const Json::Value& entry);
+    void addLinkingHypothesis(LinkEntry& entry);
 
     /**
-     * @brief read segmentation hypothesis from Json and adds it to segmentationHypotheses_
+     * @brief parse a segmentation hypothesis from Json, without modifying the model so that it can run concurrently
      * @details expects the json value to contain attributes "id"(helpers::IdLabelType) and "features"(list of double),
      *          as well as "divisionFeatures", "appearanceFeatures" and "disappearanceFeatures", where
      *          the presence of the latter two toggles the presence of an appearance or disappearance node.
      *          Hypotheses which do not have these, are not allowed to appear/disappear!
      * 
-     * @param entry json object for this hypothesis
+     * @param parser positioned in front of the json object for this hypothesis
+     */
+    SegmentationEntry parseSegmentationHypothesis(helpers::JsonStreamParser& parser) const;
+
+    /**
+     * @brief intern the id of a parsed segmentation hypothesis and add it to segmentationHypotheses_ and its feature statistics
      */
-    void readSegmentationHypothesis(const Json::Value& entry);
+    void addSegmentationHypothesis(SegmentationEntry& entry);
 
     /**
      * @brief read division hypothesis from Json
      *
-     * @param entry json object for this hypothesis
+     * @param parser positioned in front of the json object for this hypothesis
      */
-    void readDivisionHypothesis(const Json::Value& entry);
+    void readDivisionHypothesis(helpers::JsonStreamParser& parser);
 
     /**
      * @brief read exclusion constraint from Json
      * @details expects the json array to be a list of ints representing ids
      * 
-     * @param entry json object for this hypothesis
-     */
-    void readExclusionConstraints(const Json::Value& entry);
-
-    /**
-     * @brief Create a json string describing this link with its value (for result saving)
-     * 
-     * @param state the state that this link has (will be saved as "value" in JSON)
-     * @return the Json value to put in an array into the result file
+     * @param parser positioned in front of the json array for this constraint
      */
-    const Json::Value linkToJson(const std::shared_ptr<LinkingHypothesis>& link, size_t state) const;
+    void readExclusionConstraints(helpers::JsonStreamParser& parser);
 
     /**
-     * @brief Create a json string describing this division with its value (for result saving)
+     * @brief read a list of features per state, with the same checks as helpers::extractFeatures
      * 
-     * @param state the state that this division has (will be saved as "value" in JSON)
-     * @return the Json value to put in an array into the result file
+     * @param parser positioned in front of the json array of features
+     * @param type the JsonType of the features, used in error messages
      */
-    const Json::Value divisionToJson(const std::shared_ptr<DivisionHypothesis>& division, size_t state) const;
+    helpers::StateFeatureVector readFeatures(helpers::JsonStreamParser& parser, helpers::JsonTypes type) const;
 
-    /**
-     * @brief Create json value containing the state of this division, linked to this detection's id
-     */
-    const Json::Value divisionToJson(const SegmentationHypothesis& segmentation, size_t value) const;
-
-    /**
-     * @brief Create json value containing the state of this detection
-     */
-    const Json::Value detectionToJson(const SegmentationHypothesis& segmentation, size_t value) const;
-
-private:
+protected:
     // ground truth filename
     std::string groundTruthFilename_;
+
+private:
+    // threads used to parse hypothesis arrays, 0 for all CPU cores
+    size_t numReaderThreads_;
 };
 
 } // end namespace mht
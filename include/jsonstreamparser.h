@@ -0,0 +1,187 @@
+#ifndef JSON_STREAM_PARSER_H
+#define JSON_STREAM_PARSER_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+#include "helpers.h"
+
+namespace helpers
+{
+
+/**
+ * @brief Reads a JSON document token by token from a stream, without building a tree of Json::Values.
+ * @details The parser only keeps a fixed size buffer of the input, so the consumer can build its own data structures
+ *          while scanning the file. C and C++ style comments are skipped like jsoncpp does.
+ *          Separators (',' and ':') are skipped, but the nesting of objects and arrays is not validated,
+ *          consumers are expected to follow the structure they know.
+ */
+class JsonStreamParser
+{
+public:
+	enum class Token {ObjectBegin, ObjectEnd, ArrayBegin, ArrayEnd, String, Number, True, False, Null, End};
+
+	/**
+	 * @brief A range of consecutive array elements in a document stored in memory, see splitArray()
+	 */
+	struct ArrayChunk
+	{
+		const char* begin;
+		const char* end;
+		/// line of the first element, so that a parser for this chunk reports the lines of the whole document
+		size_t line;
+	};
+
+public:
+	/**
+	 * @brief Create a parser that reads the given stream in chunks of bufferSize bytes
+	 */
+	JsonStreamParser(std::istream& stream, size_t bufferSize = 1 << 20);
+
+	/**
+	 * @brief Create a parser for a JSON document that is completely stored in [begin, end)
+	 * @param firstLine the line number of begin, used in error messages
+	 */
+	JsonStreamParser(const char* begin, const char* end, size_t firstLine = 1);
+
+	/**
+	 * @brief Read the next token. Object keys are returned as String tokens
+	 */
+	Token next();
+
+	/**
+	 * @brief Look at the next token without consuming it
+	 */
+	Token peek();
+
+	/**
+	 * @brief Read the next token and throw an error containing the given message if it is not of the expected kind
+	 */
+	void expect(Token token, const std::string& message);
+
+	/**
+	 * @brief Inside an object, read the next key
+	 * @return false if the end of the object was reached (the closing brace is consumed)
+	 */
+	bool nextKey(std::string& key);
+
+	/**
+	 * @brief Inside an array, check whether there is another element
+	 * @return false if the end of the array was reached (the closing bracket is consumed)
+	 */
+	bool hasNextElement();
+
+	/**
+	 * @brief Skip the next value including all its children
+	 */
+	void skipValue();
+
+	/**
+	 * @brief Split the elements of an array into at most maxChunks ranges of similar size that can be parsed independently
+	 * @details Only works for documents in memory, and the opening bracket must have been consumed already.
+	 *          The elements are only scanned for brackets, strings and comments, which is much faster than tokenizing them.
+	 *          Afterwards the parser is positioned behind the closing bracket.
+	 *          Every chunk starts at an element and ends right before the first element of the next chunk
+	 *          (or the closing bracket), so a parser for a chunk reads elements until it reaches Token::End.
+	 *
+	 * @param maxChunks maximal number of chunks
+	 * @param minChunkSize chunks are not split further if they are smaller than this many bytes
+	 * @return the chunks in document order, empty if the array is empty
+	 */
+	std::vector<ArrayChunk> splitArray(size_t maxChunks, size_t minChunkSize);
+
+	/**
+	 * @brief Read the next value into a Json::Value, meant for small parts of the document like the settings
+	 */
+	Json::Value readValue();
+
+	/**
+	 * @brief Read the next value, which must be a number
+	 */
+	double readDouble(const std::string& message);
+
+	/**
+	 * @brief Read the next value as id, which must be an unsigned integer (or a string if USE_STRING_IDS is defined)
+	 * @return false if the value had the wrong type (the value is consumed nevertheless)
+	 */
+	bool readId(IdLabelType& id);
+
+	/**
+	 * @return the text of the last String token
+	 */
+	const std::string& getString() const { return text_; }
+
+	/**
+	 * @return the value of the last Number token
+	 */
+	double getNumber() const { return number_; }
+
+	/**
+	 * @return whether the last Number token was written as non-negative integer
+	 */
+	bool isUnsignedInteger() const { return isUnsignedInteger_; }
+
+	/**
+	 * @return whether the whole document is in memory, which is needed to split arrays
+	 */
+	bool isInMemory() const { return stream_ == nullptr; }
+
+	/**
+	 * @return the current line in the document, for error messages
+	 */
+	size_t getLine() const { return line_; }
+
+	/**
+	 * @brief throw a std::runtime_error with the given message and the current line
+	 */
+	void error(const std::string& message) const;
+
+private:
+	/// refill the buffer, return false at the end of the input
+	bool fill();
+
+	int peekChar()
+	{
+		if(position_ == end_ && !fill())
+			return -1;
+		return (unsigned char)*position_;
+	}
+
+	int getChar()
+	{
+		if(position_ == end_ && !fill())
+			return -1;
+		return (unsigned char)*position_++;
+	}
+
+	/// skip white space, separators and comments
+	void skipWhitespace();
+	Token readToken();
+	void readString();
+	/// read the four hex digits of a \u escape sequence
+	unsigned int readHexQuad();
+	void readNumber(int first);
+	void readLiteral(const char* rest);
+	/// skip a value in memory by only looking at brackets, strings and comments
+	void skipRawValue();
+
+private:
+	std::istream* stream_;
+	std::vector<char> buffer_;
+	const char* position_;
+	const char* end_;
+
+	bool hasPeeked_;
+	Token peeked_;
+
+	std::string text_;
+	double number_;
+	bool isUnsignedInteger_;
+	size_t line_;
+};
+
+} // end namespace helpers
+
+#endif // JSON_STREAM_PARSER_H
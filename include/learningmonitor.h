@@ -0,0 +1,143 @@
+#ifndef LEARNING_MONITOR_H
+#define LEARNING_MONITOR_H
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include <json/json.h>
+#include "helpers.h"
+
+namespace helpers
+{
+
+/**
+ * @brief Records what happens in every iteration of the bundle method that is used for structured learning.
+ * @details The bundle method minimizes λ/2 |w|² + L(w), where L is the structured risk, by building a piecewise linear
+ *          lower bound of L from the hyperplanes (gradient a_t and offset b_t) that the oracle returns at every w_t.
+ *          The monitor keeps the same hyperplanes, so it can reconstruct the lower bound (=dual objective) at the next w,
+ *          the number of active hyperplanes, and the gap between the best primal objective and the lower bound.
+ *          Time spent outside of the oracle is attributed to the quadratic program (QP) of the bundle method.
+ *
+ *          If a report stream is given, every iteration is written as one line of JSON, followed by a summary line.
+ */
+class LearningMonitor
+{
+public:
+	typedef std::chrono::steady_clock ClockType;
+
+	/**
+	 * @brief Statistics of one iteration of the bundle method
+	 */
+	struct Iteration
+	{
+		size_t iteration = 0;
+		double risk = 0.0; // L(w_t)
+		double primal = 0.0; // λ/2 |w_t|² + L(w_t)
+		double bestPrimal = 0.0; // smallest primal objective up to this iteration
+		double dual = 0.0; // minimum of the lower bound, found by the QP of this iteration
+		double gap = 0.0; // bestPrimal - dual
+		double weightNorm = 0.0; // |w_t|
+		size_t numConstraints = 0; // number of hyperplanes in the bundle
+		size_t numActiveConstraints = 0; // hyperplanes that define the lower bound at the QP solution
+		double modelBuildingTime = 0.0; // seconds spent setting up the loss augmented inference problems
+		double solvingTime = 0.0; // seconds spent solving the loss augmented inference problems
+		double qpTime = 0.0; // seconds spent in the QP after the oracle call
+	};
+
+public:
+	/**
+	 * @param regularizerWeight lambda, the weight of the quadratic regularizer
+	 * @param report stream to write JSON lines to, or nullptr
+	 */
+	LearningMonitor(double regularizerWeight = 1.0, std::ostream* report = nullptr);
+
+	virtual ~LearningMonitor() {}
+
+	/**
+	 * @brief Set lambda, must be called before learning starts
+	 */
+	void setRegularizerWeight(double regularizerWeight) { regularizerWeight_ = regularizerWeight; }
+
+	/**
+	 * @brief Add a field that is written to every report line, e.g. to tell apart several learning runs in one report
+	 */
+	void addReportField(const std::string& name, const Json::Value& value) { reportFields_[name] = value; }
+
+	/**
+	 * @brief Called by the oracle when it starts to evaluate the risk at the given weights.
+	 * @details The weights are the solution of the QP of the previous iteration, which is therefore finished and reported
+	 */
+	virtual void startIteration(const WeightsType& weights);
+
+	/**
+	 * @brief Add the time needed to build one loss augmented inference problem in the current iteration
+	 */
+	void addModelBuildingTime(double seconds);
+
+	/**
+	 * @brief Add the time needed to solve one loss augmented inference problem in the current iteration
+	 */
+	void addSolvingTime(double seconds);
+
+	/**
+	 * @brief Called by the oracle when it has computed risk and gradient at the weights given to startIteration()
+	 */
+	virtual void endIteration(const WeightsType& weights, double risk, const WeightsType& gradient);
+
+	/**
+	 * @brief Report the last iteration using the final weights and write the summary
+	 */
+	void finish(const WeightsType& weights);
+
+	/**
+	 * @return all iterations that were reported so far
+	 */
+	const std::vector<Iteration>& getIterations() const { return iterations_; }
+
+	/**
+	 * @return the risk L(w) of every oracle call so far
+	 */
+	const std::vector<double>& getRisks() const { return risks_; }
+
+	/**
+	 * @return seconds elapsed since the given time point
+	 */
+	static double secondsSince(const ClockType::time_point& start)
+	{
+		return std::chrono::duration<double>(ClockType::now() - start).count();
+	}
+
+protected:
+	/**
+	 * @brief Evaluate the lower bound of the bundle at the given weights and report the pending iteration
+	 */
+	void reportIteration(const WeightsType& weights);
+
+	/**
+	 * @brief Write the given iteration as JSON line, if there is a report stream
+	 */
+	void writeIteration(const Iteration& iteration);
+
+protected:
+	double regularizerWeight_;
+	std::ostream* report_;
+	Json::Value reportFields_;
+
+	// hyperplanes <w, a_t> + b_t of the lower bound
+	std::vector< std::vector<ValueType> > gradients_;
+	std::vector<ValueType> offsets_;
+	std::vector<double> risks_;
+
+	std::vector<Iteration> iterations_;
+	Iteration current_;
+	bool pending_;
+	double bestPrimal_;
+
+	ClockType::time_point startTime_;
+	ClockType::time_point oracleEndTime_;
+};
+
+} // end namespace helpers
+
+#endif // LEARNING_MONITOR_H
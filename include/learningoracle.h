@@ -0,0 +1,91 @@
+#ifndef LEARNING_ORACLE_H
+#define LEARNING_ORACLE_H
+
+#include <opengm/learning/gradient-accumulator.hxx>
+
+#include "helpers.h"
+#include "learningmonitor.h"
+
+namespace helpers
+{
+
+/**
+ * @brief Oracle for OpenGM's bundle optimizer, which computes value and gradient of the structured risk at the given weights.
+ * @details Works exactly like the oracle of OpenGM's StructMaxMargin learner, but reports the time spent in building
+ *          and solving every loss augmented inference problem, as well as the value and gradient, to a LearningMonitor.
+ *
+ *          For each training instance i the most violated constraint y*_i = argmin_y E(x_i, y) - Δ(y_i, y) is found,
+ *          the risk is the sum of E(x_i, y_i) - E(x_i, y*_i) + Δ(y_i, y*_i), and the gradient the sum of Φ(x_i, y_i) - Φ(x_i, y*_i).
+ */
+template<class INF>
+class LearningOracle
+{
+public:
+	typedef typename INF::Parameter InferenceParameter;
+
+	LearningOracle(DatasetType& dataset, const InferenceParameter& inferenceParam, LearningMonitor& monitor):
+		dataset_(dataset),
+		inferenceParam_(inferenceParam),
+		monitor_(monitor)
+	{}
+
+	/**
+	 * @brief evaluate risk and gradient at the given weights
+	 */
+	void operator()(const WeightsType& weights, double& value, WeightsType& gradient)
+	{
+		typedef opengm::learning::GradientAccumulator<WeightsType, Solution> GradientAccumulatorType;
+
+		monitor_.startIteration(weights);
+
+		for(size_t i = 0; i < gradient.numberOfWeights(); i++)
+			gradient[i] = 0.0;
+		value = 0.0;
+
+		// the OpenGM models of the dataset refer to these weights
+		dataset_.getWeights() = weights;
+
+		for(size_t i = 0; i < dataset_.getNumberOfModels(); i++)
+		{
+			const GraphicalModelType& gm = dataset_.getModel(i);
+			const DatasetType::GMWITHLOSS& gml = dataset_.getModelWithLoss(i);
+			const Solution& gt = dataset_.getGT(i);
+
+			LearningMonitor::ClockType::time_point start = LearningMonitor::ClockType::now();
+			INF inference(gml, inferenceParam_);
+			monitor_.addModelBuildingTime(LearningMonitor::secondsSince(start));
+
+			start = LearningMonitor::ClockType::now();
+			Solution mostViolated;
+			inference.infer();
+			inference.arg(mostViolated);
+			monitor_.addSolvingTime(LearningMonitor::secondsSince(start));
+
+			value += gm.evaluate(gt) - gml.evaluate(mostViolated);
+
+			GradientAccumulatorType gradientBest(gradient, gt, GradientAccumulatorType::Add);
+			GradientAccumulatorType gradientMostViolated(gradient, mostViolated, GradientAccumulatorType::Subtract);
+			for(size_t j = 0; j < gm.numberOfFactors(); j++)
+			{
+				gm[j].callViFunctor(gradientBest);
+				gm[j].callViFunctor(gradientMostViolated);
+			}
+		}
+
+		monitor_.endIteration(weights, value, gradient);
+	}
+
+	/**
+	 * @return the parameters of the loss augmented inference, the bundle optimizer checks them for verbosity
+	 */
+	const InferenceParameter& getInfParam() const { return inferenceParam_; }
+
+private:
+	DatasetType& dataset_;
+	InferenceParameter inferenceParam_;
+	LearningMonitor& monitor_;
+};
+
+} // end namespace helpers
+
+#endif // LEARNING_ORACLE_H
@@ -6,6 +6,7 @@
 
 #include <json/json.h>
 #include "helpers.h"
+#include "idtable.h"
 #include "segmentationhypothesis.h"
 #include "variable.h"
 
@@ -17,54 +18,72 @@ namespace mht
  * @details It can be read from Json, be added to an opengm model 
  * (with unary composed of several features that are learnable).
  */
-class LinkingHypothesis : public std::enable_shared_from_this<LinkingHypothesis>
+class LinkingHypothesis
 {
 public:
 	LinkingHypothesis();
 
 	/**
 	 * @brief Construct this hypothesis manually - mainly needed for testing
+	 * @param srcKey key of the source segmentation hypothesis in the IdTable of the model
+	 * @param destKey key of the destination segmentation hypothesis
+	 * @param featureStore the store of the model, the features are copied to its link arena
 	 */
-	LinkingHypothesis(helpers::IdLabelType srcId, helpers::IdLabelType destId, const helpers::StateFeatureVector& features);
+	LinkingHypothesis(helpers::FeatureStore& featureStore, helpers::IdKey srcKey, helpers::IdKey destKey, const helpers::StateFeatureVector& features);
 
-	const helpers::IdLabelType getSrcId() const { return srcId_; }
-	const helpers::IdLabelType getDestId() const { return destId_; }
+	/**
+	 * @brief Construct from features that were already added to the link arena of the given store
+	 */
+	LinkingHypothesis(helpers::FeatureStore& featureStore, helpers::IdKey srcKey, helpers::IdKey destKey, const helpers::FeatureRowRange& rows);
+
+	helpers::IdKey getSrcKey() const { return srcKey_; }
+	helpers::IdKey getDestKey() const { return destKey_; }
 
 	/**
-	 * @brief Add this hypothesis to the OpenGM model
-	 * @details also adds the unary factor
+	 * @brief Add the variable of this hypothesis to the OpenGM model
 	 * 
 	 * @param model OpenGM model
+	 */
+	void addVariablesToOpenGMModel(helpers::GraphicalModelType& model);
+
+	/**
+	 * @brief Build the unary factor of this hypothesis, after its variable was added to the OpenGM model
+	 * 
+	 * @param factors buffer for the factors of the OpenGM model
 	 * @param weights OpenGM weight object (if you are running learning this must be a reference to the weight object of the dataset)
 	 * @param statesShareWeights whether there is one weight per feature for all states, or a separate weight for each feature and state
 	 * @param weightIds indices of the weights that are meant to be used together with the features (size must match 2*numFeatures)
+	 * @param energies if not nullptr, the unary is an explicit function of the energies of its variable (see Variable)
 	 */
 	void addToOpenGMModel(
-		helpers::GraphicalModelType& model, 
+		helpers::FactorBuffer& factors, 
 		helpers::WeightsType& weights, 
 		bool statesShareWeights,
-		const std::vector<size_t>& weightIds);
-
-	/**
-	 * @brief notify the two connected segmentation hypotheses about their new incoming/outgoing link
-	 * 
-	 * @param segmentationHypotheses the map of all segmentation hypotheses
-	 */
-	void registerWithSegmentations(std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses);
+		const std::vector<size_t>& weightIds,
+		const helpers::UnaryEnergies* energies) const;
 
 	/**
 	 * @brief Save this node to an open ostream in the graphviz dot format
+	 * @param idTable the table of the model, to write the ids of the segmentation hypotheses
 	 */
-	void toDot(std::ostream& stream, const helpers::Solution* sol) const;
+	void toDot(std::ostream& stream, const helpers::Solution* sol, const helpers::IdTable& idTable) const;
 
 	/**
 	 * @return opengm variable
 	 */
 	const Variable& getVariable() const { return variable_; }
 
+	/**
+	 * @brief Standardize the features of this hypothesis in place
+	 */
+	void normalizeFeatures(const helpers::FeatureNormalization& normalization)
+	{
+		variable_.normalizeFeatures(normalization, helpers::VariableClass::Link);
+	}
+
 private:
-	helpers::IdLabelType srcId_;
-	helpers::IdLabelType destId_;
+	helpers::IdKey srcKey_;
+	helpers::IdKey destKey_;
 	
 	Variable variable_;
 };
@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace helpers
+{
+
+/**
+ * @brief Read only memory map of a whole file, unmapped on destruction
+ */
+class MappedFile
+{
+public:
+	/**
+	 * @param filename the file to map, must be a regular file
+	 * @param sequential whether the file will be read front to back exactly once, which allows more read ahead
+	 */
+	MappedFile(const std::string& filename, bool sequential = true);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* begin() const { return data_; }
+	const char* end() const { return data_ + size_; }
+	size_t size() const { return size_; }
+
+	/**
+	 * @return whether the file exists and is a regular file that can be mapped (not a pipe or device)
+	 */
+	static bool isMappable(const std::string& filename);
+
+private:
+	const char* data_;
+	size_t size_;
+};
+
+} // end namespace helpers
+
+#endif // MAPPED_FILE_H
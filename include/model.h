@@ -10,19 +10,32 @@
 #include "exclusionconstraint.h"
 #include "divisionhypothesis.h"
 #include "helpers.h"
+#include "hypothesisgraph.h"
+#include "idtable.h"
+#include "featurestore.h"
+#include "unaryenergies.h"
 #include "settings.h"
+#include "featurenormalization.h"
+#include "learningmonitor.h"
 
 namespace mht
 {
 
 /**
  * @brief The model holds all detections and their links, as well as exclusion constraints between detections
- * @detail WARNING: at the moment you can only run either learn or infer once on the model. 
- * 		   Build a new one if you need it multiple times
+ * @detail The OpenGM model is rebuilt from the hypotheses whenever learn(), infer() or initializeOpenGMModel() is called,
+ * 		   so the same parsed model can be used several times. Calls must not overlap though.
  */
 class Model
 {
 public:	
+	Model() = default;
+	virtual ~Model() = default;
+
+	// the variables of the hypotheses point into the feature store of their model
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
 	/**
 	 * @return the number of weights which is estimated by checking how many features are given for detections, links and divisions
 	 */
@@ -39,9 +52,48 @@ public:
 	 * @brief Run learning using a given ground truth file
 	 * @details Loads the ground truth using getGroundTruth() and learns the best weights using Structured Bundled Risk Minimization
 	 * 
+	 * @param monitor optional monitor that records timings and objectives of every iteration
 	 * @return the vector of learned weights
 	 */
-	std::vector<helpers::ValueType> learn();
+	std::vector<helpers::ValueType> learn(helpers::LearningMonitor* monitor = nullptr);
+
+	/**
+	 * @brief Run learning on a dataset that may contain instances of several models
+	 * @details The optimizer settings of this model are used for the loss-augmented inference
+	 * 
+	 * @param dataset the dataset whose instances were added by addToDataset()
+	 * @param regularizerWeight weight of the quadratic regularizer on the weights (lambda in the bundle method)
+	 * @param monitor optional monitor that records timings and objectives of every iteration
+	 * @return the vector of learned weights
+	 */
+	std::vector<helpers::ValueType> learn(
+		helpers::DatasetType& dataset, 
+		double regularizerWeight = 1.0, 
+		helpers::LearningMonitor* monitor = nullptr) const;
+
+	/**
+	 * @brief Build the OpenGM model against the weights of the dataset and add it together with its ground truth as a training instance
+	 * @details The dataset keeps a copy of the OpenGM model, so this model can be rebuilt afterwards
+	 * 
+	 * @param dataset the dataset to append this model to
+	 */
+	void addToDataset(helpers::DatasetType& dataset);
+
+	/**
+	 * @brief Compute the loss of a solution with respect to a ground truth labeling
+	 * @detail WARNING: may only be used after calling initializeOpenGMModel(), learn() or infer() because it needs an initialized opengm model!
+	 * 
+	 * @param sol solution vector
+	 * @param gt ground truth solution vector
+	 * @return the loss that is also used during learning
+	 */
+	double computeLoss(const helpers::Solution& sol, const helpers::Solution& gt) const;
+
+	/**
+	 * @brief Assemble the parameters of the loss, which weight the errors of each variable by the loss weight of its class in the settings
+	 * @detail WARNING: may only be used after calling initializeOpenGMModel(), learn() or infer() because it needs an initialized opengm model!
+	 */
+	helpers::LossType::Parameter getLossParameter() const;
 
 	/**
 	 * @brief check that the solution does not violate any constraints
@@ -61,6 +113,18 @@ public:
 	 */
 	double evaluateSolution(const helpers::Solution& sol) const;
 
+	/**
+	 * @brief Compute the energies of all states of all variables for the given weights, without building factors
+	 * @detail WARNING: may only be used after calling initializeOpenGMModel(), learn() or infer() because it needs the variable ids
+	 * 		   and the standardized features! The variables are split into blocks that are processed on several threads.
+	 * 		   initializeOpenGMModel() uses this for the precomputed unaries.
+	 * 
+	 * @param weights a vector of weights, laid out like in initializeOpenGMModel()
+	 * @param numThreads maximal number of threads, use 0 for all CPU cores
+	 * @return the energies of the states of every OpenGM variable
+	 */
+	helpers::UnaryEnergies computeUnaryEnergies(const std::vector<helpers::ValueType>& weights, size_t numThreads = 0) const;
+
 	/**
 	 * @brief Create a graphviz dot output of the full graph, showing used nodes/links in blue and exclusion constraints in red
 	 * 
@@ -74,14 +138,53 @@ public:
 	 * @detail This is called by learn() or infer()
 	 * 
 	 * @param weights a reference to the weights object that will be used in all 
+	 * @param precomputeEnergies if true, the unaries store the energies for the current weights instead of features and weight ids.
+	 * 		  This is what infer() uses, the model is smaller and faster to build but cannot be used for learning
 	 */
-	void initializeOpenGMModel(helpers::WeightsType& weights);
+	void initializeOpenGMModel(helpers::WeightsType& weights, bool precomputeEnergies = false);
+
+	/**
+	 * @brief Set the number of threads that build the factors of the OpenGM model
+	 * @details The model is the same for any number of threads, the factors are added in the order of the hypotheses
+	 * 
+	 * @param numThreads number of threads, 0 (the default) uses all CPU cores
+	 */
+	void setNumBuilderThreads(size_t numThreads) { numBuilderThreads_ = numThreads; }
+
+	/**
+	 * @brief Release the features of all hypotheses as soon as the OpenGM model was built
+	 * @details The OpenGM model holds the energies or its own copy of the features, and the hypotheses keep their ids
+	 * 		  and OpenGM variable ids, so solutions can still be verified, evaluated and exported. But the OpenGM model
+	 * 		  cannot be built again, and the model cannot be saved, so this is meant for models that are used only once.
+	 * 
+	 * @param release whether to release the features, false by default
+	 */
+	void setReleaseFeatures(bool release) { releaseFeatures_ = release; }
 
 	/**
 	 * @return a vector of strings describing each entry in the weight vector
 	 */
 	std::vector<std::string> getWeightDescriptions();
 
+	/**
+	 * @brief Standardize the features with the given normalization instead of the statistics of this model,
+	 * 		  e.g. with the normalization that was stored together with the learned weights
+	 * @detail must be called before the OpenGM model is initialized for the first time
+	 * 
+	 * @param normalization a feature normalization, finalized or with accumulated statistics
+	 */
+	void setFeatureNormalization(std::shared_ptr<helpers::FeatureNormalization> normalization);
+
+	/**
+	 * @return the feature normalization used by this model, or nullptr if features are not standardized
+	 */
+	std::shared_ptr<helpers::FeatureNormalization> getFeatureNormalization() const { return featureNormalization_; }
+
+	/**
+	 * @return the settings this model was read with
+	 */
+	std::shared_ptr<helpers::Settings> getSettings() const { return settings_; }
+
 	/**
 	 * @brief get the ground truth for learning, needs to be implemented by subclasses
 	 * @return the solution vector that fits the initialized OpenGM model
@@ -94,15 +197,67 @@ protected:
 	 */
 	void deduceAppearanceDisappearanceStates(helpers::Solution& solution);
 
+	/**
+	 * @brief find the segmentation hypothesis with the given id, e.g. for reading a ground truth
+	 * @return nullptr if there is none
+	 */
+	SegmentationHypothesis* findSegmentationHypothesis(const helpers::IdLabelType& id);
+
+	/**
+	 * @brief find the linking hypothesis between the segmentation hypotheses with the given ids
+	 * @return nullptr if there is none
+	 */
+	std::shared_ptr<LinkingHypothesis> findLinkingHypothesis(const helpers::IdLabelType& srcId, const helpers::IdLabelType& destId) const;
+
+	/**
+	 * @brief find the division hypothesis of the given parent into the two given children, in any order
+	 * @return nullptr if there is none
+	 */
+	std::shared_ptr<DivisionHypothesis> findDivisionHypothesis(
+		const helpers::IdLabelType& parentId,
+		const helpers::IdLabelType& childId1,
+		const helpers::IdLabelType& childId2) const;
+
+	/**
+	 * @brief Add the features of a variable to the running feature statistics, if the settings ask for standardized features
+	 * 		  or if no settings were read yet. Must be called by subclasses for every variable while reading the model
+	 */
+	void accumulateFeatureStatistics(helpers::VariableClass variableClass, const Variable& variable);
+
+	/**
+	 * @brief Standardize the features of all hypotheses once, if a feature normalization is used.
+	 * @detail This is called by initializeOpenGMModel()
+	 */
+	void normalizeFeatures();
+
+	/**
+	 * @return the index of the first weight of the given variable class, and its number of weights in numWeights
+	 */
+	size_t getWeightRange(helpers::VariableClass variableClass, size_t& numWeights) const;
+
+	/**
+	 * @brief Find the variable and its class of every OpenGM variable id, after all variables were added to the OpenGM model
+	 */
+	void buildVariableTable();
+
 protected:
-	// segmentation hypotheses
-	std::map<helpers::IdLabelType, SegmentationHypothesis> segmentationHypotheses_;
+	// keys of the ids of all hypotheses, readers intern the ids in the order of the file
+	helpers::IdTable idTable_;
+	// features of all variables, one arena per variable class
+	helpers::FeatureStore featureStore_;
+	// segmentation hypotheses, these maps own the hypotheses while graph_ indexes them (see HypothesisGraph)
+	std::map<helpers::IdKey, SegmentationHypothesis> segmentationHypotheses_;
 	// linking hypotheses are stored as shared pointer so it is easier to pass them around
-	std::map<std::pair<helpers::IdLabelType, helpers::IdLabelType>, std::shared_ptr<LinkingHypothesis> > linkingHypotheses_;
+	std::map<std::pair<helpers::IdKey, helpers::IdKey>, std::shared_ptr<LinkingHypothesis> > linkingHypotheses_;
 	// division hypotheses as shared pointers
 	std::map<DivisionHypothesis::IdType, std::shared_ptr<DivisionHypothesis> > divisionHypotheses_;
 	// exclusion constraints
 	std::vector<ExclusionConstraint> exclusionConstraints_;
+	// flat view of all hypotheses above, rebuilt by initializeOpenGMModel()
+	HypothesisGraph graph_;
+	// the variable and its class of every OpenGM variable id, rebuilt by initializeOpenGMModel()
+	std::vector<const Variable*> variables_;
+	std::vector<helpers::VariableClass> variableClasses_;
 
 	// OpenGM stuff
 	helpers::GraphicalModelType model_;
@@ -110,6 +265,16 @@ protected:
 	// model settings
 	std::shared_ptr<helpers::Settings> settings_;
 
+	// feature standardization, nullptr if features are used as they are
+	std::shared_ptr<helpers::FeatureNormalization> featureNormalization_;
+	bool featuresNormalized_ = false;
+
+	// threads used to build the factors of the OpenGM model, 0 for all CPU cores
+	size_t numBuilderThreads_ = 0;
+
+	// whether the feature store is released after the OpenGM model was built
+	bool releaseFeatures_ = false;
+
 	// numbers of weights
 	size_t numDetWeights_ = 0;
 	size_t numDivWeights_ = 0;
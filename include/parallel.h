@@ -0,0 +1,21 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+namespace helpers
+{
+
+/**
+ * @brief Run numTasks tasks on at most numThreads threads, rethrows the first exception that occurred in any task
+ * 
+ * @param numTasks number of tasks, the task function is called once for each index in [0, numTasks)
+ * @param numThreads maximal number of threads, use 0 for all CPU cores
+ * @param task the function to run for each task index
+ */
+void runInParallel(size_t numTasks, size_t numThreads, const std::function<void(size_t)>& task);
+
+} // end namespace helpers
+
+#endif // PARALLEL_H
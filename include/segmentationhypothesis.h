@@ -17,8 +17,7 @@ namespace mht
 {
 
 // forward declaration
-class LinkingHypothesis;
-class DivisionHypothesis;
+class HypothesisGraph;
 
 /**
  * @brief A segmentation hypothesis is a detection of a target in a frame.
@@ -31,14 +30,29 @@ public: // API
 
 	/**
 	 * @brief Construct this hypothesis manually - mainly needed for testing
+	 * @param featureStore the store of the model, the features are copied to the arenas of their variable classes
 	 */
 	SegmentationHypothesis(
+		helpers::FeatureStore& featureStore,
 		helpers::IdLabelType id, 
 		const helpers::StateFeatureVector& detectionFeatures, 
 		const helpers::StateFeatureVector& divisionFeatures = {},
 		const helpers::StateFeatureVector& appearanceFeatures = {},
 		const helpers::StateFeatureVector& disappearanceFeatures = {});
 
+	/**
+	 * @brief Construct from features that were already added to the arenas of their variable classes, e.g. by a reader
+	 *        that copies them straight from a file
+	 * @param featureStore the store of the model, which holds the given rows
+	 */
+	SegmentationHypothesis(
+		helpers::FeatureStore& featureStore,
+		helpers::IdLabelType id,
+		const helpers::FeatureRowRange& detectionRows,
+		const helpers::FeatureRowRange& divisionRows,
+		const helpers::FeatureRowRange& appearanceRows,
+		const helpers::FeatureRowRange& disappearanceRows);
+
 	const helpers::IdLabelType getId() const { return id_; }
 
 	/**
@@ -61,128 +75,124 @@ public: // API
 	 */
 	const Variable& getDisappearanceVariable() const { return disappearance_; }
 
+	/**
+	 * @brief Standardize the features of all variables of this hypothesis in place
+	 */
+	void normalizeFeatures(const helpers::FeatureNormalization& normalization)
+	{
+		detection_.normalizeFeatures(normalization, helpers::VariableClass::Detection);
+		division_.normalizeFeatures(normalization, helpers::VariableClass::Division);
+		appearance_.normalizeFeatures(normalization, helpers::VariableClass::Appearance);
+		disappearance_.normalizeFeatures(normalization, helpers::VariableClass::Disappearance);
+	}
+
+	/**
+	 * @brief Add the variables of this hypothesis to the OpenGM model, the division variable only if there is more than one outgoing link
+	 * @details throws if the detection has no features
+	 * 
+	 * @param model OpenGM model
+	 * @param graph the graph of the model
+	 * @param index the index of this hypothesis in the graph
+	 */
+	void addVariablesToOpenGMModel(helpers::GraphicalModelType& model, const HypothesisGraph& graph, size_t index);
 
 	/**
-	 * @brief Add this hypothesis to the OpenGM model
-	 * @details also adds the unary factor
+	 * @brief Build the unary factors and constraints of this hypothesis, after all variables were added to the OpenGM model
+	 * @details Only reads the model and the graph, so the factors of several hypotheses can be built on several threads
 	 * 
 	 * @param model OpenGM model
+	 * @param factors buffer for the factors of the OpenGM model
 	 * @param weights OpenGM weight object (if you are running learning this must be a reference to the weight object of the dataset)
 	 * @param statesShareWeights whether there is one weight per feature for all states, or a separate weight for each feature and state
 	 * @param detectionWeightIds indices of the weights that are meant to be used together with the detection features
 	 * @param divisionWeightIds indices of the weights that are meant to be used together with the division features
 	 * @param appearanceWeightIds indices of the weights that are meant to be used together with the division features
 	 * @param disappearanceWeightIds indices of the weights that are meant to be used together with the division features
+	 * @param graph the graph of the model, whose variable ids must be up to date
+	 * @param index the index of this hypothesis in the graph, its links and divisions are used in the conservation constraints
+	 * @param energies if not nullptr, the unaries are explicit functions of the energies of their variables (see Variable)
 	 */
 	void addToOpenGMModel(
-		helpers::GraphicalModelType& model, 
+		const helpers::GraphicalModelType& model, 
+		helpers::FactorBuffer& factors,
 		helpers::WeightsType& weights,
 		std::shared_ptr<helpers::Settings> settings,
 		const std::vector<size_t>& detectionWeightIds,
-		const std::vector<size_t>& divisionWeightIds = {},
-		const std::vector<size_t>& appearanceWeightIds = {},
-		const std::vector<size_t>& disappearanceWeightIds = {});
-
-	/**
-	 * @brief Add an incoming link to this node as hypothesis. Will be considered in conservation constraints
-	 * @details Links must be added before calling addToOpenGMModel for this segmentation hypothesis!
-	 * 
-	 * @param link the linking hypothesis
-	 */
-	void addIncomingLink(std::shared_ptr<LinkingHypothesis> link);
-
-	/**
-	 * @brief Add an outgoing link to this node as hypothesis. Will be considered in conservation constraints
-	 * @details Links must be added before calling addToOpenGMModel for this segmentation hypothesis!
-	 * @param link the linking hypothesis
-	 */
-	void addOutgoingLink(std::shared_ptr<LinkingHypothesis> link);
-
-	/**
-	 * @brief Add an incoming division, which will be handled the same as incoming links
-	 * @details must be added before calling addToOpenGMModel
-	 * 
-	 * @param division the division hypothesis
-	 */
-	void addIncomingDivision(std::shared_ptr<DivisionHypothesis> division);
+		const std::vector<size_t>& divisionWeightIds,
+		const std::vector<size_t>& appearanceWeightIds,
+		const std::vector<size_t>& disappearanceWeightIds,
+		const HypothesisGraph& graph,
+		size_t index,
+		const helpers::UnaryEnergies* energies) const;
 
 	/**
-	 * @brief Add an outgoing division - of which always only one may be active
-	 * @details must be added before calling addToOpenGMModel
+	 * @brief Count the constraints that addToOpenGMModel() will add, and the variables they are defined on
 	 * 
-	 * @param division the division hypothesis
+	 * @param settings the settings of the model, which decide about some of the constraints
+	 * @param graph the graph of the model, whose variable ids must be up to date
+	 * @param index the index of this hypothesis in the graph
+	 * @param counts the counts to increase
 	 */
-	void addOutgoingDivision(std::shared_ptr<DivisionHypothesis> division);
+	void countOpenGMConstraints(
+		std::shared_ptr<helpers::Settings> settings,
+		const HypothesisGraph& graph,
+		size_t index,
+		helpers::FactorCounts& counts) const;
 
 	/**
 	 * @brief Save this node to an open ostream in the graphviz dot format
 	 */
 	void toDot(std::ostream& stream, const helpers::Solution* sol) const;
 
+private:
 	/**
-	 * @brief Check that the given solution vector obeys all flow conservation constraints + divisions
-	 * 
-	 * @param sol the opengm solution vector
-	 */
-	bool verifySolution(const helpers::Solution& sol) const;
-
-	/**
-	 * @return the number of incoming links and external divisions of this detection which are active in the given solution
-	 * 
-	 */
-	size_t getNumActiveIncomingLinks(const helpers::Solution& sol) const;
-
-	/**
-	 * @return the number of outoing links and external divisions of this detection which are active in the given solution
+	 * @return the number of variables of the incoming / outgoing constraint, 0 if there is none
 	 */
-	size_t getNumActiveOutgoingLinks(const helpers::Solution& sol) const;
+	size_t getNumIncomingConstraintVariables(const HypothesisGraph& graph, size_t index) const;
+	size_t getNumOutgoingConstraintVariables(const HypothesisGraph& graph, size_t index) const;
 
-private:
 	/**
 	 * @brief Add incoming constraints to OpenGM
 	 */
-	void addIncomingConstraintToOpenGM(helpers::GraphicalModelType& model);
+	void addIncomingConstraintToOpenGM(const helpers::GraphicalModelType& model, helpers::FactorBuffer& factors, const HypothesisGraph& graph, size_t index) const;
 
 	/**
 	 * @brief Add outgoing constraints to OpenGM
 	 */
-	void addOutgoingConstraintToOpenGM(helpers::GraphicalModelType& model);
+	void addOutgoingConstraintToOpenGM(const helpers::GraphicalModelType& model, helpers::FactorBuffer& factors, const HypothesisGraph& graph, size_t index) const;
 
 	/**
 	 * @brief Add division constraints to OpenGM
 	 */
-	void addDivisionConstraintToOpenGM(helpers::GraphicalModelType& model, bool requireSeparateChildren);
+	void addDivisionConstraintToOpenGM(const helpers::GraphicalModelType& model, helpers::FactorBuffer& factors, bool requireSeparateChildren,
+		const HypothesisGraph& graph, size_t index) const;
 
 	/**
 	 * @brief Add constraints of external division nodes (division hypotheses) to OpenGM
 	 */
-	void addExternalDivisionConstraintaToOpenGM(helpers::GraphicalModelType& model);
+	void addExternalDivisionConstraintaToOpenGM(const helpers::GraphicalModelType& model, helpers::FactorBuffer& factors, const HypothesisGraph& graph, size_t index) const;
 
 	/**
 	 * @brief Add constraint that ensures that at most one of the two given opengm variables takes a state > 0
 	 */
 	void addExclusionConstraintToOpenGM(
-		helpers::GraphicalModelType& model, 
+		const helpers::GraphicalModelType& model, 
+		helpers::FactorBuffer& factors,
 		int openGmVarA, 
-		int openGmVarB);
+		int openGmVarB) const;
 
 	/**
 	 * Add a constraint between two variables and constraints with given bound and operator
 	 */
 	void addConstraintToOpenGM(
-		helpers::GraphicalModelType& model, 
+		const helpers::GraphicalModelType& model, 
+		helpers::FactorBuffer& factors,
 		int openGMVarA, 
 		int openGMVarB, 
 		size_t stateA, 
 		size_t stateB, 
 		size_t bound, 
-		opengm::LinearConstraintTraits::LinearConstraintOperator::ValueType op);
-
-	/**
-	 * @brief Sort the linking hypotheses by their opengm variable ids
-	 */
-	template<class T>
-	void sortByOpenGMVariableId(std::vector< std::shared_ptr<T> >& links);
+		opengm::LinearConstraintTraits::LinearConstraintOperator::ValueType op) const;
 
 private:
 	helpers::IdLabelType id_;
@@ -191,21 +201,8 @@ private:
 	Variable division_;
 	Variable appearance_;
 	Variable disappearance_;
-
-	std::vector< std::shared_ptr<LinkingHypothesis> > incomingLinks_;
-	std::vector< std::shared_ptr<LinkingHypothesis> > outgoingLinks_;
-	std::vector< std::shared_ptr<DivisionHypothesis> > incomingDivisions_;
-	std::vector< std::shared_ptr<DivisionHypothesis> > outgoingDivisions_;
 };
 
-template<class T>
-void SegmentationHypothesis::sortByOpenGMVariableId(std::vector< std::shared_ptr<T> >& links)
-{
-	std::sort(links.begin(), links.end(), [](const std::shared_ptr<T>& a, const std::shared_ptr<T>& b){
-		return b->getVariable().getOpenGMVariableId() > a->getVariable().getOpenGMVariableId();
-	});
-}
-
 } // end namespace mht
 
 #endif // SEGMENTATION_HYPOTHESIS_H
@@ -39,6 +39,16 @@ public: // settings object makes these parameters public instead of writing tons
 	double optimizerEpGap_; // default = 0.01
 	bool optimizerVerbose_; // default = true
 	size_t optimizerNumThreads_; // default = 1, use 0 for all CPU cores
+	// loss used during learning: per variable class weights of errors
+	double detectionLossWeight_; // default = 1.0
+	double linkLossWeight_; // default = 1.0
+	double divisionLossWeight_; // default = 1.0, also used for external division hypotheses
+	double appearanceLossWeight_; // default = 1.0
+	double disappearanceLossWeight_; // default = 1.0
+	bool trackingAwareLoss_; // default = false, if true a wrong state costs the number of wrongly assigned objects instead of 1
+	bool standardizeFeatures_; // default = false, if true all features are scaled to zero mean and unit variance per variable class
+	bool mergeExclusionCliques_; // default = false, if true overlapping exclusion constraints are merged into larger cliques
+	size_t maxExclusionCliqueSize_; // default = 16, use 0 for cliques of any size
 };
 
 } // end namespace helpers
@@ -0,0 +1,102 @@
+#ifndef TRACKING_LOSS_H
+#define TRACKING_LOSS_H
+
+#include <vector>
+#include <cstdlib>
+
+#include <opengm/functions/explicit_function.hxx>
+
+namespace helpers
+{
+
+/**
+ * @brief Loss for structured learning that weights the errors of each OpenGM variable individually,
+ *        e.g. depending on whether it is a detection, link, division, appearance or disappearance.
+ * @details The loss decomposes over variables, so loss augmentation only adds one unary table per variable
+ *          (just like OpenGM's HammingLoss) and does not introduce any higher order factors.
+ */
+class TrackingLoss
+{
+public:
+	class Parameter
+	{
+	public:
+		Parameter():
+			useStateDistance_(false)
+		{}
+
+		/**
+		 * @return the loss multiplier of the given OpenGM variable, 1.0 if none was specified
+		 */
+		double getNodeLossMultiplier(size_t i) const
+		{
+			if(i >= nodeLossMultiplier_.size())
+				return 1.0;
+			return nodeLossMultiplier_[i];
+		}
+
+		/// loss multiplier for each OpenGM variable
+		std::vector<double> nodeLossMultiplier_;
+		/// if true, a wrong state costs the distance to the ground truth state (=number of wrongly assigned objects) instead of 1
+		bool useStateDistance_;
+	};
+
+public:
+	TrackingLoss(const Parameter& param = Parameter()):
+		param_(param)
+	{}
+
+	/**
+	 * @return the loss of a single variable taking the given label while the ground truth label is gtLabel
+	 */
+	double variableLoss(size_t variable, size_t label, size_t gtLabel) const
+	{
+		if(label == gtLabel)
+			return 0.0;
+
+		double distance = param_.useStateDistance_ ? std::abs((long)label - (long)gtLabel) : 1.0;
+		return param_.getNodeLossMultiplier(variable) * distance;
+	}
+
+	/**
+	 * @brief compute the loss of the labeling given by [labelBegin, labelEnd) with respect to the ground truth
+	 */
+	template<class GM, class IT1, class IT2>
+	double loss(const GM& gm, IT1 labelBegin, const IT1 labelEnd, IT2 gtBegin, const IT2 gtEnd) const
+	{
+		double sum = 0.0;
+		for(size_t variable = 0; labelBegin != labelEnd && gtBegin != gtEnd; ++labelBegin, ++gtBegin, ++variable)
+			sum += variableLoss(variable, *labelBegin, *gtBegin);
+		return sum;
+	}
+
+	/**
+	 * @brief augment the model with the (negative, because we minimize) loss as one unary per variable
+	 */
+	template<class GM, class IT>
+	void addLoss(GM& gm, IT gtBegin) const
+	{
+		typedef opengm::ExplicitFunction<typename GM::ValueType, typename GM::IndexType, typename GM::LabelType> LossFunctionType;
+
+		for(typename GM::IndexType variable = 0; variable < gm.numberOfVariables(); ++variable, ++gtBegin)
+		{
+			// variables whose errors we do not care about do not need a loss factor
+			if(param_.getNodeLossMultiplier(variable) == 0.0)
+				continue;
+
+			typename GM::LabelType numLabels = gm.numberOfLabels(variable);
+			LossFunctionType lossFunction(&numLabels, &numLabels + 1, 0.0);
+			for(typename GM::LabelType label = 0; label < numLabels; ++label)
+				lossFunction(&label) = -variableLoss(variable, label, *gtBegin);
+
+			gm.addFactor(gm.addFunction(lossFunction), &variable, &variable + 1);
+		}
+	}
+
+private:
+	Parameter param_;
+};
+
+} // end namespace helpers
+
+#endif // TRACKING_LOSS_H
@@ -0,0 +1,70 @@
+#ifndef UNARY_ENERGIES_H
+#define UNARY_ENERGIES_H
+
+#include <stdexcept>
+#include <vector>
+
+#include "helpers.h"
+
+namespace helpers
+{
+
+/**
+ * @brief The energies of all states of all OpenGM variables of a model for one set of weights, see Model::computeUnaryEnergies().
+ * @details The energies of a variable are stored one after the other in a single array, in the order of the variable ids.
+ */
+class UnaryEnergies
+{
+public:
+	UnaryEnergies(): offsets_(1, 0) {}
+
+	/**
+	 * @brief Allocate the energies of variables with the given numbers of states, all energies are zero
+	 */
+	explicit UnaryEnergies(const std::vector<size_t>& numStates):
+		offsets_(1, 0)
+	{
+		offsets_.reserve(numStates.size() + 1);
+		for(size_t n : numStates)
+			offsets_.push_back(offsets_.back() + n);
+		energies_.assign(offsets_.back(), 0.0);
+	}
+
+	size_t getNumVariables() const { return offsets_.size() - 1; }
+	size_t getNumStates(size_t variable) const { return offsets_[variable + 1] - offsets_[variable]; }
+
+	/**
+	 * @return the energies of the states of a variable
+	 */
+	const ValueType* getEnergies(size_t variable) const { return energies_.data() + offsets_[variable]; }
+	ValueType* getEnergies(size_t variable) { return energies_.data() + offsets_[variable]; }
+
+	ValueType getEnergy(size_t variable, size_t state) const { return energies_[offsets_[variable] + state]; }
+
+	/**
+	 * @return the sum of the energies of the states that the variables take in the given solution
+	 */
+	ValueType evaluate(const Solution& sol) const
+	{
+		if(sol.size() != getNumVariables())
+			throw std::runtime_error("Solution does not have one label per variable");
+
+		ValueType sum = 0.0;
+		for(size_t variable = 0; variable < sol.size(); ++variable)
+		{
+			if(sol[variable] >= getNumStates(variable))
+				throw std::runtime_error("Solution contains a label that exceeds the number of states of its variable");
+			sum += getEnergy(variable, sol[variable]);
+		}
+		return sum;
+	}
+
+private:
+	// energies of variable v are [offsets_[v], offsets_[v+1])
+	std::vector<size_t> offsets_;
+	std::vector<ValueType> energies_;
+};
+
+} // end namespace helpers
+
+#endif // UNARY_ENERGIES_H
@@ -1,7 +1,17 @@
 #ifndef VARIABLE_H
 #define VARIABLE_H 
 
+#include <stdexcept>
+
 #include "helpers.h"
+#include "featurenormalization.h"
+#include "featurestore.h"
+
+namespace helpers
+{
+	class FactorBuffer;
+	class UnaryEnergies;
+}
 
 namespace mht
 {
@@ -13,27 +23,86 @@ namespace mht
 class Variable{
 public:
 	/**
-	 * @brief Construct with the given feature vector
+	 * @brief Construct a variable without features, which is not added to opengm
 	 */
-	Variable(const helpers::StateFeatureVector& features = {}):
-		features_(features),
+	Variable():
+		arena_(nullptr),
+		firstRow_(0),
+		numStates_(0),
 		openGMVariableId_(-1)
 	{}
 
 	/**
-	 * @brief Add this variable with given unary features and corresponding weights to opengm
+	 * @brief Construct with the given feature vector, which is copied to the arena of the variable class
+	 */
+	Variable(helpers::FeatureArena& arena, const helpers::StateFeatureVector& features):
+		arena_(&arena),
+		firstRow_(arena.addRows(features)),
+		numStates_(features.size()),
+		openGMVariableId_(-1)
+	{}
+
+	/**
+	 * @brief Construct with features that were already added to the arena of the variable class, one row per state
+	 */
+	Variable(helpers::FeatureArena& arena, const helpers::FeatureRowRange& rows):
+		arena_(&arena),
+		firstRow_(rows.getFirstRow()),
+		numStates_(rows.getNumRows()),
+		openGMVariableId_(-1)
+	{}
+
+	/**
+	 * @brief Add this variable to opengm if it has any features, its unary is built by addUnaryToOpenGM()
 	 * 
 	 * @param model OpenGM Model
+	 */
+	void addToOpenGM(helpers::GraphicalModelType& model);
+
+	/**
+	 * @brief Build the unary factor of this variable with given unary features and corresponding weights,
+	 *        if the variable was added to opengm. Only reads the variable, so it can run on several threads
+	 * 
+	 * @param factors buffer for the factors of the opengm model
 	 * @param statesShareWeights if this is true it means that the features of each state are multiplied by the same weight
 	 * @param weights opengm dataset weight object
 	 * @param weightIds ids into the weight vector that correspond to features
-	 * @return the new opengm variable id
+	 * @param energies if not nullptr, the unary is an explicit function of the energies of this variable in it
+	 *        (see Model::computeUnaryEnergies()), which is much smaller than a learnable function but does not follow changes of the weights
 	 */
-	void addToOpenGM(
-		helpers::GraphicalModelType& model, 
+	void addUnaryToOpenGM(
+		helpers::FactorBuffer& factors, 
 		bool statesShareWeights,
 		helpers::WeightsType& weights, 
-		const std::vector<size_t>& weightIds);
+		const std::vector<size_t>& weightIds,
+		const helpers::UnaryEnergies* energies) const;
+
+	/**
+	 * @brief Compute the energy of every state, the sum of its features multiplied by their weights
+	 * 
+	 * @param statesShareWeights if this is true it means that the features of each state are multiplied by the same weight
+	 * @param weights opengm weight object
+	 * @param weightIds ids into the weight vector that correspond to features
+	 * @return one energy per state
+	 */
+	std::vector<helpers::ValueType> computeEnergies(
+		bool statesShareWeights,
+		const helpers::WeightsType& weights,
+		const std::vector<size_t>& weightIds) const;
+
+	/**
+	 * @brief Compute the energy of every state from the values of the weights of this variable class
+	 * 
+	 * @param statesShareWeights if this is true it means that the features of each state are multiplied by the same weight
+	 * @param weights the weight values, in the order of the weight ids of this variable class
+	 * @param numWeights number of weight values
+	 * @param energies output, one energy per state
+	 */
+	void computeEnergies(
+		bool statesShareWeights,
+		const helpers::ValueType* weights,
+		size_t numWeights,
+		helpers::ValueType* energies) const;
 
 	/**
 	 * @brief Get the number of weights needed for this variable
@@ -47,7 +116,7 @@ public:
 	 * @param state the state of which we want to know the number of features
 	 * @return number of features 
 	 */
-	const size_t getNumFeatures(size_t state) const { return features_.at(state).size(); }
+	const size_t getNumFeatures(size_t state) const { return getFeatures(state).size(); }
 
 	/**
 	 * @return number of features summed over all states 
@@ -63,7 +132,36 @@ public:
 	/**
 	 * @return number of states this variable can take (defined by the number of feature lists in JSON)
 	 */
-	const size_t getNumStates() const { return features_.size(); }
+	const size_t getNumStates() const { return numStates_; }
+
+	/**
+	 * @return the features of the given state
+	 */
+	helpers::FeatureRow getFeatures(size_t state) const
+	{
+		if(state >= numStates_)
+			throw std::out_of_range("Variable has no features for the requested state");
+		if(arena_->isReleased())
+			throw std::runtime_error("The features of the variable were released after the OpenGM model was built");
+		return arena_->getRow(firstRow_ + state);
+	}
+
+	/**
+	 * @brief Standardize the features of this variable, rows that are shared with other variables are not changed
+	 * 
+	 * @param normalization the finalized feature normalization
+	 * @param variableClass which statistics of the normalization apply to this variable
+	 */
+	void normalizeFeatures(const helpers::FeatureNormalization& normalization, helpers::VariableClass variableClass)
+	{
+		for(size_t state = 0; state < numStates_; ++state)
+		{
+			helpers::FeatureRow features = getFeatures(state);
+			std::vector<helpers::FeatureValueType> normalized(features.begin(), features.end());
+			normalization.apply(variableClass, state, normalized.data(), normalized.size());
+			arena_->setRow(firstRow_ + state, normalized.data(), normalized.size());
+		}
+	}
 
 	/**
 	 * @return the opengm variable id of this variable
@@ -71,7 +169,10 @@ public:
 	int getOpenGMVariableId() const { return openGMVariableId_; }
 
 private:
-	helpers::StateFeatureVector features_;
+	// the features are rows [firstRow_, firstRow_ + numStates_) of the arena
+	helpers::FeatureArena* arena_;
+	size_t firstRow_;
+	size_t numStates_;
 	int openGMVariableId_;
 };
 
@@ -2,6 +2,8 @@
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <boost/python.hpp>
 
+#include <mutex>
+
 #include "pythonmodel.h"
 #include "helpers.h"
 
@@ -9,48 +11,118 @@ using namespace mht;
 using namespace boost::python;
 using namespace helpers;
 
-object track(object& graphDict, object& weightsDict)
+/**
+ * @brief A model that is read from Python once and can then be used for several inference, learning or validation runs.
+ * @details The GIL is released while the OpenGM model is built and solved, so models can be used from several Python threads.
+ *          Calls on the same model are serialized.
+ */
+class TrackingModel
+{
+public:
+	/**
+	 * @param releaseFeatures whether the features are released once the OpenGM model was built, only for models that are used once
+	 */
+	TrackingModel(dict graph, bool releaseFeatures = false)
+	{
+		model_.readFromPython(graph);
+		model_.setReleaseFeatures(releaseFeatures);
+	}
+
+	dict infer(dict weightsDict, bool asArrays = false)
+	{
+		FeatureVector weights = readWeightsFromPython(weightsDict);
+		std::shared_ptr<FeatureNormalization> normalization = readFeatureNormalizationFromPython(weightsDict);
+
+		// the lock is taken without the GIL, and is held until the result was exported
+		std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+		Solution solution;
+		{
+			ScopedGILRelease noGil;
+			lock.lock();
+			if(weights.size() != model_.computeNumWeights())
+				throw std::runtime_error("Number of weights does not match the number of features of the model");
+			if(normalization)
+				useFeatureNormalization(normalization);
+			solution = model_.infer(weights);
+		}
+		if(asArrays)
+			return model_.saveResultToPythonArrays(solution);
+		return model_.saveResultToPython(solution);
+	}
+
+	dict learn(dict groundTruthDict)
+	{
+		std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+		std::vector<double> weights;
+		{
+			ScopedGILRelease noGil;
+			lock.lock();
+			{
+				// the ground truth dictionary must only be stored with the GIL, it is read again during learning
+				ScopedGILAcquire gil;
+				model_.setPythonGt(groundTruthDict);
+			}
+			weights = model_.learn();
+		}
+		return model_.saveWeightsToPython(weights);
+	}
+
+	bool validate(dict groundTruthDict)
+	{
+		ScopedGILRelease noGil;
+		std::lock_guard<std::mutex> lock(mutex_);
+		{
+			ScopedGILAcquire gil;
+			model_.setPythonGt(groundTruthDict);
+		}
+
+		// the ground truth is read against the variables of the OpenGM model, the weights do not matter
+		WeightsType weights(model_.computeNumWeights());
+		model_.initializeOpenGMModel(weights, true);
+		Solution solution = model_.getGroundTruth();
+		return model_.verifySolution(solution);
+	}
+
+private:
+	/**
+	 * @brief use the normalization that was stored with the weights, which is only possible
+	 *        as long as the features were not standardized, or if it is the one that was used for that
+	 */
+	void useFeatureNormalization(const std::shared_ptr<FeatureNormalization>& normalization)
+	{
+		std::shared_ptr<FeatureNormalization> current = model_.getFeatureNormalization();
+		if(current && current->isFinalized())
+		{
+			Json::Value currentJson, newJson;
+			current->saveToJson(currentJson);
+			normalization->saveToJson(newJson);
+			if(currentJson == newJson)
+				return;
+		}
+		model_.setFeatureNormalization(normalization);
+	}
+
+private:
+	PythonModel model_;
+	std::mutex mutex_;
+};
+
+dict track(dict graph, dict weights, bool asArrays)
 {
-	dict pyGraph = extract<dict>(graphDict);
-	dict pyWeights = extract<dict>(weightsDict);
-
-	PythonModel model;
-	model.readFromPython(pyGraph);
-	FeatureVector weights = readWeightsFromPython(pyWeights);
-	Solution solution = model.infer(weights);
-	object result = model.saveResultToPython(solution);
-    
-	return result;
+	TrackingModel model(graph, true);
+	return model.infer(weights, asArrays);
 }
 
-object train(object& graphDict, object& gtDict)
+dict train(dict graph, dict groundTruth)
 {
-	dict pyGraph = extract<dict>(graphDict);
-	dict pyGt = extract<dict>(gtDict);
-
-	PythonModel model;
-	model.readFromPython(pyGraph);
-	model.setPythonGt(pyGt);
-	std::vector<double> weights = model.learn();
-	
-	object result = model.saveWeightsToPython(weights);
-    
-	return result;
+	TrackingModel model(graph, true);
+	return model.learn(groundTruth);
 }
 
-bool validate(object& graphDict, object& gtDict)
+bool validate(dict graph, dict solution)
 {
-	dict pyGraph = extract<dict>(graphDict);
-	dict pyGt = extract<dict>(gtDict);
-
-	PythonModel model;
-	model.readFromPython(pyGraph);
-	model.setPythonGt(pyGt);
-	
-	Solution solution = model.getGroundTruth();
-	bool valid = model.verifySolution(solution);
-	
-	return valid;
+	TrackingModel model(graph, true);
+	return model.validate(solution);
 }
 
 /**
@@ -58,18 +130,40 @@ bool validate(object& graphDict, object& gtDict)
  */
 BOOST_PYTHON_MODULE( multiHypoTracking@SUFFIX@ )
 {
-	def("track", track, args("graph", "weights"),
+#if PY_VERSION_HEX < 0x03070000
+	// the GIL has to exist before it can be released
+	PyEval_InitThreads();
+#endif
+
+	class_<TrackingModel, boost::noncopyable>("Model",
+		"A graph specified as a dictionary in the same structure as the supported JSON format, or as arrays.\n"
+		"It is read once and can be used for several infer/learn/validate calls. These release the GIL,\n"
+		"so several models can be solved from different threads at the same time.",
+		init<dict>(args("graph")))
+		.def("infer", &TrackingModel::infer, (arg("weights"), arg("asArrays") = false),
+			"Use an ILP solver to find the best configuration with the given weights, given as dict.\n\n"
+			"Returns a python dictionary similar to the result.json file, or with asArrays=True a dictionary of arrays\n"
+			"in the layout of the HDF5 result format, which numpy.asarray() uses without a copy")
+		.def("learn", &TrackingModel::learn, args("groundTruth"),
+			"Run Structured Learning with an ILP solver, the ground truth is given as dict as in a result.json file.\n\n"
+			"Returns a python dictionary containing a weights entry")
+		.def("validate", &TrackingModel::validate, args("solution"),
+			"Validate a solution given as dict as in a result.json file.\n\n"
+			"Returns a boolean whether the solution is valid");
+
+	def("track", track, (arg("graph"), arg("weights"), arg("asArrays") = false),
 		"Use an ILP solver on a graph specified as a dictionary,"
 		"in the same structure as the supported JSON format. Similarly, the weights are also given as dict.\n\n"
-		"Returns a python dictionary similar to the result.json file");
+		"Returns a python dictionary similar to the result.json file, or with asArrays=True a dictionary of arrays\n"
+		"in the layout of the HDF5 result format, which numpy.asarray() uses without a copy");
 	def("train", train, args("graph", "groundTruth"),
 		"Run Structured Learning with an ILP solver on a graph specified as a dictionary,"
-		"in the same structure as the supported JSON format." 
+		"in the same structure as the supported JSON format."
 		"Similarly, the ground truth are also given as dict as in a result.json file .\n\n"
 		"Returns a python dictionary containing a weights entry");
-	def("validate", train, args("graph", "solution"),
+	def("validate", validate, args("graph", "solution"),
 		"Validate a solution on a graph specified as a dictionary,"
-		"in the same structure as the supported JSON format." 
+		"in the same structure as the supported JSON format."
 		"Similarly, the solution is also given as dict as in a result.json file .\n\n"
 		"Returns a boolean whether the solution is valid");
 }
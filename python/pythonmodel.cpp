@@ -1,6 +1,10 @@
 #include "pythonmodel.h"
+#include <algorithm>
 #include <assert.h>
 #include <fstream>
+#include <limits>
+#include <sstream>
+#include <type_traits>
 
 using namespace boost::python;
 using namespace helpers;
@@ -8,6 +12,313 @@ using namespace helpers;
 namespace mht
 {
 
+namespace
+{
+
+/**
+ * @brief Read only view of a C contiguous Python buffer (e.g. a NumPy array) of numbers, released on destruction
+ */
+class ArrayView
+{
+public:
+    ArrayView(const object& array, const std::string& name):
+        name_(name),
+        type_(0)
+    {
+        if(PyObject_GetBuffer(array.ptr(), &buffer_, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+        {
+            PyErr_Clear();
+            throw std::runtime_error(name + " must be a C contiguous array");
+        }
+
+        // only native byte order is supported
+        const char* format = buffer_.format != nullptr ? buffer_.format : "B";
+        if(*format == '@' || *format == '=' || *format == '<')
+            ++format;
+        if(std::string("bBhHiIlLqQfd").find(*format) == std::string::npos || format[1] != 0)
+        {
+            PyBuffer_Release(&buffer_);
+            throw std::runtime_error(name + " must be an array of numbers in native byte order");
+        }
+        type_ = *format;
+    }
+
+    ~ArrayView()
+    {
+        PyBuffer_Release(&buffer_);
+    }
+
+    ArrayView(const ArrayView&) = delete;
+    ArrayView& operator=(const ArrayView&) = delete;
+
+    size_t getNumDimensions() const { return buffer_.ndim; }
+    size_t getShape(size_t dimension) const { return dimension < (size_t)buffer_.ndim ? buffer_.shape[dimension] : 1; }
+    size_t size() const { return buffer_.len / buffer_.itemsize; }
+    bool isInteger() const { return type_ != 'f' && type_ != 'd'; }
+
+    /**
+     * @return the element at the given flat index converted to T
+     */
+    template<class T>
+    T get(size_t i) const
+    {
+        switch(type_)
+        {
+            case 'b': return (T)static_cast<const signed char*>(buffer_.buf)[i];
+            case 'B': return (T)static_cast<const unsigned char*>(buffer_.buf)[i];
+            case 'h': return (T)static_cast<const short*>(buffer_.buf)[i];
+            case 'H': return (T)static_cast<const unsigned short*>(buffer_.buf)[i];
+            case 'i': return (T)static_cast<const int*>(buffer_.buf)[i];
+            case 'I': return (T)static_cast<const unsigned int*>(buffer_.buf)[i];
+            case 'l': return (T)static_cast<const long*>(buffer_.buf)[i];
+            case 'L': return (T)static_cast<const unsigned long*>(buffer_.buf)[i];
+            case 'q': return (T)static_cast<const long long*>(buffer_.buf)[i];
+            case 'Q': return (T)static_cast<const unsigned long long*>(buffer_.buf)[i];
+            case 'f': return (T)static_cast<const float*>(buffer_.buf)[i];
+            default: return (T)static_cast<const double*>(buffer_.buf)[i];
+        }
+    }
+
+    /**
+     * @return a pointer to all elements as doubles, without a copy if the array already stores doubles
+     */
+    const double* getDoubles()
+    {
+        if(type_ == 'd')
+            return static_cast<const double*>(buffer_.buf);
+        if(converted_.empty())
+        {
+            converted_.resize(size());
+            for(size_t i = 0; i < converted_.size(); i++)
+                converted_[i] = get<double>(i);
+        }
+        return converted_.data();
+    }
+
+    /**
+     * @return the element at the given flat index as unsigned integer, throws for other values
+     */
+    unsigned long long getIndex(size_t i) const
+    {
+        if(!isInteger() || get<long long>(i) < 0)
+            throw std::runtime_error(name_ + " must contain non-negative integers");
+        return get<unsigned long long>(i);
+    }
+
+private:
+    std::string name_;
+    Py_buffer buffer_;
+    char type_;
+    std::vector<double> converted_;
+};
+
+/**
+ * @brief read a one dimensional array of ids, a sequence of strings if USE_STRING_IDS is defined
+ */
+std::vector<IdLabelType> readIdArray(const object& array, const std::string& name)
+{
+    std::vector<IdLabelType> ids;
+#ifdef USE_STRING_IDS
+    ids.reserve(len(array));
+    for(size_t i = 0; (int)i < len(array); i++)
+        ids.push_back(extract<IdLabelType>(array[i]));
+#else
+    ArrayView view(array, name);
+    ids.reserve(view.size());
+    for(size_t i = 0; i < view.size(); i++)
+    {
+        unsigned long long id = view.getIndex(i);
+        if(id > std::numeric_limits<IdLabelType>::max())
+            throw std::runtime_error(name + " contains an id that is too large");
+        ids.push_back((IdLabelType)id);
+    }
+#endif
+    return ids;
+}
+
+/**
+ * @brief A Python object that owns a copy of result values and exports them through the buffer protocol
+ * with their item format and shape. Unlike memoryview.cast(), which only exists since Python 3.3,
+ * this also works with Python 2.7 (through its new-style buffer interface).
+ */
+struct TypedArrayObject
+{
+    PyObject_HEAD
+    std::vector<char>* data;
+    char* format;
+    int numDimensions;
+    Py_ssize_t itemSize;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+int typedArrayGetBuffer(PyObject* self, Py_buffer* view, int flags)
+{
+    TypedArrayObject* array = reinterpret_cast<TypedArrayObject*>(self);
+    view->obj = self;
+    Py_INCREF(self);
+    view->buf = array->data->data();
+    view->len = (Py_ssize_t)array->data->size();
+    view->readonly = 0;
+    view->itemsize = array->itemSize;
+    view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? array->format : nullptr;
+    view->ndim = array->numDimensions;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? array->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? array->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+void typedArrayDealloc(PyObject* self)
+{
+    delete reinterpret_cast<TypedArrayObject*>(self)->data;
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyTypeObject* getTypedArrayType()
+{
+    static PyBufferProcs bufferProcs;
+    static PyTypeObject type = { PyVarObject_HEAD_INIT(nullptr, 0) "multiHypoTracking.TypedArray" };
+    static bool ready = false;
+    if(!ready)
+    {
+        bufferProcs.bf_getbuffer = typedArrayGetBuffer;
+        type.tp_basicsize = sizeof(TypedArrayObject);
+        type.tp_dealloc = typedArrayDealloc;
+        type.tp_as_buffer = &bufferProcs;
+        type.tp_flags = Py_TPFLAGS_DEFAULT;
+#if PY_MAJOR_VERSION < 3
+        type.tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+        type.tp_doc = "Result values exported through the buffer protocol, use e.g. numpy.asarray() to access them";
+        if(PyType_Ready(&type) < 0)
+            throw_error_already_set();
+        ready = true;
+    }
+    return &type;
+}
+
+/**
+ * @brief Copy the values into a new writable buffer object that e.g. numpy.asarray() uses without a copy
+ * @param numColumns if greater than one, the buffer gets the shape (rows x numColumns)
+ */
+template<class T>
+object toArray(const std::vector<T>& values, size_t numColumns = 1)
+{
+    static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "only unsigned integers are supported");
+    static char format[] = { sizeof(T) == 1 ? 'B' : sizeof(T) == 2 ? 'H' : sizeof(T) == 4 ? 'I' : 'Q', 0 };
+
+    TypedArrayObject* array = PyObject_New(TypedArrayObject, getTypedArrayType());
+    if(array == nullptr)
+        throw_error_already_set();
+    object result(handle<>(reinterpret_cast<PyObject*>(array)));
+
+    const char* begin = reinterpret_cast<const char*>(values.data());
+    array->data = nullptr; // the deallocator runs if the copy below throws
+    array->data = new std::vector<char>(begin, begin + values.size() * sizeof(T));
+    array->format = format;
+    array->itemSize = sizeof(T);
+    array->numDimensions = numColumns > 1 ? 2 : 1;
+    array->shape[0] = (Py_ssize_t)(values.size() / std::max<size_t>(numColumns, 1));
+    array->shape[1] = (Py_ssize_t)numColumns;
+    array->strides[0] = (Py_ssize_t)(numColumns * sizeof(T));
+    array->strides[1] = sizeof(T);
+    return result;
+}
+
+/**
+ * @brief Write ids to a buffer like toArray(), or to a list of strings (of lists with numColumns strings) if USE_STRING_IDS is defined
+ */
+object idsToArray(const std::vector<IdLabelType>& ids, size_t numColumns = 1)
+{
+#ifdef USE_STRING_IDS
+    list result;
+    for(size_t i = 0; i < ids.size(); i += numColumns)
+    {
+        if(numColumns == 1)
+        {
+            result.append(ids[i]);
+            continue;
+        }
+        list row;
+        for(size_t c = 0; c < numColumns; c++)
+            row.append(ids[i + c]);
+        result.append(row);
+    }
+    return result;
+#else
+    return toArray(ids, numColumns);
+#endif
+}
+
+/**
+ * @brief Features of one variable class for all hypotheses of a kind, given as array of shape (rows, states, features),
+ *        or as dict with such an array as "values" and the number of states used by each row as "numStates"
+ */
+class FeatureArray
+{
+public:
+    FeatureArray(dict& hypotheses, JsonTypes type, size_t numRows):
+        maxStates_(0),
+        numFeatures_(0),
+        data_(nullptr)
+    {
+        if(!hypotheses.has_key(JsonTypeNames[type]))
+            return;
+
+        object entry = hypotheses[JsonTypeNames[type]];
+        object valuesArray = entry;
+        if(extract<dict>(entry).check())
+        {
+            dict entryDict = extract<dict>(entry);
+            valuesArray = entryDict["values"];
+            if(entryDict.has_key("numStates"))
+            {
+                numStates_.reset(new ArrayView(entryDict["numStates"], JsonTypeNames[type] + " numStates"));
+                if(numStates_->size() != numRows)
+                    throw std::runtime_error(JsonTypeNames[type] + " numStates must have one entry per row");
+            }
+        }
+
+        values_.reset(new ArrayView(valuesArray, JsonTypeNames[type]));
+        if(values_->getNumDimensions() != 3 || values_->getShape(0) != numRows)
+        {
+            std::stringstream s;
+            s << JsonTypeNames[type] << " must be an array of shape (" << numRows << ", states, features)";
+            throw std::runtime_error(s.str());
+        }
+        maxStates_ = values_->getShape(1);
+        numFeatures_ = values_->getShape(2);
+        data_ = values_->getDoubles();
+    }
+
+    StateFeatureVector row(size_t r) const
+    {
+        if(!values_)
+            return StateFeatureVector();
+
+        size_t numStates = numStates_ ? numStates_->getIndex(r) : maxStates_;
+        if(numStates > maxStates_)
+            throw std::runtime_error("Feature array uses more states than its values provide");
+
+        StateFeatureVector features(numStates);
+        const double* rowValues = data_ + r * maxStates_ * numFeatures_;
+        for(size_t s = 0; s < numStates; ++s)
+            features[s].assign(rowValues + s * numFeatures_, rowValues + (s + 1) * numFeatures_);
+        return features;
+    }
+
+private:
+    size_t maxStates_;
+    size_t numFeatures_;
+    std::unique_ptr<ArrayView> values_;
+    std::unique_ptr<ArrayView> numStates_;
+    const double* data_;
+};
+
+} // end anonymous namespace
+
 void PythonModel::readLinkingHypothesis(dict& entry)
 {
 	if(!entry.has_key(JsonTypeNames[JsonTypes::SrcId]))
@@ -24,10 +335,10 @@ void PythonModel::readLinkingHypothesis(dict& entry)
     helpers::StateFeatureVector features = extractFeatures(entry, JsonTypes::Features);
 
     // add to list
-    std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(srcId, destId, features);
-    std::pair<helpers::IdLabelType, helpers::IdLabelType> ids = std::make_pair(srcId, destId);
-    hyp->registerWithSegmentations(segmentationHypotheses_);
-    linkingHypotheses_[ids] = hyp;
+    std::pair<IdKey, IdKey> keys = std::make_pair(idTable_.intern(srcId), idTable_.intern(destId));
+    std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(featureStore_, keys.first, keys.second, features);
+    accumulateFeatureStatistics(VariableClass::Link, hyp->getVariable());
+    linkingHypotheses_[keys] = hyp;
 }
 
 void PythonModel::readSegmentationHypothesis(dict& entry)
@@ -54,9 +365,14 @@ void PythonModel::readSegmentationHypothesis(dict& entry)
     if(entry.has_key(JsonTypeNames[JsonTypes::DisappearanceFeatures]))
         disappearanceFeatures = extractFeatures(entry, JsonTypes::DisappearanceFeatures);
 
+    SegmentationHypothesis hyp(featureStore_, id, detectionFeatures, divisionFeatures, appearanceFeatures, disappearanceFeatures);
+    accumulateFeatureStatistics(VariableClass::Detection, hyp.getDetectionVariable());
+    accumulateFeatureStatistics(VariableClass::Division, hyp.getDivisionVariable());
+    accumulateFeatureStatistics(VariableClass::Appearance, hyp.getAppearanceVariable());
+    accumulateFeatureStatistics(VariableClass::Disappearance, hyp.getDisappearanceVariable());
+
     // add to list
-    SegmentationHypothesis hyp(id, detectionFeatures, divisionFeatures, appearanceFeatures, disappearanceFeatures);
-    segmentationHypotheses_[id] = hyp;
+    segmentationHypotheses_[idTable_.intern(id)] = hyp;
 }
 
 void PythonModel::readDivisionHypothesis(dict& entry)
@@ -69,43 +385,44 @@ void PythonModel::readDivisionHypothesis(dict& entry)
         throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: missing features");
 
     IdLabelType parentId = extract<IdLabelType>(entry[JsonTypeNames[JsonTypes::Parent]]);
-    std::vector<helpers::IdLabelType> childrenIds;
+    std::vector<IdKey> childrenKeys;
 
     list children = extract<list>(entry[JsonTypeNames[JsonTypes::Children]]);
     for(size_t i = 0; (int)i < len(children); ++i)
     {
-        childrenIds.push_back(extract<IdLabelType>(children[i]));
+        childrenKeys.push_back(idTable_.intern(extract<IdLabelType>(children[i])));
     }
 
     // always use ordered list of children!
-    std::sort(childrenIds.begin(), childrenIds.end());
+    std::sort(childrenKeys.begin(), childrenKeys.end());
 
     // get transition features
     StateFeatureVector features = extractFeatures(entry, JsonTypes::Features);
 
     // add to list
-    std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(parentId, childrenIds, features);
-    hyp->registerWithSegmentations(segmentationHypotheses_);
-    auto ids = std::make_tuple(parentId, childrenIds[0], childrenIds[1]);
-    divisionHypotheses_[ids] = hyp;
+    IdKey parentKey = idTable_.intern(parentId);
+    std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(featureStore_, parentKey, childrenKeys, features);
+    accumulateFeatureStatistics(VariableClass::ExternalDivision, hyp->getVariable());
+    auto keys = std::make_tuple(parentKey, childrenKeys[0], childrenKeys[1]);
+    divisionHypotheses_[keys] = hyp;
 }
 
 void PythonModel::readExclusionConstraint(list& entry)
 {
-	std::vector<helpers::IdLabelType> ids;
+	std::vector<IdKey> keys;
     for(size_t i = 0; (int)i < len(entry); i++)
     {
-        ids.push_back(extract<IdLabelType>(entry[i]));
+        keys.push_back(idTable_.intern(extract<IdLabelType>(entry[i])));
     }
 
-	if(ids.size() < 2)
+	if(keys.size() < 2)
     {
         // std::cout << "Ignoring exclusion constraint with less than two elements" << std::endl;
         return;
     }
 
     // add to list
-    exclusionConstraints_.push_back(ExclusionConstraint(ids));
+    exclusionConstraints_.push_back(ExclusionConstraint(keys));
 }
 
 void PythonModel::setPythonGt(boost::python::dict& gtDict)
@@ -113,7 +430,7 @@ void PythonModel::setPythonGt(boost::python::dict& gtDict)
 	groundTruthDict_ = gtDict;
 }
 
-void PythonModel::readFromPython(dict& graphDict)
+void PythonModel::readSettingsFromPython(dict& graphDict)
 {
 	// get flag whether states should share weights or not
 	settings_ = std::make_shared<helpers::Settings>();
@@ -133,6 +450,24 @@ void PythonModel::readFromPython(dict& graphDict)
 			settings_->optimizerVerbose_ = extract<bool>(settings[JsonTypeNames[JsonTypes::OptimizerVerbose]]);
 		if(settings.has_key(JsonTypeNames[JsonTypes::OptimizerNumThreads]))
 			settings_->optimizerNumThreads_ = extract<int>(settings[JsonTypeNames[JsonTypes::OptimizerNumThreads]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::DetectionLossWeight]))
+			settings_->detectionLossWeight_ = extract<double>(settings[JsonTypeNames[JsonTypes::DetectionLossWeight]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::LinkLossWeight]))
+			settings_->linkLossWeight_ = extract<double>(settings[JsonTypeNames[JsonTypes::LinkLossWeight]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::DivisionLossWeight]))
+			settings_->divisionLossWeight_ = extract<double>(settings[JsonTypeNames[JsonTypes::DivisionLossWeight]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::AppearanceLossWeight]))
+			settings_->appearanceLossWeight_ = extract<double>(settings[JsonTypeNames[JsonTypes::AppearanceLossWeight]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::DisappearanceLossWeight]))
+			settings_->disappearanceLossWeight_ = extract<double>(settings[JsonTypeNames[JsonTypes::DisappearanceLossWeight]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::TrackingAwareLoss]))
+			settings_->trackingAwareLoss_ = extract<bool>(settings[JsonTypeNames[JsonTypes::TrackingAwareLoss]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::StandardizeFeatures]))
+			settings_->standardizeFeatures_ = extract<bool>(settings[JsonTypeNames[JsonTypes::StandardizeFeatures]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::MergeExclusionCliques]))
+			settings_->mergeExclusionCliques_ = extract<bool>(settings[JsonTypeNames[JsonTypes::MergeExclusionCliques]]);
+		if(settings.has_key(JsonTypeNames[JsonTypes::MaxExclusionCliqueSize]))
+			settings_->maxExclusionCliqueSize_ = extract<int>(settings[JsonTypeNames[JsonTypes::MaxExclusionCliqueSize]]);
 	}
 	else
 	{
@@ -140,6 +475,18 @@ void PythonModel::readFromPython(dict& graphDict)
 	}
 
 	settings_->print();
+}
+
+void PythonModel::readFromPython(dict& graphDict)
+{
+    // hypotheses given as arrays instead of lists of dicts
+    if(extract<dict>(graphDict.get(JsonTypeNames[JsonTypes::Segmentations])).check())
+    {
+        readFromArrays(graphDict);
+        return;
+    }
+
+    readSettingsFromPython(graphDict);
 
 	list segmentationHypotheses = extract<list>(graphDict[JsonTypeNames[JsonTypes::Segmentations]]);
 	list linkingHypotheses = extract<list>(graphDict[JsonTypeNames[JsonTypes::Links]]);
@@ -186,6 +533,141 @@ void PythonModel::readFromPython(dict& graphDict)
 	}
 }
 
+void PythonModel::readFromArrays(dict& graphDict)
+{
+    readSettingsFromPython(graphDict);
+
+    auto keyOf = [&](const IdLabelType& id, const std::string& what)
+    {
+        IdKey key;
+        if(!idTable_.find(id, key) || segmentationHypotheses_.find(key) == segmentationHypotheses_.end())
+        {
+            std::stringstream s;
+            s << "Python " << what << " references unknown segmentation hypothesis " << id;
+            throw std::runtime_error(s.str());
+        }
+        return key;
+    };
+
+    // read segmentation hypotheses
+    dict segmentations = extract<dict>(graphDict[JsonTypeNames[JsonTypes::Segmentations]]);
+    std::vector<IdLabelType> ids = readIdArray(segmentations[JsonTypeNames[JsonTypes::Id]], "segmentation ids");
+    std::cout << "\tcontains " << ids.size() << " segmentation hypotheses" << std::endl;
+
+    FeatureArray detectionFeatures(segmentations, JsonTypes::Features, ids.size());
+    FeatureArray divisionFeatures(segmentations, JsonTypes::DivisionFeatures, ids.size());
+    FeatureArray appearanceFeatures(segmentations, JsonTypes::AppearanceFeatures, ids.size());
+    FeatureArray disappearanceFeatures(segmentations, JsonTypes::DisappearanceFeatures, ids.size());
+
+    {
+        // the array views only access memory that stays exported, so other Python threads can run meanwhile
+        ScopedGILRelease noGil;
+        idTable_.reserve(ids.size());
+        for(size_t i = 0; i < ids.size(); ++i)
+        {
+            SegmentationHypothesis hyp(featureStore_, ids[i], detectionFeatures.row(i), divisionFeatures.row(i),
+                appearanceFeatures.row(i), disappearanceFeatures.row(i));
+            if(hyp.getDetectionVariable().getNumStates() == 0)
+                throw std::runtime_error("Cannot read detection hypothesis without features!");
+
+            accumulateFeatureStatistics(VariableClass::Detection, hyp.getDetectionVariable());
+            accumulateFeatureStatistics(VariableClass::Division, hyp.getDivisionVariable());
+            accumulateFeatureStatistics(VariableClass::Appearance, hyp.getAppearanceVariable());
+            accumulateFeatureStatistics(VariableClass::Disappearance, hyp.getDisappearanceVariable());
+            segmentationHypotheses_[idTable_.intern(ids[i])] = hyp;
+        }
+    }
+
+    // read linking hypotheses
+    if(graphDict.has_key(JsonTypeNames[JsonTypes::Links]))
+    {
+        dict links = extract<dict>(graphDict[JsonTypeNames[JsonTypes::Links]]);
+        std::vector<IdLabelType> srcIds = readIdArray(links[JsonTypeNames[JsonTypes::SrcId]], "link src ids");
+        std::vector<IdLabelType> destIds = readIdArray(links[JsonTypeNames[JsonTypes::DestId]], "link dest ids");
+        if(srcIds.size() != destIds.size())
+            throw std::runtime_error("Python linking hypotheses must have as many src as dest ids");
+        std::cout << "\tcontains " << srcIds.size() << " linking hypotheses" << std::endl;
+
+        FeatureArray features(links, JsonTypes::Features, srcIds.size());
+        {
+            ScopedGILRelease noGil;
+            for(size_t i = 0; i < srcIds.size(); ++i)
+            {
+                IdKey srcKey = keyOf(srcIds[i], "link");
+                IdKey destKey = keyOf(destIds[i], "link");
+                StateFeatureVector linkFeatures = features.row(i);
+                if(linkFeatures.empty())
+                    throw std::runtime_error("Python dict entry for LinkingHypothesis is invalid: missing features");
+
+                std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(featureStore_, srcKey, destKey, linkFeatures);
+                accumulateFeatureStatistics(VariableClass::Link, hyp->getVariable());
+                linkingHypotheses_[std::make_pair(srcKey, destKey)] = hyp;
+            }
+        }
+    }
+
+    // read division hypotheses
+    if(graphDict.has_key(JsonTypeNames[JsonTypes::Divisions]))
+    {
+        dict divisions = extract<dict>(graphDict[JsonTypeNames[JsonTypes::Divisions]]);
+        std::vector<IdLabelType> parentIds = readIdArray(divisions[JsonTypeNames[JsonTypes::Parent]], "division parent ids");
+        std::vector<IdLabelType> childrenIds = readIdArray(divisions[JsonTypeNames[JsonTypes::Children]], "division children ids");
+        if(childrenIds.size() != 2 * parentIds.size())
+            throw std::runtime_error("Python division hypotheses must have two children each");
+        std::cout << "\tcontains " << parentIds.size() << " division hypotheses" << std::endl;
+
+        FeatureArray features(divisions, JsonTypes::Features, parentIds.size());
+        {
+            ScopedGILRelease noGil;
+            for(size_t i = 0; i < parentIds.size(); ++i)
+            {
+                // always use ordered list of children!
+                IdKey parentKey = keyOf(parentIds[i], "division");
+                std::vector<IdKey> children = {keyOf(childrenIds[2 * i], "division"), keyOf(childrenIds[2 * i + 1], "division")};
+                std::sort(children.begin(), children.end());
+
+                StateFeatureVector divisionFeatures = features.row(i);
+                if(divisionFeatures.empty())
+                    throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: missing features");
+
+                std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(featureStore_, parentKey, children, divisionFeatures);
+                accumulateFeatureStatistics(VariableClass::ExternalDivision, hyp->getVariable());
+                divisionHypotheses_[std::make_tuple(parentKey, children[0], children[1])] = hyp;
+            }
+        }
+    }
+
+    // read exclusion constraints, the ids of all constraints concatenated and the start index of each constraint
+    if(graphDict.has_key(JsonTypeNames[JsonTypes::Exclusions]))
+    {
+        dict exclusions = extract<dict>(graphDict[JsonTypeNames[JsonTypes::Exclusions]]);
+        std::vector<IdLabelType> exclusionIds = readIdArray(exclusions[JsonTypeNames[JsonTypes::Id]], "exclusion ids");
+        ArrayView offsets(exclusions["offsets"], "exclusion offsets");
+        if(offsets.size() == 0 || offsets.getIndex(offsets.size() - 1) != exclusionIds.size())
+            throw std::runtime_error("Python exclusion offsets must end with the number of exclusion ids");
+        std::cout << "\tcontains " << offsets.size() - 1 << " exclusions" << std::endl;
+
+        {
+            ScopedGILRelease noGil;
+            for(size_t e = 0; e + 1 < offsets.size(); ++e)
+            {
+                size_t begin = offsets.getIndex(e);
+                size_t end = offsets.getIndex(e + 1);
+                if(begin > end)
+                    throw std::runtime_error("Python exclusion offsets must not decrease");
+
+                // constraints with less than two elements are ignored
+                if(end - begin < 2)
+                    continue;
+                std::vector<IdKey> constraintKeys;
+                for(size_t m = begin; m < end; ++m)
+                    constraintKeys.push_back(keyOf(exclusionIds[m], "exclusion"));
+                exclusionConstraints_.push_back(ExclusionConstraint(constraintKeys));
+            }
+        }
+    }
+}
+
 dict PythonModel::saveWeightsToPython(const std::vector<double>& weights) const
 {
 	dict result;
@@ -195,6 +677,15 @@ dict PythonModel::saveWeightsToPython(const std::vector<double>& weights) const
 		weightNumbers.append(w);
 
 	result[JsonTypeNames[JsonTypes::Weights]] = weightNumbers;
+
+	// the normalization is nested, so let python's json module build the dictionary
+	if(featureNormalization_ && featureNormalization_->isFinalized())
+	{
+		Json::Value normalization;
+		featureNormalization_->saveToJson(normalization);
+		Json::FastWriter writer;
+		result[JsonTypeNames[JsonTypes::FeatureNormalization]] = import("json").attr("loads")(writer.write(normalization));
+	}
 	return result;
 }
 
@@ -251,11 +742,90 @@ dict PythonModel::saveResultToPython(const Solution& sol) const
 	return result;
 }
 
+dict PythonModel::saveResultToPythonArrays(const Solution& sol) const
+{
+    auto activeValue = [&](const Variable& variable) -> size_t
+    {
+        return variable.getOpenGMVariableId() >= 0 ? sol[variable.getOpenGMVariableId()] : 0;
+    };
+
+    std::vector<IdLabelType> srcIds, destIds;
+    std::vector<uint32_t> linkValues;
+    for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end() ; ++iter)
+    {
+        size_t value = activeValue(iter->second->getVariable());
+        if(value > 0)
+        {
+            srcIds.push_back(idTable_.getId(iter->second->getSrcKey()));
+            destIds.push_back(idTable_.getId(iter->second->getDestKey()));
+            linkValues.push_back(value);
+        }
+    }
+
+    std::vector<IdLabelType> detectionIds, divisionIds;
+    std::vector<uint32_t> detectionValues, divisionValues;
+    for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+    {
+        size_t value = activeValue(iter->second.getDetectionVariable());
+        if(value > 0)
+        {
+            detectionIds.push_back(iter->second.getId());
+            detectionValues.push_back(value);
+        }
+
+        value = activeValue(iter->second.getDivisionVariable());
+        if(value > 0)
+        {
+            divisionIds.push_back(iter->second.getId());
+            divisionValues.push_back(value);
+        }
+    }
+
+    std::vector<IdLabelType> parentIds, childrenIds;
+    std::vector<uint32_t> externalDivisionValues;
+    for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end() ; ++iter)
+    {
+        size_t value = activeValue(iter->second->getVariable());
+        if(value > 0)
+        {
+            parentIds.push_back(idTable_.getId(iter->second->getParentKey()));
+            for(IdKey child : iter->second->getChildrenKeys())
+                childrenIds.push_back(idTable_.getId(child));
+            externalDivisionValues.push_back(value);
+        }
+    }
+
+    dict detectionResults;
+    detectionResults[JsonTypeNames[JsonTypes::Id]] = idsToArray(detectionIds);
+    detectionResults[JsonTypeNames[JsonTypes::Value]] = toArray(detectionValues);
+
+    dict linkResults;
+    linkResults[JsonTypeNames[JsonTypes::SrcId]] = idsToArray(srcIds);
+    linkResults[JsonTypeNames[JsonTypes::DestId]] = idsToArray(destIds);
+    linkResults[JsonTypeNames[JsonTypes::Value]] = toArray(linkValues);
+
+    dict divisionResults;
+    divisionResults[JsonTypeNames[JsonTypes::Id]] = idsToArray(divisionIds);
+    divisionResults[JsonTypeNames[JsonTypes::Value]] = toArray(divisionValues);
+
+    dict externalDivisionResults;
+    externalDivisionResults[JsonTypeNames[JsonTypes::Parent]] = idsToArray(parentIds);
+    externalDivisionResults[JsonTypeNames[JsonTypes::Children]] = idsToArray(childrenIds, 2);
+    externalDivisionResults[JsonTypeNames[JsonTypes::Value]] = toArray(externalDivisionValues);
+
+    dict result;
+    result[JsonTypeNames[JsonTypes::DetectionResults]] = detectionResults;
+    result[JsonTypeNames[JsonTypes::LinkResults]] = linkResults;
+    result[JsonTypeNames[JsonTypes::DivisionResults]] = divisionResults;
+    result[JsonTypeNames[JsonTypes::ExternalDivisionResults]] = externalDivisionResults;
+    return result;
+}
+
 dict PythonModel::linkToPython(const std::shared_ptr<LinkingHypothesis>& link, size_t state) const
 {
 	dict linkRes;
-	linkRes[JsonTypeNames[JsonTypes::SrcId]] = link->getSrcId();
-    linkRes[JsonTypeNames[JsonTypes::DestId]] = link->getDestId();
+	linkRes[JsonTypeNames[JsonTypes::SrcId]] = idTable_.getId(link->getSrcKey());
+    linkRes[JsonTypeNames[JsonTypes::DestId]] = idTable_.getId(link->getDestKey());
     linkRes[JsonTypeNames[JsonTypes::Value]] = (unsigned int)state;
 	return linkRes;
 }
@@ -263,7 +833,7 @@ dict PythonModel::linkToPython(const std::shared_ptr<LinkingHypothesis>& link, s
 dict PythonModel::divisionToPython(const std::shared_ptr<DivisionHypothesis>& division, size_t state) const
 {
 	dict divRes;
-	divRes[JsonTypeNames[JsonTypes::Id]] = division->getParentId();
+	divRes[JsonTypeNames[JsonTypes::Id]] = idTable_.getId(division->getParentKey());
 	divRes[JsonTypeNames[JsonTypes::Value]] = state;
 	return divRes;
 }
@@ -291,6 +861,27 @@ helpers::StateFeatureVector PythonModel::extractFeatures(boost::python::dict& en
 	if(!entry.has_key(JsonTypeNames[type]))
 		throw std::runtime_error("Could not find dict entry for " + JsonTypeNames[type]);
 
+	// {"values": [...], "numStates": n} uses the same features for all n states
+	extract<dict> shared(entry[JsonTypeNames[type]]);
+	if(shared.check())
+	{
+		dict sharedDict = shared();
+		if(!sharedDict.has_key(JsonTypeNames[JsonTypes::Values]) || !sharedDict.has_key(JsonTypeNames[JsonTypes::NumStates]))
+			throw std::runtime_error("Shared features need values and numStates for " + JsonTypeNames[type]);
+
+		list values = extract<list>(sharedDict[JsonTypeNames[JsonTypes::Values]]);
+		int numStates = extract<int>(sharedDict[JsonTypeNames[JsonTypes::NumStates]]);
+		if(len(values) == 0)
+			throw std::runtime_error("Features for state may not be empty for " + JsonTypeNames[type]);
+		if(numStates <= 0)
+			throw std::runtime_error("Shared features need a positive numStates for " + JsonTypeNames[type]);
+
+		FeatureVector featVec;
+		for(size_t j = 0; (int)j < len(values); j++)
+			featVec.push_back(extract<ValueType>(values[j]));
+		return StateFeatureVector(numStates, featVec);
+	}
+
 	list featuresPerState = extract<list>(entry[JsonTypeNames[type]]);
 
 	if(len(featuresPerState) == 0)
@@ -324,6 +915,9 @@ helpers::StateFeatureVector PythonModel::extractFeatures(boost::python::dict& en
 
 Solution PythonModel::getGroundTruth()
 {
+    // learning calls this without the GIL
+    ScopedGILAcquire gil;
+
 	if(!model_.numberOfVariables() > 0)
         throw std::runtime_error("OpenGM model must be initialized before reading a ground truth!");
 	
@@ -333,6 +927,18 @@ Solution PythonModel::getGroundTruth()
     // create a solution vector that holds a value for each segmentation / detection / link
     Solution solution(model_.numberOfVariables(), 0);
 
+    auto findSegmentation = [&](const IdLabelType& id) -> SegmentationHypothesis&
+    {
+        SegmentationHypothesis* hyp = findSegmentationHypothesis(id);
+        if(hyp == nullptr)
+        {
+            std::stringstream s;
+            s << "Cannot find segmentation hypothesis to annotate: " << id;
+            throw std::runtime_error(s.str());
+        }
+        return *hyp;
+    };
+
     // first set all links and the respective source nodes to active
     for(int i = 0; i < len(linkingResults); ++i)
     {
@@ -351,7 +957,8 @@ Solution PythonModel::getGroundTruth()
         if(value > 0)
         {
             // try to find link
-            if(linkingHypotheses_.find(std::make_pair(srcId, destId)) == linkingHypotheses_.end())
+            std::shared_ptr<LinkingHypothesis> hyp = findLinkingHypothesis(srcId, destId);
+            if(!hyp)
             {
                 std::stringstream s;
                 s << "Cannot find link to annotate: " << srcId << " to " << destId;
@@ -359,7 +966,6 @@ Solution PythonModel::getGroundTruth()
             }
             
             // set link active
-            std::shared_ptr<LinkingHypothesis> hyp = linkingHypotheses_[std::make_pair(srcId, destId)];
             solution[hyp->getVariable().getOpenGMVariableId()] = value;
         }
     }
@@ -379,7 +985,7 @@ Solution PythonModel::getGroundTruth()
 		IdLabelType id = extract<IdLabelType>(entry[JsonTypeNames[JsonTypes::Id]]);
         size_t value = extract<size_t>(entry[JsonTypeNames[JsonTypes::Value]]);
 
-        solution[segmentationHypotheses_[id].getDetectionVariable().getOpenGMVariableId()] = value;
+        solution[findSegmentation(id).getDetectionVariable().getOpenGMVariableId()] = value;
     }
 
     // read division variable states
@@ -410,7 +1016,8 @@ Solution PythonModel::getGroundTruth()
                 id = extract<IdLabelType>(entry[JsonTypeNames[JsonTypes::Parent]]);
             }
 
-            if(solution[segmentationHypotheses_[id].getDetectionVariable().getOpenGMVariableId()] == 0)
+            SegmentationHypothesis& segmentation = findSegmentation(id);
+            if(solution[segmentation.getDetectionVariable().getOpenGMVariableId()] == 0)
             {
                 // in any case the parent must be active!
                 std::stringstream error;
@@ -420,14 +1027,14 @@ Solution PythonModel::getGroundTruth()
 
             if(entry.has_key(JsonTypeNames[JsonTypes::Id]))
             {
-                if(segmentationHypotheses_[id].getDivisionVariable().getOpenGMVariableId() < 0)
+                if(segmentation.getDivisionVariable().getOpenGMVariableId() < 0)
                 {
                     std::stringstream error;
                     error << "Trying to set division of " << id << " active but the variable had no division features!";
                     throw std::runtime_error(error.str());
                 }
                 // internal if id is given AND there is a opengm variable for the internal division
-                solution[segmentationHypotheses_[id].getDivisionVariable().getOpenGMVariableId()] = 1;
+                solution[segmentation.getDivisionVariable().getOpenGMVariableId()] = 1;
             }
             else if(entry.has_key(JsonTypeNames[JsonTypes::Parent]) && entry.has_key(JsonTypeNames[JsonTypes::Children]))
             {
@@ -446,14 +1053,8 @@ Solution PythonModel::getGroundTruth()
                     childrenIds.push_back(extract<IdLabelType>(children[i]));
                 }
 
-                // always use ordered list of children!
-                std::sort(childrenIds.begin(), childrenIds.end());
-
-                DivisionHypothesis::IdType idx = std::make_tuple((IdLabelType)extract<IdLabelType>(entry[JsonTypeNames[JsonTypes::Parent]]),
-                                                                childrenIds[0],
-                                                                childrenIds[1]);
-
-                if(divisionHypotheses_.find(idx) == divisionHypotheses_.end())
+                auto divHyp = findDivisionHypothesis(id, childrenIds[0], childrenIds[1]);
+                if(!divHyp)
                 {
                     std::stringstream error;
                     error << "Parent " << id << " does not have division to " << childrenIds[0] << " and " << childrenIds[1] << " to set active!";
@@ -461,7 +1062,6 @@ Solution PythonModel::getGroundTruth()
                 }
 
                 std::cout << "Setting external division to active! " << std::endl;
-                auto divHyp = divisionHypotheses_[idx];
                 solution[divHyp->getVariable().getOpenGMVariableId()] = 1;
             }
             else
@@ -489,6 +1089,19 @@ helpers::FeatureVector readWeightsFromPython(boost::python::dict& weightsDict)
 	}
 	return weights;
 }
+
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromPython(boost::python::dict& weightsDict)
+{
+	if(!weightsDict.has_key(JsonTypeNames[JsonTypes::FeatureNormalization]))
+		return std::shared_ptr<FeatureNormalization>();
+
+	std::string normalizationString = extract<std::string>(import("json").attr("dumps")(weightsDict[JsonTypeNames[JsonTypes::FeatureNormalization]]));
+	Json::Value normalization;
+	Json::Reader reader;
+	if(!reader.parse(normalizationString, normalization))
+		throw std::runtime_error("Could not parse feature normalization: " + reader.getFormattedErrorMessages());
+	return std::make_shared<FeatureNormalization>(normalization);
+}
 	
 } // end namespace mht
 
@@ -22,11 +22,52 @@ namespace mht
  */
 helpers::FeatureVector readWeightsFromPython(boost::python::dict& weightsDict);
 
+/**
+ * @brief read the feature normalization that was stored together with the weights in a python dictionary
+ * 
+ * @param weightsDict
+ * @return the normalization, or nullptr if the dictionary contains none
+ */
+std::shared_ptr<helpers::FeatureNormalization> readFeatureNormalizationFromPython(boost::python::dict& weightsDict);
+
+/**
+ * @brief Releases the GIL for the lifetime of this object, so that other Python threads can run.
+ * @details No Python objects must be touched while the GIL is released, use ScopedGILAcquire for that
+ */
+class ScopedGILRelease
+{
+public:
+    ScopedGILRelease(): state_(PyEval_SaveThread()) {}
+    ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+    ScopedGILRelease(const ScopedGILRelease&) = delete;
+    ScopedGILRelease& operator=(const ScopedGILRelease&) = delete;
+
+private:
+    PyThreadState* state_;
+};
+
+/**
+ * @brief Acquires the GIL for the lifetime of this object, works whether or not the calling thread holds it already
+ */
+class ScopedGILAcquire
+{
+public:
+    ScopedGILAcquire(): state_(PyGILState_Ensure()) {}
+    ~ScopedGILAcquire() { PyGILState_Release(state_); }
+
+    ScopedGILAcquire(const ScopedGILAcquire&) = delete;
+    ScopedGILAcquire& operator=(const ScopedGILAcquire&) = delete;
+
+private:
+    PyGILState_STATE state_;
+};
+
 
 /**
  * @brief Model specialized for Python loading and writing
- * @detail WARNING: at the moment you can only run either learn or infer once on the model. 
- *         Build a new one if you need it multiple times
+ * @detail Reading and writing needs the GIL. learn() and infer() can run without it,
+ *         getGroundTruth() acquires it while it reads the ground truth dictionary.
  */
 class PythonModel : public Model
 {
@@ -37,6 +78,25 @@ public:
      */
     void readFromPython(boost::python::dict& graphDict);
 
+    /**
+     * @brief Read a model whose hypotheses are given as arrays (e.g. NumPy arrays), which are read through
+     *        the buffer protocol without creating a Python object per value. readFromPython() calls this
+     *        if "segmentationHypotheses" is a dict.
+     * @details The layout is the same as in the HDF5 model format (see Hdf5Model):
+     *          - "segmentationHypotheses": dict with "id" (N ids), "features" and optionally "divisionFeatures",
+     *            "appearanceFeatures" and "disappearanceFeatures"
+     *          - "linkingHypotheses": dict with "src", "dest" (L ids each) and "features"
+     *          - "divisions": dict with "parent" (D ids), "children" (D x 2 ids) and "features"
+     *          - "exclusions": dict with "id" (the ids of all constraints concatenated) and "offsets" (E+1 start indices into "id")
+     *
+     *          Features are arrays of shape (rows x states x features), or dicts with such an array as "values"
+     *          and "numStates", the number of states used by each row (0 if the hypothesis does not have this kind of variable).
+     *          Ids are integer arrays, or sequences of strings if USE_STRING_IDS is defined.
+     *          Arrays must be C contiguous, features of type float64 are used without conversion.
+     * @param graphDict
+     */
+    void readFromArrays(boost::python::dict& graphDict);
+
     /**
      * @brief Export a found solution vector as a python dictionary
      * 
@@ -45,7 +105,18 @@ public:
     boost::python::dict saveResultToPython(const helpers::Solution& sol) const;
 
     /**
-     * @brief Export a found weight vector as a python dictionary
+     * @brief Export a found solution vector as a python dictionary of arrays, with the same names and layout as
+     *        the results in the HDF5 format (see Hdf5Model). Only active hypotheses are contained, like in saveResultToPython().
+     * @details The arrays are writable buffers that NumPy can use without a copy (numpy.asarray()), values are uint32,
+     *          ids use IdLabelType or are lists of strings if USE_STRING_IDS is defined.
+     *          "externalDivisionResults/children" has the shape (D x 2), unless it is empty.
+     *
+     * @param sol the labeling to save
+     */
+    boost::python::dict saveResultToPythonArrays(const helpers::Solution& sol) const;
+
+    /**
+     * @brief Export a found weight vector as a python dictionary, together with the feature normalization if one was used
      * 
      * @param weights the learned weight vector
      */
@@ -59,12 +130,17 @@ public:
     void setPythonGt(boost::python::dict& gtDict);
 
     /**
-     * @brief get the ground truth for learning from a JSON file
+     * @brief get the ground truth for learning from the dictionary given by setPythonGt(), acquires the GIL if necessary
      * @return the solution vector that fits the initialized OpenGM model
      */
     virtual helpers::Solution getGroundTruth();
 
 private:
+    /**
+     * @brief read the "settings" entry of the graph dictionary, or use the defaults if there is none
+     */
+    void readSettingsFromPython(boost::python::dict& graphDict);
+
     /**
      * @brief read linking hypothesis from Python and adds it to linkingHypotheses_
      * @details expects the json value to contain attributes "src"(helpers::IdLabelType), 
@@ -0,0 +1,494 @@
+#include "binarymodel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <json/json.h>
+#include "mappedfile.h"
+
+using namespace helpers;
+
+namespace mht
+{
+
+namespace
+{
+
+const char BinaryModelMagic[8] = {'M', 'H', 'T', 'M', 'O', 'D', 'E', 'L'};
+const uint32_t BinaryModelVersion = 1;
+const size_t BinaryModelAlignment = 8;
+
+#ifdef USE_STRING_IDS
+const uint32_t UseStringIds = 1;
+#else
+const uint32_t UseStringIds = 0;
+#endif
+
+/**
+ * @brief Hands out aligned sections of the mapped file and checks that they lie inside of it
+ */
+class SectionReader
+{
+public:
+	SectionReader(const char* begin, const char* end):
+		begin_(begin),
+		position_(begin),
+		end_(end)
+	{}
+
+	template<class T>
+	const T* take(uint64_t count)
+	{
+		size_t offset = position_ - begin_;
+		offset = (offset + BinaryModelAlignment - 1) / BinaryModelAlignment * BinaryModelAlignment;
+		if(offset > size_t(end_ - begin_) || count > (size_t(end_ - begin_) - offset) / sizeof(T))
+			throw std::runtime_error("Binary model file is truncated");
+
+		const T* section = reinterpret_cast<const T*>(begin_ + offset);
+		position_ = begin_ + offset + count * sizeof(T);
+		return section;
+	}
+
+private:
+	const char* begin_;
+	const char* position_;
+	const char* end_;
+};
+
+/**
+ * @brief Features of one variable class stored as offsets into states, offsets into values and the values
+ */
+class FeatureMatrix
+{
+public:
+	FeatureMatrix(SectionReader& reader, uint64_t numRows)
+	{
+		stateOffsets_ = reader.take<uint64_t>(numRows + 1);
+		numStates_ = stateOffsets_[numRows];
+		featureOffsets_ = reader.take<uint64_t>(numStates_ + 1);
+		numValues_ = featureOffsets_[numStates_];
+		values_ = reader.take<double>(numValues_);
+	}
+
+	/**
+	 * @brief reserve space for all rows of this matrix in the given arena, identical rows are only stored once
+	 */
+	void reserve(FeatureArena& arena) const
+	{
+		arena.reserve(numStates_);
+	}
+
+	/**
+	 * @brief copy the features of one row, i.e. of one variable, from the file to the given arena
+	 * @return the rows of the states of the variable in the arena
+	 */
+	FeatureRowRange addRow(FeatureArena& arena, uint64_t r) const
+	{
+		uint64_t stateBegin = stateOffsets_[r];
+		uint64_t stateEnd = stateOffsets_[r + 1];
+		if(stateBegin > stateEnd || stateEnd > numStates_)
+			throw std::runtime_error("Binary model file contains invalid feature offsets");
+
+		for(uint64_t s = stateBegin; s < stateEnd; ++s)
+		{
+			if(featureOffsets_[s] > featureOffsets_[s + 1] || featureOffsets_[s + 1] > numValues_)
+				throw std::runtime_error("Binary model file contains invalid feature offsets");
+		}
+		return FeatureRowRange(arena.addRows(values_, featureOffsets_ + stateBegin, stateEnd - stateBegin), stateEnd - stateBegin);
+	}
+
+private:
+	uint64_t numStates_;
+	uint64_t numValues_;
+	const uint64_t* stateOffsets_;
+	const uint64_t* featureOffsets_;
+	const double* values_;
+};
+
+/**
+ * @brief Writes sections to a file and pads them to the alignment of the format
+ */
+class SectionWriter
+{
+public:
+	SectionWriter(const std::string& filename):
+		output_(filename.c_str(), std::ios::binary),
+		position_(0)
+	{
+		if(!output_.good())
+			throw std::runtime_error("Could not open binary model file for saving: " + filename);
+	}
+
+	template<class T>
+	void write(const T* data, size_t count)
+	{
+		output_.write(reinterpret_cast<const char*>(data), count * sizeof(T));
+		position_ += count * sizeof(T);
+	}
+
+	template<class T>
+	void writeValue(const T& value)
+	{
+		write(&value, 1);
+	}
+
+	void align()
+	{
+		static const char padding[BinaryModelAlignment] = {0};
+		size_t remainder = position_ % BinaryModelAlignment;
+		if(remainder > 0)
+			write(padding, BinaryModelAlignment - remainder);
+	}
+
+	void finish()
+	{
+		output_.flush();
+		if(!output_.good())
+			throw std::runtime_error("Could not write binary model file");
+	}
+
+private:
+	std::ofstream output_;
+	size_t position_;
+};
+
+void writeFeatureMatrix(SectionWriter& writer, const std::vector<const Variable*>& variables)
+{
+	uint64_t offset = 0;
+	writer.align();
+	writer.writeValue(offset);
+	for(const Variable* variable : variables)
+	{
+		offset += variable->getNumStates();
+		writer.writeValue(offset);
+	}
+
+	offset = 0;
+	writer.align();
+	writer.writeValue(offset);
+	for(const Variable* variable : variables)
+	{
+		for(size_t s = 0; s < variable->getNumStates(); ++s)
+		{
+			offset += variable->getNumFeatures(s);
+			writer.writeValue(offset);
+		}
+	}
+
+	writer.align();
+	for(const Variable* variable : variables)
+	{
+		for(size_t s = 0; s < variable->getNumStates(); ++s)
+		{
+			FeatureRow stateFeatures = variable->getFeatures(s);
+#ifdef USE_FLOAT_FEATURES
+			// the file always stores double precision
+			std::vector<double> values(stateFeatures.begin(), stateFeatures.end());
+			writer.write(values.data(), values.size());
+#else
+			writer.write(stateFeatures.data(), stateFeatures.size());
+#endif
+		}
+	}
+}
+
+void writeIndexCSR(SectionWriter& writer, const std::vector<uint64_t>& offsets, const std::vector<uint32_t>& indices)
+{
+	writer.align();
+	writer.write(offsets.data(), offsets.size());
+	writer.align();
+	writer.write(indices.data(), indices.size());
+}
+
+} // end anonymous namespace
+
+bool BinaryModel::isBinaryModelFile(const std::string& filename)
+{
+	std::ifstream input(filename.c_str(), std::ios::binary);
+	char magic[sizeof(BinaryModelMagic)];
+	if(!input.read(magic, sizeof(magic)))
+		return false;
+	return std::memcmp(magic, BinaryModelMagic, sizeof(magic)) == 0;
+}
+
+void BinaryModel::readFromFile(const std::string& filename)
+{
+	if(isBinaryModelFile(filename))
+		readFromBinary(filename);
+	else
+		readFromJson(filename);
+}
+
+void BinaryModel::readFromBinary(const std::string& filename)
+{
+	MappedFile file(filename);
+	SectionReader reader(file.begin(), file.end());
+
+	const BinaryModelHeader& header = *reader.take<BinaryModelHeader>(1);
+	if(std::memcmp(header.magic, BinaryModelMagic, sizeof(BinaryModelMagic)) != 0)
+		throw std::runtime_error("File " + filename + " is not a binary model");
+	if(header.version != BinaryModelVersion)
+	{
+		std::stringstream s;
+		s << "Binary model file " << filename << " has unsupported version " << header.version;
+		throw std::runtime_error(s.str());
+	}
+	if(header.stringIds != UseStringIds)
+		throw std::runtime_error("Binary model file " + filename + " was written with a different id type (USE_STRING_IDS)");
+
+	// read settings
+	const char* settingsText = reader.take<char>(header.settingsSize);
+	Json::Value settingsJson;
+	Json::Reader jsonReader;
+	if(!jsonReader.parse(settingsText, settingsText + header.settingsSize, settingsJson))
+		throw std::runtime_error("Could not parse settings of binary model file " + filename);
+	settings_ = std::make_shared<helpers::Settings>(settingsJson);
+	settings_->print();
+
+	// segmentation ids, referenced by index in the rest of the file
+	const uint64_t numSegmentations = header.numSegmentations;
+	std::vector<IdLabelType> ids;
+	ids.reserve(numSegmentations);
+#ifdef USE_STRING_IDS
+	const uint64_t* idOffsets = reader.take<uint64_t>(numSegmentations + 1);
+	const char* idCharacters = reader.take<char>(idOffsets[numSegmentations]);
+	for(uint64_t i = 0; i < numSegmentations; ++i)
+	{
+		if(idOffsets[i] > idOffsets[i + 1] || idOffsets[i + 1] > idOffsets[numSegmentations])
+			throw std::runtime_error("Binary model file contains invalid id offsets");
+		ids.push_back(IdLabelType(idCharacters + idOffsets[i], idCharacters + idOffsets[i + 1]));
+	}
+#else
+	const uint32_t* idValues = reader.take<uint32_t>(numSegmentations);
+	ids.assign(idValues, idValues + numSegmentations);
+#endif
+
+	// keys of the segmentations in file order, assigned when they are added below
+	std::vector<IdKey> keys;
+	keys.reserve(numSegmentations);
+	idTable_.reserve(numSegmentations);
+	auto segmentationIndex = [&](uint32_t index)
+	{
+		if(index >= numSegmentations)
+			throw std::runtime_error("Binary model file references an invalid segmentation hypothesis");
+		return keys[index];
+	};
+
+	FeatureMatrix detectionFeatures(reader, numSegmentations);
+	FeatureMatrix divisionFeatures(reader, numSegmentations);
+	FeatureMatrix appearanceFeatures(reader, numSegmentations);
+	FeatureMatrix disappearanceFeatures(reader, numSegmentations);
+	detectionFeatures.reserve(featureStore_.getArena(VariableClass::Detection));
+	divisionFeatures.reserve(featureStore_.getArena(VariableClass::Division));
+	appearanceFeatures.reserve(featureStore_.getArena(VariableClass::Appearance));
+	disappearanceFeatures.reserve(featureStore_.getArena(VariableClass::Disappearance));
+
+	std::cout << "\tcontains " << numSegmentations << " segmentation hypotheses" << std::endl;
+	for(uint64_t i = 0; i < numSegmentations; ++i)
+	{
+		SegmentationHypothesis hyp(featureStore_, ids[i],
+			detectionFeatures.addRow(featureStore_.getArena(VariableClass::Detection), i),
+			divisionFeatures.addRow(featureStore_.getArena(VariableClass::Division), i),
+			appearanceFeatures.addRow(featureStore_.getArena(VariableClass::Appearance), i),
+			disappearanceFeatures.addRow(featureStore_.getArena(VariableClass::Disappearance), i));
+		accumulateFeatureStatistics(VariableClass::Detection, hyp.getDetectionVariable());
+		accumulateFeatureStatistics(VariableClass::Division, hyp.getDivisionVariable());
+		accumulateFeatureStatistics(VariableClass::Appearance, hyp.getAppearanceVariable());
+		accumulateFeatureStatistics(VariableClass::Disappearance, hyp.getDisappearanceVariable());
+
+		// keys are assigned in file order, so every insertion of a new model happens at the end of the map
+		keys.push_back(idTable_.intern(ids[i]));
+		segmentationHypotheses_.emplace_hint(segmentationHypotheses_.end(), keys.back(), hyp);
+	}
+
+	// links
+	const uint64_t* linkOffsets = reader.take<uint64_t>(numSegmentations + 1);
+	const uint32_t* linkTargets = reader.take<uint32_t>(header.numLinks);
+	FeatureMatrix linkFeatures(reader, header.numLinks);
+	linkFeatures.reserve(featureStore_.getArena(VariableClass::Link));
+	if(linkOffsets[numSegmentations] != header.numLinks)
+		throw std::runtime_error("Binary model file contains invalid link offsets");
+
+	std::cout << "\tcontains " << header.numLinks << " linking hypotheses" << std::endl;
+	for(uint64_t src = 0; src < numSegmentations; ++src)
+	{
+		if(linkOffsets[src] > linkOffsets[src + 1] || linkOffsets[src + 1] > header.numLinks)
+			throw std::runtime_error("Binary model file contains invalid link offsets");
+
+		for(uint64_t l = linkOffsets[src]; l < linkOffsets[src + 1]; ++l)
+		{
+			IdKey destKey = segmentationIndex(linkTargets[l]);
+			std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(featureStore_, keys[src], destKey,
+				linkFeatures.addRow(featureStore_.getArena(VariableClass::Link), l));
+			accumulateFeatureStatistics(VariableClass::Link, hyp->getVariable());
+			linkingHypotheses_.emplace_hint(linkingHypotheses_.end(), std::make_pair(keys[src], destKey), hyp);
+		}
+	}
+
+	// divisions
+	const uint64_t* divisionOffsets = reader.take<uint64_t>(numSegmentations + 1);
+	const uint32_t* divisionChildren = reader.take<uint32_t>(2 * header.numDivisions);
+	FeatureMatrix externalDivisionFeatures(reader, header.numDivisions);
+	externalDivisionFeatures.reserve(featureStore_.getArena(VariableClass::ExternalDivision));
+	if(divisionOffsets[numSegmentations] != header.numDivisions)
+		throw std::runtime_error("Binary model file contains invalid division offsets");
+
+	std::cout << "\tcontains " << header.numDivisions << " division hypotheses" << std::endl;
+	for(uint64_t parent = 0; parent < numSegmentations; ++parent)
+	{
+		if(divisionOffsets[parent] > divisionOffsets[parent + 1] || divisionOffsets[parent + 1] > header.numDivisions)
+			throw std::runtime_error("Binary model file contains invalid division offsets");
+
+		for(uint64_t d = divisionOffsets[parent]; d < divisionOffsets[parent + 1]; ++d)
+		{
+			// always use ordered list of children!
+			std::vector<IdKey> childrenKeys = {segmentationIndex(divisionChildren[2 * d]), segmentationIndex(divisionChildren[2 * d + 1])};
+			std::sort(childrenKeys.begin(), childrenKeys.end());
+			std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(featureStore_, keys[parent], childrenKeys,
+				externalDivisionFeatures.addRow(featureStore_.getArena(VariableClass::ExternalDivision), d));
+			accumulateFeatureStatistics(VariableClass::ExternalDivision, hyp->getVariable());
+			divisionHypotheses_.emplace_hint(divisionHypotheses_.end(), std::make_tuple(keys[parent], childrenKeys[0], childrenKeys[1]), hyp);
+		}
+	}
+
+	// exclusion constraints
+	const uint64_t* exclusionOffsets = reader.take<uint64_t>(header.numExclusions + 1);
+	const uint32_t* exclusionMembers = reader.take<uint32_t>(exclusionOffsets[header.numExclusions]);
+
+	std::cout << "\tcontains " << header.numExclusions << " exclusions" << std::endl;
+	exclusionConstraints_.reserve(exclusionConstraints_.size() + header.numExclusions);
+	for(uint64_t e = 0; e < header.numExclusions; ++e)
+	{
+		if(exclusionOffsets[e] > exclusionOffsets[e + 1] || exclusionOffsets[e + 1] > exclusionOffsets[header.numExclusions])
+			throw std::runtime_error("Binary model file contains invalid exclusion offsets");
+
+		std::vector<IdKey> exclusionKeys;
+		for(uint64_t m = exclusionOffsets[e]; m < exclusionOffsets[e + 1]; ++m)
+			exclusionKeys.push_back(segmentationIndex(exclusionMembers[m]));
+		exclusionConstraints_.push_back(ExclusionConstraint(exclusionKeys));
+	}
+}
+
+void BinaryModel::saveToBinary(const std::string& filename) const
+{
+	// segmentations are referenced by their position in the sorted map
+	std::map<IdKey, uint32_t> indices;
+	std::vector<const Variable*> detections, divisions, appearances, disappearances;
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+	{
+		uint32_t index = indices.size();
+		indices[iter->first] = index;
+		detections.push_back(&iter->second.getDetectionVariable());
+		divisions.push_back(&iter->second.getDivisionVariable());
+		appearances.push_back(&iter->second.getAppearanceVariable());
+		disappearances.push_back(&iter->second.getDisappearanceVariable());
+	}
+
+	auto indexOf = [&](IdKey key)
+	{
+		auto it = indices.find(key);
+		if(it == indices.end())
+		{
+			std::stringstream s;
+			s << "Cannot save model that references missing segmentation hypothesis " << idTable_.getId(key);
+			throw std::runtime_error(s.str());
+		}
+		return it->second;
+	};
+
+	// links and divisions are stored sorted by their source, which is the order of the maps
+	std::vector<uint64_t> linkOffsets(segmentationHypotheses_.size() + 1, 0);
+	std::vector<uint32_t> linkTargets;
+	std::vector<const Variable*> links;
+	for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
+	{
+		linkOffsets[indexOf(iter->second->getSrcKey()) + 1]++;
+		linkTargets.push_back(indexOf(iter->second->getDestKey()));
+		links.push_back(&iter->second->getVariable());
+	}
+
+	std::vector<uint64_t> divisionOffsets(segmentationHypotheses_.size() + 1, 0);
+	std::vector<uint32_t> divisionChildren;
+	std::vector<const Variable*> externalDivisions;
+	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
+	{
+		divisionOffsets[indexOf(iter->second->getParentKey()) + 1]++;
+		for(auto c : iter->second->getChildrenKeys())
+			divisionChildren.push_back(indexOf(c));
+		externalDivisions.push_back(&iter->second->getVariable());
+	}
+
+	for(size_t i = 1; i < linkOffsets.size(); ++i)
+	{
+		linkOffsets[i] += linkOffsets[i - 1];
+		divisionOffsets[i] += divisionOffsets[i - 1];
+	}
+
+	std::vector<uint64_t> exclusionOffsets(1, 0);
+	std::vector<uint32_t> exclusionMembers;
+	for(const ExclusionConstraint& exclusion : exclusionConstraints_)
+	{
+		for(auto key : exclusion.getKeys())
+			exclusionMembers.push_back(indexOf(key));
+		exclusionOffsets.push_back(exclusionMembers.size());
+	}
+
+	Json::Value settingsJson;
+	if(settings_)
+		settings_->saveToJson(settingsJson);
+	Json::FastWriter jsonWriter;
+	std::string settingsText = jsonWriter.write(settingsJson);
+
+	BinaryModelHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, BinaryModelMagic, sizeof(BinaryModelMagic));
+	header.version = BinaryModelVersion;
+	header.stringIds = UseStringIds;
+	header.numSegmentations = segmentationHypotheses_.size();
+	header.numLinks = linkingHypotheses_.size();
+	header.numDivisions = divisionHypotheses_.size();
+	header.numExclusions = exclusionConstraints_.size();
+	header.settingsSize = settingsText.size();
+
+	SectionWriter writer(filename);
+	writer.writeValue(header);
+	writer.align();
+	writer.write(settingsText.data(), settingsText.size());
+
+	writer.align();
+#ifdef USE_STRING_IDS
+	uint64_t offset = 0;
+	writer.writeValue(offset);
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+	{
+		offset += iter->second.getId().size();
+		writer.writeValue(offset);
+	}
+	writer.align();
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+		writer.write(iter->second.getId().data(), iter->second.getId().size());
+#else
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+		writer.writeValue(uint32_t(iter->second.getId()));
+#endif
+
+	writeFeatureMatrix(writer, detections);
+	writeFeatureMatrix(writer, divisions);
+	writeFeatureMatrix(writer, appearances);
+	writeFeatureMatrix(writer, disappearances);
+
+	writeIndexCSR(writer, linkOffsets, linkTargets);
+	writeFeatureMatrix(writer, links);
+
+	writeIndexCSR(writer, divisionOffsets, divisionChildren);
+	writeFeatureMatrix(writer, externalDivisions);
+
+	writeIndexCSR(writer, exclusionOffsets, exclusionMembers);
+	writer.finish();
+}
+
+} // end namespace mht
@@ -1,4 +1,5 @@
 #include "divisionhypothesis.h"
+#include "factorbuffer.h"
 #include <stdexcept>
 #include <algorithm>
 
@@ -10,19 +11,30 @@ namespace mht
 DivisionHypothesis::DivisionHypothesis()
 {}
 
-DivisionHypothesis::DivisionHypothesis(helpers::IdLabelType parent, 
-                                       const std::vector<helpers::IdLabelType>& children, 
+DivisionHypothesis::DivisionHypothesis(helpers::FeatureStore& featureStore,
+                                       helpers::IdKey parent, 
+                                       const std::vector<helpers::IdKey>& children, 
                                        const helpers::StateFeatureVector& features):
-    parentId_(parent),
-    childrenIds_(children),
-    variable_(features)
+    parentKey_(parent),
+    childrenKeys_(children),
+    variable_(featureStore.getArena(VariableClass::ExternalDivision), features)
 {}
 
-void DivisionHypothesis::toDot(std::ostream& stream, const Solution* sol) const
+DivisionHypothesis::DivisionHypothesis(helpers::FeatureStore& featureStore,
+                                       helpers::IdKey parent, 
+                                       const std::vector<helpers::IdKey>& children, 
+                                       const helpers::FeatureRowRange& rows):
+    parentKey_(parent),
+    childrenKeys_(children),
+    variable_(featureStore.getArena(VariableClass::ExternalDivision), rows)
+{}
+
+void DivisionHypothesis::toDot(std::ostream& stream, const Solution* sol, const IdTable& idTable) const
 {
     std::stringstream divNodeName;
-    divNodeName << "\"divisionOf" << parentId_ << "To" << childrenIds_[0] << "And" << childrenIds_[1] << "\"";
-    stream << "\t" << parentId_ << " -> " << divNodeName.str();
+    divNodeName << "\"divisionOf" << idTable.getId(parentKey_) << "To" << idTable.getId(childrenKeys_[0])
+        << "And" << idTable.getId(childrenKeys_[1]) << "\"";
+    stream << "\t" << idTable.getId(parentKey_) << " -> " << divNodeName.str();
 
     if(sol != nullptr && variable_.getOpenGMVariableId() >= 0)
     {
@@ -36,32 +48,25 @@ void DivisionHypothesis::toDot(std::ostream& stream, const Solution* sol) const
     }
 
     stream << "; \n" << std::flush;
-    stream << divNodeName.str() << " -> " << childrenIds_[0] << "; \n" << std::flush;
-    stream << divNodeName.str() << " -> " << childrenIds_[1] << "; \n" << std::flush;
+    stream << divNodeName.str() << " -> " << idTable.getId(childrenKeys_[0]) << "; \n" << std::flush;
+    stream << divNodeName.str() << " -> " << idTable.getId(childrenKeys_[1]) << "; \n" << std::flush;
 }
 
-void DivisionHypothesis::registerWithSegmentations(std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses)
+void DivisionHypothesis::addVariablesToOpenGMModel(GraphicalModelType& model)
 {
-    assert(segmentationHypotheses.find(parentId_) != segmentationHypotheses.end());
-    for(auto c : childrenIds_)
-        assert(segmentationHypotheses.find(c) != segmentationHypotheses.end());
+    // std::cout << "Adding linking hypothesis between " << srcId_ << " and " << destId_ << " to opengm" << std::endl;
 
-    // std::cout << "Registering outgoing link for " << srcId_ << std::endl;
-    segmentationHypotheses[parentId_].addOutgoingDivision(shared_from_this());
-    // std::cout << "Registering incoming link for " << destId_ << std::endl;
-    for(auto c : childrenIds_)
-        segmentationHypotheses[c].addIncomingDivision(shared_from_this());
+    variable_.addToOpenGM(model);
 }
 
 void DivisionHypothesis::addToOpenGMModel(
-    GraphicalModelType& model, 
+    FactorBuffer& factors, 
     WeightsType& weights, 
     bool statesShareWeights,
-    const std::vector<size_t>& weightIds)
+    const std::vector<size_t>& weightIds,
+    const UnaryEnergies* energies) const
 {
-    // std::cout << "Adding linking hypothesis between " << srcId_ << " and " << destId_ << " to opengm" << std::endl;
-
-    variable_.addToOpenGM(model, statesShareWeights, weights, weightIds);
+    variable_.addUnaryToOpenGM(factors, statesShareWeights, weights, weightIds, energies);
 }
 
 } // end namespace mht
@@ -1,33 +1,39 @@
 #include "exclusionconstraint.h"
-#include <algorithm>
+#include "hypothesisgraph.h"
+#include "factorbuffer.h"
 
 using namespace helpers;
 
 namespace mht
 {
 
-ExclusionConstraint::ExclusionConstraint(const std::vector<helpers::IdLabelType>& ids):
-	ids_(ids)
+ExclusionConstraint::ExclusionConstraint(const std::vector<helpers::IdKey>& keys):
+	keys_(keys)
 {}
 
-void ExclusionConstraint::addToOpenGMModel(GraphicalModelType& model, std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses)
+void ExclusionConstraint::addToOpenGMModel(
+	const GraphicalModelType& model,
+	FactorBuffer& factors,
+	const HypothesisGraph& graph,
+	size_t index)
 {
 	LinearConstraintFunctionType::LinearConstraintType exclusionConstraint;
 	std::vector<LabelType> factorVariables;
 	std::vector<LabelType> constraintShape;
-    
-	// sort because OpenGM likes to have variable ids in order
-	std::sort(ids_.begin(), ids_.end(), [&](const helpers::IdLabelType& a, const helpers::IdLabelType& b){
-		return segmentationHypotheses[b].getDetectionVariable().getOpenGMVariableId() > segmentationHypotheses[a].getDetectionVariable().getOpenGMVariableId();
-	});
+	size_t numFactorVariables = getNumOpenGMFactorVariables(model, graph, index);
+	factorVariables.reserve(numFactorVariables);
+	constraintShape.reserve(numFactorVariables);
+	exclusionConstraint.reserve(numFactorVariables);
 
-    // sum of all participating indicator variables for states > 0 must not exceed 1
-    for(size_t i = 0; i < ids_.size(); ++i)
+    // sum of all participating indicator variables for states > 0 must not exceed 1,
+    // the graph orders the members by their variable ids because OpenGM likes to have them in order
+    for(uint32_t segmentation : graph.getExclusionMembers(index))
     {
     	// indicator variable references the i'th argument of the constraint function, and its states > 0
-    	for(size_t state = 1; state < model.numberOfLabels(segmentationHypotheses[ids_[i]].getDetectionVariable().getOpenGMVariableId()); ++state)
+    	int variable = graph.getDetectionVariable(segmentation);
+    	for(size_t state = 1; state < model.numberOfLabels(variable); ++state)
     	{
-	    	addOpenGMVariableToConstraint(exclusionConstraint, segmentationHypotheses[ids_[i]].getDetectionVariable().getOpenGMVariableId(),
+	    	addOpenGMVariableToConstraint(exclusionConstraint, variable,
 				state, 1.0, constraintShape, factorVariables, model);
 	    }
     }
@@ -35,31 +41,24 @@ void ExclusionConstraint::addToOpenGMModel(GraphicalModelType& model, std::map<h
     exclusionConstraint.setBound( 1 );
     exclusionConstraint.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::LessEqual);
 
-    addConstraintToOpenGMModel(exclusionConstraint, constraintShape, factorVariables, model);
+    addConstraintToOpenGMModel(exclusionConstraint, constraintShape, factorVariables, factors);
 }
 
-bool ExclusionConstraint::verifySolution(const Solution& sol, const std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses) const
+size_t ExclusionConstraint::getNumOpenGMFactorVariables(const GraphicalModelType& model, const HypothesisGraph& graph, size_t index)
 {
 	size_t sum = 0;
-
-	for(size_t i = 0; i < ids_.size(); ++i)
-    {
-        sum += (sol[segmentationHypotheses.at(ids_[i]).getDetectionVariable().getOpenGMVariableId()] > 0 ? 1 : 0);
-    }
-
-    if(sum > 1)
-    	std::cout << "Violating exclusion constraint between ids: " << ids_ << std::endl;
-
-    return sum < 2;
+	for(uint32_t segmentation : graph.getExclusionMembers(index))
+		sum += model.numberOfLabels(graph.getDetectionVariable(segmentation)) - 1;
+	return sum;
 }
 
-void ExclusionConstraint::toDot(std::ostream& stream) const
+void ExclusionConstraint::toDot(std::ostream& stream, const IdTable& idTable) const
 {
-	for(size_t i = 0; i < ids_.size(); ++i)
+	for(size_t i = 0; i < keys_.size(); ++i)
 	{
-		for(size_t j = i + 1; j < ids_.size(); ++j)
+		for(size_t j = i + 1; j < keys_.size(); ++j)
 		{
-			stream << "\t" << ids_[i] << " -> " << ids_[j] << "[ color=\"red\" fontcolor=\"red\" ]" << "; \n" << std::flush;	
+			stream << "\t" << idTable.getId(keys_[i]) << " -> " << idTable.getId(keys_[j]) << "[ color=\"red\" fontcolor=\"red\" ]" << "; \n" << std::flush;	
 		}
 	}
 }
@@ -0,0 +1,132 @@
+#include "factorbuffer.h"
+
+#include <cstring>
+#include <iterator>
+
+namespace helpers
+{
+
+size_t FactorBuffer::ConstraintKeyHash::operator()(const ConstraintKey& key) const
+{
+	uint64_t hash = 14695981039346656037ull ^ key.size();
+	for(ValueType value : key)
+	{
+		// -0.0 == 0.0, so both must hash the same
+		value = (value == 0 ? 0 : value);
+		uint64_t bits = 0;
+		std::memcpy(&bits, &value, sizeof(value));
+		hash = (hash ^ bits) * 1099511628211ull;
+	}
+	return hash ^ (hash >> 32);
+}
+
+size_t FactorBuffer::storeFunction(const LearnableUnaryFuncType& function, FunctionKind& kind)
+{
+	kind = FunctionKind::LearnableUnary;
+	learnableUnaries_.push_back(function);
+	return learnableUnaries_.size() - 1;
+}
+
+size_t FactorBuffer::storeFunction(const LearnableWeightedSumOfFuncType& function, FunctionKind& kind)
+{
+	kind = FunctionKind::LearnableWeightedSum;
+	learnableWeightedSums_.push_back(function);
+	return learnableWeightedSums_.size() - 1;
+}
+
+size_t FactorBuffer::storeFunction(const ExplicitFunctionType& function, FunctionKind& kind)
+{
+	kind = FunctionKind::Explicit;
+	explicitFunctions_.push_back(function);
+	return explicitFunctions_.size() - 1;
+}
+
+void FactorBuffer::addConstraintFactor(
+	const LinearConstraintFunctionType::LinearConstraintType& constraint,
+	const std::vector<LabelType>& constraintShape,
+	const std::vector<LabelType>& factorVariables)
+{
+	// the lengths of all lists are part of the key, so that different constraints never give the same numbers
+	ConstraintKey key;
+	key.push_back(constraintShape.size());
+	key.insert(key.end(), constraintShape.begin(), constraintShape.end());
+	auto coefficient = constraint.coefficientsBegin();
+	for(auto indicator = constraint.indicatorVariablesBegin(); indicator != constraint.indicatorVariablesEnd(); ++indicator, ++coefficient)
+	{
+		key.push_back(std::distance(indicator->begin(), indicator->end()));
+		for(auto variableState = indicator->begin(); variableState != indicator->end(); ++variableState)
+		{
+			key.push_back(variableState->first);
+			key.push_back(variableState->second);
+		}
+		key.push_back(*coefficient);
+	}
+	key.push_back(constraint.getBound());
+	key.push_back(static_cast<ValueType>(constraint.getConstraintOperator()));
+
+	auto inserted = constraintIndices_.insert(std::make_pair(key, linearConstraints_.size()));
+	if(inserted.second)
+	{
+		linearConstraints_.push_back(LinearConstraintFunctionType(constraintShape.begin(), constraintShape.end(), &constraint, &constraint + 1));
+		constraintKeys_.push_back(std::move(key));
+	}
+
+	addFactor(FunctionKind::LinearConstraint, inserted.first->second, factorVariables.begin(), factorVariables.end());
+}
+
+void FactorBuffer::addToModel(GraphicalModelType& model, ConstraintFunctionCache& cache) const
+{
+	for(const Factor& factor : factors_)
+	{
+		GraphicalModelType::FunctionIdentifier fid;
+		switch(factor.kind)
+		{
+			case FunctionKind::LearnableUnary:
+				fid = model.addFunction(learnableUnaries_[factor.function]);
+				break;
+			case FunctionKind::LearnableWeightedSum:
+				fid = model.addFunction(learnableWeightedSums_[factor.function]);
+				break;
+			case FunctionKind::LinearConstraint:
+			{
+				auto inserted = cache.insert(std::make_pair(constraintKeys_[factor.function], fid));
+				if(inserted.second)
+					inserted.first->second = model.addFunction(linearConstraints_[factor.function]);
+				fid = inserted.first->second;
+				break;
+			}
+			case FunctionKind::Explicit:
+				fid = model.addFunction(explicitFunctions_[factor.function]);
+				break;
+		}
+
+		auto variablesBegin = variables_.begin() + factor.firstVariable;
+		model.addFactor(fid, variablesBegin, variablesBegin + factor.numVariables);
+	}
+}
+
+void FactorBuffer::countFactors(FactorCounts& counts) const
+{
+	for(const Factor& factor : factors_)
+	{
+		if(factor.kind == FunctionKind::LinearConstraint)
+			counts.numConstraints++;
+		else
+			counts.numUnaries++;
+		counts.numFactorVariables += factor.numVariables;
+	}
+}
+
+void FactorBuffer::clear()
+{
+	learnableUnaries_.clear();
+	learnableWeightedSums_.clear();
+	linearConstraints_.clear();
+	constraintKeys_.clear();
+	constraintIndices_.clear();
+	explicitFunctions_.clear();
+	variables_.clear();
+	factors_.clear();
+}
+
+} // end namespace helpers
@@ -0,0 +1,217 @@
+#include "featurenormalization.h"
+#include "gzipstream.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+
+namespace helpers
+{
+
+void FeatureNormalization::RunningStatistics::add(double value)
+{
+	count++;
+	double delta = value - mean;
+	mean += delta / count;
+	sumOfSquaredDifferences += delta * (value - mean);
+}
+
+void FeatureNormalization::RunningStatistics::merge(const RunningStatistics& other)
+{
+	if(other.count == 0)
+		return;
+
+	size_t total = count + other.count;
+	double delta = other.mean - mean;
+	mean += delta * other.count / total;
+	sumOfSquaredDifferences += other.sumOfSquaredDifferences + delta * delta * count * other.count / total;
+	count = total;
+}
+
+double FeatureNormalization::RunningStatistics::standardDeviation() const
+{
+	if(count == 0)
+		return 0.0;
+	return std::sqrt(sumOfSquaredDifferences / count);
+}
+
+FeatureNormalization::FeatureNormalization():
+	statesShareWeights_(false),
+	finalized_(false)
+{}
+
+FeatureNormalization::FeatureNormalization(const Json::Value& entry):
+	statesShareWeights_(false),
+	finalized_(true)
+{
+	if(!entry.isObject())
+		throw std::runtime_error("Cannot extract FeatureNormalization from non-object JSON entry");
+
+	statesShareWeights_ = entry[JsonTypeNames[JsonTypes::StatesShareWeights]].asBool();
+
+	for(auto iter = VariableClassNames.begin(); iter != VariableClassNames.end(); ++iter)
+	{
+		if(!entry.isMember(iter->second))
+			continue;
+
+		const Json::Value& classEntry = entry[iter->second];
+		if(!classEntry.isMember(JsonTypeNames[JsonTypes::Mean]) || !classEntry.isMember(JsonTypeNames[JsonTypes::Scale]))
+			throw std::runtime_error("FeatureNormalization of " + iter->second + " needs mean and scale");
+
+		mean_[iter->first] = extractFeatures(classEntry, JsonTypes::Mean);
+		scale_[iter->first] = extractFeatures(classEntry, JsonTypes::Scale);
+	}
+}
+
+void FeatureNormalization::accumulate(VariableClass variableClass, size_t state, const FeatureRow& features)
+{
+	if(finalized_)
+		throw std::runtime_error("Cannot accumulate feature statistics after the normalization was finalized");
+
+	StateStatistics& statistics = statistics_[variableClass];
+	if(statistics.size() <= state)
+		statistics.resize(state + 1);
+
+	if(statistics[state].size() < features.size())
+		statistics[state].resize(features.size());
+
+	for(size_t i = 0; i < features.size(); ++i)
+		statistics[state][i].add(features[i]);
+}
+
+void FeatureNormalization::merge(const FeatureNormalization& other)
+{
+	if(finalized_ || other.finalized_)
+		throw std::runtime_error("Cannot merge feature statistics after the normalization was finalized");
+
+	for(auto iter = other.statistics_.begin(); iter != other.statistics_.end(); ++iter)
+	{
+		StateStatistics& statistics = statistics_[iter->first];
+		if(statistics.size() < iter->second.size())
+			statistics.resize(iter->second.size());
+
+		for(size_t state = 0; state < iter->second.size(); ++state)
+		{
+			if(statistics[state].size() < iter->second[state].size())
+				statistics[state].resize(iter->second[state].size());
+
+			for(size_t i = 0; i < iter->second[state].size(); ++i)
+				statistics[state][i].merge(iter->second[state][i]);
+		}
+	}
+}
+
+void FeatureNormalization::finalize(bool statesShareWeights)
+{
+	statesShareWeights_ = statesShareWeights;
+	mean_.clear();
+	scale_.clear();
+
+	for(auto iter = statistics_.begin(); iter != statistics_.end(); ++iter)
+	{
+		StateStatistics statistics = iter->second;
+
+		// pool the statistics of every feature over all states
+		if(statesShareWeights)
+		{
+			StateStatistics pooled(1);
+			for(size_t state = 0; state < statistics.size(); ++state)
+			{
+				if(pooled[0].size() < statistics[state].size())
+					pooled[0].resize(statistics[state].size());
+
+				for(size_t i = 0; i < statistics[state].size(); ++i)
+					pooled[0][i].merge(statistics[state][i]);
+			}
+			statistics = pooled;
+		}
+
+		StateFeatureVector& mean = mean_[iter->first];
+		StateFeatureVector& scale = scale_[iter->first];
+		for(size_t row = 0; row < statistics.size(); ++row)
+		{
+			mean.push_back(FeatureVector(statistics[row].size(), 0.0));
+			scale.push_back(FeatureVector(statistics[row].size(), 1.0));
+
+			for(size_t i = 0; i < statistics[row].size(); ++i)
+			{
+				// do not touch constant features, they are most likely used as bias
+				double standardDeviation = statistics[row][i].standardDeviation();
+				if(standardDeviation > 1e-12 * std::max(1.0, std::abs(statistics[row][i].mean)))
+				{
+					mean[row][i] = statistics[row][i].mean;
+					scale[row][i] = standardDeviation;
+				}
+			}
+		}
+	}
+
+	finalized_ = true;
+}
+
+void FeatureNormalization::apply(VariableClass variableClass, size_t state, FeatureValueType* features, size_t numFeatures) const
+{
+	if(!finalized_)
+		throw std::runtime_error("FeatureNormalization must be finalized before it can be applied");
+
+	auto meanIt = mean_.find(variableClass);
+	auto scaleIt = scale_.find(variableClass);
+	if(meanIt == mean_.end() || scaleIt == scale_.end())
+		return;
+
+	size_t row = statesShareWeights_ ? 0 : state;
+	if(row >= meanIt->second.size() || numFeatures > meanIt->second[row].size())
+	{
+		std::stringstream error;
+		error << "FeatureNormalization of " << VariableClassNames[variableClass] << " has no statistics for state " << state
+			<< " with " << numFeatures << " features";
+		throw std::runtime_error(error.str());
+	}
+
+	for(size_t i = 0; i < numFeatures; ++i)
+		features[i] = (features[i] - meanIt->second[row][i]) / scaleIt->second[row][i];
+}
+
+void FeatureNormalization::saveToJson(Json::Value& entry) const
+{
+	if(!finalized_)
+		throw std::runtime_error("FeatureNormalization must be finalized before it can be saved");
+
+	auto tableToJson = [](const StateFeatureVector& table)
+	{
+		Json::Value rows(Json::arrayValue);
+		for(const FeatureVector& row : table)
+		{
+			Json::Value values(Json::arrayValue);
+			for(double v : row)
+				values.append(v);
+			rows.append(values);
+		}
+		return rows;
+	};
+
+	entry[JsonTypeNames[JsonTypes::StatesShareWeights]] = Json::Value(statesShareWeights_);
+	for(auto iter = mean_.begin(); iter != mean_.end(); ++iter)
+	{
+		Json::Value& classEntry = entry[VariableClassNames[iter->first]];
+		classEntry[JsonTypeNames[JsonTypes::Mean]] = tableToJson(iter->second);
+		classEntry[JsonTypeNames[JsonTypes::Scale]] = tableToJson(scale_.at(iter->first));
+	}
+}
+
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromJson(const std::string& filename)
+{
+	InputFileStream input(filename);
+	if(!input.good())
+		throw std::runtime_error("Could not open JSON weight file for reading: " + filename);
+
+	Json::Value root;
+	input >> root;
+
+	if(!root.isMember(JsonTypeNames[JsonTypes::FeatureNormalization]))
+		return std::shared_ptr<FeatureNormalization>();
+
+	return std::make_shared<FeatureNormalization>(root[JsonTypeNames[JsonTypes::FeatureNormalization]]);
+}
+
+} // end namespace helpers
@@ -0,0 +1,221 @@
+#include "featurestore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace helpers
+{
+
+namespace
+{
+
+const uint32_t EmptySlot = std::numeric_limits<uint32_t>::max();
+
+size_t hashRow(const FeatureValueType* values, size_t numValues)
+{
+	uint64_t hash = 14695981039346656037ull ^ numValues;
+	for(size_t i = 0; i < numValues; ++i)
+	{
+		// -0.0 == 0.0, so both must hash the same
+		FeatureValueType value = (values[i] == 0 ? 0 : values[i]);
+		uint64_t bits = 0;
+		std::memcpy(&bits, &value, sizeof(value));
+		hash = (hash ^ bits) * 1099511628211ull;
+	}
+
+	// FNV does not mix the high bits into the low ones, which select the slot
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+} // end anonymous namespace
+
+size_t FeatureArena::addRows(const StateFeatureVector& features)
+{
+	if(released_)
+		throw std::runtime_error("Cannot add features to an arena that was released");
+
+	size_t firstRow = getNumRows();
+	for(const FeatureVector& stateFeatures : features)
+	{
+#ifdef USE_FLOAT_FEATURES
+		converted_.assign(stateFeatures.begin(), stateFeatures.end());
+		rows_.push_back(intern(converted_.data(), converted_.size()));
+#else
+		rows_.push_back(intern(stateFeatures.data(), stateFeatures.size()));
+#endif
+	}
+	return firstRow;
+}
+
+size_t FeatureArena::addRows(const double* values, const uint64_t* featureOffsets, size_t numStates)
+{
+	if(released_)
+		throw std::runtime_error("Cannot add features to an arena that was released");
+
+	size_t firstRow = getNumRows();
+	for(size_t s = 0; s < numStates; ++s)
+	{
+		const double* begin = values + featureOffsets[s];
+		const double* end = values + featureOffsets[s + 1];
+#ifdef USE_FLOAT_FEATURES
+		converted_.assign(begin, end);
+		rows_.push_back(intern(converted_.data(), converted_.size()));
+#else
+		rows_.push_back(intern(begin, end - begin));
+#endif
+	}
+	return firstRow;
+}
+
+void FeatureArena::setRow(size_t row, const FeatureValueType* values, size_t numValues)
+{
+	uint32_t previous = rows_[row];
+	rows_[row] = intern(values, numValues);
+	refCounts_[previous]--;
+}
+
+uint32_t FeatureArena::intern(const FeatureValueType* values, size_t numValues)
+{
+	if(2 * (numIndexed_ + 1) > index_.size())
+		rebuildIndex(std::max<size_t>(1024, 2 * index_.size()));
+
+	size_t mask = index_.size() - 1;
+	for(size_t slot = hashRow(values, numValues) & mask; ; slot = (slot + 1) & mask)
+	{
+		uint32_t storedRow = index_[slot];
+		if(storedRow == EmptySlot)
+		{
+			if(refCounts_.size() >= EmptySlot)
+				throw std::runtime_error("Too many distinct feature rows");
+
+			storedRow = refCounts_.size();
+			values_.insert(values_.end(), values, values + numValues);
+			offsets_.push_back(values_.size());
+			refCounts_.push_back(1);
+			index_[slot] = storedRow;
+			numIndexed_++;
+			return storedRow;
+		}
+
+		FeatureRow candidate = getStoredRow(storedRow);
+		if(candidate.size() == numValues && std::equal(candidate.begin(), candidate.end(), values))
+		{
+			refCounts_[storedRow]++;
+			return storedRow;
+		}
+	}
+}
+
+void FeatureArena::rebuildIndex(size_t numSlots)
+{
+	index_.assign(numSlots, EmptySlot);
+	numIndexed_ = 0;
+
+	size_t mask = numSlots - 1;
+	for(uint32_t storedRow = 0; storedRow < refCounts_.size(); ++storedRow)
+	{
+		FeatureRow row = getStoredRow(storedRow);
+		size_t slot = hashRow(row.data(), row.size()) & mask;
+		while(index_[slot] != EmptySlot)
+			slot = (slot + 1) & mask;
+		index_[slot] = storedRow;
+		numIndexed_++;
+	}
+}
+
+void FeatureArena::compact()
+{
+	std::vector<uint32_t> newIndices(refCounts_.size(), EmptySlot);
+	std::vector<uint64_t> offsets(1, 0);
+	std::vector<FeatureValueType> values;
+	std::vector<uint32_t> refCounts;
+
+	size_t numValues = 0;
+	size_t numStoredRows = 0;
+	for(uint32_t storedRow = 0; storedRow < refCounts_.size(); ++storedRow)
+	{
+		if(refCounts_[storedRow] > 0)
+		{
+			numValues += offsets_[storedRow + 1] - offsets_[storedRow];
+			numStoredRows++;
+		}
+	}
+
+	offsets.reserve(numStoredRows + 1);
+	values.reserve(numValues);
+	refCounts.reserve(numStoredRows);
+	for(uint32_t storedRow = 0; storedRow < refCounts_.size(); ++storedRow)
+	{
+		if(refCounts_[storedRow] == 0)
+			continue;
+
+		FeatureRow row = getStoredRow(storedRow);
+		newIndices[storedRow] = refCounts.size();
+		values.insert(values.end(), row.begin(), row.end());
+		offsets.push_back(values.size());
+		refCounts.push_back(refCounts_[storedRow]);
+	}
+
+	for(uint32_t& row : rows_)
+		row = newIndices[row];
+	rows_.shrink_to_fit();
+	offsets_.swap(offsets);
+	values_.swap(values);
+	refCounts_.swap(refCounts);
+
+	size_t numSlots = 1024;
+	while(numSlots < 2 * refCounts_.size())
+		numSlots *= 2;
+	rebuildIndex(numSlots);
+}
+
+void FeatureArena::release()
+{
+	// swapping with empty vectors frees the memory, clear() would keep the capacity
+	std::vector<uint32_t>().swap(rows_);
+	std::vector<uint64_t>().swap(offsets_);
+	std::vector<FeatureValueType>().swap(values_);
+	std::vector<uint32_t>().swap(refCounts_);
+	std::vector<uint32_t>().swap(index_);
+#ifdef USE_FLOAT_FEATURES
+	std::vector<FeatureValueType>().swap(converted_);
+#endif
+	numIndexed_ = 0;
+	released_ = true;
+}
+
+size_t FeatureArena::getMemoryUsage() const
+{
+	return rows_.capacity() * sizeof(uint32_t)
+		+ offsets_.capacity() * sizeof(uint64_t)
+		+ values_.capacity() * sizeof(FeatureValueType)
+		+ refCounts_.capacity() * sizeof(uint32_t)
+		+ index_.capacity() * sizeof(uint32_t);
+}
+
+void FeatureStore::compact()
+{
+	for(FeatureArena& arena : arenas_)
+		arena.compact();
+}
+
+void FeatureStore::release()
+{
+	for(FeatureArena& arena : arenas_)
+		arena.release();
+}
+
+size_t FeatureStore::getMemoryUsage() const
+{
+	size_t sum = 0;
+	for(const FeatureArena& arena : arenas_)
+		sum += arena.getMemoryUsage();
+	return sum;
+}
+
+} // end namespace helpers
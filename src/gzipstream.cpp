@@ -0,0 +1,216 @@
+#include "gzipstream.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace helpers
+{
+
+namespace
+{
+
+// first byte of the gzip magic number, it is a control character that cannot start a JSON document
+const int GzipMagicByte = 0x1f;
+
+} // end anonymous namespace
+
+GzipInputStreamBuf::GzipInputStreamBuf(std::streambuf& source, size_t bufferSize):
+	source_(source),
+	compressed_(bufferSize),
+	decompressed_(bufferSize),
+	endOfInput_(false)
+{
+	std::memset(&zstream_, 0, sizeof(zstream_));
+	// window size 15, +32 detects gzip and zlib headers automatically
+	if(inflateInit2(&zstream_, 15 + 32) != Z_OK)
+		throw std::runtime_error("Could not initialize gzip decompression");
+	setg(decompressed_.data(), decompressed_.data(), decompressed_.data());
+}
+
+GzipInputStreamBuf::~GzipInputStreamBuf()
+{
+	inflateEnd(&zstream_);
+}
+
+GzipInputStreamBuf::int_type GzipInputStreamBuf::underflow()
+{
+	if(gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	while(true)
+	{
+		if(zstream_.avail_in == 0 && !endOfInput_)
+		{
+			std::streamsize numRead = source_.sgetn(compressed_.data(), compressed_.size());
+			zstream_.next_in = reinterpret_cast<Bytef*>(compressed_.data());
+			zstream_.avail_in = numRead > 0 ? numRead : 0;
+			endOfInput_ = numRead <= 0;
+		}
+
+		if(zstream_.avail_in == 0 && endOfInput_)
+		{
+			// total_in is reset after every complete member, so anything else is a truncated file
+			if(zstream_.total_in > 0)
+				throw std::runtime_error("Unexpected end of gzip compressed data");
+			return traits_type::eof();
+		}
+
+		zstream_.next_out = reinterpret_cast<Bytef*>(decompressed_.data());
+		zstream_.avail_out = decompressed_.size();
+		int result = inflate(&zstream_, Z_NO_FLUSH);
+		if(result == Z_STREAM_END)
+			inflateReset(&zstream_);
+		else if(result != Z_OK)
+			throw std::runtime_error(std::string("Invalid gzip compressed data: ") + (zstream_.msg != nullptr ? zstream_.msg : "unknown error"));
+
+		size_t numDecompressed = decompressed_.size() - zstream_.avail_out;
+		if(numDecompressed > 0)
+		{
+			setg(decompressed_.data(), decompressed_.data(), decompressed_.data() + numDecompressed);
+			return traits_type::to_int_type(*gptr());
+		}
+	}
+}
+
+GzipOutputStreamBuf::GzipOutputStreamBuf(std::streambuf& target, int compressionLevel, size_t bufferSize):
+	target_(target),
+	uncompressed_(bufferSize),
+	compressed_(bufferSize),
+	finished_(false)
+{
+	std::memset(&zstream_, 0, sizeof(zstream_));
+	// window size 15, +16 writes a gzip instead of a zlib header
+	if(deflateInit2(&zstream_, compressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw std::runtime_error("Could not initialize gzip compression");
+	setp(uncompressed_.data(), uncompressed_.data() + uncompressed_.size());
+}
+
+GzipOutputStreamBuf::~GzipOutputStreamBuf()
+{
+	finish();
+	deflateEnd(&zstream_);
+}
+
+bool GzipOutputStreamBuf::deflateBuffer(int flush)
+{
+	zstream_.next_in = reinterpret_cast<Bytef*>(pbase());
+	zstream_.avail_in = pptr() - pbase();
+
+	int result = Z_OK;
+	do
+	{
+		zstream_.next_out = reinterpret_cast<Bytef*>(compressed_.data());
+		zstream_.avail_out = compressed_.size();
+		result = deflate(&zstream_, flush);
+		if(result == Z_STREAM_ERROR)
+			return false;
+
+		std::streamsize numCompressed = compressed_.size() - zstream_.avail_out;
+		if(numCompressed > 0 && target_.sputn(compressed_.data(), numCompressed) != numCompressed)
+			return false;
+	} while(zstream_.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+
+	setp(uncompressed_.data(), uncompressed_.data() + uncompressed_.size());
+	return true;
+}
+
+GzipOutputStreamBuf::int_type GzipOutputStreamBuf::overflow(int_type c)
+{
+	if(finished_ || !deflateBuffer(Z_NO_FLUSH))
+		return traits_type::eof();
+
+	if(!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+	return traits_type::not_eof(c);
+}
+
+int GzipOutputStreamBuf::sync()
+{
+	// only hand the buffer to zlib, a real flush on every std::endl would hurt the compression
+	if(finished_ || !deflateBuffer(Z_NO_FLUSH))
+		return -1;
+	return 0;
+}
+
+bool GzipOutputStreamBuf::finish()
+{
+	if(finished_)
+		return true;
+	finished_ = true;
+	return deflateBuffer(Z_FINISH) && target_.pubsync() == 0;
+}
+
+InputFileStream::InputFileStream(const std::string& filename):
+	std::istream(nullptr)
+{
+	rdbuf(&file_);
+	if(file_.open(filename.c_str(), std::ios::in | std::ios::binary) == nullptr)
+	{
+		setstate(std::ios::failbit);
+		return;
+	}
+
+	// report errors of the stream buffers (e.g. corrupt compressed data) with their message
+	exceptions(std::ios::badbit);
+
+	// peek without consuming, so that pipes work as well
+	if(file_.sgetc() == GzipMagicByte)
+	{
+		gzip_.reset(new GzipInputStreamBuf(file_));
+		rdbuf(gzip_.get());
+	}
+}
+
+OutputFileStream::OutputFileStream(const std::string& filename):
+	std::ostream(nullptr)
+{
+	rdbuf(&file_);
+	if(file_.open(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc) == nullptr)
+	{
+		setstate(std::ios::failbit);
+		return;
+	}
+
+	if(hasGzipExtension(filename))
+	{
+		gzip_.reset(new GzipOutputStreamBuf(file_));
+		rdbuf(gzip_.get());
+	}
+}
+
+OutputFileStream::~OutputFileStream()
+{
+	close();
+}
+
+void OutputFileStream::close()
+{
+	if(!file_.is_open())
+		return;
+
+	flush();
+	if(gzip_ && !gzip_->finish())
+		setstate(std::ios::badbit);
+	if(file_.close() == nullptr)
+		setstate(std::ios::failbit);
+}
+
+bool isGzipFile(const std::string& filename)
+{
+	std::ifstream input(filename.c_str(), std::ios::binary);
+	unsigned char magic[2];
+	if(!input.read(reinterpret_cast<char*>(magic), sizeof(magic)))
+		return false;
+	return magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+bool hasGzipExtension(const std::string& filename)
+{
+	const std::string extension = ".gz";
+	return filename.size() >= extension.size()
+		&& filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+} // end namespace helpers
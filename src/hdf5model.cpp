@@ -0,0 +1,947 @@
+#include "hdf5model.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+#include <hdf5.h>
+#include <json/json.h>
+
+using namespace helpers;
+
+namespace
+{
+
+/**
+ * @brief Owns an HDF5 identifier and closes it with the matching function
+ */
+class Hdf5Handle
+{
+public:
+	Hdf5Handle(hid_t id, herr_t (*close)(hid_t), const std::string& action):
+		id_(id),
+		close_(close)
+	{
+		if(id_ < 0)
+			throw std::runtime_error("HDF5 error: could not " + action);
+	}
+
+	Hdf5Handle(Hdf5Handle&& other):
+		id_(other.id_),
+		close_(other.close_)
+	{
+		other.id_ = -1;
+	}
+
+	~Hdf5Handle()
+	{
+		if(id_ >= 0)
+			close_(id_);
+	}
+
+	Hdf5Handle(const Hdf5Handle&) = delete;
+	Hdf5Handle& operator=(const Hdf5Handle&) = delete;
+
+	operator hid_t() const { return id_; }
+
+private:
+	hid_t id_;
+	herr_t (*close_)(hid_t);
+};
+
+// number of rows of a feature dataset that are held in memory while reading
+const hsize_t FeatureBlockRows = 1 << 14;
+// number of rows per chunk of written datasets
+const hsize_t ChunkRows = 1 << 14;
+
+template<class T> hid_t nativeType();
+template<> hid_t nativeType<double>() { return H5T_NATIVE_DOUBLE; }
+template<> hid_t nativeType<uint32_t>() { return H5T_NATIVE_UINT32; }
+template<> hid_t nativeType<uint64_t>() { return H5T_NATIVE_UINT64; }
+
+void check(herr_t status, const std::string& action)
+{
+	if(status < 0)
+		throw std::runtime_error("HDF5 error: could not " + action);
+}
+
+Hdf5Handle openFile(const std::string& filename)
+{
+	return Hdf5Handle(H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose, "open HDF5 file " + filename);
+}
+
+Hdf5Handle createFile(const std::string& filename)
+{
+	return Hdf5Handle(H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT), H5Fclose, "create HDF5 file " + filename);
+}
+
+/// check whether a path like "a/b/c" exists, H5Lexists only checks the last component
+bool exists(hid_t location, const std::string& path)
+{
+	size_t end = 0;
+	while(end != std::string::npos)
+	{
+		end = path.find('/', end + 1);
+		if(H5Lexists(location, path.substr(0, end).c_str(), H5P_DEFAULT) <= 0)
+			return false;
+	}
+	return true;
+}
+
+std::vector<hsize_t> getShape(hid_t dataset)
+{
+	Hdf5Handle space(H5Dget_space(dataset), H5Sclose, "get dataspace");
+	int rank = H5Sget_simple_extent_ndims(space);
+	if(rank < 0)
+		throw std::runtime_error("HDF5 error: could not get rank of dataset");
+	std::vector<hsize_t> shape(rank);
+	H5Sget_simple_extent_dims(space, shape.data(), nullptr);
+	return shape;
+}
+
+/// read a whole dataset, converting its values to T
+template<class T>
+std::vector<T> readArray(hid_t location, const std::string& path, std::vector<hsize_t>* shape = nullptr)
+{
+	Hdf5Handle dataset(H5Dopen2(location, path.c_str(), H5P_DEFAULT), H5Dclose, "open dataset " + path);
+	std::vector<hsize_t> datasetShape = getShape(dataset);
+	hsize_t size = 1;
+	for(hsize_t d : datasetShape)
+		size *= d;
+
+	std::vector<T> values(size);
+	if(size > 0)
+		check(H5Dread(dataset, nativeType<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()), "read dataset " + path);
+	if(shape != nullptr)
+		*shape = datasetShape;
+	return values;
+}
+
+#ifdef USE_STRING_IDS
+/// read a dataset of variable or fixed length strings
+std::vector<std::string> readStrings(hid_t location, const std::string& path)
+{
+	Hdf5Handle dataset(H5Dopen2(location, path.c_str(), H5P_DEFAULT), H5Dclose, "open dataset " + path);
+	Hdf5Handle fileType(H5Dget_type(dataset), H5Tclose, "get type of dataset " + path);
+	if(H5Tget_class(fileType) != H5T_STRING)
+		throw std::runtime_error("HDF5 dataset " + path + " must contain strings");
+
+	std::vector<hsize_t> shape = getShape(dataset);
+	hsize_t size = 1;
+	for(hsize_t d : shape)
+		size *= d;
+	std::vector<std::string> strings;
+	strings.reserve(size);
+	if(size == 0)
+		return strings;
+
+	Hdf5Handle memoryType(H5Tcopy(H5T_C_S1), H5Tclose, "create string type");
+	if(H5Tis_variable_str(fileType) > 0)
+	{
+		check(H5Tset_size(memoryType, H5T_VARIABLE), "set string size");
+		std::vector<char*> buffer(size, nullptr);
+		check(H5Dread(dataset, memoryType, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()), "read dataset " + path);
+		for(char* s : buffer)
+			strings.push_back(s != nullptr ? std::string(s) : std::string());
+
+		Hdf5Handle space(H5Dget_space(dataset), H5Sclose, "get dataspace");
+		H5Dvlen_reclaim(memoryType, space, H5P_DEFAULT, buffer.data());
+	}
+	else
+	{
+		size_t length = H5Tget_size(fileType);
+		check(H5Tset_size(memoryType, length), "set string size");
+		std::vector<char> buffer(size * length);
+		check(H5Dread(dataset, memoryType, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data()), "read dataset " + path);
+		for(hsize_t i = 0; i < size; ++i)
+		{
+			const char* s = buffer.data() + i * length;
+			strings.push_back(std::string(s, std::find(s, s + length, '\0')));
+		}
+	}
+	return strings;
+}
+#endif
+
+std::vector<IdLabelType> readIds(hid_t location, const std::string& path)
+{
+#ifdef USE_STRING_IDS
+	return readStrings(location, path);
+#else
+	std::vector<uint32_t> ids = readArray<uint32_t>(location, path);
+	return std::vector<IdLabelType>(ids.begin(), ids.end());
+#endif
+}
+
+/// property list that creates missing groups along the path of a dataset
+Hdf5Handle createIntermediateGroups()
+{
+	Hdf5Handle properties(H5Pcreate(H5P_LINK_CREATE), H5Pclose, "create link properties");
+	check(H5Pset_create_intermediate_group(properties, 1), "set link properties");
+	return properties;
+}
+
+/// dataset properties for chunked and compressed storage, contiguous if the dataset is empty
+Hdf5Handle datasetProperties(const std::vector<hsize_t>& shape, int compressionLevel)
+{
+	Hdf5Handle properties(H5Pcreate(H5P_DATASET_CREATE), H5Pclose, "create dataset properties");
+	hsize_t size = 1;
+	for(hsize_t d : shape)
+		size *= d;
+
+	if(size > 0)
+	{
+		std::vector<hsize_t> chunk(shape);
+		chunk[0] = std::min(chunk[0], ChunkRows);
+		check(H5Pset_chunk(properties, chunk.size(), chunk.data()), "set chunk size");
+		if(compressionLevel > 0)
+			check(H5Pset_deflate(properties, compressionLevel), "enable compression");
+	}
+	return properties;
+}
+
+template<class T>
+void writeArray(hid_t location, const std::string& path, const T* data, const std::vector<hsize_t>& shape, int compressionLevel)
+{
+	Hdf5Handle space(H5Screate_simple(shape.size(), shape.data(), nullptr), H5Sclose, "create dataspace");
+	Hdf5Handle linkProperties = createIntermediateGroups();
+	Hdf5Handle properties = datasetProperties(shape, compressionLevel);
+	Hdf5Handle dataset(H5Dcreate2(location, path.c_str(), nativeType<T>(), space, linkProperties, properties, H5P_DEFAULT),
+		H5Dclose, "create dataset " + path);
+
+	if(H5Sget_simple_extent_npoints(space) > 0)
+		check(H5Dwrite(dataset, nativeType<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, data), "write dataset " + path);
+}
+
+template<class T>
+void writeArray(hid_t location, const std::string& path, const std::vector<T>& data, int compressionLevel)
+{
+	writeArray(location, path, data.data(), {data.size()}, compressionLevel);
+}
+
+void writeStrings(hid_t location, const std::string& path, const std::vector<std::string>& strings, const std::vector<hsize_t>& shape, int compressionLevel)
+{
+	std::vector<const char*> pointers;
+	for(const std::string& s : strings)
+		pointers.push_back(s.c_str());
+
+	Hdf5Handle type(H5Tcopy(H5T_C_S1), H5Tclose, "create string type");
+	check(H5Tset_size(type, H5T_VARIABLE), "set string size");
+	Hdf5Handle space(H5Screate_simple(shape.size(), shape.data(), nullptr), H5Sclose, "create dataspace");
+	Hdf5Handle linkProperties = createIntermediateGroups();
+	Hdf5Handle properties = datasetProperties(shape, compressionLevel);
+	Hdf5Handle dataset(H5Dcreate2(location, path.c_str(), type, space, linkProperties, properties, H5P_DEFAULT),
+		H5Dclose, "create dataset " + path);
+
+	if(!strings.empty())
+		check(H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, pointers.data()), "write dataset " + path);
+}
+
+/// write ids as a (rows x columns) dataset
+void writeIds(hid_t location, const std::string& path, const std::vector<IdLabelType>& ids, int compressionLevel, hsize_t columns = 1)
+{
+	std::vector<hsize_t> shape = {ids.size() / columns};
+	if(columns > 1)
+		shape.push_back(columns);
+#ifdef USE_STRING_IDS
+	writeStrings(location, path, ids, shape, compressionLevel);
+#else
+	std::vector<uint32_t> values(ids.begin(), ids.end());
+	writeArray(location, path, values.data(), shape, compressionLevel);
+#endif
+}
+
+void writeStringAttribute(hid_t location, const std::string& name, const std::string& text)
+{
+	Hdf5Handle type(H5Tcopy(H5T_C_S1), H5Tclose, "create string type");
+	check(H5Tset_size(type, H5T_VARIABLE), "set string size");
+	Hdf5Handle space(H5Screate(H5S_SCALAR), H5Sclose, "create dataspace");
+	Hdf5Handle attribute(H5Acreate2(location, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose, "create attribute " + name);
+	const char* data = text.c_str();
+	check(H5Awrite(attribute, type, &data), "write attribute " + name);
+}
+
+/// read a string attribute into a Json::Value, returns false if the attribute does not exist
+bool readJsonAttribute(hid_t location, const std::string& name, Json::Value& value)
+{
+	if(H5Aexists(location, name.c_str()) <= 0)
+		return false;
+
+	Hdf5Handle attribute(H5Aopen(location, name.c_str(), H5P_DEFAULT), H5Aclose, "open attribute " + name);
+	Hdf5Handle fileType(H5Aget_type(attribute), H5Tclose, "get type of attribute " + name);
+	if(H5Tget_class(fileType) != H5T_STRING)
+		throw std::runtime_error("HDF5 attribute " + name + " must be a string");
+
+	std::string text;
+	Hdf5Handle memoryType(H5Tcopy(H5T_C_S1), H5Tclose, "create string type");
+	if(H5Tis_variable_str(fileType) > 0)
+	{
+		check(H5Tset_size(memoryType, H5T_VARIABLE), "set string size");
+		char* data = nullptr;
+		check(H5Aread(attribute, memoryType, &data), "read attribute " + name);
+		if(data != nullptr)
+			text = data;
+		Hdf5Handle space(H5Aget_space(attribute), H5Sclose, "get dataspace");
+		H5Dvlen_reclaim(memoryType, space, H5P_DEFAULT, &data);
+	}
+	else
+	{
+		size_t length = H5Tget_size(fileType);
+		check(H5Tset_size(memoryType, length), "set string size");
+		std::vector<char> buffer(length);
+		check(H5Aread(attribute, memoryType, buffer.data()), "read attribute " + name);
+		text = std::string(buffer.begin(), std::find(buffer.begin(), buffer.end(), '\0'));
+	}
+
+	Json::Reader reader;
+	if(!reader.parse(text, value))
+		throw std::runtime_error("Could not parse JSON in HDF5 attribute " + name);
+	return true;
+}
+
+/**
+ * @brief Reads the rows of a feature group ("values" of shape rows x states x features, optional "numStates")
+ *        in blocks, the rows must be requested in increasing order
+ */
+class FeatureSetReader
+{
+public:
+	FeatureSetReader(hid_t location, const std::string& path, hsize_t numRows):
+		numRows_(numRows),
+		present_(exists(location, path)),
+		maxStates_(0),
+		numFeatures_(0),
+		blockBegin_(0),
+		blockEnd_(0)
+	{
+		if(!present_)
+			return;
+
+		const std::string valuesPath = path + "/values";
+		dataset_.reset(new Hdf5Handle(H5Dopen2(location, valuesPath.c_str(), H5P_DEFAULT), H5Dclose, "open dataset " + valuesPath));
+		std::vector<hsize_t> shape = getShape(*dataset_);
+		if(shape.size() != 3 || shape[0] != numRows)
+		{
+			std::stringstream s;
+			s << "HDF5 dataset " << valuesPath << " must have the shape (" << numRows << ", states, features)";
+			throw std::runtime_error(s.str());
+		}
+		maxStates_ = shape[1];
+		numFeatures_ = shape[2];
+
+		if(exists(location, path + "/numStates"))
+		{
+			numStates_ = readArray<uint32_t>(location, path + "/numStates");
+			if(numStates_.size() != numRows)
+				throw std::runtime_error("HDF5 dataset " + path + "/numStates must have one entry per row");
+		}
+	}
+
+	StateFeatureVector row(hsize_t r)
+	{
+		if(!present_)
+			return StateFeatureVector();
+		if(r >= blockEnd_)
+			readBlock(r);
+
+		size_t numStates = numStates_.empty() ? maxStates_ : numStates_[r];
+		if(numStates > maxStates_)
+			throw std::runtime_error("HDF5 feature set uses more states than its values provide");
+
+		StateFeatureVector features(numStates);
+		const double* rowValues = buffer_.data() + (r - blockBegin_) * maxStates_ * numFeatures_;
+		for(size_t s = 0; s < numStates; ++s)
+			features[s].assign(rowValues + s * numFeatures_, rowValues + (s + 1) * numFeatures_);
+		return features;
+	}
+
+private:
+	void readBlock(hsize_t firstRow)
+	{
+		blockBegin_ = firstRow;
+		blockEnd_ = std::min(numRows_, firstRow + FeatureBlockRows);
+
+		std::vector<hsize_t> offset = {blockBegin_, 0, 0};
+		std::vector<hsize_t> count = {blockEnd_ - blockBegin_, maxStates_, numFeatures_};
+		buffer_.resize(count[0] * count[1] * count[2]);
+		if(buffer_.empty())
+			return;
+
+		Hdf5Handle fileSpace(H5Dget_space(*dataset_), H5Sclose, "get dataspace");
+		check(H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, offset.data(), nullptr, count.data(), nullptr), "select rows");
+		Hdf5Handle memorySpace(H5Screate_simple(3, count.data(), nullptr), H5Sclose, "create dataspace");
+		check(H5Dread(*dataset_, H5T_NATIVE_DOUBLE, memorySpace, fileSpace, H5P_DEFAULT, buffer_.data()), "read features");
+	}
+
+private:
+	hsize_t numRows_;
+	bool present_;
+	std::unique_ptr<Hdf5Handle> dataset_;
+	hsize_t maxStates_;
+	hsize_t numFeatures_;
+	std::vector<uint32_t> numStates_;
+
+	hsize_t blockBegin_;
+	hsize_t blockEnd_;
+	std::vector<double> buffer_;
+};
+
+/**
+ * @brief Write the features of the given variables as dense (rows x states x features) array,
+ *        skipped if none of the variables has features
+ */
+void writeFeatureSet(hid_t location, const std::string& path, const std::vector<const mht::Variable*>& variables, int compressionLevel)
+{
+	size_t maxStates = 0;
+	size_t numFeatures = 0;
+	bool hasNumFeatures = false;
+	bool uniformStates = true;
+	for(const mht::Variable* variable : variables)
+	{
+		if(variable->getNumStates() != variables.front()->getNumStates())
+			uniformStates = false;
+		maxStates = std::max(maxStates, variable->getNumStates());
+		for(size_t s = 0; s < variable->getNumStates(); ++s)
+		{
+			if(hasNumFeatures && variable->getNumFeatures(s) != numFeatures)
+				throw std::runtime_error("Cannot store features in HDF5 that have different lengths for " + path);
+			numFeatures = variable->getNumFeatures(s);
+			hasNumFeatures = true;
+		}
+	}
+
+	if(maxStates == 0)
+		return;
+
+	std::vector<double> values(variables.size() * maxStates * numFeatures, 0.0);
+	std::vector<uint32_t> numStates(variables.size(), 0);
+	for(size_t r = 0; r < variables.size(); ++r)
+	{
+		numStates[r] = variables[r]->getNumStates();
+		for(size_t s = 0; s < numStates[r]; ++s)
+		{
+			FeatureRow features = variables[r]->getFeatures(s);
+			std::copy(features.begin(), features.end(), values.begin() + (r * maxStates + s) * numFeatures);
+		}
+	}
+
+	writeArray(location, path + "/values", values.data(), {variables.size(), maxStates, numFeatures}, compressionLevel);
+	if(!uniformStates)
+		writeArray(location, path + "/numStates", numStates, compressionLevel);
+}
+
+std::string join(JsonTypes group, JsonTypes dataset)
+{
+	return JsonTypeNames[group] + "/" + JsonTypeNames[dataset];
+}
+
+} // end anonymous namespace
+
+namespace mht
+{
+
+bool Hdf5Model::isHdf5File(const std::string& filename)
+{
+	// H5Fis_hdf5 prints an error stack for missing files, which is no error here
+	H5E_auto2_t errorFunction;
+	void* errorData;
+	H5Eget_auto2(H5E_DEFAULT, &errorFunction, &errorData);
+	H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+	htri_t result = H5Fis_hdf5(filename.c_str());
+	H5Eset_auto2(H5E_DEFAULT, errorFunction, errorData);
+	return result > 0;
+}
+
+bool Hdf5Model::hasHdf5Extension(const std::string& filename)
+{
+	auto endsWith = [&](const std::string& suffix)
+	{
+		return filename.size() >= suffix.size() && filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+	return endsWith(".h5") || endsWith(".hdf5");
+}
+
+void Hdf5Model::readFromFile(const std::string& filename)
+{
+	if(isHdf5File(filename))
+		readFromHdf5(filename);
+	else
+		BinaryModel::readFromFile(filename);
+}
+
+void Hdf5Model::readFromHdf5(const std::string& filename)
+{
+	Hdf5Handle file = openFile(filename);
+
+	// read settings:
+	Json::Value settingsJson;
+	if(!readJsonAttribute(file, JsonTypeNames[JsonTypes::Settings], settingsJson))
+		std::cout << "WARNING: HDF5 model has no settings specified, using defaults" << std::endl;
+	settings_ = std::make_shared<helpers::Settings>(settingsJson);
+	settings_->print();
+
+	// read segmentation hypotheses
+	std::vector<IdLabelType> ids = readIds(file, join(JsonTypes::Segmentations, JsonTypes::Id));
+	std::cout << "\tcontains " << ids.size() << " segmentation hypotheses" << std::endl;
+
+	FeatureSetReader detectionFeatures(file, join(JsonTypes::Segmentations, JsonTypes::Features), ids.size());
+	FeatureSetReader divisionFeatures(file, join(JsonTypes::Segmentations, JsonTypes::DivisionFeatures), ids.size());
+	FeatureSetReader appearanceFeatures(file, join(JsonTypes::Segmentations, JsonTypes::AppearanceFeatures), ids.size());
+	FeatureSetReader disappearanceFeatures(file, join(JsonTypes::Segmentations, JsonTypes::DisappearanceFeatures), ids.size());
+
+	idTable_.reserve(ids.size());
+	for(size_t i = 0; i < ids.size(); ++i)
+	{
+		SegmentationHypothesis hyp(featureStore_, ids[i], detectionFeatures.row(i), divisionFeatures.row(i),
+			appearanceFeatures.row(i), disappearanceFeatures.row(i));
+		if(hyp.getDetectionVariable().getNumStates() == 0)
+			throw std::runtime_error("HDF5 entry for SegmentationHypothesis is invalid: missing features");
+
+		accumulateFeatureStatistics(VariableClass::Detection, hyp.getDetectionVariable());
+		accumulateFeatureStatistics(VariableClass::Division, hyp.getDivisionVariable());
+		accumulateFeatureStatistics(VariableClass::Appearance, hyp.getAppearanceVariable());
+		accumulateFeatureStatistics(VariableClass::Disappearance, hyp.getDisappearanceVariable());
+		segmentationHypotheses_[idTable_.intern(ids[i])] = hyp;
+	}
+
+	auto keyOf = [&](const IdLabelType& id, const std::string& what)
+	{
+		IdKey key;
+		if(!idTable_.find(id, key) || segmentationHypotheses_.find(key) == segmentationHypotheses_.end())
+		{
+			std::stringstream s;
+			s << "HDF5 " << what << " references unknown segmentation hypothesis " << id;
+			throw std::runtime_error(s.str());
+		}
+		return key;
+	};
+
+	// read linking hypotheses
+	if(exists(file, JsonTypeNames[JsonTypes::Links]))
+	{
+		std::vector<IdLabelType> srcIds = readIds(file, join(JsonTypes::Links, JsonTypes::SrcId));
+		std::vector<IdLabelType> destIds = readIds(file, join(JsonTypes::Links, JsonTypes::DestId));
+		if(srcIds.size() != destIds.size())
+			throw std::runtime_error("HDF5 linking hypotheses must have as many src as dest ids");
+		std::cout << "\tcontains " << srcIds.size() << " linking hypotheses" << std::endl;
+
+		FeatureSetReader features(file, join(JsonTypes::Links, JsonTypes::Features), srcIds.size());
+		for(size_t i = 0; i < srcIds.size(); ++i)
+		{
+			IdKey srcKey = keyOf(srcIds[i], "link");
+			IdKey destKey = keyOf(destIds[i], "link");
+			StateFeatureVector linkFeatures = features.row(i);
+			if(linkFeatures.empty())
+				throw std::runtime_error("HDF5 entry for LinkingHypothesis is invalid: missing features");
+
+			std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(featureStore_, srcKey, destKey, linkFeatures);
+			accumulateFeatureStatistics(VariableClass::Link, hyp->getVariable());
+			linkingHypotheses_[std::make_pair(srcKey, destKey)] = hyp;
+		}
+	}
+
+	// read division hypotheses
+	if(exists(file, JsonTypeNames[JsonTypes::Divisions]))
+	{
+		std::vector<IdLabelType> parentIds = readIds(file, join(JsonTypes::Divisions, JsonTypes::Parent));
+		std::vector<IdLabelType> childrenIds = readIds(file, join(JsonTypes::Divisions, JsonTypes::Children));
+		if(childrenIds.size() != 2 * parentIds.size())
+			throw std::runtime_error("HDF5 division hypotheses must have two children each");
+		std::cout << "\tcontains " << parentIds.size() << " division hypotheses" << std::endl;
+
+		FeatureSetReader features(file, join(JsonTypes::Divisions, JsonTypes::Features), parentIds.size());
+		for(size_t i = 0; i < parentIds.size(); ++i)
+		{
+			// always use ordered list of children!
+			IdKey parentKey = keyOf(parentIds[i], "division");
+			std::vector<IdKey> children = {keyOf(childrenIds[2 * i], "division"), keyOf(childrenIds[2 * i + 1], "division")};
+			std::sort(children.begin(), children.end());
+
+			StateFeatureVector divisionFeatures = features.row(i);
+			if(divisionFeatures.empty())
+				throw std::runtime_error("HDF5 entry for DivisionHypothesis is invalid: missing features");
+
+			std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(featureStore_, parentKey, children, divisionFeatures);
+			accumulateFeatureStatistics(VariableClass::ExternalDivision, hyp->getVariable());
+			divisionHypotheses_[std::make_tuple(parentKey, children[0], children[1])] = hyp;
+		}
+	}
+
+	// read exclusion constraints between detections
+	if(exists(file, JsonTypeNames[JsonTypes::Exclusions]))
+	{
+		std::vector<IdLabelType> members = readIds(file, join(JsonTypes::Exclusions, JsonTypes::Id));
+		std::vector<uint64_t> offsets = readArray<uint64_t>(file, JsonTypeNames[JsonTypes::Exclusions] + "/offsets");
+		std::cout << "\tcontains " << (offsets.empty() ? 0 : offsets.size() - 1) << " exclusions" << std::endl;
+
+		for(size_t e = 0; e + 1 < offsets.size(); ++e)
+		{
+			if(offsets[e] > offsets[e + 1] || offsets[e + 1] > members.size())
+				throw std::runtime_error("HDF5 exclusion offsets are invalid");
+			if(offsets[e + 1] - offsets[e] < 2)
+				continue;
+			std::vector<IdKey> keys;
+			for(size_t m = offsets[e]; m < offsets[e + 1]; ++m)
+				keys.push_back(idTable_.intern(members[m]));
+			exclusionConstraints_.push_back(ExclusionConstraint(keys));
+		}
+	}
+}
+
+void Hdf5Model::saveToHdf5(const std::string& filename, int compressionLevel) const
+{
+	Hdf5Handle file = createFile(filename);
+
+	Json::Value settingsJson;
+	if(settings_)
+		settings_->saveToJson(settingsJson);
+	Json::FastWriter writer;
+	writeStringAttribute(file, JsonTypeNames[JsonTypes::Settings], writer.write(settingsJson));
+
+	std::vector<IdLabelType> ids;
+	std::vector<const Variable*> detections, divisions, appearances, disappearances;
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+	{
+		ids.push_back(iter->second.getId());
+		detections.push_back(&iter->second.getDetectionVariable());
+		divisions.push_back(&iter->second.getDivisionVariable());
+		appearances.push_back(&iter->second.getAppearanceVariable());
+		disappearances.push_back(&iter->second.getDisappearanceVariable());
+	}
+	writeIds(file, join(JsonTypes::Segmentations, JsonTypes::Id), ids, compressionLevel);
+	writeFeatureSet(file, join(JsonTypes::Segmentations, JsonTypes::Features), detections, compressionLevel);
+	writeFeatureSet(file, join(JsonTypes::Segmentations, JsonTypes::DivisionFeatures), divisions, compressionLevel);
+	writeFeatureSet(file, join(JsonTypes::Segmentations, JsonTypes::AppearanceFeatures), appearances, compressionLevel);
+	writeFeatureSet(file, join(JsonTypes::Segmentations, JsonTypes::DisappearanceFeatures), disappearances, compressionLevel);
+
+	std::vector<IdLabelType> srcIds, destIds;
+	std::vector<const Variable*> links;
+	for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
+	{
+		srcIds.push_back(idTable_.getId(iter->second->getSrcKey()));
+		destIds.push_back(idTable_.getId(iter->second->getDestKey()));
+		links.push_back(&iter->second->getVariable());
+	}
+	writeIds(file, join(JsonTypes::Links, JsonTypes::SrcId), srcIds, compressionLevel);
+	writeIds(file, join(JsonTypes::Links, JsonTypes::DestId), destIds, compressionLevel);
+	writeFeatureSet(file, join(JsonTypes::Links, JsonTypes::Features), links, compressionLevel);
+
+	std::vector<IdLabelType> parentIds, childrenIds;
+	std::vector<const Variable*> externalDivisions;
+	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
+	{
+		parentIds.push_back(idTable_.getId(iter->second->getParentKey()));
+		for(auto c : iter->second->getChildrenKeys())
+			childrenIds.push_back(idTable_.getId(c));
+		externalDivisions.push_back(&iter->second->getVariable());
+	}
+	writeIds(file, join(JsonTypes::Divisions, JsonTypes::Parent), parentIds, compressionLevel);
+	writeIds(file, join(JsonTypes::Divisions, JsonTypes::Children), childrenIds, compressionLevel, 2);
+	writeFeatureSet(file, join(JsonTypes::Divisions, JsonTypes::Features), externalDivisions, compressionLevel);
+
+	std::vector<IdLabelType> members;
+	std::vector<uint64_t> offsets(1, 0);
+	for(const ExclusionConstraint& exclusion : exclusionConstraints_)
+	{
+		for(auto key : exclusion.getKeys())
+			members.push_back(idTable_.getId(key));
+		offsets.push_back(members.size());
+	}
+	writeIds(file, join(JsonTypes::Exclusions, JsonTypes::Id), members, compressionLevel);
+	writeArray(file, JsonTypeNames[JsonTypes::Exclusions] + "/offsets", offsets, compressionLevel);
+}
+
+void Hdf5Model::saveResultToHdf5(const std::string& filename, const Solution& sol) const
+{
+	Hdf5Handle file = createFile(filename);
+	const int compressionLevel = 4;
+
+	// the graph holds all variable ids of the initialized OpenGM model in flat arrays
+	auto idOf = [&](size_t segmentation) -> IdLabelType { return idTable_.getId(graph_.getKey(segmentation)); };
+
+	// save links
+	std::vector<IdLabelType> srcIds, destIds;
+	std::vector<uint32_t> linkValues;
+	for(size_t l = 0; l < graph_.getNumLinks(); ++l)
+	{
+		size_t value = sol[graph_.getLinkVariable(l)];
+		if(value > 0)
+		{
+			srcIds.push_back(idOf(graph_.getLinkSource(l)));
+			destIds.push_back(idOf(graph_.getLinkDestination(l)));
+			linkValues.push_back(value);
+		}
+	}
+	writeIds(file, join(JsonTypes::LinkResults, JsonTypes::SrcId), srcIds, compressionLevel);
+	writeIds(file, join(JsonTypes::LinkResults, JsonTypes::DestId), destIds, compressionLevel);
+	writeArray(file, join(JsonTypes::LinkResults, JsonTypes::Value), linkValues, compressionLevel);
+
+	// save divisions within detections and external divisions
+	std::vector<IdLabelType> divisionIds;
+	std::vector<uint32_t> divisionValues;
+	std::vector<IdLabelType> detectionIds;
+	std::vector<uint32_t> detectionValues;
+	for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
+	{
+		if(graph_.getDivisionVariable(s) >= 0)
+		{
+			size_t value = sol[graph_.getDivisionVariable(s)];
+			if(value > 0)
+			{
+				divisionIds.push_back(idOf(s));
+				divisionValues.push_back(1);
+			}
+		}
+
+		if(graph_.getDetectionVariable(s) >= 0)
+		{
+			size_t value = sol[graph_.getDetectionVariable(s)];
+			if(value > 0)
+			{
+				detectionIds.push_back(idOf(s));
+				detectionValues.push_back(value);
+			}
+		}
+	}
+	writeIds(file, join(JsonTypes::DivisionResults, JsonTypes::Id), divisionIds, compressionLevel);
+	writeArray(file, join(JsonTypes::DivisionResults, JsonTypes::Value), divisionValues, compressionLevel);
+	writeIds(file, join(JsonTypes::DetectionResults, JsonTypes::Id), detectionIds, compressionLevel);
+	writeArray(file, join(JsonTypes::DetectionResults, JsonTypes::Value), detectionValues, compressionLevel);
+
+	std::vector<IdLabelType> parentIds, childrenIds;
+	std::vector<uint32_t> externalDivisionValues;
+	for(size_t d = 0; d < graph_.getNumDivisions(); ++d)
+	{
+		if(graph_.getExternalDivisionVariable(d) >= 0)
+		{
+			size_t value = sol[graph_.getExternalDivisionVariable(d)];
+			if(value > 0)
+			{
+				parentIds.push_back(idOf(graph_.getDivisionParent(d)));
+				childrenIds.push_back(idOf(graph_.getDivisionChild(d, 0)));
+				childrenIds.push_back(idOf(graph_.getDivisionChild(d, 1)));
+				externalDivisionValues.push_back(1);
+			}
+		}
+	}
+	writeIds(file, join(JsonTypes::ExternalDivisionResults, JsonTypes::Parent), parentIds, compressionLevel);
+	writeIds(file, join(JsonTypes::ExternalDivisionResults, JsonTypes::Children), childrenIds, compressionLevel, 2);
+	writeArray(file, join(JsonTypes::ExternalDivisionResults, JsonTypes::Value), externalDivisionValues, compressionLevel);
+}
+
+void Hdf5Model::saveResultToFile(const std::string& filename, const Solution& sol, bool compact) const
+{
+	if(hasHdf5Extension(filename))
+		saveResultToHdf5(filename, sol);
+	else
+		saveResultToJson(filename, sol, compact);
+}
+
+Solution Hdf5Model::getGroundTruth()
+{
+	if(isHdf5File(groundTruthFilename_))
+		return readGroundTruthFromHdf5(groundTruthFilename_);
+	return JsonModel::getGroundTruth();
+}
+
+Solution Hdf5Model::readGroundTruthFromHdf5(const std::string& filename)
+{
+	if(model_.numberOfVariables() == 0)
+		throw std::runtime_error("OpenGM model must be initialized before reading a ground truth file!");
+
+	Hdf5Handle file = openFile(filename);
+
+	// create a solution vector that holds a value for each segmentation / detection / link
+	Solution solution(model_.numberOfVariables(), 0);
+
+	auto findSegmentation = [&](const IdLabelType& id) -> SegmentationHypothesis&
+	{
+		SegmentationHypothesis* hyp = findSegmentationHypothesis(id);
+		if(hyp == nullptr)
+		{
+			std::stringstream s;
+			s << "Cannot find segmentation hypothesis to annotate: " << id;
+			throw std::runtime_error(s.str());
+		}
+		return *hyp;
+	};
+
+	// first set all links and the respective source nodes to active
+	if(exists(file, JsonTypeNames[JsonTypes::LinkResults]))
+	{
+		std::vector<IdLabelType> srcIds = readIds(file, join(JsonTypes::LinkResults, JsonTypes::SrcId));
+		std::vector<IdLabelType> destIds = readIds(file, join(JsonTypes::LinkResults, JsonTypes::DestId));
+		std::vector<uint32_t> values = readArray<uint32_t>(file, join(JsonTypes::LinkResults, JsonTypes::Value));
+		if(srcIds.size() != destIds.size() || srcIds.size() != values.size())
+			throw std::runtime_error("HDF5 linking annotations must have the same number of src, dest and value entries");
+		std::cout << "\tcontains " << values.size() << " linking annotations" << std::endl;
+
+		for(size_t i = 0; i < values.size(); ++i)
+		{
+			if(values[i] == 0)
+				continue;
+
+			std::shared_ptr<LinkingHypothesis> hyp = findLinkingHypothesis(srcIds[i], destIds[i]);
+			if(!hyp)
+			{
+				std::stringstream s;
+				s << "Cannot find link to annotate: " << srcIds[i] << " to " << destIds[i];
+				throw std::runtime_error(s.str());
+			}
+			solution[hyp->getVariable().getOpenGMVariableId()] = values[i];
+		}
+	}
+
+	// read segmentation variables
+	if(exists(file, JsonTypeNames[JsonTypes::DetectionResults]))
+	{
+		std::vector<IdLabelType> ids = readIds(file, join(JsonTypes::DetectionResults, JsonTypes::Id));
+		std::vector<uint32_t> values = readArray<uint32_t>(file, join(JsonTypes::DetectionResults, JsonTypes::Value));
+		if(ids.size() != values.size())
+			throw std::runtime_error("HDF5 detection annotations must have the same number of id and value entries");
+		std::cout << "\tcontains " << values.size() << " detection annotations" << std::endl;
+
+		for(size_t i = 0; i < values.size(); ++i)
+			solution[findSegmentation(ids[i]).getDetectionVariable().getOpenGMVariableId()] = values[i];
+	}
+
+	// read division variable states, the parent must be active in any case
+	auto checkParentActive = [&](const IdLabelType& id)
+	{
+		if(solution[findSegmentation(id).getDetectionVariable().getOpenGMVariableId()] == 0)
+		{
+			std::stringstream error;
+			error << "Cannot activate division of node " << id << " that is not active!";
+			throw std::runtime_error(error.str());
+		}
+	};
+
+	if(exists(file, JsonTypeNames[JsonTypes::DivisionResults]))
+	{
+		std::vector<IdLabelType> ids = readIds(file, join(JsonTypes::DivisionResults, JsonTypes::Id));
+		std::vector<uint32_t> values = readArray<uint32_t>(file, join(JsonTypes::DivisionResults, JsonTypes::Value));
+		if(ids.size() != values.size())
+			throw std::runtime_error("HDF5 division annotations must have the same number of id and value entries");
+		std::cout << "\tcontains " << values.size() << " division annotations" << std::endl;
+
+		for(size_t i = 0; i < values.size(); ++i)
+		{
+			if(values[i] == 0)
+				continue;
+
+			checkParentActive(ids[i]);
+			int divisionVariable = findSegmentation(ids[i]).getDivisionVariable().getOpenGMVariableId();
+			if(divisionVariable < 0)
+			{
+				std::stringstream error;
+				error << "Trying to set division of " << ids[i] << " active but the variable had no division features!";
+				throw std::runtime_error(error.str());
+			}
+			solution[divisionVariable] = 1;
+		}
+	}
+
+	if(exists(file, JsonTypeNames[JsonTypes::ExternalDivisionResults]))
+	{
+		std::vector<IdLabelType> parentIds = readIds(file, join(JsonTypes::ExternalDivisionResults, JsonTypes::Parent));
+		std::vector<IdLabelType> childrenIds = readIds(file, join(JsonTypes::ExternalDivisionResults, JsonTypes::Children));
+		std::vector<uint32_t> values = readArray<uint32_t>(file, join(JsonTypes::ExternalDivisionResults, JsonTypes::Value));
+		if(parentIds.size() != values.size() || childrenIds.size() != 2 * values.size())
+			throw std::runtime_error("HDF5 external division annotations need a parent, two children and a value each");
+		std::cout << "\tcontains " << values.size() << " external division annotations" << std::endl;
+
+		for(size_t i = 0; i < values.size(); ++i)
+		{
+			if(values[i] == 0)
+				continue;
+
+			checkParentActive(parentIds[i]);
+
+			std::shared_ptr<DivisionHypothesis> hyp = findDivisionHypothesis(parentIds[i], childrenIds[2 * i], childrenIds[2 * i + 1]);
+			if(!hyp)
+			{
+				std::stringstream error;
+				error << "Parent " << parentIds[i] << " does not have division to " << childrenIds[2 * i] << " and " << childrenIds[2 * i + 1] << " to set active!";
+				throw std::runtime_error(error.str());
+			}
+			solution[hyp->getVariable().getOpenGMVariableId()] = 1;
+		}
+	}
+
+	deduceAppearanceDisappearanceStates(solution);
+	return solution;
+}
+
+} // end namespace mht
+
+namespace helpers
+{
+
+void saveWeightsToHdf5(
+	const std::vector<ValueType>& weights,
+	const std::string& filename,
+	const std::vector<std::string>& weightDescriptions,
+	const FeatureNormalization* normalization)
+{
+	if(weightDescriptions.size() > 0 && weightDescriptions.size() != weights.size())
+		throw std::runtime_error("Length of weight descriptions must match length of weights if given");
+
+	Hdf5Handle file = createFile(filename);
+	writeArray(file, JsonTypeNames[JsonTypes::Weights], weights, 0);
+	if(weightDescriptions.size() > 0)
+		writeStrings(file, JsonTypeNames[JsonTypes::WeightDescriptions], weightDescriptions, {weightDescriptions.size()}, 0);
+
+	if(normalization != nullptr)
+	{
+		Json::Value normalizationJson;
+		normalization->saveToJson(normalizationJson);
+		Json::FastWriter writer;
+		writeStringAttribute(file, JsonTypeNames[JsonTypes::FeatureNormalization], writer.write(normalizationJson));
+	}
+}
+
+std::vector<ValueType> readWeightsFromHdf5(const std::string& filename)
+{
+	Hdf5Handle file = openFile(filename);
+	if(!exists(file, JsonTypeNames[JsonTypes::Weights]))
+		throw std::runtime_error("Could not find 'weights' dataset in HDF5 file");
+	return readArray<ValueType>(file, JsonTypeNames[JsonTypes::Weights]);
+}
+
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromHdf5(const std::string& filename)
+{
+	Hdf5Handle file = openFile(filename);
+	Json::Value normalizationJson;
+	if(!readJsonAttribute(file, JsonTypeNames[JsonTypes::FeatureNormalization], normalizationJson))
+		return std::shared_ptr<FeatureNormalization>();
+	return std::make_shared<FeatureNormalization>(normalizationJson);
+}
+
+void saveWeightsToFile(
+	const std::vector<ValueType>& weights,
+	const std::string& filename,
+	const std::vector<std::string>& weightDescriptions,
+	const FeatureNormalization* normalization)
+{
+	if(mht::Hdf5Model::hasHdf5Extension(filename))
+		saveWeightsToHdf5(weights, filename, weightDescriptions, normalization);
+	else
+		saveWeightsToJson(weights, filename, weightDescriptions, normalization);
+}
+
+std::vector<ValueType> readWeightsFromFile(const std::string& filename)
+{
+	if(mht::Hdf5Model::isHdf5File(filename))
+		return readWeightsFromHdf5(filename);
+	return readWeightsFromJson(filename);
+}
+
+std::shared_ptr<FeatureNormalization> readFeatureNormalizationFromFile(const std::string& filename)
+{
+	if(mht::Hdf5Model::isHdf5File(filename))
+		return readFeatureNormalizationFromHdf5(filename);
+	return readFeatureNormalizationFromJson(filename);
+}
+
+} // end namespace helpers
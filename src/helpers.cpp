@@ -1,6 +1,9 @@
 #include <fstream>
 #include <json/json.h>
 #include "helpers.h"
+#include "factorbuffer.h"
+#include "featurenormalization.h"
+#include "gzipstream.h"
 
 namespace helpers
 {
@@ -13,6 +16,7 @@ std::map<JsonTypes, std::string> JsonTypeNames = {
 	{JsonTypes::LinkResults, "linkingResults"},
 	{JsonTypes::DivisionResults, "divisionResults"},
 	{JsonTypes::DetectionResults, "detectionResults"},
+	{JsonTypes::ExternalDivisionResults, "externalDivisionResults"},
 	{JsonTypes::SrcId, "src"}, 
 	{JsonTypes::DestId, "dest"}, 
 	{JsonTypes::Value, "value"},
@@ -23,25 +27,50 @@ std::map<JsonTypes, std::string> JsonTypeNames = {
 	{JsonTypes::DivisionFeatures, "divisionFeatures"},
 	{JsonTypes::AppearanceFeatures, "appearanceFeatures"},
 	{JsonTypes::DisappearanceFeatures, "disappearanceFeatures"},
+	{JsonTypes::Values, "values"},
+	{JsonTypes::NumStates, "numStates"},
 	{JsonTypes::Weights, "weights"},
+	{JsonTypes::WeightDescriptions, "weightDescriptions"},
 	{JsonTypes::StatesShareWeights, "statesShareWeights"},
 	{JsonTypes::Settings, "settings"},
 	{JsonTypes::OptimizerEpGap, "optimizerEpGap"},
 	{JsonTypes::OptimizerVerbose, "optimizerVerbose"},
 	{JsonTypes::OptimizerNumThreads, "optimizerNumThreads"},
 	{JsonTypes::AllowPartialMergerAppearance, "allowPartialMergerAppearance"},
-	{JsonTypes::RequireSeparateChildrenOfDivision, "requireSeparateChildrenOfDivision"}
+	{JsonTypes::RequireSeparateChildrenOfDivision, "requireSeparateChildrenOfDivision"},
+	{JsonTypes::DetectionLossWeight, "detectionLossWeight"},
+	{JsonTypes::LinkLossWeight, "linkLossWeight"},
+	{JsonTypes::DivisionLossWeight, "divisionLossWeight"},
+	{JsonTypes::AppearanceLossWeight, "appearanceLossWeight"},
+	{JsonTypes::DisappearanceLossWeight, "disappearanceLossWeight"},
+	{JsonTypes::TrackingAwareLoss, "trackingAwareLoss"},
+	{JsonTypes::StandardizeFeatures, "standardizeFeatures"},
+	{JsonTypes::MergeExclusionCliques, "mergeExclusionCliques"},
+	{JsonTypes::MaxExclusionCliqueSize, "maxExclusionCliqueSize"},
+	{JsonTypes::FeatureNormalization, "featureNormalization"},
+	{JsonTypes::Mean, "mean"},
+	{JsonTypes::Scale, "scale"}
+};
+
+std::map<VariableClass, std::string> VariableClassNames = {
+	{VariableClass::Link, "link"},
+	{VariableClass::Detection, "detection"},
+	{VariableClass::Division, "division"},
+	{VariableClass::Appearance, "appearance"},
+	{VariableClass::Disappearance, "disappearance"},
+	{VariableClass::ExternalDivision, "externalDivision"}
 };
 
 void saveWeightsToJson(
 	const std::vector<ValueType>& weights, 
 	const std::string& filename, 
-	const std::vector<std::string>& weightDescriptions)
+	const std::vector<std::string>& weightDescriptions,
+	const FeatureNormalization* normalization)
 {
 	if(weightDescriptions.size() > 0 && weightDescriptions.size() != weights.size())
 		throw std::runtime_error("Length of weight descriptions must match length of weights if given");
 
-	std::ofstream output(filename.c_str());
+	OutputFileStream output(filename);
 	if(!output.good())
 		throw std::runtime_error("Could not open JSON weight file for saving: " + filename);
 
@@ -59,12 +88,15 @@ void saveWeightsToJson(
 	if(!weightsJson.isArray())
 		throw std::runtime_error("Cannot save Weights to non-array JSON entry");
 
+	if(normalization != nullptr)
+		normalization->saveToJson(root[JsonTypeNames[JsonTypes::FeatureNormalization]]);
+
 	output << root << std::endl;
 }
 
 std::vector<ValueType> readWeightsFromJson(const std::string& filename)
 {
-	std::ifstream input(filename.c_str());
+	InputFileStream input(filename);
 	if(!input.good())
 		throw std::runtime_error("Could not open JSON weight file for reading: " + filename);
 
@@ -94,6 +126,22 @@ StateFeatureVector extractFeatures(const Json::Value& entry, JsonTypes type)
 
 	const Json::Value featuresPerState = entry[JsonTypeNames[type]];
 
+	// {"values": [...], "numStates": n} uses the same features for all n states
+	if(featuresPerState.isObject())
+	{
+		const Json::Value& values = featuresPerState[JsonTypeNames[JsonTypes::Values]];
+		const Json::Value& numStates = featuresPerState[JsonTypeNames[JsonTypes::NumStates]];
+		if(!values.isArray() || values.size() == 0)
+			throw std::runtime_error("Features for state may not be empty for " + JsonTypeNames[type]);
+		if(!numStates.isUInt() || numStates.asUInt() == 0)
+			throw std::runtime_error("Shared features need a positive numStates for " + JsonTypeNames[type]);
+
+		FeatureVector featVec;
+		for(int j = 0; j < (int)values.size(); j++)
+			featVec.push_back(values[j].asDouble());
+		return StateFeatureVector(numStates.asUInt(), featVec);
+	}
+
 	if(!featuresPerState.isArray())
 		throw std::runtime_error(JsonTypeNames[type] + " must be an array");
 
@@ -135,7 +183,7 @@ void addOpenGMVariableToConstraint(
 	double coefficient,
 	std::vector<LabelType>& constraintShape,
 	std::vector<LabelType>& factorVariables,
-	GraphicalModelType& model)
+	const GraphicalModelType& model)
 {
 	IndicatorVariableType indicatorVariable(constraintShape.size(), LabelType(state));
     constraint.add(indicatorVariable, coefficient);
@@ -150,7 +198,7 @@ void addOpenGMVariableStateToConstraint(
 	double coefficient,
 	std::vector<LabelType>& constraintShape,
 	std::vector<LabelType>& factorVariables,
-	GraphicalModelType& model)
+	const GraphicalModelType& model)
 {
 	size_t numStates = model.numberOfLabels(opengmVariableId);
 
@@ -168,11 +216,10 @@ void addConstraintToOpenGMModel(
 	LinearConstraintFunctionType::LinearConstraintType& constraint, 
 	std::vector<LabelType>& constraintShape,
 	std::vector<LabelType>& factorVariables,
-	GraphicalModelType& model)
+	FactorBuffer& factors)
 {
-	LinearConstraintFunctionType linearConstraintFunction(constraintShape.begin(), constraintShape.end(), &constraint, &constraint + 1);
-    GraphicalModelType::FunctionIdentifier linearConstraintFunctionID = model.addFunction(linearConstraintFunction);
-    model.addFactor(linearConstraintFunctionID, factorVariables.begin(), factorVariables.end());
+	// identical constraints share one function
+    factors.addConstraintFactor(constraint, constraintShape, factorVariables);
 }
 
 } // end namespace mht
@@ -0,0 +1,389 @@
+#include "hypothesisgraph.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+using namespace helpers;
+
+namespace mht
+{
+
+namespace
+{
+
+/**
+ * @brief turn counts per row (stored at row + 1) into offsets, and return a copy to use as insert positions
+ */
+std::vector<uint32_t> countsToOffsets(std::vector<uint32_t>& offsets)
+{
+	for(size_t i = 1; i < offsets.size(); ++i)
+		offsets[i] += offsets[i - 1];
+	return std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+}
+
+/**
+ * @return the position of b in the sorted row of a, or the end of the row if it is not in there
+ */
+size_t findInRow(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& indices, uint32_t a, uint32_t b)
+{
+	auto rowEnd = indices.begin() + offsets[a + 1];
+	auto it = std::lower_bound(indices.begin() + offsets[a], rowEnd, b);
+	return (it != rowEnd && *it == b) ? it - indices.begin() : offsets[a + 1];
+}
+
+} // end anonymous namespace
+
+uint32_t HypothesisGraph::indexOf(IdKey key, const IdTable& idTable) const
+{
+	auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+	if(it == keys_.end() || *it != key)
+	{
+		std::stringstream s;
+		s << "Hypothesis references unknown segmentation hypothesis " << idTable.getId(key);
+		throw std::runtime_error(s.str());
+	}
+	return it - keys_.begin();
+}
+
+void HypothesisGraph::build(
+	const SegmentationMap& segmentations,
+	const LinkMap& links,
+	const DivisionMap& divisions,
+	const std::vector<ExclusionConstraint>& exclusions,
+	const IdTable& idTable)
+{
+	if(segmentations.size() + links.size() + divisions.size() >= std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error("Too many hypotheses in the model");
+
+	const size_t numSegmentations = segmentations.size();
+	keys_.clear();
+	keys_.reserve(numSegmentations);
+	for(auto iter = segmentations.begin(); iter != segmentations.end(); ++iter)
+		keys_.push_back(iter->first);
+
+	// the rows are filled in the order of the links and divisions, which is the order of their variable ids
+	linkSources_.clear();
+	linkDestinations_.clear();
+	linkSources_.reserve(links.size());
+	linkDestinations_.reserve(links.size());
+	incomingLinkOffsets_.assign(numSegmentations + 1, 0);
+	outgoingLinkOffsets_.assign(numSegmentations + 1, 0);
+	for(auto iter = links.begin(); iter != links.end(); ++iter)
+	{
+		linkSources_.push_back(indexOf(iter->second->getSrcKey(), idTable));
+		linkDestinations_.push_back(indexOf(iter->second->getDestKey(), idTable));
+		outgoingLinkOffsets_[linkSources_.back() + 1]++;
+		incomingLinkOffsets_[linkDestinations_.back() + 1]++;
+	}
+
+	std::vector<uint32_t> outgoingPositions = countsToOffsets(outgoingLinkOffsets_);
+	std::vector<uint32_t> incomingPositions = countsToOffsets(incomingLinkOffsets_);
+	outgoingLinks_.resize(links.size());
+	incomingLinks_.resize(links.size());
+	for(uint32_t l = 0; l < linkSources_.size(); ++l)
+	{
+		outgoingLinks_[outgoingPositions[linkSources_[l]]++] = l;
+		incomingLinks_[incomingPositions[linkDestinations_[l]]++] = l;
+	}
+
+	// divisions are outgoing at the parent, and incoming at both children
+	divisionParents_.clear();
+	divisionChildren_.clear();
+	divisionParents_.reserve(divisions.size());
+	divisionChildren_.reserve(2 * divisions.size());
+	incomingDivisionOffsets_.assign(numSegmentations + 1, 0);
+	outgoingDivisionOffsets_.assign(numSegmentations + 1, 0);
+	for(auto iter = divisions.begin(); iter != divisions.end(); ++iter)
+	{
+		divisionParents_.push_back(indexOf(iter->second->getParentKey(), idTable));
+		outgoingDivisionOffsets_[divisionParents_.back() + 1]++;
+		for(IdKey child : iter->second->getChildrenKeys())
+		{
+			divisionChildren_.push_back(indexOf(child, idTable));
+			incomingDivisionOffsets_[divisionChildren_.back() + 1]++;
+		}
+	}
+
+	outgoingPositions = countsToOffsets(outgoingDivisionOffsets_);
+	incomingPositions = countsToOffsets(incomingDivisionOffsets_);
+	outgoingDivisions_.resize(divisionParents_.size());
+	incomingDivisions_.resize(divisionChildren_.size());
+	for(uint32_t d = 0; d < divisionParents_.size(); ++d)
+	{
+		outgoingDivisions_[outgoingPositions[divisionParents_[d]]++] = d;
+		for(size_t c = 2 * d; c < 2 * d + 2; ++c)
+			incomingDivisions_[incomingPositions[divisionChildren_[c]]++] = d;
+	}
+
+	// OpenGM wants the variables of a constraint in order, which is the order of the segmentation indices
+	exclusionOffsets_.assign(1, 0);
+	exclusionMembers_.clear();
+	for(const ExclusionConstraint& exclusion : exclusions)
+	{
+		for(IdKey key : exclusion.getKeys())
+			exclusionMembers_.push_back(indexOf(key, idTable));
+		std::sort(exclusionMembers_.begin() + exclusionOffsets_.back(), exclusionMembers_.end());
+		exclusionOffsets_.push_back(exclusionMembers_.size());
+	}
+
+	detectionVariables_.assign(numSegmentations, -1);
+	divisionVariables_.assign(numSegmentations, -1);
+	appearanceVariables_.assign(numSegmentations, -1);
+	disappearanceVariables_.assign(numSegmentations, -1);
+	linkVariables_.assign(links.size(), -1);
+	externalDivisionVariables_.assign(divisions.size(), -1);
+}
+
+void HypothesisGraph::mergeExclusionCliques(size_t maxCliqueSize)
+{
+	const size_t numSegmentations = keys_.size();
+	const size_t numExclusions = getNumExclusions();
+
+	// the conflict graph: two segmentations conflict if they are members of the same exclusion, both directions are stored
+	std::vector<std::pair<uint32_t, uint32_t> > arcs;
+	for(size_t e = 0; e < numExclusions; ++e)
+	{
+		IndexRange members = getExclusionMembers(e);
+		for(const uint32_t* a = members.begin(); a != members.end(); ++a)
+		{
+			for(const uint32_t* b = a + 1; b != members.end(); ++b)
+			{
+				if(*a == *b)
+					continue;
+				arcs.push_back(std::make_pair(*a, *b));
+				arcs.push_back(std::make_pair(*b, *a));
+			}
+		}
+	}
+	std::sort(arcs.begin(), arcs.end());
+	arcs.erase(std::unique(arcs.begin(), arcs.end()), arcs.end());
+
+	std::vector<uint32_t> conflictOffsets(numSegmentations + 1, 0);
+	std::vector<uint32_t> conflicts;
+	conflicts.reserve(arcs.size());
+	for(const auto& arc : arcs)
+	{
+		conflictOffsets[arc.first + 1]++;
+		conflicts.push_back(arc.second);
+	}
+	countsToOffsets(conflictOffsets);
+	std::vector<bool> covered(conflicts.size(), false);
+
+	// larger exclusions first, ties keep the order of the model
+	std::vector<uint32_t> order(numExclusions);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return getExclusionMembers(a).size() > getExclusionMembers(b).size();
+	});
+
+	std::vector<uint32_t> cliqueOffsets(1, 0);
+	std::vector<uint32_t> cliqueMembers;
+	std::vector<uint32_t> clique;
+	for(uint32_t e : order)
+	{
+		IndexRange members = getExclusionMembers(e);
+		clique.assign(members.begin(), members.end());
+		clique.erase(std::unique(clique.begin(), clique.end()), clique.end());
+
+		// exclusions whose conflicts are all part of earlier cliques are dropped, including those with a single member
+		bool hasUncoveredConflict = false;
+		for(size_t i = 0; i < clique.size() && !hasUncoveredConflict; ++i)
+			for(size_t j = i + 1; j < clique.size() && !hasUncoveredConflict; ++j)
+				hasUncoveredConflict = !covered[findInRow(conflictOffsets, conflicts, clique[i], clique[j])];
+		if(!hasUncoveredConflict)
+			continue;
+
+		// grow the clique by the conflicts of its member with the fewest conflicts which conflict with all other members
+		uint32_t pivot = clique[0];
+		for(uint32_t s : clique)
+			if(conflictOffsets[s + 1] - conflictOffsets[s] < conflictOffsets[pivot + 1] - conflictOffsets[pivot])
+				pivot = s;
+
+		const size_t numOriginalMembers = clique.size();
+		for(size_t c = conflictOffsets[pivot]; c < conflictOffsets[pivot + 1]; ++c)
+		{
+			if(maxCliqueSize > 0 && clique.size() >= maxCliqueSize)
+				break;
+
+			uint32_t candidate = conflicts[c];
+			bool conflictsWithAll = true;
+			for(size_t i = 0; i < clique.size() && conflictsWithAll; ++i)
+				conflictsWithAll = (clique[i] != candidate
+					&& findInRow(conflictOffsets, conflicts, clique[i], candidate) < conflictOffsets[clique[i] + 1]);
+			if(conflictsWithAll)
+				clique.push_back(candidate);
+		}
+		std::inplace_merge(clique.begin(), clique.begin() + numOriginalMembers, clique.end());
+
+		for(size_t i = 0; i < clique.size(); ++i)
+		{
+			for(size_t j = i + 1; j < clique.size(); ++j)
+			{
+				covered[findInRow(conflictOffsets, conflicts, clique[i], clique[j])] = true;
+				covered[findInRow(conflictOffsets, conflicts, clique[j], clique[i])] = true;
+			}
+		}
+
+		cliqueMembers.insert(cliqueMembers.end(), clique.begin(), clique.end());
+		cliqueOffsets.push_back(cliqueMembers.size());
+	}
+
+	exclusionOffsets_.swap(cliqueOffsets);
+	exclusionMembers_.swap(cliqueMembers);
+}
+
+void HypothesisGraph::updateVariableIds(const SegmentationMap& segmentations, const LinkMap& links, const DivisionMap& divisions)
+{
+	if(segmentations.size() != keys_.size() || links.size() != linkSources_.size() || divisions.size() != divisionParents_.size())
+		throw std::runtime_error("The hypotheses of the model changed since the graph was built");
+
+	size_t s = 0;
+	for(auto iter = segmentations.begin(); iter != segmentations.end(); ++iter, ++s)
+	{
+		detectionVariables_[s] = iter->second.getDetectionVariable().getOpenGMVariableId();
+		divisionVariables_[s] = iter->second.getDivisionVariable().getOpenGMVariableId();
+		appearanceVariables_[s] = iter->second.getAppearanceVariable().getOpenGMVariableId();
+		disappearanceVariables_[s] = iter->second.getDisappearanceVariable().getOpenGMVariableId();
+	}
+
+	size_t l = 0;
+	for(auto iter = links.begin(); iter != links.end(); ++iter, ++l)
+		linkVariables_[l] = iter->second->getVariable().getOpenGMVariableId();
+
+	size_t d = 0;
+	for(auto iter = divisions.begin(); iter != divisions.end(); ++iter, ++d)
+		externalDivisionVariables_[d] = iter->second->getVariable().getOpenGMVariableId();
+}
+
+size_t HypothesisGraph::getNumActiveIncomingLinks(const Solution& sol, size_t segmentation) const
+{
+	size_t sum = 0;
+	for(uint32_t l : getIncomingLinks(segmentation))
+	{
+		if(linkVariables_[l] < 0)
+			throw std::runtime_error("Cannot compute sum of active links if they have not been added to opengm");
+		sum += sol[linkVariables_[l]];
+	}
+
+	for(uint32_t d : getIncomingDivisions(segmentation))
+	{
+		if(externalDivisionVariables_[d] < 0)
+			throw std::runtime_error("Cannot compute sum of active incoming divisions if they have not been added to opengm");
+		sum += sol[externalDivisionVariables_[d]];
+	}
+
+	return sum;
+}
+
+size_t HypothesisGraph::getNumActiveOutgoingLinks(const Solution& sol, size_t segmentation) const
+{
+	size_t sum = 0;
+	for(uint32_t l : getOutgoingLinks(segmentation))
+	{
+		if(linkVariables_[l] < 0)
+			throw std::runtime_error("Cannot compute sum of active links if they have not been added to opengm");
+		sum += sol[linkVariables_[l]];
+	}
+
+	for(uint32_t d : getOutgoingDivisions(segmentation))
+	{
+		if(externalDivisionVariables_[d] < 0)
+			throw std::runtime_error("Cannot compute sum of active outgoing divisions if they have not been added to opengm");
+		sum += sol[externalDivisionVariables_[d]];
+	}
+
+	return sum;
+}
+
+bool HypothesisGraph::verifySegmentation(const Solution& sol, size_t segmentation, const IdTable& idTable) const
+{
+	const int appearance = appearanceVariables_[segmentation];
+	const int disappearance = disappearanceVariables_[segmentation];
+	size_t ownValue = sol[detectionVariables_[segmentation]];
+	size_t divisionValue = 0;
+	if(divisionVariables_[segmentation] >= 0)
+		divisionValue = sol[divisionVariables_[segmentation]];
+
+	//--------------------------------
+	// check incoming
+	size_t sumIncoming = getNumActiveIncomingLinks(sol, segmentation);
+
+	if(appearance >= 0)
+	{
+		if(sol[appearance] > 0 && sumIncoming > 0)
+		{
+			std::cout << "At node " << idTable.getId(keys_[segmentation]) << ": there are active incoming transitions and active appearances!" << std::endl;
+			return false;
+		}
+		sumIncoming += sol[appearance];
+	}
+
+	if(!getIncomingLinks(segmentation).empty() && sumIncoming != ownValue)
+	{
+		std::cout << "At node " << idTable.getId(keys_[segmentation]) << ": incoming=" << sumIncoming << " is NOT EQUAL to " << ownValue << std::endl;
+		std::cout << "(division = " << divisionValue << ")" << std::endl;
+		return false;
+	}
+
+	//--------------------------------
+	// check outgoing
+	size_t sumOutgoing = getNumActiveOutgoingLinks(sol, segmentation);
+
+	if(disappearance >= 0)
+	{
+		if(sol[disappearance] > 0 && sumOutgoing > 0)
+		{
+			std::cout << "At node " << idTable.getId(keys_[segmentation]) << ": there are active outgoing transitions and active disappearances!" << std::endl;
+			return false;
+		}
+		sumOutgoing += sol[disappearance];
+	}
+
+	if(!getOutgoingLinks(segmentation).empty() && sumOutgoing != ownValue + divisionValue)
+	{
+		std::cout << "At node " << idTable.getId(keys_[segmentation]) << ": outgoing=" << sumOutgoing << " is NOT EQUAL to "
+			<< ownValue << " + " << divisionValue << " (own+div)" << std::endl;
+		return false;
+	}
+
+	//--------------------------------
+	// check divisions
+	if(divisionValue > ownValue)
+	{
+		std::cout << "At node " << idTable.getId(keys_[segmentation]) << ": division > value: " << divisionValue << " > " << ownValue << " -> INVALID!" << std::endl;
+		return false;
+	}
+
+	//--------------------------------
+	// check division vs disappearance
+	if(disappearance >= 0 && (divisionValue > 0 && sol[disappearance] > 0))
+	{
+		std::cout << "At node " << idTable.getId(keys_[segmentation]) << ": division and disappearance are BOTH active -> INVALID!" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool HypothesisGraph::verifyExclusion(const Solution& sol, size_t exclusion, const IdTable& idTable) const
+{
+	size_t sum = 0;
+	for(uint32_t s : getExclusionMembers(exclusion))
+		sum += (sol[detectionVariables_[s]] > 0 ? 1 : 0);
+
+	if(sum > 1)
+	{
+		std::vector<IdLabelType> ids;
+		for(uint32_t s : getExclusionMembers(exclusion))
+			ids.push_back(idTable.getId(keys_[s]));
+		std::cout << "Violating exclusion constraint between ids: " << ids << std::endl;
+	}
+
+	return sum < 2;
+}
+
+} // end namespace mht
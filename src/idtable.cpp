@@ -0,0 +1,89 @@
+#include "idtable.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+namespace helpers
+{
+
+#ifdef USE_STRING_IDS
+namespace
+{
+
+const IdKey EmptySlot = std::numeric_limits<IdKey>::max();
+
+size_t hashId(const IdLabelType& id)
+{
+	return std::hash<IdLabelType>()(id);
+}
+
+} // end anonymous namespace
+
+IdKey IdTable::intern(const IdLabelType& id)
+{
+	if(2 * (ids_.size() + 1) > index_.size())
+		rebuildIndex(std::max<size_t>(64, 2 * index_.size()));
+
+	size_t mask = index_.size() - 1;
+	for(size_t slot = hashId(id) & mask; ; slot = (slot + 1) & mask)
+	{
+		IdKey key = index_[slot];
+		if(key == EmptySlot)
+		{
+			// EmptySlot itself is never used as a key
+			if(ids_.size() >= EmptySlot)
+				throw std::runtime_error("Too many different ids");
+
+			key = ids_.size();
+			ids_.push_back(id);
+			index_[slot] = key;
+			return key;
+		}
+		if(ids_[key] == id)
+			return key;
+	}
+}
+
+bool IdTable::find(const IdLabelType& id, IdKey& key) const
+{
+	if(index_.empty())
+		return false;
+
+	size_t mask = index_.size() - 1;
+	for(size_t slot = hashId(id) & mask; index_[slot] != EmptySlot; slot = (slot + 1) & mask)
+	{
+		if(ids_[index_[slot]] == id)
+		{
+			key = index_[slot];
+			return true;
+		}
+	}
+	return false;
+}
+
+void IdTable::reserve(size_t numIds)
+{
+	ids_.reserve(numIds);
+	size_t numSlots = 64;
+	while(numSlots < 2 * numIds)
+		numSlots *= 2;
+	if(numSlots > index_.size())
+		rebuildIndex(numSlots);
+}
+
+void IdTable::rebuildIndex(size_t numSlots)
+{
+	index_.assign(numSlots, EmptySlot);
+
+	size_t mask = numSlots - 1;
+	for(IdKey key = 0; key < ids_.size(); ++key)
+	{
+		size_t slot = hashId(ids_[key]) & mask;
+		while(index_[slot] != EmptySlot)
+			slot = (slot + 1) & mask;
+		index_[slot] = key;
+	}
+}
+#endif
+
+} // end namespace helpers
@@ -1,181 +1,631 @@
 #include "jsonmodel.h"
+#include "mappedfile.h"
+#include "gzipstream.h"
+#include "parallel.h"
 #include <json/json.h>
 #include <fstream>
+#include <exception>
+#include <thread>
 #include <stdexcept>
 #include <numeric>
 #include <sstream>
 #include <tuple>
+#include <functional>
+#include <algorithm>
 
 using namespace helpers;
 
 namespace mht
 {
 
-void JsonModel::readLinkingHypothesis(const Json::Value& entry)
+typedef JsonStreamParser::Token Token;
+
+namespace
+{
+
+// hypothesis arrays are only split into parts of at least this many bytes
+const size_t MinParallelChunkSize = 1 << 18;
+
+/**
+ * @brief Parse the entries of an array on several threads and add them to the model in document order
+ * @details parser must be positioned right after the opening bracket of the array, and behind the array afterwards
+ * @return the number of entries
+ */
+template<class T>
+size_t readListInParallel(
+    JsonStreamParser& parser,
+    size_t numThreads,
+    const std::function<T(JsonStreamParser&)>& parseEntry,
+    const std::function<void(T&)>& addEntry)
 {
-    if(!entry.isObject())
+    // several chunks per thread balance the load if the entries differ in size
+    std::vector<JsonStreamParser::ArrayChunk> chunks = parser.splitArray(4 * numThreads, MinParallelChunkSize);
+    std::vector<std::vector<T> > entries(chunks.size());
+    std::vector<std::exception_ptr> errors(chunks.size());
+
+    runInParallel(chunks.size(), numThreads, [&](size_t c)
+    {
+        try
+        {
+            JsonStreamParser chunkParser(chunks[c].begin, chunks[c].end, chunks[c].line);
+            while(chunkParser.peek() != Token::End)
+                entries[c].push_back(parseEntry(chunkParser));
+        }
+        catch(...)
+        {
+            errors[c] = std::current_exception();
+        }
+    });
+
+    // report the error of the first invalid entry in the file, like reading it sequentially would
+    for(const std::exception_ptr& error : errors)
+        if(error)
+            std::rethrow_exception(error);
+
+    size_t numEntries = 0;
+    for(std::vector<T>& chunkEntries : entries)
+    {
+        for(T& entry : chunkEntries)
+            addEntry(entry);
+        numEntries += chunkEntries.size();
+        std::vector<T>().swap(chunkEntries);
+    }
+    return numEntries;
+}
+
+/**
+ * @brief Writes the lists of a result file entry by entry, either indented like jsoncpp's styled writer or compact
+ * @details Entries are flat objects whose fields are ids, numbers, booleans or lists of ids
+ */
+class JsonResultWriter
+{
+public:
+    JsonResultWriter(std::ostream& output, bool compact):
+        output_(output),
+        compact_(compact),
+        numLists_(0),
+        numEntries_(0),
+        numFields_(0)
+    {
+        output_ << "{";
+    }
+
+    void beginList(JsonTypes type)
+    {
+        if(numLists_++ > 0)
+            output_ << ",";
+        newline(1);
+        writeKey(type);
+        numEntries_ = 0;
+    }
+
+    void endList()
+    {
+        if(numEntries_ == 0)
+            output_ << "[]";
+        else
+        {
+            newline(1);
+            output_ << "]";
+        }
+    }
+
+    void beginEntry()
+    {
+        if(numEntries_++ == 0)
+        {
+            newline(1);
+            output_ << "[";
+        }
+        else
+            output_ << ",";
+        newline(2);
+        output_ << "{";
+        numFields_ = 0;
+    }
+
+    void endEntry()
+    {
+        newline(2);
+        output_ << "}";
+    }
+
+    template<class T>
+    void writeField(JsonTypes type, const T& value)
+    {
+        if(numFields_++ > 0)
+            output_ << ",";
+        newline(3);
+        writeKey(type);
+        writeValue(value);
+    }
+
+    void finish()
+    {
+        if(!compact_)
+            output_ << "\n";
+        output_ << "}" << std::endl;
+    }
+
+private:
+    void newline(size_t indentation)
+    {
+        if(!compact_)
+            output_ << "\n" << std::string(indentation, '\t');
+    }
+
+    void writeKey(JsonTypes type)
+    {
+        output_ << Json::valueToQuotedString(JsonTypeNames[type].c_str()) << (compact_ ? ":" : " : ");
+    }
+
+    void writeValue(bool value) { output_ << (value ? "true" : "false"); }
+    void writeValue(size_t value) { output_ << value; }
+#ifdef USE_STRING_IDS
+    void writeValue(const std::string& id) { output_ << Json::valueToQuotedString(id.c_str()); }
+#else
+    void writeValue(unsigned int id) { output_ << id; }
+#endif
+
+    void writeValue(const std::vector<IdLabelType>& ids)
+    {
+        // operator<< of Json::Value, which wrote the results before, uses a StreamWriterBuilder whose default comment style
+        // writes every non-empty array over several lines, so every id goes on its own line below the key.
+        // (Json::StyledWriter would put short arrays on one line instead)
+        newline(3);
+        output_ << "[";
+        for(size_t i = 0; i < ids.size(); i++)
+        {
+            if(i > 0)
+                output_ << ",";
+            newline(4);
+            writeValue(ids[i]);
+        }
+        newline(3);
+        output_ << "]";
+    }
+
+private:
+    std::ostream& output_;
+    bool compact_;
+    size_t numLists_;
+    size_t numEntries_;
+    size_t numFields_;
+};
+
+} // end anonymous namespace
+
+JsonModel::JsonModel():
+    numReaderThreads_(0)
+{}
+
+StateFeatureVector JsonModel::readFeatures(JsonStreamParser& parser, JsonTypes type) const
+{
+    // same checks as helpers::extractFeatures
+    if(parser.peek() == Token::ObjectBegin)
+    {
+        Json::Value shared = parser.readValue();
+        Json::Value entry;
+        entry[JsonTypeNames[type]] = shared;
+        return extractFeatures(entry, type);
+    }
+
+    if(parser.next() != Token::ArrayBegin)
+        throw std::runtime_error(JsonTypeNames[type] + " must be an array");
+
+    // get the features per state
+    StateFeatureVector stateFeatVec;
+    while(parser.hasNextElement())
+    {
+        if(parser.next() != Token::ArrayBegin)
+            throw std::runtime_error("Expected to find a list of features for each state");
+
+        FeatureVector featVec;
+        while(parser.hasNextElement())
+            featVec.push_back(parser.readDouble("Features must be numbers for " + JsonTypeNames[type]));
+
+        if(featVec.empty())
+            throw std::runtime_error("Features for state may not be empty for " + JsonTypeNames[type]);
+
+        stateFeatVec.push_back(featVec);
+    }
+
+    if(stateFeatVec.empty())
+        throw std::runtime_error("Features may not be empty for " + JsonTypeNames[type]);
+
+    return stateFeatVec;
+}
+
+JsonModel::LinkEntry JsonModel::parseLinkingHypothesis(JsonStreamParser& parser) const
+{
+    if(parser.next() != Token::ObjectBegin)
         throw std::runtime_error("Cannot extract LinkingHypothesis from non-object JSON entry");
-    if(!entry.isMember(JsonTypeNames[JsonTypes::SrcId]) || !entry[JsonTypeNames[JsonTypes::SrcId]].isLabelType())
+
+    LinkEntry entry;
+    bool hasSrcId = false;
+    bool hasDestId = false;
+    bool hasFeatures = false;
+
+    std::string key;
+    while(parser.nextKey(key))
+    {
+        if(key == JsonTypeNames[JsonTypes::SrcId])
+            hasSrcId = parser.readId(entry.srcId);
+        else if(key == JsonTypeNames[JsonTypes::DestId])
+            hasDestId = parser.readId(entry.destId);
+        else if(key == JsonTypeNames[JsonTypes::Features] && (parser.peek() == Token::ArrayBegin || parser.peek() == Token::ObjectBegin))
+        {
+            // get transition features
+            entry.features = readFeatures(parser, JsonTypes::Features);
+            hasFeatures = true;
+        }
+        else
+            parser.skipValue();
+    }
+
+    if(!hasSrcId)
         throw std::runtime_error("JSON entry for LinkingHypothesis is invalid: missing srcId"); 
-    if(!entry.isMember(JsonTypeNames[JsonTypes::DestId]) || !entry[JsonTypeNames[JsonTypes::DestId]].isLabelType())
+    if(!hasDestId)
         throw std::runtime_error("JSON entry for LinkingHypothesis is invalid: missing destId");
-    if(!entry.isMember(JsonTypeNames[JsonTypes::Features]) || !entry[JsonTypeNames[JsonTypes::Features]].isArray())
+    if(!hasFeatures)
         throw std::runtime_error("JSON entry for LinkingHypothesis is invalid: missing features");
 
-    helpers::IdLabelType srcId = entry[JsonTypeNames[JsonTypes::SrcId]].asLabelType();
-    helpers::IdLabelType destId = entry[JsonTypeNames[JsonTypes::DestId]].asLabelType();
-
-    // get transition features
-    helpers::StateFeatureVector features = extractFeatures(entry, JsonTypes::Features);
+    return entry;
+}
 
-    // add to list
-    std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(srcId, destId, features);
-    std::pair<helpers::IdLabelType, helpers::IdLabelType> ids = std::make_pair(srcId, destId);
-    hyp->registerWithSegmentations(segmentationHypotheses_);
-    linkingHypotheses_[ids] = hyp;
+void JsonModel::addLinkingHypothesis(LinkEntry& entry)
+{
+    // add to list, the connections to the segmentations are resolved when the OpenGM model is built
+    std::pair<helpers::IdKey, helpers::IdKey> keys = std::make_pair(idTable_.intern(entry.srcId), idTable_.intern(entry.destId));
+    std::shared_ptr<LinkingHypothesis> hyp = std::make_shared<LinkingHypothesis>(featureStore_, keys.first, keys.second, entry.features);
+    accumulateFeatureStatistics(VariableClass::Link, hyp->getVariable());
+    linkingHypotheses_[keys] = hyp;
 }
 
-void JsonModel::readSegmentationHypothesis(const Json::Value& entry)
+JsonModel::SegmentationEntry JsonModel::parseSegmentationHypothesis(JsonStreamParser& parser) const
 {
-    if(!entry.isObject())
+    if(parser.next() != Token::ObjectBegin)
         throw std::runtime_error("Cannot extract SegmentationHypothesis from non-object JSON entry");
-    if(!entry.isMember(JsonTypeNames[JsonTypes::Id]) || !entry[JsonTypeNames[JsonTypes::Id]].isLabelType() 
-        || !entry.isMember(JsonTypeNames[JsonTypes::Features]) || !entry[JsonTypeNames[JsonTypes::Features]].isArray())
-        throw std::runtime_error("JSON entry for SegmentationHytpohesis is invalid");
 
-    StateFeatureVector detectionFeatures;
-    StateFeatureVector divisionFeatures;
-    StateFeatureVector appearanceFeatures;
-    StateFeatureVector disappearanceFeatures;
+    SegmentationEntry entry;
+    bool hasId = false;
+    bool hasFeatures = false;
 
-    IdLabelType id = entry[JsonTypeNames[JsonTypes::Id]].asLabelType();
+    std::string key;
+    while(parser.nextKey(key))
+    {
+        if(key == JsonTypeNames[JsonTypes::Id])
+            hasId = parser.readId(entry.id);
+        else if(key == JsonTypeNames[JsonTypes::Features] && (parser.peek() == Token::ArrayBegin || parser.peek() == Token::ObjectBegin))
+        {
+            entry.detectionFeatures = readFeatures(parser, JsonTypes::Features);
+            hasFeatures = true;
+        }
+        else if(key == JsonTypeNames[JsonTypes::DivisionFeatures])
+            entry.divisionFeatures = readFeatures(parser, JsonTypes::DivisionFeatures);
+        // read appearance and disappearance if present
+        else if(key == JsonTypeNames[JsonTypes::AppearanceFeatures])
+            entry.appearanceFeatures = readFeatures(parser, JsonTypes::AppearanceFeatures);
+        else if(key == JsonTypeNames[JsonTypes::DisappearanceFeatures])
+            entry.disappearanceFeatures = readFeatures(parser, JsonTypes::DisappearanceFeatures);
+        else
+            parser.skipValue();
+    }
 
-    detectionFeatures = extractFeatures(entry, JsonTypes::Features);
+    if(!hasId || !hasFeatures)
+        throw std::runtime_error("JSON entry for SegmentationHytpohesis is invalid");
 
-    if(entry.isMember(JsonTypeNames[JsonTypes::DivisionFeatures]))
-        divisionFeatures = extractFeatures(entry, JsonTypes::DivisionFeatures);
+    return entry;
+}
 
-    // read appearance and disappearance if present
-    if(entry.isMember(JsonTypeNames[JsonTypes::AppearanceFeatures]))
-        appearanceFeatures = extractFeatures(entry, JsonTypes::AppearanceFeatures);
-    
-    if(entry.isMember(JsonTypeNames[JsonTypes::DisappearanceFeatures]))
-        disappearanceFeatures = extractFeatures(entry, JsonTypes::DisappearanceFeatures);
+void JsonModel::addSegmentationHypothesis(SegmentationEntry& entry)
+{
+    SegmentationHypothesis hyp(featureStore_, entry.id, entry.detectionFeatures, entry.divisionFeatures,
+        entry.appearanceFeatures, entry.disappearanceFeatures);
+    accumulateFeatureStatistics(VariableClass::Detection, hyp.getDetectionVariable());
+    accumulateFeatureStatistics(VariableClass::Division, hyp.getDivisionVariable());
+    accumulateFeatureStatistics(VariableClass::Appearance, hyp.getAppearanceVariable());
+    accumulateFeatureStatistics(VariableClass::Disappearance, hyp.getDisappearanceVariable());
 
     // add to list
-    SegmentationHypothesis hyp(id, detectionFeatures, divisionFeatures, appearanceFeatures, disappearanceFeatures);
-    segmentationHypotheses_[id] = hyp;
+    segmentationHypotheses_[idTable_.intern(hyp.getId())] = std::move(hyp);
 }
 
-void JsonModel::readDivisionHypothesis(const Json::Value& entry)
+void JsonModel::readDivisionHypothesis(JsonStreamParser& parser)
 {
-    if(!entry.isObject())
+    if(parser.next() != Token::ObjectBegin)
         throw std::runtime_error("Cannot extract DivisionHypothesis from non-object JSON entry");
-    if(!entry.isMember(JsonTypeNames[JsonTypes::Parent]) || !entry[JsonTypeNames[JsonTypes::Parent]].isLabelType())
-        throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: missing srcId"); 
-    if(!entry.isMember(JsonTypeNames[JsonTypes::Children]) || !entry[JsonTypeNames[JsonTypes::Children]].isArray() 
-            || entry[JsonTypeNames[JsonTypes::Children]].size() != 2)
-        throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: must have two children as array");
-    if(!entry.isMember(JsonTypeNames[JsonTypes::Features]) || !entry[JsonTypeNames[JsonTypes::Features]].isArray())
-        throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: missing features");
 
-    IdLabelType parentId = entry[JsonTypeNames[JsonTypes::Parent]].asLabelType();
+    IdLabelType parentId;
     std::vector<helpers::IdLabelType> childrenIds;
+    StateFeatureVector features;
+    bool hasParentId = false;
+    bool validChildren = false;
+    bool hasFeatures = false;
 
-    const Json::Value children = entry[JsonTypeNames[JsonTypes::Children]];
-    for(int i = 0; i < (int)children.size(); ++i)
+    std::string key;
+    while(parser.nextKey(key))
     {
-        childrenIds.push_back(children[i].asLabelType());
+        if(key == JsonTypeNames[JsonTypes::Parent])
+            hasParentId = parser.readId(parentId);
+        else if(key == JsonTypeNames[JsonTypes::Children] && parser.peek() == Token::ArrayBegin)
+        {
+            parser.next();
+            childrenIds.clear();
+            validChildren = true;
+            while(parser.hasNextElement())
+            {
+                IdLabelType childId;
+                validChildren = parser.readId(childId) && validChildren;
+                childrenIds.push_back(childId);
+            }
+            validChildren = validChildren && childrenIds.size() == 2;
+        }
+        else if(key == JsonTypeNames[JsonTypes::Features] && (parser.peek() == Token::ArrayBegin || parser.peek() == Token::ObjectBegin))
+        {
+            // get transition features
+            features = readFeatures(parser, JsonTypes::Features);
+            hasFeatures = true;
+        }
+        else
+            parser.skipValue();
     }
 
-    // always use ordered list of children!
-    std::sort(childrenIds.begin(), childrenIds.end());
-
-    // get transition features
-    StateFeatureVector features = extractFeatures(entry, JsonTypes::Features);
+    if(!hasParentId)
+        throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: missing srcId"); 
+    if(!validChildren)
+        throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: must have two children as array");
+    if(!hasFeatures)
+        throw std::runtime_error("JSON entry for DivisionHypothesis is invalid: missing features");
 
-    // add to list
-    std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(parentId, childrenIds, features);
-    hyp->registerWithSegmentations(segmentationHypotheses_);
-    auto ids = std::make_tuple(parentId, childrenIds[0], childrenIds[1]);
-    divisionHypotheses_[ids] = hyp;
+    // always use ordered list of children!
+    std::vector<helpers::IdKey> childrenKeys = {idTable_.intern(childrenIds[0]), idTable_.intern(childrenIds[1])};
+    std::sort(childrenKeys.begin(), childrenKeys.end());
+    helpers::IdKey parentKey = idTable_.intern(parentId);
+
+    // add to list, the connections to the segmentations are resolved when the OpenGM model is built
+    std::shared_ptr<DivisionHypothesis> hyp = std::make_shared<DivisionHypothesis>(featureStore_, parentKey, childrenKeys, features);
+    accumulateFeatureStatistics(VariableClass::ExternalDivision, hyp->getVariable());
+    auto keys = std::make_tuple(parentKey, childrenKeys[0], childrenKeys[1]);
+    divisionHypotheses_[keys] = hyp;
 }
 
-void JsonModel::readExclusionConstraints(const Json::Value& entry)
+void JsonModel::readExclusionConstraints(JsonStreamParser& parser)
 {
-    if(!entry.isArray())
+    if(parser.next() != Token::ArrayBegin)
         throw std::runtime_error("Cannot extract Constraint from non-array JSON entry");
 
-    std::vector<helpers::IdLabelType> ids;
-    for(int i = 0; i < (int)entry.size(); i++)
+    std::vector<helpers::IdKey> keys;
+    while(parser.hasNextElement())
     {
-        ids.push_back(entry[i].asLabelType());
+        IdLabelType id;
+        if(!parser.readId(id))
+            throw std::runtime_error("Exclusion constraints must only contain ids");
+        keys.push_back(idTable_.intern(id));
     }
 
-    if(ids.size() < 2)
+    if(keys.size() < 2)
     {
         // std::cout << "Ignoring exclusion constraint with less than two elements" << std::endl;
         return;
     }
 
     // add to list
-    exclusionConstraints_.push_back(ExclusionConstraint(ids));
+    exclusionConstraints_.push_back(ExclusionConstraint(keys));
 }
 
 void JsonModel::readFromJson(const std::string& filename)
 {
-    std::ifstream input(filename.c_str());
+    if(numReaderThreads_ != 1 && MappedFile::isMappable(filename) && !isGzipFile(filename))
+    {
+        // the hypothesis arrays are split into parts that are parsed concurrently
+        MappedFile file(filename, false);
+        JsonStreamParser parser(file.begin(), file.end());
+        readFromJson(parser);
+        return;
+    }
+
+    InputFileStream input(filename);
     if(!input.good())
         throw std::runtime_error("Could not open JSON model file " + filename);
 
-    Json::Value root;
-    input >> root;
+    // scan the file once (decompressing it if needed) and build the hypotheses on the fly, without keeping the document in memory
+    JsonStreamParser parser(input);
+    readFromJson(parser);
+}
 
-    // read settings:
-    Json::Value settingsJson;
-    if(!root.isMember(JsonTypeNames[JsonTypes::Settings]))
+void JsonModel::readFromJson(JsonStreamParser& parser)
+{
+    if(parser.next() != Token::ObjectBegin)
+        throw std::runtime_error("JSON model must be an object");
+
+    size_t numThreads = numReaderThreads_ > 0 ? numReaderThreads_ : std::max(1u, std::thread::hardware_concurrency());
+    bool parallel = numThreads > 1 && parser.isInMemory();
+
+    // read a list of entries with the given function, and report how many there were
+    auto readList = [&](JsonTypes type, const std::string& description, std::function<void(JsonStreamParser&)> readEntry)
+    {
+        if(parser.next() != Token::ArrayBegin)
+            throw std::runtime_error(JsonTypeNames[type] + " must be an array");
+
+        size_t numEntries = 0;
+        while(parser.hasNextElement())
+        {
+            readEntry(parser);
+            numEntries++;
+        }
+        std::cout << "\tcontains " << numEntries << " " << description << std::endl;
+    };
+
+    // same for the large lists, whose entries are parsed concurrently if possible and then added in file order
+    auto readSegmentations = [&]()
+    {
+        if(!parallel)
+        {
+            readList(JsonTypes::Segmentations, "segmentation hypotheses", [&](JsonStreamParser& p)
+            {
+                SegmentationEntry entry = parseSegmentationHypothesis(p);
+                addSegmentationHypothesis(entry);
+            });
+            return;
+        }
+
+        if(parser.next() != Token::ArrayBegin)
+            throw std::runtime_error(JsonTypeNames[JsonTypes::Segmentations] + " must be an array");
+        size_t numEntries = readListInParallel<SegmentationEntry>(parser, numThreads,
+            [&](JsonStreamParser& p){ return parseSegmentationHypothesis(p); },
+            [&](SegmentationEntry& entry){ addSegmentationHypothesis(entry); });
+        std::cout << "\tcontains " << numEntries << " segmentation hypotheses" << std::endl;
+    };
+
+    auto readLinks = [&]()
+    {
+        if(!parallel)
+        {
+            readList(JsonTypes::Links, "linking hypotheses", [&](JsonStreamParser& p)
+            {
+                LinkEntry entry = parseLinkingHypothesis(p);
+                addLinkingHypothesis(entry);
+            });
+            return;
+        }
+
+        if(parser.next() != Token::ArrayBegin)
+            throw std::runtime_error(JsonTypeNames[JsonTypes::Links] + " must be an array");
+        size_t numEntries = readListInParallel<LinkEntry>(parser, numThreads,
+            [&](JsonStreamParser& p){ return parseLinkingHypothesis(p); },
+            [&](LinkEntry& entry){ addLinkingHypothesis(entry); });
+        std::cout << "\tcontains " << numEntries << " linking hypotheses" << std::endl;
+    };
+
+    std::string key;
+    while(parser.nextKey(key))
+    {
+        if(key == JsonTypeNames[JsonTypes::Settings])
+        {
+            settings_ = std::make_shared<helpers::Settings>(parser.readValue());
+            settings_->print();
+        }
+        else if(key == JsonTypeNames[JsonTypes::Segmentations])
+            readSegmentations();
+        else if(key == JsonTypeNames[JsonTypes::Links])
+            readLinks();
+        else if(key == JsonTypeNames[JsonTypes::Divisions])
+            readList(JsonTypes::Divisions, "division hypotheses", [&](JsonStreamParser& p){ readDivisionHypothesis(p); });
+        else if(key == JsonTypeNames[JsonTypes::Exclusions])
+            readList(JsonTypes::Exclusions, "exclusions", [&](JsonStreamParser& p){ readExclusionConstraints(p); });
+        else
+            parser.skipValue();
+    }
+
+    if(!settings_)
+    {
         std::cout << "WARNING: JSON JsonModel has no settings specified, using defaults" << std::endl;
-    else
-        settingsJson = root[JsonTypeNames[JsonTypes::Settings]];
-    settings_ = std::make_shared<helpers::Settings>(settingsJson);
-    settings_->print();
+        settings_ = std::make_shared<helpers::Settings>(Json::Value());
+        settings_->print();
+    }
+
+    // feature statistics are collected as long as the settings are unknown, drop them if they are not needed
+    if(!settings_->standardizeFeatures_ && featureNormalization_ && !featureNormalization_->isFinalized())
+        featureNormalization_.reset();
+}
 
-    // read segmentation hypotheses
-    const Json::Value segmentationHypotheses = root[JsonTypeNames[JsonTypes::Segmentations]];
-    std::cout << "\tcontains " << segmentationHypotheses.size() << " segmentation hypotheses" << std::endl;
-    
-    for(int i = 0; i < (int)segmentationHypotheses.size(); i++)
+void JsonModel::saveModelToJson(const std::string& filename) const
+{
+    OutputFileStream output(filename);
+    if(!output.good())
+        throw std::runtime_error("Could not open JSON model file for saving: " + filename);
+
+    Json::FastWriter writer;
+    auto featuresToJson = [](const Variable& variable)
     {
-        const Json::Value jsonHyp = segmentationHypotheses[i];
-        readSegmentationHypothesis(jsonHyp);
+        Json::Value features(Json::arrayValue);
+        for(size_t s = 0; s < variable.getNumStates(); ++s)
+        {
+            Json::Value state(Json::arrayValue);
+            for(double f : variable.getFeatures(s))
+                state.append(Json::Value(f));
+            features.append(state);
+        }
+        return features;
+    };
+
+    // every list is written one entry after the other, each entry string ends with a newline
+    bool firstEntry = true;
+    auto beginList = [&](JsonTypes type)
+    {
+        output << ",\n\"" << JsonTypeNames[type] << "\": [\n";
+        firstEntry = true;
+    };
+    auto writeEntry = [&](const Json::Value& entry)
+    {
+        output << (firstEntry ? "" : ",") << writer.write(entry);
+        firstEntry = false;
+    };
+
+    Json::Value settingsJson;
+    if(settings_)
+        settings_->saveToJson(settingsJson);
+    std::string settingsString = writer.write(settingsJson);
+    settingsString.pop_back();
+    output << "{\n\"" << JsonTypeNames[JsonTypes::Settings] << "\": " << settingsString;
+
+    beginList(JsonTypes::Segmentations);
+    for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+    {
+        const SegmentationHypothesis& hyp = iter->second;
+        Json::Value entry;
+        entry[JsonTypeNames[JsonTypes::Id]] = Json::Value(hyp.getId());
+        entry[JsonTypeNames[JsonTypes::Features]] = featuresToJson(hyp.getDetectionVariable());
+        if(hyp.getDivisionVariable().getNumStates() > 0)
+            entry[JsonTypeNames[JsonTypes::DivisionFeatures]] = featuresToJson(hyp.getDivisionVariable());
+        if(hyp.getAppearanceVariable().getNumStates() > 0)
+            entry[JsonTypeNames[JsonTypes::AppearanceFeatures]] = featuresToJson(hyp.getAppearanceVariable());
+        if(hyp.getDisappearanceVariable().getNumStates() > 0)
+            entry[JsonTypeNames[JsonTypes::DisappearanceFeatures]] = featuresToJson(hyp.getDisappearanceVariable());
+        writeEntry(entry);
     }
+    output << "]";
 
-    // read linking hypotheses
-    const Json::Value linkingHypotheses = root[JsonTypeNames[JsonTypes::Links]];
-    std::cout << "\tcontains " << linkingHypotheses.size() << " linking hypotheses" << std::endl;
-    for(int i = 0; i < (int)linkingHypotheses.size(); i++)
+    beginList(JsonTypes::Links);
+    for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
     {
-        const Json::Value jsonHyp = linkingHypotheses[i];
-        readLinkingHypothesis(jsonHyp);
+        Json::Value entry;
+        entry[JsonTypeNames[JsonTypes::SrcId]] = Json::Value(idTable_.getId(iter->second->getSrcKey()));
+        entry[JsonTypeNames[JsonTypes::DestId]] = Json::Value(idTable_.getId(iter->second->getDestKey()));
+        entry[JsonTypeNames[JsonTypes::Features]] = featuresToJson(iter->second->getVariable());
+        writeEntry(entry);
     }
+    output << "]";
 
-    // read division hypotheses
-    const Json::Value divisionHypotheses = root[JsonTypeNames[JsonTypes::Divisions]];
-    std::cout << "\tcontains " << divisionHypotheses.size() << " division hypotheses" << std::endl;
-    for(int i = 0; i < (int)divisionHypotheses.size(); i++)
+    beginList(JsonTypes::Divisions);
+    for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
     {
-        const Json::Value jsonHyp = divisionHypotheses[i];
-        readDivisionHypothesis(jsonHyp);
+        Json::Value entry;
+        entry[JsonTypeNames[JsonTypes::Parent]] = Json::Value(idTable_.getId(iter->second->getParentKey()));
+        Json::Value& children = entry[JsonTypeNames[JsonTypes::Children]];
+        for(auto c : iter->second->getChildrenKeys())
+            children.append(Json::Value(idTable_.getId(c)));
+        entry[JsonTypeNames[JsonTypes::Features]] = featuresToJson(iter->second->getVariable());
+        writeEntry(entry);
     }
+    output << "]";
 
-    // read exclusion constraints between detections
-    const Json::Value exclusions = root[JsonTypeNames[JsonTypes::Exclusions]];
-    std::cout << "\tcontains " << exclusions.size() << " exclusions" << std::endl;
-    for(int i = 0; i < (int)exclusions.size(); i++)
+    beginList(JsonTypes::Exclusions);
+    for(const ExclusionConstraint& exclusion : exclusionConstraints_)
     {
-        const Json::Value jsonExc = exclusions[i];
-        readExclusionConstraints(jsonExc);
+        Json::Value entry(Json::arrayValue);
+        for(auto key : exclusion.getKeys())
+            entry.append(Json::Value(idTable_.getId(key)));
+        writeEntry(entry);
     }
+    output << "]";
+
+    output << "\n}" << std::endl;
+
+    output.close();
+    if(!output.good())
+        throw std::runtime_error("Could not write JSON model file " + filename);
 }
 
 void JsonModel::setJsonGtFile(const std::string& filename)
@@ -185,7 +635,7 @@ void JsonModel::setJsonGtFile(const std::string& filename)
 
 Solution JsonModel::getGroundTruth()
 {
-    std::ifstream input(groundTruthFilename_.c_str());
+    InputFileStream input(groundTruthFilename_);
     if(!input.good())
         throw std::runtime_error("Could not open JSON ground truth file " + groundTruthFilename_);
 
@@ -201,6 +651,18 @@ Solution JsonModel::getGroundTruth()
     // create a solution vector that holds a value for each segmentation / detection / link
     Solution solution(model_.numberOfVariables(), 0);
 
+    auto findSegmentation = [&](const IdLabelType& id) -> SegmentationHypothesis&
+    {
+        SegmentationHypothesis* hyp = findSegmentationHypothesis(id);
+        if(hyp == nullptr)
+        {
+            std::stringstream s;
+            s << "Cannot find segmentation hypothesis to annotate: " << id;
+            throw std::runtime_error(s.str());
+        }
+        return *hyp;
+    };
+
     // first set all links and the respective source nodes to active
     for(int i = 0; i < (int)linkingResults.size(); ++i)
     {
@@ -211,7 +673,8 @@ Solution JsonModel::getGroundTruth()
         if(value > 0)
         {
             // try to find link
-            if(linkingHypotheses_.find(std::make_pair(srcId, destId)) == linkingHypotheses_.end())
+            std::shared_ptr<LinkingHypothesis> hyp = findLinkingHypothesis(srcId, destId);
+            if(!hyp)
             {
                 std::stringstream s;
                 s << "Cannot find link to annotate: " << srcId << " to " << destId;
@@ -219,7 +682,6 @@ Solution JsonModel::getGroundTruth()
             }
             
             // set link active
-            std::shared_ptr<LinkingHypothesis> hyp = linkingHypotheses_[std::make_pair(srcId, destId)];
             solution[hyp->getVariable().getOpenGMVariableId()] = value;
         }
     }
@@ -233,7 +695,7 @@ Solution JsonModel::getGroundTruth()
         helpers::IdLabelType id = jsonHyp[JsonTypeNames[JsonTypes::Id]].asLabelType();
         size_t value = jsonHyp[JsonTypeNames[JsonTypes::Value]].asUInt();
 
-        solution[segmentationHypotheses_[id].getDetectionVariable().getOpenGMVariableId()] = value;
+        solution[findSegmentation(id).getDetectionVariable().getOpenGMVariableId()] = value;
     }
 
     // read division variable states
@@ -262,7 +724,8 @@ Solution JsonModel::getGroundTruth()
                 id = jsonHyp[JsonTypeNames[JsonTypes::Parent]].asLabelType();
             }
 
-            if(solution[segmentationHypotheses_[id].getDetectionVariable().getOpenGMVariableId()] == 0)
+            const SegmentationHypothesis& segmentation = findSegmentation(id);
+            if(solution[segmentation.getDetectionVariable().getOpenGMVariableId()] == 0)
             {
                 // in any case the parent must be active!
                 std::stringstream error;
@@ -272,14 +735,14 @@ Solution JsonModel::getGroundTruth()
 
             if(jsonHyp.isMember(JsonTypeNames[JsonTypes::Id]))
             {
-                if(segmentationHypotheses_[id].getDivisionVariable().getOpenGMVariableId() < 0)
+                if(segmentation.getDivisionVariable().getOpenGMVariableId() < 0)
                 {
                     std::stringstream error;
                     error << "Trying to set division of " << id << " active but the variable had no division features!";
                     throw std::runtime_error(error.str());
                 }
                 // internal if id is given AND there is a opengm variable for the internal division
-                solution[segmentationHypotheses_[id].getDivisionVariable().getOpenGMVariableId()] = 1;
+                solution[segmentation.getDivisionVariable().getOpenGMVariableId()] = 1;
             }
             else if(jsonHyp.isMember(JsonTypeNames[JsonTypes::Parent]) && jsonHyp.isMember(JsonTypeNames[JsonTypes::Children]))
             {
@@ -292,20 +755,8 @@ Solution JsonModel::getGroundTruth()
                     throw std::runtime_error(error.str());
                 }
 
-                std::vector<IdLabelType> childrenIds;
-                for(int i = 0; i < (int)children.size(); ++i)
-                {
-                    childrenIds.push_back(children[i].asLabelType());
-                }
-
-                // always use ordered list of children!
-                std::sort(childrenIds.begin(), childrenIds.end());
-
-                DivisionHypothesis::IdType idx = std::make_tuple(jsonHyp[JsonTypeNames[JsonTypes::Parent]].asLabelType(),
-                                                                childrenIds[0],
-                                                                childrenIds[1]);
-
-                if(divisionHypotheses_.find(idx) == divisionHypotheses_.end())
+                auto divHyp = findDivisionHypothesis(id, children[0].asLabelType(), children[1].asLabelType());
+                if(!divHyp)
                 {
                     std::stringstream error;
                     error << "Parent " << id << " does not have division to " << children[0].asLabelType() << " and " << children[1].asLabelType() << " to set active!";
@@ -313,7 +764,6 @@ Solution JsonModel::getGroundTruth()
                 }
 
                 std::cout << "Setting external division to active! " << std::endl;
-                auto divHyp = divisionHypotheses_[idx];
                 solution[divHyp->getVariable().getOpenGMVariableId()] = 1;
             }
             else
@@ -333,97 +783,89 @@ Solution JsonModel::getGroundTruth()
     return solution;
 }
 
-void JsonModel::saveResultToJson(const std::string& filename, const Solution& sol) const
+void JsonModel::saveResultToJson(const std::string& filename, const Solution& sol, bool compact) const
 {
-    std::ofstream output(filename.c_str());
+    OutputFileStream output(filename);
     if(!output.good())
         throw std::runtime_error("Could not open JSON result file for saving: " + filename);
 
-    Json::Value root;
+    // the lists are sorted by name like jsoncpp does for the keys of objects
+    JsonResultWriter writer(output, compact);
 
-    // save links
-    Json::Value& linksJson = root[JsonTypeNames[JsonTypes::LinkResults]];
-    for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end() ; ++iter)
+    // the graph holds all variable ids of the initialized OpenGM model in flat arrays
+    auto idOf = [&](size_t segmentation) -> IdLabelType { return idTable_.getId(graph_.getKey(segmentation)); };
+
+    // save detections
+    writer.beginList(JsonTypes::DetectionResults);
+    for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
     {
-        size_t value = sol[iter->second->getVariable().getOpenGMVariableId()];
-        if(value > 0)
-            linksJson.append(linkToJson(iter->second, value));
+        if(graph_.getDetectionVariable(s) >= 0)
+        {
+            size_t value = sol[graph_.getDetectionVariable(s)];
+            if(value > 0)
+            {
+                writer.beginEntry();
+                writer.writeField(JsonTypes::Id, idOf(s));
+                writer.writeField(JsonTypes::Value, value);
+                writer.endEntry();
+            }
+        }
     }
+    writer.endList();
 
     // save divisions
-    Json::Value& divisionsJson = root[JsonTypeNames[JsonTypes::DivisionResults]];
-    for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+    writer.beginList(JsonTypes::DivisionResults);
+    for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
     {
-        if(iter->second.getDivisionVariable().getOpenGMVariableId() >= 0)
+        if(graph_.getDivisionVariable(s) >= 0)
         {
-            size_t value = sol[iter->second.getDivisionVariable().getOpenGMVariableId()];
+            size_t value = sol[graph_.getDivisionVariable(s)];
             if(value > 0)
-                divisionsJson.append(divisionToJson(iter->second, value));
+            {
+                writer.beginEntry();
+                writer.writeField(JsonTypes::Id, idOf(s));
+                writer.writeField(JsonTypes::Value, true);
+                writer.endEntry();
+            }
         }
     }
-    for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end() ; ++iter)
+    for(size_t d = 0; d < graph_.getNumDivisions(); ++d)
     {
-        if(iter->second->getVariable().getOpenGMVariableId() >= 0)
+        if(graph_.getExternalDivisionVariable(d) >= 0)
         {
-            size_t value = sol[iter->second->getVariable().getOpenGMVariableId()];
+            size_t value = sol[graph_.getExternalDivisionVariable(d)];
             if(value > 0)
-                divisionsJson.append(divisionToJson(iter->second, value));
+            {
+                writer.beginEntry();
+                writer.writeField(JsonTypes::Children, std::vector<IdLabelType>{idOf(graph_.getDivisionChild(d, 0)), idOf(graph_.getDivisionChild(d, 1))});
+                writer.writeField(JsonTypes::Parent, idOf(graph_.getDivisionParent(d)));
+                writer.writeField(JsonTypes::Value, value == 1);
+                writer.endEntry();
+            }
         }
     }
+    writer.endList();
 
-    // save detections
-    Json::Value& detectionsJson = root[JsonTypeNames[JsonTypes::DetectionResults]];
-    for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+    // save links
+    writer.beginList(JsonTypes::LinkResults);
+    for(size_t l = 0; l < graph_.getNumLinks(); ++l)
     {
-        if(iter->second.getDetectionVariable().getOpenGMVariableId() >= 0)
+        size_t value = sol[graph_.getLinkVariable(l)];
+        if(value > 0)
         {
-            size_t value = sol[iter->second.getDetectionVariable().getOpenGMVariableId()];
-            if(value > 0)
-                detectionsJson.append(detectionToJson(iter->second, value));
+            writer.beginEntry();
+            writer.writeField(JsonTypes::DestId, idOf(graph_.getLinkDestination(l)));
+            writer.writeField(JsonTypes::SrcId, idOf(graph_.getLinkSource(l)));
+            writer.writeField(JsonTypes::Value, value);
+            writer.endEntry();
         }
     }
+    writer.endList();
 
-    output << root << std::endl;
-}
-
-const Json::Value JsonModel::linkToJson(const std::shared_ptr<LinkingHypothesis>& link, size_t state) const
-{
-    Json::Value val;
-    val[JsonTypeNames[JsonTypes::SrcId]] = Json::Value(link->getSrcId());
-    val[JsonTypeNames[JsonTypes::DestId]] = Json::Value(link->getDestId());
-    val[JsonTypeNames[JsonTypes::Value]] = Json::Value((unsigned int)state);
-    return val;
-}
-
-const Json::Value JsonModel::divisionToJson(const std::shared_ptr<DivisionHypothesis>& division, size_t state) const
-{
-    Json::Value val;
-    val[JsonTypeNames[JsonTypes::Parent]] = Json::Value(division->getParentId());
-    Json::Value& children = val[JsonTypeNames[JsonTypes::Children]];
-    for(auto c : division->getChildrenIds())
-        children.append(c);
-
-    val[JsonTypeNames[JsonTypes::Value]] = Json::Value(state==1);
-    return val;
-}
-
-const Json::Value JsonModel::divisionToJson(const SegmentationHypothesis& segmentation, size_t value) const
-{
-    // save as bool
-    Json::Value val;
-    val[JsonTypeNames[JsonTypes::Id]] = Json::Value(segmentation.getId());
-    val[JsonTypeNames[JsonTypes::Value]] = Json::Value((bool)(value > 0));
-    return val;
-}
-
-const Json::Value JsonModel::detectionToJson(const SegmentationHypothesis& segmentation, size_t value) const
-{
-    // save as int
-    Json::Value val;
-    val[JsonTypeNames[JsonTypes::Id]] = Json::Value(segmentation.getId());
-    val[JsonTypeNames[JsonTypes::Value]] = Json::Value((int)(value));
-    return val;
+    writer.finish();
+    output.close();
+    if(!output.good())
+        throw std::runtime_error("Could not write JSON result file " + filename);
 }
 
-
 } // end namespace mht
\ No newline at end of file
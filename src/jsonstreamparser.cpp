@@ -0,0 +1,501 @@
+#include "jsonstreamparser.h"
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace helpers
+{
+
+JsonStreamParser::JsonStreamParser(std::istream& stream, size_t bufferSize):
+	stream_(&stream),
+	buffer_(bufferSize),
+	position_(nullptr),
+	end_(nullptr),
+	hasPeeked_(false),
+	peeked_(Token::End),
+	number_(0.0),
+	isUnsignedInteger_(false),
+	line_(1)
+{}
+
+JsonStreamParser::JsonStreamParser(const char* begin, const char* end, size_t firstLine):
+	stream_(nullptr),
+	position_(begin),
+	end_(end),
+	hasPeeked_(false),
+	peeked_(Token::End),
+	number_(0.0),
+	isUnsignedInteger_(false),
+	line_(firstLine)
+{}
+
+bool JsonStreamParser::fill()
+{
+	if(stream_ == nullptr || !stream_->good())
+		return false;
+
+	stream_->read(buffer_.data(), buffer_.size());
+	std::streamsize numRead = stream_->gcount();
+	position_ = buffer_.data();
+	end_ = position_ + numRead;
+	return numRead > 0;
+}
+
+void JsonStreamParser::error(const std::string& message) const
+{
+	std::stringstream s;
+	s << "JSON parse error in line " << line_ << ": " << message;
+	throw std::runtime_error(s.str());
+}
+
+void JsonStreamParser::skipWhitespace()
+{
+	while(true)
+	{
+		int c = peekChar();
+		if(c == '\n')
+		{
+			line_++;
+			getChar();
+		}
+		else if(c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ':')
+		{
+			getChar();
+		}
+		else if(c == '/')
+		{
+			getChar();
+			int kind = getChar();
+			if(kind == '/')
+			{
+				// comment until the end of the line
+				for(c = getChar(); c != '\n' && c != -1; c = getChar());
+				line_++;
+			}
+			else if(kind == '*')
+			{
+				// comment until */
+				int previous = 0;
+				for(c = getChar(); c != -1 && !(previous == '*' && c == '/'); c = getChar())
+				{
+					if(c == '\n')
+						line_++;
+					previous = c;
+				}
+				if(c == -1)
+					error("unterminated comment");
+			}
+			else
+				error("unexpected character '/'");
+		}
+		else
+			return;
+	}
+}
+
+JsonStreamParser::Token JsonStreamParser::peek()
+{
+	if(!hasPeeked_)
+	{
+		peeked_ = readToken();
+		hasPeeked_ = true;
+	}
+	return peeked_;
+}
+
+JsonStreamParser::Token JsonStreamParser::next()
+{
+	if(hasPeeked_)
+	{
+		hasPeeked_ = false;
+		return peeked_;
+	}
+	return readToken();
+}
+
+JsonStreamParser::Token JsonStreamParser::readToken()
+{
+	skipWhitespace();
+	int c = getChar();
+	switch(c)
+	{
+		case -1: return Token::End;
+		case '{': return Token::ObjectBegin;
+		case '}': return Token::ObjectEnd;
+		case '[': return Token::ArrayBegin;
+		case ']': return Token::ArrayEnd;
+		case '"': readString(); return Token::String;
+		case 't': readLiteral("rue"); return Token::True;
+		case 'f': readLiteral("alse"); return Token::False;
+		case 'n': readLiteral("ull"); return Token::Null;
+		default:
+			if(c == '-' || (c >= '0' && c <= '9'))
+			{
+				readNumber(c);
+				return Token::Number;
+			}
+			error(std::string("unexpected character '") + (char)c + "'");
+	}
+	return Token::End;
+}
+
+void JsonStreamParser::readLiteral(const char* rest)
+{
+	for(; *rest != 0; ++rest)
+		if(getChar() != *rest)
+			error("invalid literal");
+}
+
+void JsonStreamParser::readNumber(int first)
+{
+	text_.clear();
+	text_.push_back((char)first);
+	isUnsignedInteger_ = (first != '-');
+
+	for(int c = peekChar(); (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-'; c = peekChar())
+	{
+		if(c == '.' || c == 'e' || c == 'E')
+			isUnsignedInteger_ = false;
+		text_.push_back((char)getChar());
+	}
+
+	char* parsedEnd = nullptr;
+	number_ = std::strtod(text_.c_str(), &parsedEnd);
+	if(parsedEnd != text_.c_str() + text_.size())
+		error("invalid number " + text_);
+}
+
+void JsonStreamParser::readString()
+{
+	text_.clear();
+	while(true)
+	{
+		int c = getChar();
+		if(c == -1)
+			error("unterminated string");
+		if(c == '"')
+			return;
+		if(c != '\\')
+		{
+			text_.push_back((char)c);
+			continue;
+		}
+
+		c = getChar();
+		switch(c)
+		{
+			case '"': text_.push_back('"'); break;
+			case '\\': text_.push_back('\\'); break;
+			case '/': text_.push_back('/'); break;
+			case 'b': text_.push_back('\b'); break;
+			case 'f': text_.push_back('\f'); break;
+			case 'n': text_.push_back('\n'); break;
+			case 'r': text_.push_back('\r'); break;
+			case 't': text_.push_back('\t'); break;
+			case 'u':
+			{
+				unsigned int codePoint = readHexQuad();
+
+				// code points above 0xFFFF are escaped as a UTF-16 surrogate pair, which must be combined
+				if(codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+					error("unicode low surrogate without a preceding high surrogate");
+				if(codePoint >= 0xD800 && codePoint <= 0xDBFF)
+				{
+					if(getChar() != '\\' || getChar() != 'u')
+						error("unicode high surrogate without a following low surrogate");
+					unsigned int lowSurrogate = readHexQuad();
+					if(lowSurrogate < 0xDC00 || lowSurrogate > 0xDFFF)
+						error("unicode high surrogate without a following low surrogate");
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+				}
+
+				// encode as UTF-8
+				if(codePoint < 0x80)
+					text_.push_back((char)codePoint);
+				else if(codePoint < 0x800)
+				{
+					text_.push_back((char)(0xC0 | (codePoint >> 6)));
+					text_.push_back((char)(0x80 | (codePoint & 0x3F)));
+				}
+				else if(codePoint < 0x10000)
+				{
+					text_.push_back((char)(0xE0 | (codePoint >> 12)));
+					text_.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+					text_.push_back((char)(0x80 | (codePoint & 0x3F)));
+				}
+				else
+				{
+					text_.push_back((char)(0xF0 | (codePoint >> 18)));
+					text_.push_back((char)(0x80 | ((codePoint >> 12) & 0x3F)));
+					text_.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+					text_.push_back((char)(0x80 | (codePoint & 0x3F)));
+				}
+				break;
+			}
+			default:
+				error("invalid escape sequence in string");
+		}
+	}
+}
+
+unsigned int JsonStreamParser::readHexQuad()
+{
+	unsigned int value = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		int h = getChar();
+		value <<= 4;
+		if(h >= '0' && h <= '9') value += h - '0';
+		else if(h >= 'a' && h <= 'f') value += h - 'a' + 10;
+		else if(h >= 'A' && h <= 'F') value += h - 'A' + 10;
+		else error("invalid unicode escape sequence");
+	}
+	return value;
+}
+
+void JsonStreamParser::expect(Token token, const std::string& message)
+{
+	if(next() != token)
+		error(message);
+}
+
+bool JsonStreamParser::nextKey(std::string& key)
+{
+	Token token = next();
+	if(token == Token::ObjectEnd)
+		return false;
+	if(token != Token::String)
+		error("expected a key inside of an object");
+	key = text_;
+	return true;
+}
+
+bool JsonStreamParser::hasNextElement()
+{
+	if(peek() == Token::ArrayEnd)
+	{
+		next();
+		return false;
+	}
+	if(peeked_ == Token::End || peeked_ == Token::ObjectEnd)
+		error("unterminated array");
+	return true;
+}
+
+void JsonStreamParser::skipValue()
+{
+	size_t depth = 0;
+	do
+	{
+		switch(next())
+		{
+			case Token::ObjectBegin:
+			case Token::ArrayBegin:
+				depth++;
+				break;
+			case Token::ObjectEnd:
+			case Token::ArrayEnd:
+				if(depth == 0)
+					error("unexpected end of object or array");
+				depth--;
+				break;
+			case Token::End:
+				error("unexpected end of document");
+				break;
+			default:
+				// keys inside skipped objects are String tokens as well
+				break;
+		}
+	} while(depth > 0);
+}
+
+void JsonStreamParser::skipRawValue()
+{
+	// the value ends when the nesting depth drops back to zero, or at a delimiter if it is not an object or array
+	size_t depth = 0;
+	while(position_ != end_)
+	{
+		char c = *position_;
+		switch(c)
+		{
+			case '"':
+				// strings may contain brackets, escaped quotes do not end them
+				for(++position_; position_ != end_ && *position_ != '"'; ++position_)
+					if(*position_ == '\\' && position_ + 1 != end_)
+						++position_;
+				if(position_ == end_)
+					error("unterminated string");
+				++position_;
+				if(depth == 0)
+					return;
+				break;
+			case '{':
+			case '[':
+				depth++;
+				++position_;
+				break;
+			case '}':
+			case ']':
+				if(depth == 0)
+					return;
+				++position_;
+				if(--depth == 0)
+					return;
+				break;
+			case '/':
+				if(depth == 0)
+					return;
+				// comments may contain brackets as well, let the tokenizer skip them
+				skipWhitespace();
+				break;
+			case ',':
+			case ':':
+			case ' ':
+			case '\t':
+			case '\r':
+				if(depth == 0)
+					return;
+				++position_;
+				break;
+			case '\n':
+				if(depth == 0)
+					return;
+				line_++;
+				++position_;
+				break;
+			default:
+				++position_;
+		}
+	}
+	if(depth > 0)
+		error("unexpected end of document");
+}
+
+std::vector<JsonStreamParser::ArrayChunk> JsonStreamParser::splitArray(size_t maxChunks, size_t minChunkSize)
+{
+	if(stream_ != nullptr || hasPeeked_)
+		throw std::logic_error("JsonStreamParser can only split arrays of documents in memory right after the opening bracket");
+
+	// find element starts that are at least minChunkSize bytes apart
+	std::vector<ArrayChunk> candidates;
+	while(true)
+	{
+		skipWhitespace();
+		if(position_ == end_)
+			error("unterminated array");
+		if(*position_ == ']')
+			break;
+		if(candidates.empty() || size_t(position_ - candidates.back().begin) >= minChunkSize)
+			candidates.push_back(ArrayChunk{position_, nullptr, line_});
+		skipRawValue();
+	}
+	const char* arrayEnd = position_++;
+
+	if(candidates.empty())
+		return candidates;
+
+	// pick the candidates closest behind the ideal chunk boundaries
+	maxChunks = std::max<size_t>(1, maxChunks);
+	const char* arrayBegin = candidates.front().begin;
+	size_t arraySize = arrayEnd - arrayBegin;
+	std::vector<ArrayChunk> chunks;
+	for(const ArrayChunk& candidate : candidates)
+	{
+		size_t numChunks = chunks.size();
+		if(numChunks == 0 || (numChunks < maxChunks && size_t(candidate.begin - arrayBegin) >= numChunks * arraySize / maxChunks))
+			chunks.push_back(candidate);
+	}
+
+	for(size_t i = 0; i + 1 < chunks.size(); i++)
+		chunks[i].end = chunks[i + 1].begin;
+	chunks.back().end = arrayEnd;
+	return chunks;
+}
+
+Json::Value JsonStreamParser::readValue()
+{
+	switch(next())
+	{
+		case Token::ObjectBegin:
+		{
+			Json::Value value(Json::objectValue);
+			std::string key;
+			while(nextKey(key))
+				value[key] = readValue();
+			return value;
+		}
+		case Token::ArrayBegin:
+		{
+			Json::Value value(Json::arrayValue);
+			while(hasNextElement())
+				value.append(readValue());
+			return value;
+		}
+		case Token::String:
+			return Json::Value(text_);
+		case Token::Number:
+			// same value types as the jsoncpp reader: signed integers if possible, unsigned only if needed
+			if(text_.find_first_of(".eE") == std::string::npos)
+			{
+				if(!isUnsignedInteger_)
+					return Json::Value((Json::Int64)std::strtoll(text_.c_str(), nullptr, 10));
+				Json::UInt64 value = std::strtoull(text_.c_str(), nullptr, 10);
+				if(value <= (Json::UInt64)Json::Value::maxInt64)
+					return Json::Value((Json::Int64)value);
+				return Json::Value(value);
+			}
+			return Json::Value(number_);
+		case Token::True:
+			return Json::Value(true);
+		case Token::False:
+			return Json::Value(false);
+		case Token::Null:
+			return Json::Value();
+		default:
+			error("expected a value");
+	}
+	return Json::Value();
+}
+
+double JsonStreamParser::readDouble(const std::string& message)
+{
+	Token token = next();
+	if(token == Token::True || token == Token::False)
+		return token == Token::True ? 1.0 : 0.0;
+	if(token != Token::Number)
+		error(message);
+	return number_;
+}
+
+bool JsonStreamParser::readId(IdLabelType& id)
+{
+#ifdef USE_STRING_IDS
+	if(peek() != Token::String)
+	{
+		skipValue();
+		return false;
+	}
+	next();
+	id = text_;
+	return true;
+#else
+	if(peek() != Token::Number)
+	{
+		skipValue();
+		return false;
+	}
+	next();
+	if(!isUnsignedInteger_)
+		return false;
+	unsigned long long value = std::strtoull(text_.c_str(), nullptr, 10);
+	if(value > UINT_MAX)
+		return false;
+	id = (IdLabelType)value;
+	return true;
+#endif
+}
+
+} // end namespace helpers
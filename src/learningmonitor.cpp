@@ -0,0 +1,174 @@
+#include "learningmonitor.h"
+#include <limits>
+#include <cmath>
+
+#include <json/json.h>
+
+namespace helpers
+{
+
+LearningMonitor::LearningMonitor(double regularizerWeight, std::ostream* report):
+	regularizerWeight_(regularizerWeight),
+	report_(report),
+	pending_(false),
+	bestPrimal_(std::numeric_limits<double>::infinity())
+{}
+
+void LearningMonitor::startIteration(const WeightsType& weights)
+{
+	if(pending_)
+	{
+		current_.qpTime = secondsSince(oracleEndTime_);
+		reportIteration(weights);
+	}
+	else if(risks_.empty())
+	{
+		startTime_ = ClockType::now();
+	}
+
+	current_ = Iteration();
+	current_.iteration = risks_.size() + 1;
+}
+
+void LearningMonitor::addModelBuildingTime(double seconds)
+{
+	current_.modelBuildingTime += seconds;
+}
+
+void LearningMonitor::addSolvingTime(double seconds)
+{
+	current_.solvingTime += seconds;
+}
+
+void LearningMonitor::endIteration(const WeightsType& weights, double risk, const WeightsType& gradient)
+{
+	// store the hyperplane a_t = gradient, b_t = L(w_t) - <w_t, a_t>
+	std::vector<ValueType> a(gradient.numberOfWeights());
+	double squaredNorm = 0.0;
+	double offset = risk;
+	for(size_t i = 0; i < a.size(); ++i)
+	{
+		a[i] = gradient[i];
+		offset -= weights[i] * a[i];
+		squaredNorm += weights[i] * weights[i];
+	}
+	gradients_.push_back(a);
+	offsets_.push_back(offset);
+	risks_.push_back(risk);
+
+	current_.risk = risk;
+	current_.weightNorm = std::sqrt(squaredNorm);
+	current_.primal = risk + 0.5 * regularizerWeight_ * squaredNorm;
+	bestPrimal_ = std::min(bestPrimal_, current_.primal);
+	current_.bestPrimal = bestPrimal_;
+	current_.numConstraints = gradients_.size();
+
+	pending_ = true;
+	oracleEndTime_ = ClockType::now();
+}
+
+void LearningMonitor::reportIteration(const WeightsType& weights)
+{
+	// the QP found the minimum of λ/2 |w|² + max_i <w, a_i> + b_i at the given weights
+	double squaredNorm = 0.0;
+	for(size_t i = 0; i < weights.numberOfWeights(); ++i)
+		squaredNorm += weights[i] * weights[i];
+
+	std::vector<double> planeValues(gradients_.size(), 0.0);
+	double maxPlaneValue = -std::numeric_limits<double>::infinity();
+	for(size_t p = 0; p < gradients_.size(); ++p)
+	{
+		planeValues[p] = offsets_[p];
+		for(size_t i = 0; i < gradients_[p].size() && i < weights.numberOfWeights(); ++i)
+			planeValues[p] += gradients_[p][i] * weights[i];
+		maxPlaneValue = std::max(maxPlaneValue, planeValues[p]);
+	}
+
+	double tolerance = 1e-9 * std::max(1.0, std::abs(maxPlaneValue));
+	current_.numActiveConstraints = 0;
+	for(double value : planeValues)
+		if(value >= maxPlaneValue - tolerance)
+			current_.numActiveConstraints++;
+
+	current_.dual = 0.5 * regularizerWeight_ * squaredNorm + maxPlaneValue;
+	current_.gap = bestPrimal_ - current_.dual;
+
+	iterations_.push_back(current_);
+	writeIteration(current_);
+	pending_ = false;
+}
+
+void LearningMonitor::writeIteration(const Iteration& iteration)
+{
+	if(report_ == nullptr)
+		return;
+
+	Json::Value line = reportFields_;
+	line["iteration"] = Json::Value((Json::UInt64)iteration.iteration);
+	line["risk"] = Json::Value(iteration.risk);
+	line["primal"] = Json::Value(iteration.primal);
+	line["bestPrimal"] = Json::Value(iteration.bestPrimal);
+	line["dual"] = Json::Value(iteration.dual);
+	line["gap"] = Json::Value(iteration.gap);
+	line["weightNorm"] = Json::Value(iteration.weightNorm);
+	line["constraints"] = Json::Value((Json::UInt64)iteration.numConstraints);
+	line["activeConstraints"] = Json::Value((Json::UInt64)iteration.numActiveConstraints);
+	line["modelBuildingTime"] = Json::Value(iteration.modelBuildingTime);
+	line["solvingTime"] = Json::Value(iteration.solvingTime);
+	line["lossAugmentedInferenceTime"] = Json::Value(iteration.modelBuildingTime + iteration.solvingTime);
+	line["qpTime"] = Json::Value(iteration.qpTime);
+
+	Json::FastWriter writer;
+	*report_ << writer.write(line) << std::flush;
+}
+
+void LearningMonitor::finish(const WeightsType& weights)
+{
+	if(pending_)
+	{
+		current_.qpTime = secondsSince(oracleEndTime_);
+		reportIteration(weights);
+	}
+
+	double modelBuildingTime = 0.0;
+	double solvingTime = 0.0;
+	double qpTime = 0.0;
+	for(const Iteration& iteration : iterations_)
+	{
+		modelBuildingTime += iteration.modelBuildingTime;
+		solvingTime += iteration.solvingTime;
+		qpTime += iteration.qpTime;
+	}
+	double totalTime = iterations_.empty() ? 0.0 : secondsSince(startTime_);
+
+	std::cout << "Learning finished after " << iterations_.size() << " iterations and " << totalTime << " seconds:"
+		<< "\n\tbuilding inference models: " << modelBuildingTime << " s"
+		<< "\n\tsolving inference problems: " << solvingTime << " s"
+		<< "\n\tQP of the bundle method: " << qpTime << " s";
+	if(!iterations_.empty())
+		std::cout << "\n\tfinal gap: " << iterations_.back().gap;
+	std::cout << std::endl;
+
+	if(report_ == nullptr)
+		return;
+
+	Json::Value summary = reportFields_;
+	summary["summary"] = Json::Value(true);
+	summary["iterations"] = Json::Value((Json::UInt64)iterations_.size());
+	summary["totalTime"] = Json::Value(totalTime);
+	summary["modelBuildingTime"] = Json::Value(modelBuildingTime);
+	summary["solvingTime"] = Json::Value(solvingTime);
+	summary["qpTime"] = Json::Value(qpTime);
+	summary["otherTime"] = Json::Value(std::max(0.0, totalTime - modelBuildingTime - solvingTime - qpTime));
+	if(!iterations_.empty())
+	{
+		summary["primal"] = Json::Value(iterations_.back().bestPrimal);
+		summary["dual"] = Json::Value(iterations_.back().dual);
+		summary["gap"] = Json::Value(iterations_.back().gap);
+	}
+
+	Json::FastWriter writer;
+	*report_ << writer.write(summary) << std::flush;
+}
+
+} // end namespace helpers
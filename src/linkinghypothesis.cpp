@@ -1,4 +1,5 @@
 #include "linkinghypothesis.h"
+#include "factorbuffer.h"
 #include <stdexcept>
 
 using namespace helpers;
@@ -9,15 +10,21 @@ namespace mht
 LinkingHypothesis::LinkingHypothesis()
 {}
 
-LinkingHypothesis::LinkingHypothesis(helpers::IdLabelType srcId, helpers::IdLabelType destId, const helpers::StateFeatureVector& features):
-    srcId_(srcId),
-    destId_(destId),
-    variable_(features)
+LinkingHypothesis::LinkingHypothesis(helpers::FeatureStore& featureStore, helpers::IdKey srcKey, helpers::IdKey destKey, const helpers::StateFeatureVector& features):
+    srcKey_(srcKey),
+    destKey_(destKey),
+    variable_(featureStore.getArena(VariableClass::Link), features)
 {}
 
-void LinkingHypothesis::toDot(std::ostream& stream, const Solution* sol) const
+LinkingHypothesis::LinkingHypothesis(helpers::FeatureStore& featureStore, helpers::IdKey srcKey, helpers::IdKey destKey, const helpers::FeatureRowRange& rows):
+    srcKey_(srcKey),
+    destKey_(destKey),
+    variable_(featureStore.getArena(VariableClass::Link), rows)
+{}
+
+void LinkingHypothesis::toDot(std::ostream& stream, const Solution* sol, const IdTable& idTable) const
 {
-    stream << "\t" << srcId_ << " -> " << destId_;
+    stream << "\t" << idTable.getId(srcKey_) << " -> " << idTable.getId(destKey_);
 
     if(sol != nullptr && variable_.getOpenGMVariableId() >= 0)
     {
@@ -33,26 +40,21 @@ void LinkingHypothesis::toDot(std::ostream& stream, const Solution* sol) const
     stream << "; \n" << std::flush;
 }
 
-void LinkingHypothesis::registerWithSegmentations(std::map<helpers::IdLabelType, SegmentationHypothesis>& segmentationHypotheses)
+void LinkingHypothesis::addVariablesToOpenGMModel(GraphicalModelType& model)
 {
-    assert(segmentationHypotheses.find(srcId_) != segmentationHypotheses.end());
-    assert(segmentationHypotheses.find(destId_) != segmentationHypotheses.end());
+    // std::cout << "Adding linking hypothesis between " << srcKey_ << " and " << destKey_ << " to opengm" << std::endl;
 
-    // std::cout << "Registering outgoing link for " << srcId_ << std::endl;
-    segmentationHypotheses[srcId_].addOutgoingLink(shared_from_this());
-    // std::cout << "Registering incoming link for " << destId_ << std::endl;
-    segmentationHypotheses[destId_].addIncomingLink(shared_from_this());
+    variable_.addToOpenGM(model);
 }
 
 void LinkingHypothesis::addToOpenGMModel(
-    GraphicalModelType& model, 
+    FactorBuffer& factors, 
     WeightsType& weights, 
     bool statesShareWeights,
-    const std::vector<size_t>& weightIds)
+    const std::vector<size_t>& weightIds,
+    const UnaryEnergies* energies) const
 {
-    // std::cout << "Adding linking hypothesis between " << srcId_ << " and " << destId_ << " to opengm" << std::endl;
-
-    variable_.addToOpenGM(model, statesShareWeights, weights, weightIds);
+    variable_.addUnaryToOpenGM(factors, statesShareWeights, weights, weightIds, energies);
 }
 
 } // end namespace mht
@@ -0,0 +1,55 @@
+#include "mappedfile.h"
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace helpers
+{
+
+MappedFile::MappedFile(const std::string& filename, bool sequential):
+	data_(nullptr),
+	size_(0)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw std::runtime_error("Could not open file " + filename);
+
+	struct stat status;
+	if(fstat(fd, &status) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Could not determine size of file " + filename);
+	}
+	size_ = status.st_size;
+
+	if(size_ > 0)
+	{
+		void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED)
+		{
+			close(fd);
+			throw std::runtime_error("Could not map file " + filename);
+		}
+		if(sequential)
+			madvise(data, size_, MADV_SEQUENTIAL);
+		data_ = static_cast<const char*>(data);
+	}
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if(data_ != nullptr)
+		munmap(const_cast<char*>(data_), size_);
+}
+
+bool MappedFile::isMappable(const std::string& filename)
+{
+	struct stat status;
+	return stat(filename.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+}
+
+} // end namespace helpers
@@ -1,8 +1,13 @@
 #include "model.h"
+#include "parallel.h"
+#include "factorbuffer.h"
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <stdexcept>
 #include <numeric>
 #include <sstream>
+#include <thread>
 
 // include the LPDef symbols only once!
 #undef OPENGM_LPDEF_NO_SYMBOLS
@@ -14,7 +19,8 @@
 #include <opengm/inference/lpgurobi2.hxx>
 #endif
 
-#include <opengm/learning/struct-max-margin.hxx>
+#include <opengm/learning/bundle-optimizer.hxx>
+#include "learningoracle.h"
 
 using namespace helpers;
 
@@ -23,8 +29,8 @@ namespace mht
 
 size_t Model::computeNumWeights()
 {
-	// only compute if it wasn't initialized yet
-	if(numDetWeights_ == 0)
+	// only compute if it wasn't initialized yet, and as long as there are features to count
+	if(numDetWeights_ == 0 && !featureStore_.isReleased())
 	{
 		int numDetWeights = -1;
 		int numDivWeights = -1;
@@ -86,50 +92,161 @@ size_t Model::computeNumWeights()
 	return numDetWeights_ + numDivWeights_ + numAppWeights_ + numDisWeights_ + numExternalDivWeights_ + numLinkWeights_;
 }
 
-void Model::initializeOpenGMModel(WeightsType& weights)
+void Model::initializeOpenGMModel(WeightsType& weights, bool precomputeEnergies)
 {
+	if(featureStore_.isReleased())
+		throw std::runtime_error("Cannot build the OpenGM model again after the features of the hypotheses were released");
+
 	// make sure the numbers of features are initialized
 	computeNumWeights();
+	normalizeFeatures();
 
 	std::cout << "Initializing opengm model..." << std::endl;
+	// start from an empty model, so that the hypotheses can be added again
+	model_ = GraphicalModelType();
+	graph_.build(segmentationHypotheses_, linkingHypotheses_, divisionHypotheses_, exclusionConstraints_, idTable_);
+	if(settings_->mergeExclusionCliques_)
+	{
+		graph_.mergeExclusionCliques(settings_->maxExclusionCliqueSize_);
+		std::cout << "Merged " << exclusionConstraints_.size() << " exclusion constraints into " << graph_.getNumExclusions() << " cliques" << std::endl;
+	}
+
+	// the weights of each variable class are consecutive, see getWeightRange()
+	auto getWeightIds = [&](VariableClass variableClass)
+	{
+		size_t numWeights = 0;
+		size_t firstWeight = getWeightRange(variableClass, numWeights);
+		std::vector<size_t> weightIds(numWeights);
+		std::iota(weightIds.begin(), weightIds.end(), firstWeight); // fill with increasing values starting at the first weight
+		return weightIds;
+	};
+
 	// we need two sets of weights for all features to represent state "on" and "off"!
-	std::vector<size_t> linkWeightIds(numLinkWeights_);
-	std::iota(linkWeightIds.begin(), linkWeightIds.end(), 0); // fill with increasing values starting at 0
+	std::vector<size_t> linkWeightIds = getWeightIds(VariableClass::Link);
+	std::vector<size_t> detWeightIds = getWeightIds(VariableClass::Detection);
+	std::vector<size_t> divWeightIds = getWeightIds(VariableClass::Division);
+	std::vector<size_t> appWeightIds = getWeightIds(VariableClass::Appearance);
+	std::vector<size_t> disWeightIds = getWeightIds(VariableClass::Disappearance);
+	std::vector<size_t> externalDivWeightIds = getWeightIds(VariableClass::ExternalDivision);
+
+	// first add all variables: links, divisions, then the variables of each segmentation, which gives the same ids as always
+	std::vector<const LinkingHypothesis*> links;
+	std::vector<const DivisionHypothesis*> divisions;
+	std::vector<const SegmentationHypothesis*> segmentations;
+	links.reserve(linkingHypotheses_.size());
+	divisions.reserve(divisionHypotheses_.size());
+	segmentations.reserve(segmentationHypotheses_.size());
 
-	// first add all link variables, because segmentations will use them when defining constraints
 	for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end() ; ++iter)
 	{
-		iter->second->addToOpenGMModel(model_, weights, settings_->statesShareWeights_, linkWeightIds);
+		iter->second->addVariablesToOpenGMModel(model_);
+		links.push_back(iter->second.get());
+	}
+
+	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end() ; ++iter)
+	{
+		iter->second->addVariablesToOpenGMModel(model_);
+		divisions.push_back(iter->second.get());
+	}
+
+	size_t index = 0;
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter, ++index)
+	{
+		iter->second.addVariablesToOpenGMModel(model_, graph_, index);
+		segmentations.push_back(&iter->second);
 	}
 
-	std::vector<size_t> detWeightIds(numDetWeights_);
-	std::iota(detWeightIds.begin(), detWeightIds.end(), numLinkWeights_); // fill with increasing values starting at the next valid index
+	// the constraints of the segmentations need the variables of their links and divisions
+	graph_.updateVariableIds(segmentationHypotheses_, linkingHypotheses_, divisionHypotheses_);
+	buildVariableTable();
 
-	std::vector<size_t> divWeightIds(numDivWeights_);
-	std::iota(divWeightIds.begin(), divWeightIds.end(), numLinkWeights_ + numDetWeights_);
+	// precomputed unaries are explicit functions of the energies of all variables, which are computed at once
+	UnaryEnergies energies;
+	if(precomputeEnergies)
+	{
+		std::vector<ValueType> weightValues(weights.numberOfWeights());
+		for(size_t i = 0; i < weightValues.size(); ++i)
+			weightValues[i] = weights.getWeight(i);
+		energies = computeUnaryEnergies(weightValues, numBuilderThreads_);
+	}
+	const UnaryEnergies* unaryEnergies = precomputeEnergies ? &energies : nullptr;
+
+	// count the factors and the variables they are defined on, so that the storage of the model is allocated only once
+	FactorCounts counts;
+	counts.addUnaries(model_.numberOfVariables());
+	for(size_t s = 0; s < segmentations.size(); ++s)
+		segmentations[s]->countOpenGMConstraints(settings_, graph_, s, counts);
+	for(size_t e = 0; e < graph_.getNumExclusions(); ++e)
+		counts.addConstraint(ExclusionConstraint::getNumOpenGMFactorVariables(model_, graph_, e));
+
+	model_.reserveFactors(counts.getNumFactors());
+	model_.reserveFactorsVarialbeIndices(counts.numFactorVariables); // sic, that is how OpenGM spells it
+	if(precomputeEnergies)
+		model_.reserveFunctions<ExplicitFunctionType>(counts.numUnaries);
+	else if(settings_->statesShareWeights_)
+		model_.reserveFunctions<LearnableWeightedSumOfFuncType>(counts.numUnaries);
+	else
+		model_.reserveFunctions<LearnableUnaryFuncType>(counts.numUnaries);
+
+	// the factors of all links, divisions, segmentations and exclusions, in this order, only read the model and the graph
+	const size_t numItems = links.size() + divisions.size() + segmentations.size() + graph_.getNumExclusions();
+	auto addFactors = [&](size_t item, FactorBuffer& factors)
+	{
+		if(item < links.size())
+			return links[item]->addToOpenGMModel(factors, weights, settings_->statesShareWeights_, linkWeightIds, unaryEnergies);
+		item -= links.size();
 
-	std::vector<size_t> appWeightIds(numAppWeights_);
-	std::iota(appWeightIds.begin(), appWeightIds.end(), numLinkWeights_ + numDetWeights_ + numDivWeights_);
+		if(item < divisions.size())
+			return divisions[item]->addToOpenGMModel(factors, weights, settings_->statesShareWeights_, externalDivWeightIds, unaryEnergies);
+		item -= divisions.size();
 
-	std::vector<size_t> disWeightIds(numDisWeights_);
-	std::iota(disWeightIds.begin(), disWeightIds.end(), numLinkWeights_ + numDetWeights_ + numDivWeights_ + numAppWeights_);
+		if(item < segmentations.size())
+			return segmentations[item]->addToOpenGMModel(model_, factors, weights, settings_, detWeightIds, divWeightIds, appWeightIds,
+				disWeightIds, graph_, item, unaryEnergies);
+		item -= segmentations.size();
 
-	std::vector<size_t> externalDivWeightIds(numExternalDivWeights_);
-	std::iota(externalDivWeightIds.begin(), externalDivWeightIds.end(), numLinkWeights_ + numDetWeights_ + numDivWeights_ + numAppWeights_ + numDisWeights_);
+		ExclusionConstraint::addToOpenGMModel(model_, factors, graph_, item);
+	};
 
-	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end() ; ++iter)
+	// Blocks of items are built on several threads, and their buffers are added to the model in the order of the blocks,
+	// so the factors are the same as if they were added in a single loop. Only a few blocks per thread are kept in memory at once.
+	const size_t blockSize = 1024;
+	const size_t numThreads = numBuilderThreads_ > 0 ? numBuilderThreads_ : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<FactorBuffer> buffers(4 * numThreads);
+	FactorBuffer::ConstraintFunctionCache constraintFunctions;
+	FactorCounts builtCounts;
+	for(size_t batchBegin = 0; batchBegin < numItems; batchBegin += buffers.size() * blockSize)
 	{
-		iter->second->addToOpenGMModel(model_, weights, settings_->statesShareWeights_, externalDivWeightIds);
+		size_t numBlocks = std::min(buffers.size(), (numItems - batchBegin + blockSize - 1) / blockSize);
+		runInParallel(numBlocks, numThreads, [&](size_t block)
+		{
+			size_t blockBegin = batchBegin + block * blockSize;
+			for(size_t item = blockBegin; item < std::min(numItems, blockBegin + blockSize); ++item)
+				addFactors(item, buffers[block]);
+		});
+
+		for(size_t block = 0; block < numBlocks; ++block)
+		{
+			buffers[block].addToModel(model_, constraintFunctions);
+			buffers[block].countFactors(builtCounts);
+			buffers[block].clear();
+		}
 	}
 
-	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+	// the storage was reserved for the counted factors, the hypotheses must have built exactly these
+	if(builtCounts != counts)
 	{
-		iter->second.addToOpenGMModel(model_, weights, settings_, detWeightIds, divWeightIds, appWeightIds, disWeightIds);
+		std::stringstream message;
+		message << "Built " << builtCounts.numUnaries << " unaries and " << builtCounts.numConstraints << " constraints on "
+			<< builtCounts.numFactorVariables << " variables, but counted " << counts.numUnaries << " unaries and "
+			<< counts.numConstraints << " constraints on " << counts.numFactorVariables << " variables";
+		throw std::runtime_error(message.str());
 	}
 
-	for(auto iter = exclusionConstraints_.begin(); iter != exclusionConstraints_.end() ; ++iter)
+	if(releaseFeatures_)
 	{
-		iter->addToOpenGMModel(model_, segmentationHypotheses_);
+		std::cout << "Releasing " << featureStore_.getMemoryUsage() / 1024 << " kB of features" << std::endl;
+		featureStore_.release();
 	}
 
 	size_t numIndicatorVars = 0;
@@ -147,7 +264,9 @@ Solution Model::infer(const std::vector<ValueType>& weights)
 	assert(weights.size() == weightObject.numberOfWeights());
 	for(size_t i = 0; i < weights.size(); i++)
 		weightObject.setWeight(i, weights[i]);
-	initializeOpenGMModel(weightObject);
+
+	// the weights are fixed, so the unaries only need the energies of their states
+	initializeOpenGMModel(weightObject, true);
 
 #ifdef WITH_CPLEX
 	std::cout << "Using cplex optimizer" << std::endl;
@@ -177,22 +296,45 @@ Solution Model::infer(const std::vector<ValueType>& weights)
 	return solution;
 }
 
-std::vector<ValueType> Model::learn()
+std::vector<ValueType> Model::learn(LearningMonitor* monitor)
 {
 	// prepare OpenGM for learning
 	DatasetType dataset;
 	WeightsType initialWeights(computeNumWeights());
 	dataset.setWeights(initialWeights);
+	addToDataset(dataset);
+	return learn(dataset, 1.0, monitor);
+}
+
+void Model::addToDataset(DatasetType& dataset)
+{
+	if(dataset.getWeights().numberOfWeights() != computeNumWeights())
+		throw std::runtime_error("Number of weights in dataset does not match the number of weights of the model");
+
 	initializeOpenGMModel(dataset.getWeights());
 
 	// load GT from subclass-specified method
 	Solution gt = getGroundTruth();
 
-	dataset.pushBackInstance(model_, gt);
-	
+	dataset.pushBackInstance(model_, gt, getLossParameter());
+}
+
+std::vector<ValueType> Model::learn(DatasetType& dataset, double regularizerWeight, LearningMonitor* monitor) const
+{
+	if(dataset.getNumberOfModels() == 0)
+		throw std::runtime_error("Cannot learn on a dataset without instances");
+
 	std::cout << "Done setting up dataset, creating learner" << std::endl;
-	opengm::learning::StructMaxMargin<DatasetType>::Parameter learnerParam;
-	opengm::learning::StructMaxMargin<DatasetType> learner(dataset, learnerParam);
+	typedef opengm::learning::BundleOptimizer<ValueType> BundleOptimizerType;
+	BundleOptimizerType::Parameter bundleParam;
+	bundleParam.lambda = regularizerWeight;
+	BundleOptimizerType bundleOptimizer(bundleParam);
+
+	// without a given monitor we still want to see the timing summary
+	LearningMonitor defaultMonitor;
+	if(monitor == nullptr)
+		monitor = &defaultMonitor;
+	monitor->setRegularizerWeight(regularizerWeight);
 
 #ifdef WITH_CPLEX
 	typedef opengm::LPCplex2<GraphicalModelType, opengm::Minimizer> OptimizerType;
@@ -209,20 +351,184 @@ std::vector<ValueType> Model::learn()
 	optimizerParam.numberOfThreads_ = settings_->optimizerNumThreads_;
 
 	std::cout << "Calling learn()..." << std::endl;
-	learner.learn<OptimizerType>(optimizerParam); 
+	// this is what StructMaxMargin::learn does, but with an oracle that reports to the monitor
+	LearningOracle<OptimizerType> oracle(dataset, optimizerParam, *monitor);
+	WeightsType finalWeights = dataset.getWeights();
+	opengm::learning::OptimizerResult result = bundleOptimizer.optimize(oracle, finalWeights);
+	monitor->finish(finalWeights);
+
+	if(result == opengm::learning::Error)
+		throw std::runtime_error("Bundle optimizer did not succeed");
+	else if(result == opengm::learning::ReachedSteps)
+		std::cout << "Bundle optimizer stopped after the maximal number of iterations" << std::endl;
+
 	std::cout << "extracting weights" << std::endl;
-	const WeightsType& finalWeights = learner.getWeights();
 	std::vector<double> resultWeights;
 	for(size_t i = 0; i < finalWeights.numberOfWeights(); ++i)
 		resultWeights.push_back(finalWeights.getWeight(i));
 	return resultWeights;
 }
 
+double Model::computeLoss(const Solution& sol, const Solution& gt) const
+{
+	if(sol.size() != model_.numberOfVariables() || gt.size() != model_.numberOfVariables())
+		throw std::runtime_error("Solution and ground truth must have one entry per variable of the OpenGM model");
+
+	LossType loss(getLossParameter());
+	return loss.loss(model_, sol.begin(), sol.end(), gt.begin(), gt.end());
+}
+
+LossType::Parameter Model::getLossParameter() const
+{
+	LossType::Parameter param;
+	param.useStateDistance_ = settings_->trackingAwareLoss_;
+	param.nodeLossMultiplier_.resize(model_.numberOfVariables(), 1.0);
+
+	auto setLossWeight = [&](int variable, double lossWeight)
+	{
+		if(variable >= 0)
+			param.nodeLossMultiplier_[variable] = lossWeight;
+	};
+
+	for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
+	{
+		setLossWeight(graph_.getDetectionVariable(s), settings_->detectionLossWeight_);
+		setLossWeight(graph_.getDivisionVariable(s), settings_->divisionLossWeight_);
+		setLossWeight(graph_.getAppearanceVariable(s), settings_->appearanceLossWeight_);
+		setLossWeight(graph_.getDisappearanceVariable(s), settings_->disappearanceLossWeight_);
+	}
+
+	for(size_t d = 0; d < graph_.getNumDivisions(); ++d)
+		setLossWeight(graph_.getExternalDivisionVariable(d), settings_->divisionLossWeight_);
+
+	for(size_t l = 0; l < graph_.getNumLinks(); ++l)
+		setLossWeight(graph_.getLinkVariable(l), settings_->linkLossWeight_);
+
+	return param;
+}
+
+void Model::setFeatureNormalization(std::shared_ptr<FeatureNormalization> normalization)
+{
+	if(featuresNormalized_)
+		throw std::runtime_error("Cannot change the feature normalization after the features were standardized");
+	featureNormalization_ = normalization;
+}
+
+void Model::accumulateFeatureStatistics(VariableClass variableClass, const Variable& variable)
+{
+	// readers that find the settings only after some hypotheses collect statistics until the settings are known
+	if(settings_ && !settings_->standardizeFeatures_)
+		return;
+
+	if(!featureNormalization_)
+		featureNormalization_ = std::make_shared<FeatureNormalization>();
+
+	// a normalization that was given from outside must not be changed
+	if(!featureNormalization_->isFinalized())
+		for(size_t state = 0; state < variable.getNumStates(); ++state)
+			featureNormalization_->accumulate(variableClass, state, variable.getFeatures(state));
+}
+
+void Model::normalizeFeatures()
+{
+	if(!featureNormalization_ || featuresNormalized_)
+		return;
+
+	if(!featureNormalization_->isFinalized())
+		featureNormalization_->finalize(settings_->statesShareWeights_);
+	else if(featureNormalization_->getStatesShareWeights() != settings_->statesShareWeights_)
+		throw std::runtime_error("Feature normalization was computed with a different statesShareWeights setting than the model uses");
+
+	std::cout << "Standardizing features..." << std::endl;
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+		iter->second.normalizeFeatures(*featureNormalization_);
+
+	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end() ; ++iter)
+		iter->second->normalizeFeatures(*featureNormalization_);
+
+	for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end() ; ++iter)
+		iter->second->normalizeFeatures(*featureNormalization_);
+
+	// drop the rows from before the standardization
+	featureStore_.compact();
+	featuresNormalized_ = true;
+}
+
 double Model::evaluateSolution(const Solution& sol) const
 {
 	return model_.evaluate(sol);
 }
 
+size_t Model::getWeightRange(VariableClass variableClass, size_t& numWeights) const
+{
+	// the weights are ordered like the variable classes: links, detections, divisions, appearances, disappearances, external divisions
+	const std::array<size_t, 6> numWeightsPerClass = {{
+		numLinkWeights_, numDetWeights_, numDivWeights_, numAppWeights_, numDisWeights_, numExternalDivWeights_}};
+	size_t classIndex = static_cast<size_t>(variableClass);
+	numWeights = numWeightsPerClass[classIndex];
+	return std::accumulate(numWeightsPerClass.begin(), numWeightsPerClass.begin() + classIndex, size_t(0));
+}
+
+UnaryEnergies Model::computeUnaryEnergies(const std::vector<ValueType>& weights, size_t numThreads) const
+{
+	const size_t numWeights = numLinkWeights_ + numDetWeights_ + numDivWeights_ + numAppWeights_ + numDisWeights_ + numExternalDivWeights_;
+	if(weights.size() != numWeights)
+		throw std::runtime_error("Number of weights does not match the number of features of the model");
+	if(featureStore_.isReleased())
+		throw std::runtime_error("Cannot compute energies after the features of the hypotheses were released");
+
+	// a model without hypotheses has no variables even after it was initialized
+	if(variables_.size() != model_.numberOfVariables() || (variables_.empty() && !segmentationHypotheses_.empty()))
+		throw std::runtime_error("Model must be initialized before computing unary energies");
+
+	std::vector<size_t> numStates(variables_.size());
+	for(size_t v = 0; v < variables_.size(); ++v)
+		numStates[v] = variables_[v]->getNumStates();
+
+	// every block of variables is one task, the energies of a variable only depend on its own features
+	const size_t blockSize = 4096;
+	const size_t numBlocks = (variables_.size() + blockSize - 1) / blockSize;
+	UnaryEnergies energies(numStates);
+	runInParallel(numBlocks, numThreads, [&](size_t block)
+	{
+		for(size_t v = block * blockSize; v < std::min(variables_.size(), (block + 1) * blockSize); ++v)
+		{
+			size_t numClassWeights = 0;
+			size_t firstWeight = getWeightRange(variableClasses_[v], numClassWeights);
+			variables_[v]->computeEnergies(settings_->statesShareWeights_, weights.data() + firstWeight, numClassWeights,
+				energies.getEnergies(v));
+		}
+	});
+	return energies;
+}
+
+void Model::buildVariableTable()
+{
+	variables_.assign(model_.numberOfVariables(), nullptr);
+	variableClasses_.assign(model_.numberOfVariables(), VariableClass::Link);
+	auto addVariable = [&](const Variable& variable, VariableClass variableClass)
+	{
+		int id = variable.getOpenGMVariableId();
+		if(id < 0)
+			return;
+		variables_[id] = &variable;
+		variableClasses_[id] = variableClass;
+	};
+
+	for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
+		addVariable(iter->second->getVariable(), VariableClass::Link);
+	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
+		addVariable(iter->second->getVariable(), VariableClass::ExternalDivision);
+	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+	{
+		addVariable(iter->second.getDetectionVariable(), VariableClass::Detection);
+		addVariable(iter->second.getDivisionVariable(), VariableClass::Division);
+		addVariable(iter->second.getAppearanceVariable(), VariableClass::Appearance);
+		addVariable(iter->second.getDisappearanceVariable(), VariableClass::Disappearance);
+	}
+	assert(std::find(variables_.begin(), variables_.end(), nullptr) == variables_.end());
+}
+
 bool Model::verifySolution(const Solution& sol) const
 {
 	std::cout << "Checking solution..." << std::endl;
@@ -230,9 +536,9 @@ bool Model::verifySolution(const Solution& sol) const
 	bool valid = true;
 
 	// check that all exclusions are obeyed
-	for(auto iter = exclusionConstraints_.begin(); iter != exclusionConstraints_.end() ; ++iter)
+	for(size_t e = 0; e < graph_.getNumExclusions(); ++e)
 	{
-		if(!iter->verifySolution(sol, segmentationHypotheses_))
+		if(!graph_.verifyExclusion(sol, e, idTable_))
 		{
 			std::cout << "\tFound violated exclusion constraint " << std::endl;
 			valid = false;
@@ -240,9 +546,9 @@ bool Model::verifySolution(const Solution& sol) const
 	}
 
 	// check that flow-conservation + division constraints are satisfied
-	for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+	for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
 	{
-		if(!iter->second.verifySolution(sol))
+		if(!graph_.verifySegmentation(sol, s, idTable_))
 		{
 			std::cout << "\tFound violated flow conservation constraint " << std::endl;
 			valid = false;
@@ -269,15 +575,15 @@ void Model::toDot(const std::string& filename, const Solution* sol) const
 
 	// links
 	for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end() ; ++iter)
-		iter->second->toDot(out_file, sol);
+		iter->second->toDot(out_file, sol, idTable_);
 
 	// divisions
 	for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end() ; ++iter)
-		iter->second->toDot(out_file, sol);
+		iter->second->toDot(out_file, sol, idTable_);
 
 	// exclusions
 	for(auto iter = exclusionConstraints_.begin(); iter != exclusionConstraints_.end() ; ++iter)
-		iter->toDot(out_file);
+		iter->toDot(out_file, idTable_);
 	
     out_file << "}";
 }
@@ -308,42 +614,76 @@ std::vector<std::string> Model::getWeightDescriptions()
 	return descriptions;
 }
 
+SegmentationHypothesis* Model::findSegmentationHypothesis(const IdLabelType& id)
+{
+	IdKey key;
+	if(!idTable_.find(id, key))
+		return nullptr;
+	auto it = segmentationHypotheses_.find(key);
+	return it != segmentationHypotheses_.end() ? &it->second : nullptr;
+}
+
+std::shared_ptr<LinkingHypothesis> Model::findLinkingHypothesis(const IdLabelType& srcId, const IdLabelType& destId) const
+{
+	IdKey srcKey, destKey;
+	if(!idTable_.find(srcId, srcKey) || !idTable_.find(destId, destKey))
+		return nullptr;
+	auto it = linkingHypotheses_.find(std::make_pair(srcKey, destKey));
+	return it != linkingHypotheses_.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<DivisionHypothesis> Model::findDivisionHypothesis(
+	const IdLabelType& parentId,
+	const IdLabelType& childId1,
+	const IdLabelType& childId2) const
+{
+	IdKey parentKey, childKey1, childKey2;
+	if(!idTable_.find(parentId, parentKey) || !idTable_.find(childId1, childKey1) || !idTable_.find(childId2, childKey2))
+		return nullptr;
+
+	// children are stored ordered by their keys
+	if(childKey2 < childKey1)
+		std::swap(childKey1, childKey2);
+	auto it = divisionHypotheses_.find(std::make_tuple(parentKey, childKey1, childKey2));
+	return it != divisionHypotheses_.end() ? it->second : nullptr;
+}
+
 void Model::deduceAppearanceDisappearanceStates(helpers::Solution& solution)
 {
 	// deduce states of appearance and disappearance variables
-    for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end() ; ++iter)
+    for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
     {
-        size_t detValue = solution[iter->second.getDetectionVariable().getOpenGMVariableId()];
+        size_t detValue = solution[graph_.getDetectionVariable(s)];
 
         if(detValue > 0)
         {
             // each variable that has no active incoming links but is active should have its appearance variables set
-            if(iter->second.getNumActiveIncomingLinks(solution) == 0)
+            if(graph_.getNumActiveIncomingLinks(solution, s) == 0)
             {
-                if(iter->second.getAppearanceVariable().getOpenGMVariableId() == -1)
+                if(graph_.getAppearanceVariable(s) == -1)
                 {
-                    std::stringstream s;
-                    s << "Segmentation Hypothesis: " << iter->first << " - GT contains appearing variable that has no appearance features set!";
-                    throw std::runtime_error(s.str());
+                    std::stringstream error;
+                    error << "Segmentation Hypothesis: " << idTable_.getId(graph_.getKey(s)) << " - GT contains appearing variable that has no appearance features set!";
+                    throw std::runtime_error(error.str());
                 }
                 else
                 {
-                    solution[iter->second.getAppearanceVariable().getOpenGMVariableId()] = detValue;
+                    solution[graph_.getAppearanceVariable(s)] = detValue;
                 }
             }
 
             // each variable that has no active outgoing links but is active should have its disappearance variables set
-            if(iter->second.getNumActiveOutgoingLinks(solution) == 0)
+            if(graph_.getNumActiveOutgoingLinks(solution, s) == 0)
             {
-                if(iter->second.getDisappearanceVariable().getOpenGMVariableId() == -1)
+                if(graph_.getDisappearanceVariable(s) == -1)
                 {
-                    std::stringstream s;
-                    s << "Segmentation Hypothesis: " << iter->first << " - GT contains disappearing variable that has no disappearance features set!";
-                    throw std::runtime_error(s.str());
+                    std::stringstream error;
+                    error << "Segmentation Hypothesis: " << idTable_.getId(graph_.getKey(s)) << " - GT contains disappearing variable that has no disappearance features set!";
+                    throw std::runtime_error(error.str());
                 }
                 else
                 {
-                    solution[iter->second.getDisappearanceVariable().getOpenGMVariableId()] = detValue;
+                    solution[graph_.getDisappearanceVariable(s)] = detValue;
                 }
             }
         }
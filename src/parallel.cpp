@@ -0,0 +1,48 @@
+#include "parallel.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <vector>
+#include <algorithm>
+
+namespace helpers
+{
+
+void runInParallel(size_t numTasks, size_t numThreads, const std::function<void(size_t)>& task)
+{
+	if(numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::atomic<size_t> nextTask(0);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto worker = [&]()
+	{
+		for(size_t t = nextTask++; t < numTasks; t = nextTask++)
+		{
+			try
+			{
+				task(t);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if(!error)
+					error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < std::min(numThreads, numTasks); i++)
+		threads.push_back(std::thread(worker));
+	for(auto& thread : threads)
+		thread.join();
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
+} // end namespace helpers
@@ -1,7 +1,7 @@
 #include "segmentationhypothesis.h"
-#include "linkinghypothesis.h"
-#include "divisionhypothesis.h"
+#include "hypothesisgraph.h"
 #include "settings.h"
+#include "factorbuffer.h"
 
 #include <stdexcept>
 
@@ -14,16 +14,31 @@ SegmentationHypothesis::SegmentationHypothesis()
 {}
 
 SegmentationHypothesis::SegmentationHypothesis(
+	helpers::FeatureStore& featureStore,
 	helpers::IdLabelType id, 
 	const helpers::StateFeatureVector& detectionFeatures, 
 	const helpers::StateFeatureVector& divisionFeatures,
 	const helpers::StateFeatureVector& appearanceFeatures,
 	const helpers::StateFeatureVector& disappearanceFeatures):
 	id_(id),
-	detection_(detectionFeatures),
-	division_(divisionFeatures),
-	appearance_(appearanceFeatures),
-	disappearance_(disappearanceFeatures)
+	detection_(featureStore.getArena(VariableClass::Detection), detectionFeatures),
+	division_(featureStore.getArena(VariableClass::Division), divisionFeatures),
+	appearance_(featureStore.getArena(VariableClass::Appearance), appearanceFeatures),
+	disappearance_(featureStore.getArena(VariableClass::Disappearance), disappearanceFeatures)
+{}
+
+SegmentationHypothesis::SegmentationHypothesis(
+	helpers::FeatureStore& featureStore,
+	helpers::IdLabelType id,
+	const helpers::FeatureRowRange& detectionRows,
+	const helpers::FeatureRowRange& divisionRows,
+	const helpers::FeatureRowRange& appearanceRows,
+	const helpers::FeatureRowRange& disappearanceRows):
+	id_(id),
+	detection_(featureStore.getArena(VariableClass::Detection), detectionRows),
+	division_(featureStore.getArena(VariableClass::Division), divisionRows),
+	appearance_(featureStore.getArena(VariableClass::Appearance), appearanceRows),
+	disappearance_(featureStore.getArena(VariableClass::Disappearance), disappearanceRows)
 {}
 
 void SegmentationHypothesis::toDot(std::ostream& stream, const Solution* sol) const
@@ -51,29 +66,52 @@ void SegmentationHypothesis::toDot(std::ostream& stream, const Solution* sol) co
 	stream <<  "]; \n" << std::flush;
 }
 
-void SegmentationHypothesis::addIncomingConstraintToOpenGM(GraphicalModelType& model)
+size_t SegmentationHypothesis::getNumIncomingConstraintVariables(const HypothesisGraph& graph, size_t index) const
+{
+	if(graph.getIncomingLinks(index).empty() && appearance_.getOpenGMVariableId() < 0)
+		return 0;
+
+	return graph.getIncomingLinks(index).size() + graph.getIncomingDivisions(index).size() + 1
+		+ (appearance_.getOpenGMVariableId() >= 0 ? 1 : 0);
+}
+
+size_t SegmentationHypothesis::getNumOutgoingConstraintVariables(const HypothesisGraph& graph, size_t index) const
+{
+	if(graph.getOutgoingLinks(index).empty() && disappearance_.getOpenGMVariableId() < 0)
+		return 0;
+
+	return graph.getOutgoingLinks(index).size() + graph.getOutgoingDivisions(index).size() + 1
+		+ (division_.getOpenGMVariableId() >= 0 ? 1 : 0)
+		+ (disappearance_.getOpenGMVariableId() >= 0 ? 1 : 0);
+}
+
+void SegmentationHypothesis::addIncomingConstraintToOpenGM(const GraphicalModelType& model, FactorBuffer& factors, const HypothesisGraph& graph, size_t index) const
 {
-	if(incomingLinks_.size() == 0 && appearance_.getOpenGMVariableId() < 0)
+	size_t numFactorVariables = getNumIncomingConstraintVariables(graph, index);
+	if(numFactorVariables == 0)
 		return;
 
-	// add constraint for sum of incoming = this label
+	// add constraint for sum of incoming = this label, the sizes are exact for binary variables
 	LinearConstraintFunctionType::LinearConstraintType incomingConsistencyConstraint;
 	std::vector<LabelType> factorVariables;
 	std::vector<LabelType> constraintShape;
+	incomingConsistencyConstraint.reserve(numFactorVariables);
+	factorVariables.reserve(numFactorVariables);
+	constraintShape.reserve(numFactorVariables);
     
     // add all incoming transition variables with positive coefficient
-    for(size_t i = 0; i < incomingLinks_.size(); ++i)
+    for(uint32_t link : graph.getIncomingLinks(index))
     {
     	// indicator variable references the i+1'th argument of the constraint function, and its state 1
-    	addOpenGMVariableStateToConstraint(incomingConsistencyConstraint, incomingLinks_[i]->getVariable().getOpenGMVariableId(),
+    	addOpenGMVariableStateToConstraint(incomingConsistencyConstraint, graph.getLinkVariable(link),
     		1.0, constraintShape, factorVariables, model);
     }
 
     // add all incoming division variables with positive coefficient
-    for(size_t i = 0; i < incomingDivisions_.size(); ++i)
+    for(uint32_t division : graph.getIncomingDivisions(index))
     {
     	// indicator variable references the i+1'th argument of the constraint function, and its state 1
-    	addOpenGMVariableStateToConstraint(incomingConsistencyConstraint, incomingDivisions_[i]->getVariable().getOpenGMVariableId(),
+    	addOpenGMVariableStateToConstraint(incomingConsistencyConstraint, graph.getExternalDivisionVariable(division),
     		1.0, constraintShape, factorVariables, model);
     }
 
@@ -91,32 +129,36 @@ void SegmentationHypothesis::addIncomingConstraintToOpenGM(GraphicalModelType& m
     incomingConsistencyConstraint.setBound( 0 );
     incomingConsistencyConstraint.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::Equal);
 
-    addConstraintToOpenGMModel(incomingConsistencyConstraint, constraintShape, factorVariables, model);
+    addConstraintToOpenGMModel(incomingConsistencyConstraint, constraintShape, factorVariables, factors);
 }
 
-void SegmentationHypothesis::addOutgoingConstraintToOpenGM(GraphicalModelType& model)
+void SegmentationHypothesis::addOutgoingConstraintToOpenGM(const GraphicalModelType& model, FactorBuffer& factors, const HypothesisGraph& graph, size_t index) const
 {
-	if(outgoingLinks_.size() == 0 && disappearance_.getOpenGMVariableId() < 0)
+	size_t numFactorVariables = getNumOutgoingConstraintVariables(graph, index);
+	if(numFactorVariables == 0)
 		return;
 
-	// add constraint for sum of ougoing = this label + division
+	// add constraint for sum of ougoing = this label + division, the sizes are exact for binary variables
 	LinearConstraintFunctionType::LinearConstraintType outgoingConsistencyConstraint;
 	std::vector<LabelType> factorVariables;
 	std::vector<LabelType> constraintShape;
+	outgoingConsistencyConstraint.reserve(numFactorVariables);
+	factorVariables.reserve(numFactorVariables);
+	constraintShape.reserve(numFactorVariables);
     
     // add all outgoing transition variables with positive coefficient
-    for(size_t i = 0; i < outgoingLinks_.size(); ++i)
+    for(uint32_t link : graph.getOutgoingLinks(index))
     {
     	// indicator variable references the i+2'nd argument of the constraint function, and its state 1
-        addOpenGMVariableStateToConstraint(outgoingConsistencyConstraint, outgoingLinks_[i]->getVariable().getOpenGMVariableId(),
+        addOpenGMVariableStateToConstraint(outgoingConsistencyConstraint, graph.getLinkVariable(link),
     		1.0, constraintShape, factorVariables, model);
     }
 
     // outgoing division variables take one unit of flow as well
-    for(size_t i = 0; i < outgoingDivisions_.size(); ++i)
+    for(uint32_t division : graph.getOutgoingDivisions(index))
     {
     	// indicator variable references the i+1'th argument of the constraint function, and its state 1
-    	addOpenGMVariableStateToConstraint(outgoingConsistencyConstraint, outgoingDivisions_[i]->getVariable().getOpenGMVariableId(),
+    	addOpenGMVariableStateToConstraint(outgoingConsistencyConstraint, graph.getExternalDivisionVariable(division),
     		1.0, constraintShape, factorVariables, model);
     }
 
@@ -141,10 +183,15 @@ void SegmentationHypothesis::addOutgoingConstraintToOpenGM(GraphicalModelType& m
     outgoingConsistencyConstraint.setBound( 0 );
     outgoingConsistencyConstraint.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::Equal);
 
-    addConstraintToOpenGMModel(outgoingConsistencyConstraint, constraintShape, factorVariables, model);
+    addConstraintToOpenGMModel(outgoingConsistencyConstraint, constraintShape, factorVariables, factors);
 }
 
-void SegmentationHypothesis::addDivisionConstraintToOpenGM(GraphicalModelType& model, bool requireSeparateChildren)
+void SegmentationHypothesis::addDivisionConstraintToOpenGM(
+	const GraphicalModelType& model,
+	FactorBuffer& factors,
+	bool requireSeparateChildren,
+	const HypothesisGraph& graph,
+	size_t index) const
 {
 	if(division_.getOpenGMVariableId() < 0)
 		return;
@@ -164,7 +211,7 @@ void SegmentationHypothesis::addDivisionConstraintToOpenGM(GraphicalModelType& m
     divisionConstraint.setBound( 0 );
     divisionConstraint.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::LessEqual);
 
-    addConstraintToOpenGMModel(divisionConstraint, constraintShape, factorVariables, model);
+    addConstraintToOpenGMModel(divisionConstraint, constraintShape, factorVariables, factors);
     
     if(requireSeparateChildren)
     {
@@ -190,10 +237,13 @@ void SegmentationHypothesis::addDivisionConstraintToOpenGM(GraphicalModelType& m
 	    LinearConstraintFunctionType::LinearConstraintType divisionConstraint2;
 		std::vector<LabelType> factorVariables2;
 		std::vector<LabelType> constraintShape2;
+		divisionConstraint2.reserve(graph.getOutgoingLinks(index).size() + 1);
+		factorVariables2.reserve(graph.getOutgoingLinks(index).size() + 1);
+		constraintShape2.reserve(graph.getOutgoingLinks(index).size() + 1);
 
-		for(auto link : outgoingLinks_)
+		for(uint32_t link : graph.getOutgoingLinks(index))
 	    {
-	    	addOpenGMVariableToConstraint(divisionConstraint2, link->getVariable().getOpenGMVariableId(),
+	    	addOpenGMVariableToConstraint(divisionConstraint2, graph.getLinkVariable(link),
 				1, -1.0, constraintShape2, factorVariables2, model);
 	    }
 
@@ -203,17 +253,20 @@ void SegmentationHypothesis::addDivisionConstraintToOpenGM(GraphicalModelType& m
 	    divisionConstraint2.setBound( 0 );
 	    divisionConstraint2.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::LessEqual);
 
-	    addConstraintToOpenGMModel(divisionConstraint2, constraintShape2, factorVariables2, model);
+	    addConstraintToOpenGMModel(divisionConstraint2, constraintShape2, factorVariables2, factors);
 	}
 }
 
-void SegmentationHypothesis::addExternalDivisionConstraintaToOpenGM(GraphicalModelType& model)
+void SegmentationHypothesis::addExternalDivisionConstraintaToOpenGM(const GraphicalModelType& model, FactorBuffer& factors, const HypothesisGraph& graph, size_t index) const
 {
 	LinearConstraintFunctionType::LinearConstraintType onlyOneDivisionConstraint;
 	std::vector<LabelType> onlyOneFactorVariables;
 	std::vector<LabelType> onlyOneConstraintShape;
+	onlyOneDivisionConstraint.reserve(graph.getOutgoingDivisions(index).size());
+	onlyOneFactorVariables.reserve(graph.getOutgoingDivisions(index).size());
+	onlyOneConstraintShape.reserve(graph.getOutgoingDivisions(index).size());
 
-	for(auto division : outgoingDivisions_)
+	for(uint32_t division : graph.getOutgoingDivisions(index))
 	{
 		// add constraint for sum of ougoing = this label + division
 		LinearConstraintFunctionType::LinearConstraintType divisionConstraint;
@@ -221,7 +274,7 @@ void SegmentationHypothesis::addExternalDivisionConstraintaToOpenGM(GraphicalMod
 		std::vector<LabelType> constraintShape;
 
 		// add this variable's state with negative coefficient
-		addOpenGMVariableToConstraint(divisionConstraint, division->getVariable().getOpenGMVariableId(),
+		addOpenGMVariableToConstraint(divisionConstraint, graph.getExternalDivisionVariable(division),
 			1, 1.0, constraintShape, factorVariables, model);
 
 		addOpenGMVariableToConstraint(divisionConstraint, detection_.getOpenGMVariableId(),
@@ -230,10 +283,10 @@ void SegmentationHypothesis::addExternalDivisionConstraintaToOpenGM(GraphicalMod
 	    divisionConstraint.setBound( 0 );
 	    divisionConstraint.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::LessEqual);
 
-	    addConstraintToOpenGMModel(divisionConstraint, constraintShape, factorVariables, model);
+	    addConstraintToOpenGMModel(divisionConstraint, constraintShape, factorVariables, factors);
 
 	    // save variable reference for overall constraint
-	    addOpenGMVariableToConstraint(onlyOneDivisionConstraint, division->getVariable().getOpenGMVariableId(),
+	    addOpenGMVariableToConstraint(onlyOneDivisionConstraint, graph.getExternalDivisionVariable(division),
 			1, 1.0, onlyOneConstraintShape, onlyOneFactorVariables, model);
 	}
 
@@ -241,23 +294,24 @@ void SegmentationHypothesis::addExternalDivisionConstraintaToOpenGM(GraphicalMod
 	{
 		onlyOneDivisionConstraint.setBound(1);
 		onlyOneDivisionConstraint.setConstraintOperator(LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::LessEqual);
-		addConstraintToOpenGMModel(onlyOneDivisionConstraint, onlyOneConstraintShape, onlyOneFactorVariables, model);
+		addConstraintToOpenGMModel(onlyOneDivisionConstraint, onlyOneConstraintShape, onlyOneFactorVariables, factors);
 	}
 }
 
-void SegmentationHypothesis::addExclusionConstraintToOpenGM(GraphicalModelType& model, int openGMVarA, int openGMVarB)
+void SegmentationHypothesis::addExclusionConstraintToOpenGM(const GraphicalModelType& model, FactorBuffer& factors, int openGMVarA, int openGMVarB) const
 {
-	addConstraintToOpenGM(model, openGMVarA, openGMVarB, 0, 0, 1, LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::GreaterEqual);
+	addConstraintToOpenGM(model, factors, openGMVarA, openGMVarB, 0, 0, 1, LinearConstraintFunctionType::LinearConstraintType::LinearConstraintOperatorType::GreaterEqual);
 }
 
 void SegmentationHypothesis::addConstraintToOpenGM(
-	GraphicalModelType& model, 
+	const GraphicalModelType& model, 
+	FactorBuffer& factors,
 	int openGMVarA, 
 	int openGMVarB, 
 	size_t stateA, 
 	size_t stateB, 
 	size_t bound, 
-	opengm::LinearConstraintTraits::LinearConstraintOperator::ValueType op)
+	opengm::LinearConstraintTraits::LinearConstraintOperator::ValueType op) const
 {
 	if(openGMVarA < 0 || openGMVarB < 0)
 		return;
@@ -283,204 +337,123 @@ void SegmentationHypothesis::addConstraintToOpenGM(
     exclusionConstraint.setBound( bound );
     exclusionConstraint.setConstraintOperator(op);
 
-    addConstraintToOpenGMModel(exclusionConstraint, constraintShape, factorVariables, model);
+    addConstraintToOpenGMModel(exclusionConstraint, constraintShape, factorVariables, factors);
+}
+
+void SegmentationHypothesis::addVariablesToOpenGMModel(GraphicalModelType& model, const HypothesisGraph& graph, size_t index)
+{
+	detection_.addToOpenGM(model);
+	if(detection_.getOpenGMVariableId() < 0)
+		throw std::runtime_error("Detection variable must have some features!");
+
+	// only add division node if there are outgoing links
+	if(graph.getOutgoingLinks(index).size() > 1)
+		division_.addToOpenGM(model);
+
+	appearance_.addToOpenGM(model);
+	disappearance_.addToOpenGM(model);
 }
 
 void SegmentationHypothesis::addToOpenGMModel(
-	GraphicalModelType& model, 
+	const GraphicalModelType& model, 
+	FactorBuffer& factors,
 	WeightsType& weights, 
 	std::shared_ptr<Settings> settings,
 	const std::vector<size_t>& detectionWeightIds,
 	const std::vector<size_t>& divisionWeightIds,
 	const std::vector<size_t>& appearanceWeightIds,
-	const std::vector<size_t>& disappearanceWeightIds)
+	const std::vector<size_t>& disappearanceWeightIds,
+	const HypothesisGraph& graph,
+	size_t index,
+	const UnaryEnergies* energies) const
 {
 	if(!settings)
 		throw std::runtime_error("Settings object cannot be nullptr");
 
-	detection_.addToOpenGM(model, settings->statesShareWeights_, weights, detectionWeightIds);
-	if(detection_.getOpenGMVariableId() < 0)
-		throw std::runtime_error("Detection variable must have some features!");
-
-	// only add division node if there are outgoing links
-	if(outgoingLinks_.size() > 1)
-		division_.addToOpenGM(model, settings->statesShareWeights_, weights, divisionWeightIds);
-
-	appearance_.addToOpenGM(model, settings->statesShareWeights_, weights, appearanceWeightIds);
-	disappearance_.addToOpenGM(model, settings->statesShareWeights_, weights, disappearanceWeightIds);
-
-	sortByOpenGMVariableId(incomingLinks_);
-	sortByOpenGMVariableId(outgoingLinks_);
-	sortByOpenGMVariableId(incomingDivisions_);
-	sortByOpenGMVariableId(outgoingDivisions_);
+	// the unaries of variables that were not added to the model are skipped
+	detection_.addUnaryToOpenGM(factors, settings->statesShareWeights_, weights, detectionWeightIds, energies);
+	division_.addUnaryToOpenGM(factors, settings->statesShareWeights_, weights, divisionWeightIds, energies);
+	appearance_.addUnaryToOpenGM(factors, settings->statesShareWeights_, weights, appearanceWeightIds, energies);
+	disappearance_.addUnaryToOpenGM(factors, settings->statesShareWeights_, weights, disappearanceWeightIds, energies);
 
-	addIncomingConstraintToOpenGM(model);
-	addOutgoingConstraintToOpenGM(model);
-	addDivisionConstraintToOpenGM(model, settings->requireSeparateChildrenOfDivision_);
-	addExternalDivisionConstraintaToOpenGM(model);
+	// the links and divisions of the graph are already ordered by their variable ids, as OpenGM needs it
+	addIncomingConstraintToOpenGM(model, factors, graph, index);
+	addOutgoingConstraintToOpenGM(model, factors, graph, index);
+	addDivisionConstraintToOpenGM(model, factors, settings->requireSeparateChildrenOfDivision_, graph, index);
+	addExternalDivisionConstraintaToOpenGM(model, factors, graph, index);
 
 	// add transition exclusion constraints in the multilabel case:
 	if(detection_.getNumStates() > 1)
 	{
 		if(appearance_.getOpenGMVariableId() >= 0 && settings->allowPartialMergerAppearance_ == false)
 		{
-			for(auto link : incomingLinks_)
-				addExclusionConstraintToOpenGM(model, appearance_.getOpenGMVariableId(), link->getVariable().getOpenGMVariableId());
+			for(uint32_t link : graph.getIncomingLinks(index))
+				addExclusionConstraintToOpenGM(model, factors, appearance_.getOpenGMVariableId(), graph.getLinkVariable(link));
 		}
 
 		if(disappearance_.getOpenGMVariableId() >= 0)
 		{
 			if(settings->allowPartialMergerAppearance_ == false)
 			{
-				for(auto link : outgoingLinks_)
-					addExclusionConstraintToOpenGM(model, disappearance_.getOpenGMVariableId(), link->getVariable().getOpenGMVariableId());
+				for(uint32_t link : graph.getOutgoingLinks(index))
+					addExclusionConstraintToOpenGM(model, factors, disappearance_.getOpenGMVariableId(), graph.getLinkVariable(link));
 			}
 
 			if(division_.getOpenGMVariableId() >= 0)
-				addExclusionConstraintToOpenGM(model, disappearance_.getOpenGMVariableId(), division_.getOpenGMVariableId());
+				addExclusionConstraintToOpenGM(model, factors, disappearance_.getOpenGMVariableId(), division_.getOpenGMVariableId());
 		}
 	}
 }
 
-void SegmentationHypothesis::addIncomingLink(std::shared_ptr<LinkingHypothesis> link)
-{
-	if(detection_.getOpenGMVariableId() >= 0)
-		throw std::runtime_error("Links must be added before the segmentation hypothesis is added to the OpenGM model");
-	if(link)
-		incomingLinks_.push_back(link);
-
-}
-
-void SegmentationHypothesis::addOutgoingLink(std::shared_ptr<LinkingHypothesis> link)
+void SegmentationHypothesis::countOpenGMConstraints(
+	std::shared_ptr<Settings> settings,
+	const HypothesisGraph& graph,
+	size_t index,
+	FactorCounts& counts) const
 {
-	if(detection_.getOpenGMVariableId() >= 0)
-		throw std::runtime_error("Links must be added before the segmentation hypothesis is added to the OpenGM model");
-	if(link)
-		outgoingLinks_.push_back(link);
-}
+	if(!settings)
+		throw std::runtime_error("Settings object cannot be nullptr");
 
-void SegmentationHypothesis::addIncomingDivision(std::shared_ptr<DivisionHypothesis> division)
-{
-	if(division_.getOpenGMVariableId() >= 0)
-		throw std::runtime_error("Cannot add external division hypothesis if it is included in detection already!");
-	if(division)
-		incomingDivisions_.push_back(division);
-}
+	// the same constraints as in addToOpenGMModel(), in the same order
+	if(size_t numFactorVariables = getNumIncomingConstraintVariables(graph, index))
+		counts.addConstraint(numFactorVariables);
+	if(size_t numFactorVariables = getNumOutgoingConstraintVariables(graph, index))
+		counts.addConstraint(numFactorVariables);
 
-void SegmentationHypothesis::addOutgoingDivision(std::shared_ptr<DivisionHypothesis> division)
-{
 	if(division_.getOpenGMVariableId() >= 0)
-		throw std::runtime_error("Cannot add external division hypothesis if it is included in detection already!");
-	if(division)
-		outgoingDivisions_.push_back(division);
-}
-
-size_t SegmentationHypothesis::getNumActiveIncomingLinks(const Solution& sol) const
-{
-	size_t sum = 0;
-	for(auto link : incomingLinks_)
-	{
-		if(link->getVariable().getOpenGMVariableId() < 0)
-			throw std::runtime_error("Cannot compute sum of active links if they have not been added to opengm");
-		sum += sol[link->getVariable().getOpenGMVariableId()];
-	}
-	
-	for(auto division : incomingDivisions_)
-	{
-		if(division->getVariable().getOpenGMVariableId() < 0)
-			throw std::runtime_error("Cannot compute sum of active incoming divisions if they have not been added to opengm");
-		sum += sol[division->getVariable().getOpenGMVariableId()];
-	}
-
-	return sum;
-}
-
-size_t SegmentationHypothesis::getNumActiveOutgoingLinks(const Solution& sol) const
-{
-	size_t sum = 0;
-	for(auto link : outgoingLinks_)
 	{
-		if(link->getVariable().getOpenGMVariableId() < 0)
-			throw std::runtime_error("Cannot compute sum of active links if they have not been added to opengm");
-		sum += sol[link->getVariable().getOpenGMVariableId()];
+		counts.addConstraint(2);
+		if(settings->requireSeparateChildrenOfDivision_)
+			counts.addConstraint(graph.getOutgoingLinks(index).size() + 1);
 	}
 
-	for(auto division : outgoingDivisions_)
-	{
-		if(division->getVariable().getOpenGMVariableId() < 0)
-			throw std::runtime_error("Cannot compute sum of active outgoing divisions if they have not been added to opengm");
-		sum += sol[division->getVariable().getOpenGMVariableId()];
-	}
+	for(size_t i = 0; i < graph.getOutgoingDivisions(index).size(); ++i)
+		counts.addConstraint(2);
+	if(!graph.getOutgoingDivisions(index).empty())
+		counts.addConstraint(graph.getOutgoingDivisions(index).size());
 
-	return sum;
-}
-
-bool SegmentationHypothesis::verifySolution(const Solution& sol) const
-{
-	size_t ownValue = sol[detection_.getOpenGMVariableId()];
-	size_t divisionValue = 0;
-	if(division_.getOpenGMVariableId() >=0) 
-		divisionValue = sol[division_.getOpenGMVariableId()];
-	
-	//--------------------------------
-	// check incoming
-	size_t sumIncoming = getNumActiveIncomingLinks(sol);
-
-	if(appearance_.getOpenGMVariableId() >= 0)
+	if(detection_.getNumStates() > 1)
 	{
-		if(sol[appearance_.getOpenGMVariableId()] > 0 && sumIncoming > 0)
+		if(appearance_.getOpenGMVariableId() >= 0 && settings->allowPartialMergerAppearance_ == false)
 		{
-			std::cout << "At node " << id_ << ": there are active incoming transitions and active appearances!" << std::endl;
-			return false;
+			for(uint32_t link : graph.getIncomingLinks(index))
+				if(graph.getLinkVariable(link) >= 0)
+					counts.addConstraint(2);
 		}
-		sumIncoming += sol[appearance_.getOpenGMVariableId()];
-	}
-
-	if(incomingLinks_.size() > 0 && sumIncoming != ownValue)
-	{
-		std::cout << "At node " << id_ << ": incoming=" << sumIncoming << " is NOT EQUAL to " << ownValue << std::endl;
-		std::cout << "(division = " << divisionValue << ")" << std::endl;
-		return false;
-	}
-
-	//--------------------------------
-	// check outgoing
-	size_t sumOutgoing = getNumActiveOutgoingLinks(sol);
 
-	if(disappearance_.getOpenGMVariableId() >= 0)
-	{
-		if(sol[disappearance_.getOpenGMVariableId()] > 0 && sumOutgoing > 0)
+		if(disappearance_.getOpenGMVariableId() >= 0)
 		{
-			std::cout << "At node " << id_ << ": there are active outgoing transitions and active disappearances!" << std::endl;
-			return false;
-		}
-		sumOutgoing += sol[disappearance_.getOpenGMVariableId()];
-	}
-
-	if(outgoingLinks_.size() > 0 && sumOutgoing != ownValue + divisionValue)
-	{
-		std::cout << "At node " << id_ << ": outgoing=" << sumOutgoing << " is NOT EQUAL to " << ownValue << " + " << divisionValue << " (own+div)" << std::endl;
-		return false;
-	}
-
-	//--------------------------------
-	// check divisions
-	if(divisionValue > ownValue)
-	{
-		std::cout << "At node " << id_ << ": division > value: " << divisionValue << " > " << ownValue << " -> INVALID!" << std::endl;
-		return false;
-	}
-
+			if(settings->allowPartialMergerAppearance_ == false)
+			{
+				for(uint32_t link : graph.getOutgoingLinks(index))
+					if(graph.getLinkVariable(link) >= 0)
+						counts.addConstraint(2);
+			}
 
-	//--------------------------------
-	// check division vs disappearance
-	if(disappearance_.getOpenGMVariableId() >= 0 && (divisionValue > 0 && sol[disappearance_.getOpenGMVariableId()] > 0))
-	{
-		std::cout << "At node " << id_ << ": division and disappearance are BOTH active -> INVALID!" << std::endl;
-		return false;
+			if(division_.getOpenGMVariableId() >= 0)
+				counts.addConstraint(2);
+		}
 	}
-
-	return true;
 }
 
 } // end namespace mht
@@ -9,7 +9,16 @@ Settings::Settings():
 	requireSeparateChildrenOfDivision_(false),
 	optimizerEpGap_(0.01),
 	optimizerVerbose_(true),
-	optimizerNumThreads_(1)
+	optimizerNumThreads_(1),
+	detectionLossWeight_(1.0),
+	linkLossWeight_(1.0),
+	divisionLossWeight_(1.0),
+	appearanceLossWeight_(1.0),
+	disappearanceLossWeight_(1.0),
+	trackingAwareLoss_(false),
+	standardizeFeatures_(false),
+	mergeExclusionCliques_(false),
+	maxExclusionCliqueSize_(16)
 {}
 
 Settings::Settings(const Json::Value& entry)
@@ -43,6 +52,51 @@ Settings::Settings(const Json::Value& entry)
 		optimizerNumThreads_ = entry[JsonTypeNames[JsonTypes::OptimizerNumThreads]].asUInt();
 	else 
 		optimizerNumThreads_ = 1;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::DetectionLossWeight]))
+		detectionLossWeight_ = entry[JsonTypeNames[JsonTypes::DetectionLossWeight]].asDouble();
+	else 
+		detectionLossWeight_ = 1.0;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::LinkLossWeight]))
+		linkLossWeight_ = entry[JsonTypeNames[JsonTypes::LinkLossWeight]].asDouble();
+	else 
+		linkLossWeight_ = 1.0;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::DivisionLossWeight]))
+		divisionLossWeight_ = entry[JsonTypeNames[JsonTypes::DivisionLossWeight]].asDouble();
+	else 
+		divisionLossWeight_ = 1.0;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::AppearanceLossWeight]))
+		appearanceLossWeight_ = entry[JsonTypeNames[JsonTypes::AppearanceLossWeight]].asDouble();
+	else 
+		appearanceLossWeight_ = 1.0;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::DisappearanceLossWeight]))
+		disappearanceLossWeight_ = entry[JsonTypeNames[JsonTypes::DisappearanceLossWeight]].asDouble();
+	else 
+		disappearanceLossWeight_ = 1.0;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::TrackingAwareLoss]))
+		trackingAwareLoss_ = entry[JsonTypeNames[JsonTypes::TrackingAwareLoss]].asBool();
+	else 
+		trackingAwareLoss_ = false;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::StandardizeFeatures]))
+		standardizeFeatures_ = entry[JsonTypeNames[JsonTypes::StandardizeFeatures]].asBool();
+	else 
+		standardizeFeatures_ = false;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::MergeExclusionCliques]))
+		mergeExclusionCliques_ = entry[JsonTypeNames[JsonTypes::MergeExclusionCliques]].asBool();
+	else 
+		mergeExclusionCliques_ = false;
+
+	if(entry.isMember(JsonTypeNames[JsonTypes::MaxExclusionCliqueSize]))
+		maxExclusionCliqueSize_ = entry[JsonTypeNames[JsonTypes::MaxExclusionCliqueSize]].asUInt();
+	else 
+		maxExclusionCliqueSize_ = 16;
 }
 
 void Settings::saveToJson(Json::Value& entry)
@@ -53,6 +107,15 @@ void Settings::saveToJson(Json::Value& entry)
 	entry[JsonTypeNames[JsonTypes::OptimizerEpGap]] = Json::Value(optimizerEpGap_);
 	entry[JsonTypeNames[JsonTypes::OptimizerVerbose]] = Json::Value(optimizerVerbose_);
 	entry[JsonTypeNames[JsonTypes::OptimizerNumThreads]] = Json::Value((int)optimizerNumThreads_);
+	entry[JsonTypeNames[JsonTypes::DetectionLossWeight]] = Json::Value(detectionLossWeight_);
+	entry[JsonTypeNames[JsonTypes::LinkLossWeight]] = Json::Value(linkLossWeight_);
+	entry[JsonTypeNames[JsonTypes::DivisionLossWeight]] = Json::Value(divisionLossWeight_);
+	entry[JsonTypeNames[JsonTypes::AppearanceLossWeight]] = Json::Value(appearanceLossWeight_);
+	entry[JsonTypeNames[JsonTypes::DisappearanceLossWeight]] = Json::Value(disappearanceLossWeight_);
+	entry[JsonTypeNames[JsonTypes::TrackingAwareLoss]] = Json::Value(trackingAwareLoss_);
+	entry[JsonTypeNames[JsonTypes::StandardizeFeatures]] = Json::Value(standardizeFeatures_);
+	entry[JsonTypeNames[JsonTypes::MergeExclusionCliques]] = Json::Value(mergeExclusionCliques_);
+	entry[JsonTypeNames[JsonTypes::MaxExclusionCliqueSize]] = Json::Value((int)maxExclusionCliqueSize_);
 }
 
 void Settings::print()
@@ -65,6 +128,12 @@ void Settings::print()
 		<< "\n\tOptimizerEpGap: " << optimizerEpGap_
 		<< "\n\tOptimizerVerbose: " << (optimizerVerbose_ ? "true" : "false")
 		<< "\n\tOptimizerNumThreads: " << optimizerNumThreads_
+		<< "\n\tLossWeights (det/link/div/app/dis): " << detectionLossWeight_ << "/" << linkLossWeight_ << "/" 
+			<< divisionLossWeight_ << "/" << appearanceLossWeight_ << "/" << disappearanceLossWeight_
+		<< "\n\tTrackingAwareLoss: " << (trackingAwareLoss_ ? "true" : "false")
+		<< "\n\tStandardizeFeatures: " << (standardizeFeatures_ ? "true" : "false")
+		<< "\n\tMergeExclusionCliques: " << (mergeExclusionCliques_ ? "true" : "false")
+		<< "\n\tMaxExclusionCliqueSize: " << maxExclusionCliqueSize_
 		<< "\n************************"
 		<< std::endl;
 }
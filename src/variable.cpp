@@ -1,5 +1,7 @@
 #include "variable.h"
 #include "helpers.h"
+#include "factorbuffer.h"
+#include "unaryenergies.h"
 
 #include <opengm/datastructures/marray/marray.hxx>
 
@@ -8,26 +10,48 @@ using namespace helpers;
 namespace mht
 {
 
-void Variable::addToOpenGM(
-	GraphicalModelType& model, 
-	bool statesShareWeights,
-	WeightsType& weights, 
-	const std::vector<size_t>& weightIds)
+void Variable::addToOpenGM(GraphicalModelType& model)
 {
 	// only add variable if there are any features
-	if(features_.size() == 0 || features_[0].size() == 0)
+	if(numStates_ == 0 || getNumFeatures(0) == 0)
 		return;
 
 	// Add variable to model. All Variables are binary!
-	size_t numStates = getNumStates();
-	model.addVariable(numStates);
+	model.addVariable(getNumStates());
 	openGMVariableId_ = model.numberOfVariables() - 1;
+}
+
+void Variable::addUnaryToOpenGM(
+	FactorBuffer& factors, 
+	bool statesShareWeights,
+	WeightsType& weights, 
+	const std::vector<size_t>& weightIds,
+	const UnaryEnergies* energies) const
+{
+	if(openGMVariableId_ < 0)
+		return;
+
+	size_t numStates = getNumStates();
 	assert((int)weightIds.size() == getNumWeights(statesShareWeights));
 
-	if(statesShareWeights)
+	if(energies != nullptr)
+	{
+		const ValueType* stateEnergies = energies->getEnergies(openGMVariableId_);
+		std::vector<size_t> functionShape(1, numStates);
+		std::vector<size_t> coords(1, 0);
+		ExplicitFunctionType unary(functionShape.begin(), functionShape.end(), 0.0);
+		for(size_t state = 0; state < numStates; ++state)
+		{
+			coords[0] = state;
+			unary(coords.begin()) = stateEnergies[state];
+		}
+
+		factors.addFactor(unary, &openGMVariableId_, &openGMVariableId_+1);
+	}
+	else if(statesShareWeights)
 	{
 		// if we want to use the weights more than once, the construction is a bit more involved than in the else-branch
-		size_t numFeatures = features_[0].size();
+		size_t numFeatures = getNumFeatures(0);
 		std::vector<marray::Marray<double>> features; // for each feature, there will be its own Marray (which is a column for a unary)
 		std::vector<size_t> coords(1, 0); // coordinate into a feature column
 
@@ -39,7 +63,7 @@ void Variable::addToOpenGM(
 	        for(size_t state = 0; state < numStates; ++state)
 	        {
 	        	coords[0] = state;
-	        	featureColumn(coords.begin()) = features_[state][i];
+	        	featureColumn(coords.begin()) = getFeatures(state)[i];
 	        }
 
 	        features.push_back(featureColumn);
@@ -47,8 +71,7 @@ void Variable::addToOpenGM(
 
 	    std::vector<size_t> functionShape(1, numStates);
 	    LearnableWeightedSumOfFuncType unary(functionShape, weights, weightIds, features);
-		GraphicalModelType::FunctionIdentifier fid = model.addFunction(unary);
-		model.addFactor(fid, &openGMVariableId_, &openGMVariableId_+1);
+		factors.addFactor(unary, &openGMVariableId_, &openGMVariableId_+1);
 	}
 	else
 	{
@@ -62,8 +85,9 @@ void Variable::addToOpenGM(
 		{
 			FeaturesAndIndicesType featureAndIndex;
 
-			featureAndIndex.features = features_[state];
-			for(size_t i = 0; i < features_[state].size(); ++i)
+			FeatureRow stateFeatures = getFeatures(state);
+			featureAndIndex.features.assign(stateFeatures.begin(), stateFeatures.end());
+			for(size_t i = 0; i < stateFeatures.size(); ++i)
 			{
 				featureAndIndex.weightIds.push_back(weightIds[weightIdx++]);
 			}
@@ -72,8 +96,40 @@ void Variable::addToOpenGM(
 		}
 
 		LearnableUnaryFuncType unary(weights, featuresAndWeightsPerLabel);
-		GraphicalModelType::FunctionIdentifier fid = model.addFunction(unary);
-		model.addFactor(fid, &openGMVariableId_, &openGMVariableId_+1);
+		factors.addFactor(unary, &openGMVariableId_, &openGMVariableId_+1);
+	}
+}
+
+std::vector<ValueType> Variable::computeEnergies(
+	bool statesShareWeights,
+	const WeightsType& weights,
+	const std::vector<size_t>& weightIds) const
+{
+	// gather the weights, the ids are consecutive for all states if they do not share weights
+	std::vector<ValueType> weightValues(weightIds.size());
+	for(size_t i = 0; i < weightIds.size(); ++i)
+		weightValues[i] = weights.getWeight(weightIds[i]);
+
+	std::vector<ValueType> energies(numStates_, 0.0);
+	computeEnergies(statesShareWeights, weightValues.data(), weightValues.size(), energies.data());
+	return energies;
+}
+
+void Variable::computeEnergies(
+	bool statesShareWeights,
+	const ValueType* weights,
+	size_t numWeights,
+	ValueType* energies) const
+{
+	size_t weightIdx = 0;
+	for(size_t state = 0; state < numStates_; ++state)
+	{
+		FeatureRow stateFeatures = arena_->getRow(firstRow_ + state);
+		if(weightIdx + stateFeatures.size() > numWeights)
+			throw std::runtime_error("Variable has more features than weights");
+		energies[state] = dotProduct(stateFeatures.data(), weights + weightIdx, stateFeatures.size());
+		if(!statesShareWeights)
+			weightIdx += stateFeatures.size();
 	}
 }
 
@@ -81,22 +137,20 @@ const int Variable::getNumWeights(bool statesShareWeights) const
 {
 	int numWeights = -1;
 
-	if(features_.size() > 0 && features_.at(0).size() > 0)
+	if(numStates_ > 0 && getNumFeatures(0) > 0)
 	{
 		if(statesShareWeights)
 		{
-			numWeights = features_.at(0).size();
+			numWeights = getNumFeatures(0);
 
 			// sanity check
-			for(size_t i = 1; i < features_.size(); ++i)
-				if((int)features_.at(i).size() != numWeights)
+			for(size_t i = 1; i < numStates_; ++i)
+				if((int)getNumFeatures(i) != numWeights)
 					throw std::runtime_error("Number of features must be equal for all states!");
 		}
 		else
 		{
-			numWeights = 0;
-			for(size_t i = 0; i < features_.size(); ++i)
-				numWeights += features_.at(i).size();
+			numWeights = getNumFeatures();
 		}
 	}
 
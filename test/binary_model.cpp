@@ -0,0 +1,303 @@
+#define BOOST_TEST_MODULE binary_model
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "binarymodel.h"
+
+using namespace mht;
+using namespace helpers;
+
+namespace
+{
+
+const size_t NumSegmentations = 30;
+
+IdLabelType toId(size_t number)
+{
+#ifdef USE_STRING_IDS
+	return std::to_string(number);
+#else
+	return number;
+#endif
+}
+
+Json::Value makeFeatures(size_t numStates, size_t numFeatures, double offset)
+{
+	Json::Value features(Json::arrayValue);
+	for(size_t state = 0; state < numStates; ++state)
+	{
+		Json::Value values(Json::arrayValue);
+		for(size_t i = 0; i < numFeatures; ++i)
+			values.append(offset + state - 0.5 * i);
+		features.append(values);
+	}
+	return features;
+}
+
+/**
+ * @brief A model whose variables have different numbers of states and features, with links, external divisions and exclusions
+ */
+void writeModel(const std::string& filename)
+{
+	Json::Value root;
+	root[JsonTypeNames[JsonTypes::Settings]][JsonTypeNames[JsonTypes::StatesShareWeights]] = true;
+	Json::Value& segmentations = root[JsonTypeNames[JsonTypes::Segmentations]] = Json::Value(Json::arrayValue);
+	Json::Value& links = root[JsonTypeNames[JsonTypes::Links]] = Json::Value(Json::arrayValue);
+	Json::Value& divisions = root[JsonTypeNames[JsonTypes::Divisions]] = Json::Value(Json::arrayValue);
+	Json::Value& exclusions = root[JsonTypeNames[JsonTypes::Exclusions]] = Json::Value(Json::arrayValue);
+
+	for(size_t i = 0; i < NumSegmentations; ++i)
+	{
+		Json::Value segmentation;
+		segmentation[JsonTypeNames[JsonTypes::Id]] = toId(100 + i);
+		segmentation[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2 + i % 2, 1 + i % 3, 0.25 * i);
+		if(i % 3 == 0)
+			segmentation[JsonTypeNames[JsonTypes::AppearanceFeatures]] = makeFeatures(2, 1, 1.0);
+		if(i % 2 == 0)
+			segmentation[JsonTypeNames[JsonTypes::DisappearanceFeatures]] = makeFeatures(2, 2, -0.125 * i);
+		segmentations.append(segmentation);
+
+		if(i + 6 >= NumSegmentations)
+			continue;
+		for(size_t dest : {i + 5, i + 6})
+		{
+			Json::Value link;
+			link[JsonTypeNames[JsonTypes::SrcId]] = toId(100 + i);
+			link[JsonTypeNames[JsonTypes::DestId]] = toId(100 + dest);
+			link[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2 + dest % 2, 2, 0.5 * dest);
+			links.append(link);
+		}
+		if(i % 4 == 0)
+		{
+			Json::Value division;
+			division[JsonTypeNames[JsonTypes::Parent]] = toId(100 + i);
+			division[JsonTypeNames[JsonTypes::Children]].append(toId(100 + i + 6));
+			division[JsonTypeNames[JsonTypes::Children]].append(toId(100 + i + 5));
+			division[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2, 1, 2.0 * i);
+			divisions.append(division);
+		}
+		if(i % 3 == 0)
+		{
+			Json::Value exclusion(Json::arrayValue);
+			for(size_t member = i; member < i + 2 + i % 2; ++member)
+				exclusion.append(toId(100 + member));
+			exclusions.append(exclusion);
+		}
+	}
+
+	std::ofstream file(filename);
+	file << root;
+}
+
+class TestModel : public BinaryModel
+{
+public:
+	/**
+	 * @brief Everything the formats must preserve: ids, features, exclusions and the adjacency of the segmentations
+	 */
+	Json::Value describe()
+	{
+		graph_.build(segmentationHypotheses_, linkingHypotheses_, divisionHypotheses_, exclusionConstraints_, idTable_);
+
+		Json::Value description;
+		for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+		{
+			Json::Value segmentation;
+			segmentation.append(iter->second.getId());
+			segmentation.append(describe(iter->second.getDetectionVariable()));
+			segmentation.append(describe(iter->second.getDivisionVariable()));
+			segmentation.append(describe(iter->second.getAppearanceVariable()));
+			segmentation.append(describe(iter->second.getDisappearanceVariable()));
+			description["segmentations"].append(segmentation);
+		}
+
+		for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
+		{
+			Json::Value link;
+			link.append(idTable_.getId(iter->second->getSrcKey()));
+			link.append(idTable_.getId(iter->second->getDestKey()));
+			link.append(describe(iter->second->getVariable()));
+			description["links"].append(link);
+		}
+
+		for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
+		{
+			Json::Value division;
+			division.append(idTable_.getId(iter->second->getParentKey()));
+			for(IdKey child : iter->second->getChildrenKeys())
+				division.append(idTable_.getId(child));
+			division.append(describe(iter->second->getVariable()));
+			description["divisions"].append(division);
+		}
+
+		for(const ExclusionConstraint& exclusion : exclusionConstraints_)
+		{
+			Json::Value members(Json::arrayValue);
+			for(IdKey key : exclusion.getKeys())
+				members.append(idTable_.getId(key));
+			description["exclusions"].append(members);
+		}
+
+		for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
+		{
+			Json::Value adjacency;
+			adjacency.append(idTable_.getId(graph_.getKey(s)));
+			for(uint32_t link : graph_.getIncomingLinks(s))
+				adjacency.append(idTable_.getId(graph_.getKey(graph_.getLinkSource(link))));
+			for(uint32_t link : graph_.getOutgoingLinks(s))
+				adjacency.append(idTable_.getId(graph_.getKey(graph_.getLinkDestination(link))));
+			for(uint32_t division : graph_.getOutgoingDivisions(s))
+				adjacency.append(idTable_.getId(graph_.getKey(graph_.getDivisionChild(division, 0))));
+			for(uint32_t division : graph_.getIncomingDivisions(s))
+				adjacency.append(idTable_.getId(graph_.getKey(graph_.getDivisionParent(division))));
+			description["adjacency"].append(adjacency);
+		}
+		return description;
+	}
+
+private:
+	static Json::Value describe(const Variable& variable)
+	{
+		Json::Value features(Json::arrayValue);
+		for(size_t state = 0; state < variable.getNumStates(); ++state)
+		{
+			Json::Value values(Json::arrayValue);
+			for(FeatureValueType value : variable.getFeatures(state))
+				values.append(value);
+			features.append(values);
+		}
+		return features;
+	}
+};
+
+std::string readFile(const std::string& filename)
+{
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& filename, const std::string& content)
+{
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	file.write(content.data(), content.size());
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( JsonBinaryJsonRoundTrip )
+{
+	writeModel("binarymodel.json");
+	TestModel jsonModel;
+	jsonModel.readFromFile("binarymodel.json");
+	Json::Value expected = jsonModel.describe();
+	BOOST_REQUIRE_EQUAL(expected["segmentations"].size(), NumSegmentations);
+	BOOST_REQUIRE_EQUAL(expected["links"].size(), 2 * (NumSegmentations - 6));
+	BOOST_REQUIRE_EQUAL(expected["divisions"].size(), 6);
+	BOOST_REQUIRE_EQUAL(expected["exclusions"].size(), 8);
+
+	jsonModel.saveToBinary("binarymodel.bin");
+	BOOST_CHECK(BinaryModel::isBinaryModelFile("binarymodel.bin"));
+	BOOST_CHECK(!BinaryModel::isBinaryModelFile("binarymodel.json"));
+
+	TestModel binaryModel;
+	binaryModel.readFromFile("binarymodel.bin");
+	BOOST_CHECK(binaryModel.describe() == expected);
+	BOOST_CHECK_EQUAL(binaryModel.getSettings()->statesShareWeights_, true);
+
+	binaryModel.saveModelToJson("binarymodel.json");
+	TestModel convertedModel;
+	convertedModel.readFromFile("binarymodel.json");
+	BOOST_CHECK(convertedModel.describe() == expected);
+}
+
+BOOST_AUTO_TEST_CASE( TruncatedFilesThrow )
+{
+	writeModel("binarymodel.json");
+	TestModel jsonModel;
+	jsonModel.readFromFile("binarymodel.json");
+	jsonModel.saveToBinary("binarymodel.bin");
+	std::string content = readFile("binarymodel.bin");
+
+	// the reader prints the settings of every model
+	std::stringstream log;
+	std::streambuf* stdoutBuffer = std::cout.rdbuf(log.rdbuf());
+
+	for(size_t size = 0; size < content.size(); size += 7)
+	{
+		writeFile("binarymodel.bin", content.substr(0, size));
+		TestModel model;
+		BOOST_CHECK_THROW(model.readFromBinary("binarymodel.bin"), std::runtime_error);
+	}
+
+	std::cout.rdbuf(stdoutBuffer);
+}
+
+BOOST_AUTO_TEST_CASE( InvalidFeatureOffsetsThrow )
+{
+	writeModel("binarymodel.json");
+	TestModel jsonModel;
+	jsonModel.readFromFile("binarymodel.json");
+	jsonModel.saveToBinary("binarymodel.bin");
+	std::string content = readFile("binarymodel.bin");
+
+	// the detection features are the first feature matrix, its offsets into the values and the values begin with
+	// those of the first two states of the first segmentation
+	Json::Value description = jsonModel.describe();
+	size_t numDetectionStates = 0;
+	for(const Json::Value& segmentation : description["segmentations"])
+		numDetectionStates += segmentation[1].size();
+	const Json::Value& firstFeatures = description["segmentations"][0][1];
+	std::vector<uint64_t> firstOffsets = {0, firstFeatures[0].size(), firstFeatures[0].size() + firstFeatures[1].size()};
+	std::vector<double> firstValues;
+	for(const Json::Value& stateFeatures : firstFeatures)
+		for(const Json::Value& value : stateFeatures)
+			firstValues.push_back(value.asDouble());
+
+	size_t offsetsBegin = std::string::npos;
+	for(size_t position = 0; position + (numDetectionStates + 1) * sizeof(uint64_t) + firstValues.size() * sizeof(double) <= content.size();
+		position += sizeof(uint64_t))
+	{
+		const char* values = content.data() + position + (numDetectionStates + 1) * sizeof(uint64_t);
+		if(std::memcmp(content.data() + position, firstOffsets.data(), firstOffsets.size() * sizeof(uint64_t)) == 0
+			&& std::memcmp(values, firstValues.data(), firstValues.size() * sizeof(double)) == 0)
+		{
+			offsetsBegin = position;
+			break;
+		}
+	}
+	BOOST_REQUIRE(offsetsBegin != std::string::npos);
+
+	std::stringstream log;
+	std::streambuf* stdoutBuffer = std::cout.rdbuf(log.rdbuf());
+
+	// the features of the first state end behind those of the second state, or behind all values
+	for(uint64_t offset : {firstOffsets[2] + 1, uint64_t(1) << 40})
+	{
+		std::string corrupted = content;
+		std::memcpy(&corrupted[offsetsBegin + sizeof(uint64_t)], &offset, sizeof(uint64_t));
+		writeFile("binarymodel.bin", corrupted);
+
+		TestModel model;
+		try
+		{
+			model.readFromBinary("binarymodel.bin");
+			BOOST_ERROR("Reading invalid feature offsets did not throw");
+		}
+		catch(std::runtime_error& e)
+		{
+			BOOST_CHECK_EQUAL(std::string(e.what()), "Binary model file contains invalid feature offsets");
+		}
+	}
+
+	std::cout.rdbuf(stdoutBuffer);
+}
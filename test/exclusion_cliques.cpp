@@ -0,0 +1,260 @@
+#define BOOST_TEST_MODULE exclusion_cliques
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "hypothesisgraph.h"
+#include "jsonmodel.h"
+
+using namespace mht;
+using namespace helpers;
+
+namespace
+{
+
+typedef std::vector<std::vector<uint32_t> > Cliques;
+
+/**
+ * @return the id of the segmentation with the given number, in the type of the ids of the build
+ */
+IdLabelType toId(size_t number)
+{
+#ifdef USE_STRING_IDS
+	return std::to_string(number);
+#else
+	return number;
+#endif
+}
+
+/**
+ * @brief Build a graph of the given number of segmentations (with ids 0..n-1, interned in this order so that their keys
+ *        are the same numbers) and exclusions, and merge its exclusions
+ * @return the members of the merged exclusions
+ */
+Cliques mergeExclusions(size_t numSegmentations, const std::vector<std::vector<IdKey> >& exclusionKeys, size_t maxCliqueSize)
+{
+	IdTable idTable;
+	HypothesisGraph::SegmentationMap segmentations;
+	for(size_t s = 0; s < numSegmentations; ++s)
+		segmentations[idTable.intern(toId(s))] = SegmentationHypothesis();
+
+	std::vector<ExclusionConstraint> exclusions;
+	for(const std::vector<IdKey>& keys : exclusionKeys)
+		exclusions.push_back(ExclusionConstraint(keys));
+
+	HypothesisGraph graph;
+	graph.build(segmentations, HypothesisGraph::LinkMap(), HypothesisGraph::DivisionMap(), exclusions, idTable);
+	graph.mergeExclusionCliques(maxCliqueSize);
+
+	Cliques cliques;
+	for(size_t e = 0; e < graph.getNumExclusions(); ++e)
+	{
+		HypothesisGraph::IndexRange members = graph.getExclusionMembers(e);
+		cliques.push_back(std::vector<uint32_t>(members.begin(), members.end()));
+	}
+	return cliques;
+}
+
+std::set<std::pair<uint32_t, uint32_t> > getConflicts(const std::vector<std::vector<IdKey> >& exclusions)
+{
+	std::set<std::pair<uint32_t, uint32_t> > conflicts;
+	for(const std::vector<IdKey>& members : exclusions)
+		for(IdKey a : members)
+			for(IdKey b : members)
+				if(a != b)
+					conflicts.insert(std::make_pair(a, b));
+	return conflicts;
+}
+
+bool contains(const std::vector<uint32_t>& clique, uint32_t member)
+{
+	return std::find(clique.begin(), clique.end(), member) != clique.end();
+}
+
+/**
+ * @brief overlapping exclusions of 2 to 5 segmentations that are close to each other
+ */
+std::vector<std::vector<IdKey> > makeExclusions(size_t numSegmentations, size_t numExclusions)
+{
+	std::vector<std::vector<IdKey> > exclusions;
+	unsigned int state = 12345;
+	auto next = [&](unsigned int range)
+	{
+		state = state * 1103515245u + 12345u;
+		return (state >> 16) % range;
+	};
+
+	for(size_t e = 0; e < numExclusions; ++e)
+	{
+		size_t first = next(numSegmentations - 6);
+		size_t numMembers = 2 + next(4);
+		std::vector<IdKey> members;
+		while(members.size() < numMembers)
+		{
+			IdKey member = first + next(6);
+			if(std::find(members.begin(), members.end(), member) == members.end())
+				members.push_back(member);
+		}
+		exclusions.push_back(members);
+	}
+	return exclusions;
+}
+
+/**
+ * @brief A model of detections with the given exclusions, without links, so that only the exclusions restrict the solutions
+ */
+void writeModel(const std::string& filename, const std::vector<std::vector<IdKey> >& exclusions, bool mergeCliques)
+{
+	Json::Value root;
+	root[JsonTypeNames[JsonTypes::Settings]][JsonTypeNames[JsonTypes::MergeExclusionCliques]] = mergeCliques;
+	root[JsonTypeNames[JsonTypes::Settings]][JsonTypeNames[JsonTypes::MaxExclusionCliqueSize]] = 3;
+	for(int id = 0; id < 8; ++id)
+	{
+		Json::Value segmentation;
+		segmentation[JsonTypeNames[JsonTypes::Id]] = toId(id);
+		for(int state = 0; state < 3; ++state)
+			segmentation[JsonTypeNames[JsonTypes::Features]][state].append(1.0 * state);
+		root[JsonTypeNames[JsonTypes::Segmentations]].append(segmentation);
+	}
+	for(const std::vector<IdKey>& members : exclusions)
+	{
+		Json::Value exclusion(Json::arrayValue);
+		for(IdKey member : members)
+			exclusion.append(toId(member));
+		root[JsonTypeNames[JsonTypes::Exclusions]].append(exclusion);
+	}
+
+	std::ofstream file(filename);
+	file << root;
+}
+
+class CliqueModel : public JsonModel
+{
+public:
+	size_t getNumExclusions() const { return graph_.getNumExclusions(); }
+
+	/**
+	 * @return a solution with the given labels of the detections of all segmentations, in the order of their ids
+	 */
+	Solution makeSolution(const std::vector<size_t>& labels) const
+	{
+		Solution sol(model_.numberOfVariables(), 0);
+		for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
+			sol[graph_.getDetectionVariable(s)] = labels[s];
+		return sol;
+	}
+};
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( CliquesCoverAllConflicts )
+{
+	const size_t numSegmentations = 40;
+	std::vector<std::vector<IdKey> > exclusions = makeExclusions(numSegmentations, 60);
+	std::set<std::pair<uint32_t, uint32_t> > conflicts = getConflicts(exclusions);
+
+	for(size_t maxCliqueSize : {0, 3, 4})
+	{
+		Cliques cliques = mergeExclusions(numSegmentations, exclusions, maxCliqueSize);
+		BOOST_CHECK_LT(cliques.size(), exclusions.size());
+
+		// every pair of the original exclusions is part of a clique
+		for(const auto& conflict : conflicts)
+		{
+			bool isCovered = false;
+			for(const std::vector<uint32_t>& clique : cliques)
+				isCovered = isCovered || (contains(clique, conflict.first) && contains(clique, conflict.second));
+			BOOST_CHECK(isCovered);
+		}
+
+		// and the cliques exclude nothing that was allowed before
+		for(const std::vector<uint32_t>& clique : cliques)
+			for(uint32_t a : clique)
+				for(uint32_t b : clique)
+					if(a != b)
+						BOOST_CHECK(conflicts.count(std::make_pair(a, b)) > 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( MaxCliqueSizeOnlyLimitsGrowth )
+{
+	// 5 and 6 conflict with everything, so the five members of the first exclusion could grow into a clique of 7
+	std::vector<std::vector<IdKey> > exclusions = {{0, 1, 2, 3, 4}, {5, 6}};
+	for(IdKey member = 0; member < 5; ++member)
+	{
+		exclusions.push_back({member, 5});
+		exclusions.push_back({member, 6});
+	}
+
+	Cliques unlimited = mergeExclusions(7, exclusions, 0);
+	BOOST_REQUIRE_EQUAL(unlimited.size(), 1);
+	BOOST_CHECK(unlimited[0] == std::vector<uint32_t>({0, 1, 2, 3, 4, 5, 6}));
+
+	// the first exclusion is larger than the limit, its members are kept but it does not grow
+	Cliques limited = mergeExclusions(7, exclusions, 3);
+	BOOST_REQUIRE_GT(limited.size(), 1);
+	BOOST_CHECK(limited[0] == std::vector<uint32_t>({0, 1, 2, 3, 4}));
+	for(size_t c = 1; c < limited.size(); ++c)
+	{
+		BOOST_CHECK_LE(limited[c].size(), 3);
+		BOOST_CHECK(contains(limited[c], 5) || contains(limited[c], 6));
+	}
+}
+
+BOOST_AUTO_TEST_CASE( SingleAndCoveredExclusionsAreDropped )
+{
+	std::vector<std::vector<IdKey> > exclusions = {{3}, {0, 1}, {0, 1, 2}, {1, 2}, {4, 4}, {3, 4}};
+	Cliques cliques = mergeExclusions(5, exclusions, 0);
+
+	BOOST_REQUIRE_EQUAL(cliques.size(), 2);
+	BOOST_CHECK(cliques[0] == std::vector<uint32_t>({0, 1, 2}));
+	BOOST_CHECK(cliques[1] == std::vector<uint32_t>({3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE( MergingKeepsValidSolutions )
+{
+	std::vector<std::vector<IdKey> > exclusions = {{0, 1}, {1, 2}, {0, 2}, {2, 3, 4}, {4, 5}, {3, 5}, {5, 6}, {6, 7}, {7}};
+
+	writeModel("exclusioncliquesmodel.json", exclusions, false);
+	CliqueModel model;
+	model.readFromJson("exclusioncliquesmodel.json");
+	writeModel("exclusioncliquesmodel.json", exclusions, true);
+	CliqueModel mergedModel;
+	mergedModel.readFromJson("exclusioncliquesmodel.json");
+
+	WeightsType weights(model.computeNumWeights());
+	model.initializeOpenGMModel(weights);
+	mergedModel.initializeOpenGMModel(weights);
+	BOOST_CHECK_LT(mergedModel.getNumExclusions(), model.getNumExclusions());
+
+	// verifySolution() reports every violation
+	std::stringstream log;
+	std::streambuf* stdoutBuffer = std::cout.rdbuf(log.rdbuf());
+
+	// all combinations of active detections, with one or two cells
+	size_t numValid = 0;
+	for(size_t combination = 0; combination < 256; ++combination)
+	{
+		std::vector<size_t> labels(8, 0);
+		for(size_t s = 0; s < 8; ++s)
+			if(combination & (1 << s))
+				labels[s] = 1 + (combination + s) % 2;
+
+		bool valid = model.verifySolution(model.makeSolution(labels));
+		BOOST_CHECK_EQUAL(mergedModel.verifySolution(mergedModel.makeSolution(labels)), valid);
+		numValid += valid;
+	}
+
+	std::cout.rdbuf(stdoutBuffer);
+	BOOST_CHECK_GT(numValid, 1);
+	BOOST_CHECK_LT(numValid, 256);
+}
@@ -0,0 +1,300 @@
+#define BOOST_TEST_MODULE feature_normalization
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "featurenormalization.h"
+
+using namespace helpers;
+
+namespace
+{
+
+/**
+ * @brief one feature vector of a state of a variable of the given class
+ */
+struct Sample
+{
+	VariableClass variableClass;
+	size_t state;
+	std::vector<FeatureValueType> features;
+};
+
+/**
+ * @brief Features of detections (3 states, the last one with an additional feature) and links (2 states).
+ *        The first feature is a constant bias, the others have different means and spreads for every state
+ */
+std::vector<Sample> makeSamples(size_t numSamples)
+{
+	std::vector<Sample> samples;
+	unsigned int randomState = 4711;
+	auto next = [&]()
+	{
+		randomState = randomState * 1103515245u + 12345u;
+		return ((randomState >> 8) % 10000) / 10000.0;
+	};
+
+	for(size_t s = 0; s < numSamples; ++s)
+	{
+		for(size_t state = 0; state < 3; ++state)
+		{
+			Sample detection = {VariableClass::Detection, state, {1.0}};
+			detection.features.push_back(FeatureValueType(100.0 * state + 20.0 * next()));
+			detection.features.push_back(FeatureValueType(-3.0 + (state + 1) * next()));
+			if(state == 2)
+				detection.features.push_back(FeatureValueType(1000.0 + 0.5 * next()));
+			samples.push_back(detection);
+		}
+		for(size_t state = 0; state < 2; ++state)
+		{
+			Sample link = {VariableClass::Link, state, {1.0, FeatureValueType(5.0 * next() - 2.0 * state)}};
+			samples.push_back(link);
+		}
+	}
+	return samples;
+}
+
+void accumulate(FeatureNormalization& normalization, const std::vector<Sample>& samples, size_t begin, size_t end)
+{
+	for(size_t s = begin; s < end; ++s)
+		normalization.accumulate(samples[s].variableClass, samples[s].state,
+			FeatureRow(samples[s].features.data(), samples[s].features.size()));
+}
+
+/**
+ * @brief Two-pass mean and (population) standard deviation of a feature of the given class,
+ *        over the given state or over all states if state is -1
+ * @return whether any sample had this feature
+ */
+bool computeStatistics(const std::vector<Sample>& samples, VariableClass variableClass, int state, size_t feature,
+	double& mean, double& standardDeviation)
+{
+	std::vector<double> values;
+	for(const Sample& sample : samples)
+		if(sample.variableClass == variableClass && (state < 0 || sample.state == size_t(state)) && feature < sample.features.size())
+			values.push_back(sample.features[feature]);
+	if(values.empty())
+		return false;
+
+	mean = 0.0;
+	for(double value : values)
+		mean += value;
+	mean /= values.size();
+
+	double sumOfSquares = 0.0;
+	for(double value : values)
+		sumOfSquares += (value - mean) * (value - mean);
+	standardDeviation = std::sqrt(sumOfSquares / values.size());
+	return true;
+}
+
+/**
+ * @brief check mean and scale of every feature of the finalized normalization against those of the pooled data,
+ *        where constant features must have mean 0 and scale 1
+ */
+void checkStatistics(const FeatureNormalization& normalization, const std::vector<Sample>& samples)
+{
+	Json::Value entry;
+	normalization.saveToJson(entry);
+	bool statesShareWeights = normalization.getStatesShareWeights();
+	BOOST_CHECK_EQUAL(entry[JsonTypeNames[JsonTypes::StatesShareWeights]].asBool(), statesShareWeights);
+
+	for(VariableClass variableClass : {VariableClass::Detection, VariableClass::Link})
+	{
+		const Json::Value& classEntry = entry[VariableClassNames[variableClass]];
+		StateFeatureVector mean = extractFeatures(classEntry, JsonTypes::Mean);
+		StateFeatureVector scale = extractFeatures(classEntry, JsonTypes::Scale);
+		size_t numStates = variableClass == VariableClass::Detection ? 3 : 2;
+		BOOST_REQUIRE_EQUAL(mean.size(), statesShareWeights ? 1 : numStates);
+		BOOST_REQUIRE_EQUAL(scale.size(), mean.size());
+
+		for(size_t row = 0; row < mean.size(); ++row)
+		{
+			BOOST_REQUIRE_EQUAL(scale[row].size(), mean[row].size());
+			for(size_t feature = 0; feature < mean[row].size(); ++feature)
+			{
+				double expectedMean = 0.0;
+				double expectedStandardDeviation = 0.0;
+				BOOST_REQUIRE(computeStatistics(samples, variableClass, statesShareWeights ? -1 : int(row), feature,
+					expectedMean, expectedStandardDeviation));
+				if(feature == 0)
+				{
+					BOOST_CHECK_EQUAL(expectedStandardDeviation, 0.0);
+					BOOST_CHECK_EQUAL(mean[row][feature], 0.0);
+					BOOST_CHECK_EQUAL(scale[row][feature], 1.0);
+				}
+				else
+				{
+					BOOST_CHECK_CLOSE(mean[row][feature], expectedMean, 1e-8);
+					BOOST_CHECK_CLOSE(scale[row][feature], expectedStandardDeviation, 1e-6);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @return the features of all samples after applying the given normalization
+ */
+std::vector<std::vector<FeatureValueType> > applyToAll(const FeatureNormalization& normalization, std::vector<Sample> samples)
+{
+	std::vector<std::vector<FeatureValueType> > normalized;
+	for(Sample& sample : samples)
+	{
+		normalization.apply(sample.variableClass, sample.state, sample.features.data(), sample.features.size());
+		normalized.push_back(sample.features);
+	}
+	return normalized;
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( MergedStatisticsMatchPooledData )
+{
+	std::vector<Sample> samples = makeSamples(200);
+
+	FeatureNormalization onePass;
+	accumulate(onePass, samples, 0, samples.size());
+
+	// unequal parts, of which one is empty, one holds a single detection and one only links
+	const std::vector<size_t> boundaries = {0, 37, 37, 38, 40, 700, samples.size()};
+	FeatureNormalization merged;
+	for(size_t part = 0; part + 1 < boundaries.size(); ++part)
+	{
+		FeatureNormalization partNormalization;
+		accumulate(partNormalization, samples, boundaries[part], boundaries[part + 1]);
+		merged.merge(partNormalization);
+	}
+
+	merged.finalize(false);
+	onePass.finalize(false);
+	BOOST_CHECK(merged.isFinalized());
+	BOOST_CHECK(!merged.getStatesShareWeights());
+	checkStatistics(merged, samples);
+	checkStatistics(onePass, samples);
+}
+
+BOOST_AUTO_TEST_CASE( StatesShareWeightsPoolsStates )
+{
+	std::vector<Sample> samples = makeSamples(150);
+
+	FeatureNormalization first;
+	accumulate(first, samples, 0, samples.size() / 2);
+	FeatureNormalization second;
+	accumulate(second, samples, samples.size() / 2, samples.size());
+	first.merge(second);
+	first.finalize(true);
+	BOOST_CHECK(first.getStatesShareWeights());
+	checkStatistics(first, samples);
+
+	// all states of a class are standardized with the same mean and scale
+	Sample detection = {VariableClass::Detection, 0, {2.0, 50.0, -1.0}};
+	std::vector<Sample> sameFeatures = {detection, detection, detection};
+	sameFeatures[1].state = 1;
+	sameFeatures[2].state = 2;
+	std::vector<std::vector<FeatureValueType> > normalized = applyToAll(first, sameFeatures);
+	BOOST_CHECK(normalized[0] == normalized[1]);
+	BOOST_CHECK(normalized[0] == normalized[2]);
+}
+
+BOOST_AUTO_TEST_CASE( ConstantFeaturesAreNotChanged )
+{
+	std::vector<Sample> samples = makeSamples(100);
+	for(bool statesShareWeights : {false, true})
+	{
+		FeatureNormalization normalization;
+		accumulate(normalization, samples, 0, samples.size());
+		normalization.finalize(statesShareWeights);
+
+		std::vector<std::vector<FeatureValueType> > normalized = applyToAll(normalization, samples);
+		std::vector<Sample> normalizedSamples = samples;
+		for(size_t s = 0; s < samples.size(); ++s)
+		{
+			BOOST_CHECK_EQUAL(normalized[s][0], 1.0);
+			normalizedSamples[s].features = normalized[s];
+		}
+
+		// the other features are standardized over the data they were computed from
+		for(VariableClass variableClass : {VariableClass::Detection, VariableClass::Link})
+		{
+			for(size_t feature = 1; feature < 4; ++feature)
+			{
+				double mean = 0.0;
+				double standardDeviation = 0.0;
+				if(!computeStatistics(normalizedSamples, variableClass, statesShareWeights ? -1 : 2, feature, mean, standardDeviation))
+					continue;
+				BOOST_CHECK_SMALL(mean, 1e-4);
+				BOOST_CHECK_CLOSE(standardDeviation, 1.0, 1e-3);
+			}
+		}
+	}
+
+	// a single value has no spread either
+	FeatureNormalization single;
+	accumulate(single, samples, 0, 1);
+	single.finalize(false);
+	std::vector<FeatureValueType> features = samples[0].features;
+	single.apply(samples[0].variableClass, samples[0].state, features.data(), features.size());
+	BOOST_CHECK(features == samples[0].features);
+}
+
+BOOST_AUTO_TEST_CASE( JsonRoundTrip )
+{
+	std::vector<Sample> samples = makeSamples(50);
+	for(bool statesShareWeights : {false, true})
+	{
+		FeatureNormalization normalization;
+		accumulate(normalization, samples, 0, samples.size());
+		normalization.finalize(statesShareWeights);
+
+		Json::Value entry;
+		normalization.saveToJson(entry);
+		FeatureNormalization loaded(entry);
+		BOOST_CHECK(loaded.isFinalized());
+		BOOST_CHECK_EQUAL(loaded.getStatesShareWeights(), statesShareWeights);
+		BOOST_CHECK(applyToAll(loaded, samples) == applyToAll(normalization, samples));
+
+		// and stored together with the weights
+		saveWeightsToJson({0.5, -1.0}, "featurenormalization.json", {}, &normalization);
+		BOOST_CHECK(readWeightsFromJson("featurenormalization.json") == std::vector<ValueType>({0.5, -1.0}));
+		std::shared_ptr<FeatureNormalization> read = readFeatureNormalizationFromJson("featurenormalization.json");
+		BOOST_REQUIRE(read);
+		BOOST_CHECK_EQUAL(read->getStatesShareWeights(), statesShareWeights);
+		BOOST_CHECK(applyToAll(*read, samples) == applyToAll(normalization, samples));
+	}
+
+	// weights without normalization
+	saveWeightsToJson({0.5, -1.0}, "featurenormalization.json", {}, nullptr);
+	BOOST_CHECK(!readFeatureNormalizationFromJson("featurenormalization.json"));
+
+	// a class needs both mean and scale
+	Json::Value entry;
+	entry[VariableClassNames[VariableClass::Link]][JsonTypeNames[JsonTypes::Mean]].append(Json::Value(Json::arrayValue));
+	BOOST_CHECK_THROW(FeatureNormalization invalid(entry), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( FinalizedNormalizationIsFixed )
+{
+	std::vector<Sample> samples = makeSamples(10);
+	FeatureNormalization normalization;
+	accumulate(normalization, samples, 0, samples.size());
+
+	std::vector<FeatureValueType> features = samples[0].features;
+	BOOST_CHECK_THROW(normalization.apply(samples[0].variableClass, 0, features.data(), features.size()), std::runtime_error);
+	Json::Value entry;
+	BOOST_CHECK_THROW(normalization.saveToJson(entry), std::runtime_error);
+
+	normalization.finalize(false);
+	FeatureNormalization other;
+	BOOST_CHECK_THROW(accumulate(normalization, samples, 0, 1), std::runtime_error);
+	BOOST_CHECK_THROW(other.merge(normalization), std::runtime_error);
+
+	// without statistics for a state or for all features
+	BOOST_CHECK_THROW(normalization.apply(VariableClass::Link, 2, features.data(), 2), std::runtime_error);
+	BOOST_CHECK_THROW(normalization.apply(VariableClass::Link, 0, features.data(), 3), std::runtime_error);
+}
@@ -0,0 +1,132 @@
+#define BOOST_TEST_MODULE feature_store
+
+#include <sstream>
+#include <vector>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "featurestore.h"
+
+using namespace helpers;
+
+namespace
+{
+
+std::vector<FeatureValueType> toVector(const FeatureRow& row)
+{
+	return std::vector<FeatureValueType>(row.begin(), row.end());
+}
+
+std::vector<std::vector<FeatureValueType> > getAllRows(const FeatureArena& arena)
+{
+	std::vector<std::vector<FeatureValueType> > rows;
+	for(size_t row = 0; row < arena.getNumRows(); ++row)
+		rows.push_back(toVector(arena.getRow(row)));
+	return rows;
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( IdenticalRowsAreStoredOnce )
+{
+	FeatureArena arena;
+	size_t first = arena.addRows({{1.0, 2.0}, {1.0, 2.0}, {3.0}});
+	size_t second = arena.addRows({{3.0}, {1.0, 2.0}});
+
+	BOOST_CHECK_EQUAL(first, 0);
+	BOOST_CHECK_EQUAL(second, 3);
+	BOOST_CHECK_EQUAL(arena.getNumRows(), 5);
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 2);
+	BOOST_CHECK_EQUAL(arena.getNumValues(), 3);
+	BOOST_CHECK(arena.getRow(0).data() == arena.getRow(4).data());
+	BOOST_CHECK(arena.getRow(2).data() == arena.getRow(3).data());
+
+	// rows that only share a prefix are different
+	arena.addRows({{1.0}});
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 3);
+}
+
+BOOST_AUTO_TEST_CASE( SetRowKeepsSharedRows )
+{
+	FeatureArena arena;
+	size_t first = arena.addRows({{1.0, 2.0}, {5.0}});
+	size_t second = arena.addRows({{1.0, 2.0}, {5.0}});
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 2);
+
+	const FeatureValueType values[] = {7.0, 8.0};
+	arena.setRow(first, values, 2);
+
+	BOOST_CHECK(toVector(arena.getRow(first)) == std::vector<FeatureValueType>({7.0, 8.0}));
+	BOOST_CHECK(toVector(arena.getRow(second)) == std::vector<FeatureValueType>({1.0, 2.0}));
+	BOOST_CHECK(toVector(arena.getRow(second + 1)) == std::vector<FeatureValueType>({5.0}));
+
+	// setting the other row to the same values shares the new row again
+	arena.setRow(second, values, 2);
+	BOOST_CHECK(arena.getRow(first).data() == arena.getRow(second).data());
+}
+
+BOOST_AUTO_TEST_CASE( CompactDropsUnreferencedRows )
+{
+	FeatureArena arena;
+	arena.addRows({{1.0, 2.0}, {3.0}, {4.0, 5.0, 6.0}});
+	arena.addRows({{3.0}, {7.0}});
+
+	const FeatureValueType first[] = {8.0};
+	const FeatureValueType third[] = {3.0};
+	arena.setRow(0, first, 1);
+	arena.setRow(2, third, 1);
+	// {1.0, 2.0} and {4.0, 5.0, 6.0} are no longer referenced
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 5);
+
+	std::vector<std::vector<FeatureValueType> > before = getAllRows(arena);
+	arena.compact();
+
+	BOOST_CHECK(getAllRows(arena) == before);
+	BOOST_CHECK_EQUAL(arena.getNumRows(), 5);
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 3);
+	BOOST_CHECK_EQUAL(arena.getNumValues(), 3);
+
+	// the index still finds the remaining rows
+	arena.addRows({{7.0}, {8.0}});
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 3);
+}
+
+BOOST_AUTO_TEST_CASE( NegativeZeroEqualsZero )
+{
+	FeatureArena arena;
+	arena.addRows({{0.0, 1.0}, {-0.0, 1.0}});
+	arena.addRows({{-0.0, 1.0}});
+
+	BOOST_CHECK_EQUAL(arena.getNumStoredRows(), 1);
+	BOOST_CHECK_EQUAL(arena.getRow(2)[0], 0.0);
+}
+
+BOOST_AUTO_TEST_CASE( SharedFeatureShorthand )
+{
+	Json::Value entry;
+	std::stringstream text(
+		"{ \"explicit\" : [[0.5, 2.0], [0.5, 2.0], [0.5, 2.0]],"
+		"  \"shared\" : { \"values\" : [0.5, 2.0], \"numStates\" : 3 } }");
+	text >> entry;
+
+	// the same features, once listed per state and once given as shared values
+	Json::Value explicitEntry, sharedEntry;
+	explicitEntry[JsonTypeNames[JsonTypes::Features]] = entry["explicit"];
+	sharedEntry[JsonTypeNames[JsonTypes::Features]] = entry["shared"];
+	StateFeatureVector explicitFeatures = extractFeatures(explicitEntry, JsonTypes::Features);
+	StateFeatureVector sharedFeatures = extractFeatures(sharedEntry, JsonTypes::Features);
+	BOOST_CHECK(explicitFeatures == sharedFeatures);
+
+	FeatureArena explicitArena, sharedArena;
+	explicitArena.addRows(explicitFeatures);
+	sharedArena.addRows(sharedFeatures);
+	BOOST_CHECK(getAllRows(explicitArena) == getAllRows(sharedArena));
+	BOOST_CHECK_EQUAL(sharedArena.getNumRows(), 3);
+	BOOST_CHECK_EQUAL(sharedArena.getNumStoredRows(), 1);
+
+	Json::Value noStates;
+	noStates[JsonTypeNames[JsonTypes::Features]][JsonTypeNames[JsonTypes::Values]] = entry["shared"]["values"];
+	BOOST_CHECK_THROW(extractFeatures(noStates, JsonTypes::Features), std::runtime_error);
+}
@@ -0,0 +1,169 @@
+#define BOOST_TEST_MODULE gzip_stream
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "gzipstream.h"
+#include "jsonmodel.h"
+
+using namespace helpers;
+
+namespace
+{
+
+IdLabelType toId(size_t number)
+{
+#ifdef USE_STRING_IDS
+	return std::to_string(number);
+#else
+	return number;
+#endif
+}
+
+Json::Value makeModel(size_t numSegmentations)
+{
+	Json::Value root;
+	root[JsonTypeNames[JsonTypes::Settings]][JsonTypeNames[JsonTypes::StatesShareWeights]] = true;
+	Json::Value& segmentations = root[JsonTypeNames[JsonTypes::Segmentations]] = Json::Value(Json::arrayValue);
+	Json::Value& links = root[JsonTypeNames[JsonTypes::Links]] = Json::Value(Json::arrayValue);
+	for(size_t i = 0; i < numSegmentations; ++i)
+	{
+		Json::Value segmentation;
+		segmentation[JsonTypeNames[JsonTypes::Id]] = toId(i);
+		for(int state = 0; state < 3; ++state)
+			segmentation[JsonTypeNames[JsonTypes::Features]][state].append(0.25 * (i % 13) + state);
+		segmentations.append(segmentation);
+
+		if(i + 1 == numSegmentations)
+			continue;
+		Json::Value link;
+		link[JsonTypeNames[JsonTypes::SrcId]] = toId(i);
+		link[JsonTypeNames[JsonTypes::DestId]] = toId(i + 1);
+		for(int state = 0; state < 2; ++state)
+			link[JsonTypeNames[JsonTypes::Features]][state].append(0.5 * (i % 7) - state);
+		links.append(link);
+	}
+	return root;
+}
+
+/**
+ * @brief read everything from the given stream buffer, errors of the buffer are thrown
+ */
+std::string readAll(std::streambuf& buffer)
+{
+	return std::string(std::istreambuf_iterator<char>(&buffer), std::istreambuf_iterator<char>());
+}
+
+std::string readFile(const std::string& filename)
+{
+	InputFileStream input(filename);
+	BOOST_REQUIRE(input.good());
+	return readAll(*input.rdbuf());
+}
+
+/**
+ * @return the given text as one gzip member
+ */
+std::string compress(const std::string& text)
+{
+	std::stringbuf compressed;
+	GzipOutputStreamBuf gzip(compressed);
+	gzip.sputn(text.data(), text.size());
+	BOOST_REQUIRE(gzip.finish());
+	return compressed.str();
+}
+
+void writeRawFile(const std::string& filename, const std::string& content)
+{
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	file.write(content.data(), content.size());
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( CompressedModelRoundTrip )
+{
+	Json::Value root = makeModel(2000);
+	{
+		OutputFileStream output("gzipmodel.json.gz");
+		BOOST_REQUIRE(output.good());
+		output << root;
+		output.close();
+		BOOST_CHECK(output.good());
+	}
+	BOOST_CHECK(isGzipFile("gzipmodel.json.gz"));
+
+	InputFileStream input("gzipmodel.json.gz");
+	BOOST_REQUIRE(input.good());
+	BOOST_CHECK(input.isCompressed());
+	Json::Value readRoot;
+	input >> readRoot;
+	BOOST_CHECK_EQUAL(readRoot.toStyledString(), root.toStyledString());
+
+	// the model reads the compressed file, and writes the same model compressed and uncompressed
+	mht::JsonModel model;
+	model.readFromJson("gzipmodel.json.gz");
+	model.saveModelToJson("gzipsaved.json.gz");
+	model.saveModelToJson("gzipsaved.json");
+	BOOST_CHECK(isGzipFile("gzipsaved.json.gz"));
+	BOOST_CHECK(!isGzipFile("gzipsaved.json"));
+
+	std::string saved = readFile("gzipsaved.json");
+	BOOST_CHECK(readFile("gzipsaved.json.gz") == saved);
+
+	std::stringstream savedText(saved);
+	Json::Value savedRoot;
+	savedText >> savedRoot;
+	BOOST_CHECK_EQUAL(savedRoot[JsonTypeNames[JsonTypes::Segmentations]].size(), 2000);
+	BOOST_CHECK_EQUAL(savedRoot[JsonTypeNames[JsonTypes::Links]].size(), 1999);
+}
+
+BOOST_AUTO_TEST_CASE( ConcatenatedMembers )
+{
+	const std::string first = "{\"first\": [1, 2, 3],";
+	const std::string second = " \"second\": \"member\"}";
+	writeRawFile("gzipmembers.json.gz", compress(first) + compress(second));
+
+	BOOST_CHECK_EQUAL(readFile("gzipmembers.json.gz"), first + second);
+
+	// a tiny buffer decompresses the members in many small parts
+	std::stringbuf compressed(compress(first) + compress(second));
+	GzipInputStreamBuf gzip(compressed, 7);
+	BOOST_CHECK_EQUAL(readAll(gzip), first + second);
+}
+
+BOOST_AUTO_TEST_CASE( TruncatedFileThrows )
+{
+	std::stringstream text;
+	text << makeModel(200);
+	std::string compressed = compress(text.str());
+	BOOST_REQUIRE_GT(compressed.size(), 100);
+
+	// every cut, up to the last byte of the trailer, is noticed
+	for(size_t size = 1; size < compressed.size(); size += (size < 32 || size + 32 > compressed.size()) ? 1 : 97)
+	{
+		writeRawFile("gziptruncated.json.gz", compressed.substr(0, size));
+		InputFileStream input("gziptruncated.json.gz");
+		BOOST_REQUIRE(input.isCompressed());
+		try
+		{
+			readAll(*input.rdbuf());
+			BOOST_ERROR("Reading a gzip file truncated to " << size << " bytes did not throw");
+		}
+		catch(std::runtime_error& e)
+		{
+			BOOST_CHECK_EQUAL(std::string(e.what()), "Unexpected end of gzip compressed data");
+		}
+	}
+
+	// the JSON reader reports it as well
+	writeRawFile("gziptruncated.json.gz", compressed.substr(0, compressed.size() / 2));
+	mht::JsonModel model;
+	BOOST_CHECK_THROW(model.readFromJson("gziptruncated.json.gz"), std::runtime_error);
+}
@@ -0,0 +1,314 @@
+#define BOOST_TEST_MODULE hdf5_model
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <json/json.h>
+#include <hdf5.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "hdf5model.h"
+
+using namespace mht;
+using namespace helpers;
+
+namespace
+{
+
+const size_t NumSegmentations = 30;
+
+IdLabelType toId(size_t number)
+{
+#ifdef USE_STRING_IDS
+	return std::to_string(number);
+#else
+	return number;
+#endif
+}
+
+Json::Value makeFeatures(size_t numStates, size_t numFeatures, double offset)
+{
+	Json::Value features(Json::arrayValue);
+	for(size_t state = 0; state < numStates; ++state)
+	{
+		Json::Value values(Json::arrayValue);
+		for(size_t i = 0; i < numFeatures; ++i)
+			values.append(offset + state - 0.5 * i);
+		features.append(values);
+	}
+	return features;
+}
+
+/**
+ * @brief A model whose variables have different numbers of states, with links, external divisions and exclusions.
+ *        HDF5 stores the features of a variable class as dense array, so all states of a class have the same number of features
+ */
+void writeModel(const std::string& filename)
+{
+	Json::Value root;
+	root[JsonTypeNames[JsonTypes::Settings]][JsonTypeNames[JsonTypes::StatesShareWeights]] = true;
+	Json::Value& segmentations = root[JsonTypeNames[JsonTypes::Segmentations]] = Json::Value(Json::arrayValue);
+	Json::Value& links = root[JsonTypeNames[JsonTypes::Links]] = Json::Value(Json::arrayValue);
+	Json::Value& divisions = root[JsonTypeNames[JsonTypes::Divisions]] = Json::Value(Json::arrayValue);
+	Json::Value& exclusions = root[JsonTypeNames[JsonTypes::Exclusions]] = Json::Value(Json::arrayValue);
+
+	for(size_t i = 0; i < NumSegmentations; ++i)
+	{
+		Json::Value segmentation;
+		segmentation[JsonTypeNames[JsonTypes::Id]] = toId(100 + i);
+		segmentation[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2 + i % 2, 2, 0.25 * i);
+		// every detection can appear and disappear, so that any solution has a valid ground truth
+		segmentation[JsonTypeNames[JsonTypes::AppearanceFeatures]] = makeFeatures(2 + i % 2, 1, 1.0);
+		segmentation[JsonTypeNames[JsonTypes::DisappearanceFeatures]] = makeFeatures(2 + i % 2, 2, -0.125 * i);
+		segmentations.append(segmentation);
+
+		if(i + 6 >= NumSegmentations)
+			continue;
+		for(size_t dest : {i + 5, i + 6})
+		{
+			Json::Value link;
+			link[JsonTypeNames[JsonTypes::SrcId]] = toId(100 + i);
+			link[JsonTypeNames[JsonTypes::DestId]] = toId(100 + dest);
+			link[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2 + dest % 2, 2, 0.5 * dest);
+			links.append(link);
+		}
+		if(i % 4 == 0)
+		{
+			Json::Value division;
+			division[JsonTypeNames[JsonTypes::Parent]] = toId(100 + i);
+			division[JsonTypeNames[JsonTypes::Children]].append(toId(100 + i + 6));
+			division[JsonTypeNames[JsonTypes::Children]].append(toId(100 + i + 5));
+			division[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2, 1, 2.0 * i);
+			divisions.append(division);
+		}
+		if(i % 3 == 0)
+		{
+			Json::Value exclusion(Json::arrayValue);
+			for(size_t member = i; member < i + 2 + i % 2; ++member)
+				exclusion.append(toId(100 + member));
+			exclusions.append(exclusion);
+		}
+	}
+
+	std::ofstream file(filename);
+	file << root;
+}
+
+class TestModel : public Hdf5Model
+{
+public:
+	/**
+	 * @brief Everything the formats must preserve: ids, features (and thus the number of states), exclusions and links
+	 */
+	Json::Value describe() const
+	{
+		Json::Value description;
+		for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+		{
+			Json::Value segmentation;
+			segmentation.append(iter->second.getId());
+			segmentation.append(describe(iter->second.getDetectionVariable()));
+			segmentation.append(describe(iter->second.getDivisionVariable()));
+			segmentation.append(describe(iter->second.getAppearanceVariable()));
+			segmentation.append(describe(iter->second.getDisappearanceVariable()));
+			description["segmentations"].append(segmentation);
+		}
+
+		for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
+		{
+			Json::Value link;
+			link.append(idTable_.getId(iter->second->getSrcKey()));
+			link.append(idTable_.getId(iter->second->getDestKey()));
+			link.append(describe(iter->second->getVariable()));
+			description["links"].append(link);
+		}
+
+		for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
+		{
+			Json::Value division;
+			division.append(idTable_.getId(iter->second->getParentKey()));
+			for(IdKey child : iter->second->getChildrenKeys())
+				division.append(idTable_.getId(child));
+			division.append(describe(iter->second->getVariable()));
+			description["divisions"].append(division);
+		}
+
+		for(const ExclusionConstraint& exclusion : exclusionConstraints_)
+		{
+			Json::Value members(Json::arrayValue);
+			for(IdKey key : exclusion.getKeys())
+				members.append(idTable_.getId(key));
+			description["exclusions"].append(members);
+		}
+		return description;
+	}
+
+	/**
+	 * @brief A solution with all detections active and some links and divisions, which must be initialized
+	 */
+	Solution makeSolution() const
+	{
+		Solution sol(model_.numberOfVariables(), 0);
+		for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
+		{
+			int variable = graph_.getDetectionVariable(s);
+			sol[variable] = 1 + s % (model_.numberOfLabels(variable) - 1);
+		}
+		for(size_t l = 0; l < graph_.getNumLinks(); ++l)
+			sol[graph_.getLinkVariable(l)] = l % model_.numberOfLabels(graph_.getLinkVariable(l));
+		for(size_t d = 0; d < graph_.getNumDivisions(); d += 2)
+			sol[graph_.getExternalDivisionVariable(d)] = 1;
+		return sol;
+	}
+
+	/**
+	 * @brief check that the stored variables of the given ground truth have the values of the solution
+	 */
+	void checkResult(const Solution& gt, const Solution& sol) const
+	{
+		BOOST_REQUIRE_EQUAL(gt.size(), sol.size());
+		for(size_t s = 0; s < graph_.getNumSegmentations(); ++s)
+			BOOST_CHECK_EQUAL(gt[graph_.getDetectionVariable(s)], sol[graph_.getDetectionVariable(s)]);
+		for(size_t l = 0; l < graph_.getNumLinks(); ++l)
+			BOOST_CHECK_EQUAL(gt[graph_.getLinkVariable(l)], sol[graph_.getLinkVariable(l)]);
+		for(size_t d = 0; d < graph_.getNumDivisions(); ++d)
+			BOOST_CHECK_EQUAL(gt[graph_.getExternalDivisionVariable(d)], sol[graph_.getExternalDivisionVariable(d)]);
+	}
+
+private:
+	static Json::Value describe(const Variable& variable)
+	{
+		Json::Value features(Json::arrayValue);
+		for(size_t state = 0; state < variable.getNumStates(); ++state)
+		{
+			Json::Value values(Json::arrayValue);
+			for(FeatureValueType value : variable.getFeatures(state))
+				values.append(value);
+			features.append(values);
+		}
+		return features;
+	}
+};
+
+/**
+ * @brief read the given file, which must fail with an error that contains the given message
+ */
+void checkReadError(const std::string& filename, const std::string& message)
+{
+	TestModel model;
+	try
+	{
+		model.readFromHdf5(filename);
+		BOOST_ERROR("Reading the malformed file " + filename + " did not throw");
+	}
+	catch(std::runtime_error& e)
+	{
+		BOOST_CHECK_MESSAGE(std::string(e.what()).find(message) != std::string::npos, "Unexpected error: " << e.what());
+	}
+}
+
+/**
+ * @brief save the generated model to the given HDF5 file, and open it for writing
+ */
+hid_t writeHdf5Model(const std::string& filename)
+{
+	writeModel("hdf5model.json");
+	TestModel model;
+	model.readFromFile("hdf5model.json");
+	model.saveToHdf5(filename);
+
+	hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+	BOOST_REQUIRE(file >= 0);
+	return file;
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( ModelRoundTrip )
+{
+	writeModel("hdf5model.json");
+	TestModel jsonModel;
+	jsonModel.readFromFile("hdf5model.json");
+	Json::Value expected = jsonModel.describe();
+	BOOST_REQUIRE_EQUAL(expected["segmentations"].size(), NumSegmentations);
+	BOOST_REQUIRE_EQUAL(expected["links"].size(), 2 * (NumSegmentations - 6));
+	BOOST_REQUIRE_EQUAL(expected["divisions"].size(), 6);
+	BOOST_REQUIRE_EQUAL(expected["exclusions"].size(), 8);
+
+	jsonModel.saveToHdf5("hdf5model.h5");
+	BOOST_CHECK(Hdf5Model::isHdf5File("hdf5model.h5"));
+	BOOST_CHECK(!Hdf5Model::isHdf5File("hdf5model.json"));
+
+	TestModel hdf5Model;
+	hdf5Model.readFromFile("hdf5model.h5");
+	BOOST_CHECK(hdf5Model.describe() == expected);
+	BOOST_CHECK_EQUAL(hdf5Model.getSettings()->statesShareWeights_, true);
+
+	// and back to JSON
+	hdf5Model.saveModelToJson("hdf5model.json");
+	TestModel convertedModel;
+	convertedModel.readFromFile("hdf5model.json");
+	BOOST_CHECK(convertedModel.describe() == expected);
+}
+
+BOOST_AUTO_TEST_CASE( ResultRoundTrip )
+{
+	writeModel("hdf5model.json");
+	TestModel model;
+	model.readFromFile("hdf5model.json");
+	WeightsType weights(model.computeNumWeights());
+	model.initializeOpenGMModel(weights);
+
+	Solution sol = model.makeSolution();
+	model.saveResultToHdf5("hdf5result.h5", sol);
+	model.setJsonGtFile("hdf5result.h5");
+	Solution hdf5Result = model.getGroundTruth();
+	model.checkResult(hdf5Result, sol);
+
+	// the results of both formats describe the same solution
+	model.saveResultToJson("hdf5result.json", sol);
+	model.setJsonGtFile("hdf5result.json");
+	BOOST_CHECK(model.getGroundTruth() == hdf5Result);
+}
+
+BOOST_AUTO_TEST_CASE( InvalidExclusionOffsetsThrow )
+{
+	hid_t file = writeHdf5Model("hdf5model.h5");
+	const std::string path = JsonTypeNames[JsonTypes::Exclusions] + "/offsets";
+	hid_t dataset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
+	BOOST_REQUIRE(dataset >= 0);
+
+	// the second exclusion ends before it begins
+	std::vector<uint64_t> offsets(9);
+	BOOST_REQUIRE(H5Dread(dataset, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, offsets.data()) >= 0);
+	offsets[1] = offsets[2] + 1;
+	BOOST_REQUIRE(H5Dwrite(dataset, H5T_NATIVE_UINT64, H5S_ALL, H5S_ALL, H5P_DEFAULT, offsets.data()) >= 0);
+	H5Dclose(dataset);
+	H5Fclose(file);
+
+	checkReadError("hdf5model.h5", "offsets are invalid");
+}
+
+BOOST_AUTO_TEST_CASE( InvalidFeatureShapeThrows )
+{
+	hid_t file = writeHdf5Model("hdf5model.h5");
+	const std::string path = JsonTypeNames[JsonTypes::Segmentations] + "/" + JsonTypeNames[JsonTypes::Features] + "/values";
+	BOOST_REQUIRE(H5Ldelete(file, path.c_str(), H5P_DEFAULT) >= 0);
+
+	// the features of every segmentation as one row, without states
+	hsize_t shape[2] = {NumSegmentations, 2};
+	std::vector<double> values(NumSegmentations * 2, 1.0);
+	hid_t space = H5Screate_simple(2, shape, nullptr);
+	hid_t dataset = H5Dcreate2(file, path.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+	BOOST_REQUIRE(dataset >= 0);
+	BOOST_REQUIRE(H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) >= 0);
+	H5Dclose(dataset);
+	H5Sclose(space);
+	H5Fclose(file);
+
+	checkReadError("hdf5model.h5", "must have the shape");
+}
@@ -2,10 +2,113 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include <json/json.h>
+#include "jsonstreamparser.h"
+#include "jsonmodel.h"
 
 #include <boost/test/unit_test.hpp>
 
+namespace
+{
+
+helpers::IdLabelType toId(size_t number)
+{
+#ifdef USE_STRING_IDS
+	return std::to_string(number);
+#else
+	return number;
+#endif
+}
+
+/**
+ * @brief Write a model that is large enough to be read in several parts, with one entry per line. The segmentations with
+ *        the given indices get invalid features
+ * @return the line of every segmentation
+ */
+std::vector<size_t> writeLargeModel(const std::string& filename, size_t numSegmentations, const std::vector<size_t>& invalidSegmentations = {})
+{
+	Json::FastWriter writer;
+	std::ofstream file(filename.c_str());
+	file << "{\n\"" << helpers::JsonTypeNames[helpers::JsonTypes::Segmentations] << "\": [\n";
+
+	std::vector<size_t> lines;
+	for(size_t i = 0; i < numSegmentations; ++i)
+	{
+		Json::Value entry;
+		entry[helpers::JsonTypeNames[helpers::JsonTypes::Id]] = toId(i);
+		for(size_t state = 0; state < 2 + i % 2; ++state)
+		{
+			entry[helpers::JsonTypeNames[helpers::JsonTypes::Features]][int(state)].append(0.125 * (i % 17) + state);
+			entry[helpers::JsonTypeNames[helpers::JsonTypes::Features]][int(state)].append(-0.5 * state);
+			entry[helpers::JsonTypeNames[helpers::JsonTypes::AppearanceFeatures]][int(state)].append(1.0 * (i % 5));
+		}
+		if(std::find(invalidSegmentations.begin(), invalidSegmentations.end(), i) != invalidSegmentations.end())
+			entry[helpers::JsonTypeNames[helpers::JsonTypes::Features]][0][1] = "invalid";
+
+		lines.push_back(3 + i);
+		file << (i > 0 ? "," : "") << writer.write(entry);
+	}
+
+	file << "],\n\"" << helpers::JsonTypeNames[helpers::JsonTypes::Links] << "\": [\n";
+	for(size_t i = 0; i + 1 < numSegmentations; ++i)
+	{
+		Json::Value entry;
+		entry[helpers::JsonTypeNames[helpers::JsonTypes::SrcId]] = toId(i);
+		entry[helpers::JsonTypeNames[helpers::JsonTypes::DestId]] = toId(i + 1 + i % 3);
+		entry[helpers::JsonTypeNames[helpers::JsonTypes::Features]][0].append(0.25 * (i % 7));
+		entry[helpers::JsonTypeNames[helpers::JsonTypes::Features]][1].append(1.0);
+		if(i + 1 + i % 3 < numSegmentations)
+			file << (i > 0 ? "," : "") << writer.write(entry);
+	}
+	file << "]}\n";
+	return lines;
+}
+
+std::string readFile(const std::string& filename)
+{
+	std::ifstream file(filename.c_str());
+	std::stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+/**
+ * @brief read the given model with the given number of threads
+ * @return the model as written by saveModelToJson()
+ */
+std::string readModel(const std::string& filename, size_t numThreads)
+{
+	mht::JsonModel model;
+	model.setNumReaderThreads(numThreads);
+	model.readFromJson(filename);
+	model.saveModelToJson("readermodel.json");
+	return readFile("readermodel.json");
+}
+
+/**
+ * @return the error of reading the given model with the given number of threads
+ */
+std::string readModelError(const std::string& filename, size_t numThreads)
+{
+	mht::JsonModel model;
+	model.setNumReaderThreads(numThreads);
+	try
+	{
+		model.readFromJson(filename);
+	}
+	catch(std::runtime_error& e)
+	{
+		return e.what();
+	}
+	return "";
+}
+
+} // end anonymous namespace
+
 BOOST_AUTO_TEST_CASE( json_test )
 {
 	Json::Value root;
@@ -61,4 +164,114 @@ BOOST_AUTO_TEST_CASE( json_test )
 		BOOST_CHECK_EQUAL(hyp[0].asInt(), 7);
 		BOOST_CHECK_EQUAL(hyp[1].asInt(), 9);
 	}
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE( json_stream_test )
+{
+	Json::Value root;
+	std::ifstream doc("example.json");
+	BOOST_CHECK(doc.good());
+	doc >> root;
+
+	// use a tiny buffer so that tokens cross buffer boundaries
+	std::ifstream streamDoc("example.json");
+	helpers::JsonStreamParser parser(streamDoc, 7);
+	Json::Value streamRoot = parser.readValue();
+	BOOST_CHECK(streamRoot == root);
+	BOOST_CHECK(parser.next() == helpers::JsonStreamParser::Token::End);
+
+	std::string text = "{\"ids\": [3, 5], \"skipped\": {\"a\": [1, {}]}, \"name\": \"a\\u00e4\"}";
+	helpers::JsonStreamParser textParser(text.data(), text.data() + text.size());
+	textParser.expect(helpers::JsonStreamParser::Token::ObjectBegin, "expected object");
+	std::string key;
+	BOOST_CHECK(textParser.nextKey(key));
+	BOOST_CHECK_EQUAL(key, "ids");
+	textParser.expect(helpers::JsonStreamParser::Token::ArrayBegin, "expected array");
+	BOOST_CHECK(textParser.hasNextElement());
+	BOOST_CHECK_EQUAL(textParser.readDouble("expected number"), 3.0);
+	BOOST_CHECK(textParser.hasNextElement());
+	BOOST_CHECK_EQUAL(textParser.readDouble("expected number"), 5.0);
+	BOOST_CHECK(!textParser.hasNextElement());
+	BOOST_CHECK(textParser.nextKey(key));
+	textParser.skipValue();
+	BOOST_CHECK(textParser.nextKey(key));
+	BOOST_CHECK(textParser.next() == helpers::JsonStreamParser::Token::String);
+	BOOST_CHECK_EQUAL(textParser.getString(), "a\xc3\xa4");
+	BOOST_CHECK(!textParser.nextKey(key));
+}
+
+BOOST_AUTO_TEST_CASE( json_surrogate_pair_test )
+{
+	// U+1F600 is escaped as a surrogate pair, but must become a single 4 byte UTF-8 sequence like jsoncpp produces
+	std::string text = "\"\\uD83D\\uDE00 \\u20AC\"";
+	helpers::JsonStreamParser parser(text.data(), text.data() + text.size());
+	BOOST_CHECK(parser.next() == helpers::JsonStreamParser::Token::String);
+	BOOST_CHECK_EQUAL(parser.getString(), "\xf0\x9f\x98\x80 \xe2\x82\xac");
+
+	Json::Value root;
+	std::stringstream stream(text);
+	stream >> root;
+	BOOST_CHECK_EQUAL(parser.getString(), root.asString());
+
+	// lone surrogates are rejected
+	for(std::string invalid : {"\"\\uD83D\"", "\"\\uD83Dx\"", "\"\\uD83D\\u0041\"", "\"\\uDE00\""})
+	{
+		helpers::JsonStreamParser invalidParser(invalid.data(), invalid.data() + invalid.size());
+		BOOST_CHECK_THROW(invalidParser.next(), std::runtime_error);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( json_split_array_test )
+{
+	typedef helpers::JsonStreamParser::Token Token;
+	std::string text = "[{\"a\": \"]\"}, 12,\n/* [ */ [1, [2]], \"x\\\"]\",\n{}] 7";
+	helpers::JsonStreamParser parser(text.data(), text.data() + text.size());
+	parser.expect(Token::ArrayBegin, "expected array");
+	std::vector<helpers::JsonStreamParser::ArrayChunk> chunks = parser.splitArray(3, 1);
+	BOOST_CHECK_EQUAL(chunks.size(), 3);
+	BOOST_CHECK_EQUAL(parser.readDouble("expected number"), 7.0);
+
+	// parsing the chunks one after the other yields all elements in order
+	Json::Value elements(Json::arrayValue);
+	for(const helpers::JsonStreamParser::ArrayChunk& chunk : chunks)
+	{
+		helpers::JsonStreamParser chunkParser(chunk.begin, chunk.end, chunk.line);
+		while(chunkParser.peek() != Token::End)
+			elements.append(chunkParser.readValue());
+	}
+	BOOST_CHECK_EQUAL(elements.size(), 5);
+	BOOST_CHECK_EQUAL(elements[0]["a"].asString(), "]");
+	BOOST_CHECK_EQUAL(elements[1].asInt(), 12);
+	BOOST_CHECK_EQUAL(elements[2][1][0].asInt(), 2);
+	BOOST_CHECK_EQUAL(elements[3].asString(), "x\"]");
+	BOOST_CHECK(elements[4].isObject());
+	for(const helpers::JsonStreamParser::ArrayChunk& chunk : chunks)
+		BOOST_CHECK_EQUAL(chunk.line, 1 + std::count(text.data(), chunk.begin, '\n'));
+}
+
+BOOST_AUTO_TEST_CASE( json_parallel_reader_test )
+{
+	const size_t numSegmentations = 40000;
+	writeLargeModel("largemodel.json", numSegmentations);
+	// the segmentations must be split into several parts of at least 256 KiB
+	BOOST_REQUIRE_GT(readFile("largemodel.json").size(), 4 << 20);
+
+	std::string sequential = readModel("largemodel.json", 1);
+	std::string parallel = readModel("largemodel.json", 4);
+	BOOST_CHECK_GT(sequential.size(), 1 << 20);
+	BOOST_CHECK(parallel == sequential);
+}
+
+BOOST_AUTO_TEST_CASE( json_parallel_reader_error_test )
+{
+	// two invalid entries that are several MiB apart, and thus in different parts
+	const size_t numSegmentations = 40000;
+	std::vector<size_t> lines = writeLargeModel("largemodel.json", numSegmentations, {35000, 12000});
+
+	std::stringstream expected;
+	expected << "JSON parse error in line " << lines[12000] << ": ";
+	for(size_t numThreads : {1, 4})
+	{
+		std::string error = readModelError("largemodel.json", numThreads);
+		BOOST_CHECK_MESSAGE(error.find(expected.str()) == 0, "Unexpected error with " << numThreads << " threads: " << error);
+	}
+}
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <cstdio>
+#include <fstream>
+#include <sstream>
 
 #include <boost/test/unit_test.hpp>
 
@@ -40,3 +42,30 @@ BOOST_AUTO_TEST_CASE( OpenGMInference )
 	BOOST_CHECK_EQUAL(numWeights, 5);
 }
 
+BOOST_AUTO_TEST_CASE( StreamedResultFormat )
+{
+	JsonModel model;
+	model.readFromJson("constrackingmodel-new-divs.json");
+	WeightsType weights(model.computeNumWeights());
+	model.initializeOpenGMModel(weights, true);
+	model.setJsonGtFile("constrackinggt-new-divs.json");
+	Solution gt = model.getGroundTruth();
+
+	// the streamed result must look exactly like the Json::Value tree written with operator<<, e.g. the children of external divisions
+	model.saveResultToJson("streamedresult.json", gt);
+	std::ifstream streamed("streamedresult.json");
+	std::stringstream streamedText;
+	streamedText << streamed.rdbuf();
+
+	Json::Value root;
+	streamedText.seekg(0);
+	streamedText >> root;
+	std::stringstream treeText;
+	treeText << root << std::endl;
+	BOOST_CHECK_EQUAL(streamedText.str(), treeText.str());
+
+	const Json::Value& divisions = root[JsonTypeNames[JsonTypes::DivisionResults]];
+	BOOST_CHECK_EQUAL(divisions.size(), 1);
+	BOOST_CHECK_EQUAL(divisions[0][JsonTypeNames[JsonTypes::Children]].size(), 2);
+}
+
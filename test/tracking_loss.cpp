@@ -0,0 +1,224 @@
+#define BOOST_TEST_MODULE tracking_loss
+
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "jsonmodel.h"
+#include "trackingloss.h"
+
+using namespace mht;
+using namespace helpers;
+
+namespace
+{
+
+IdLabelType toId(size_t number)
+{
+#ifdef USE_STRING_IDS
+	return std::to_string(number);
+#else
+	return number;
+#endif
+}
+
+Json::Value makeFeatures(size_t numStates, double offset)
+{
+	Json::Value features(Json::arrayValue);
+	for(size_t state = 0; state < numStates; ++state)
+	{
+		Json::Value values(Json::arrayValue);
+		values.append(offset + state);
+		features.append(values);
+	}
+	return features;
+}
+
+/**
+ * @brief Two frames of detections with links and external divisions, and a different loss weight for every variable class.
+ *        Links do not count at all
+ */
+void writeModel(const std::string& filename, bool trackingAwareLoss)
+{
+	const size_t numPerFrame = 4;
+	Json::Value root;
+	Json::Value& settings = root[JsonTypeNames[JsonTypes::Settings]];
+	settings[JsonTypeNames[JsonTypes::DetectionLossWeight]] = 2.0;
+	settings[JsonTypeNames[JsonTypes::LinkLossWeight]] = 0.0;
+	settings[JsonTypeNames[JsonTypes::DivisionLossWeight]] = 3.0;
+	settings[JsonTypeNames[JsonTypes::AppearanceLossWeight]] = 0.5;
+	settings[JsonTypeNames[JsonTypes::DisappearanceLossWeight]] = 4.0;
+	settings[JsonTypeNames[JsonTypes::TrackingAwareLoss]] = trackingAwareLoss;
+
+	Json::Value& segmentations = root[JsonTypeNames[JsonTypes::Segmentations]] = Json::Value(Json::arrayValue);
+	Json::Value& links = root[JsonTypeNames[JsonTypes::Links]] = Json::Value(Json::arrayValue);
+	Json::Value& divisions = root[JsonTypeNames[JsonTypes::Divisions]] = Json::Value(Json::arrayValue);
+	for(size_t i = 0; i < 2 * numPerFrame; ++i)
+	{
+		Json::Value segmentation;
+		segmentation[JsonTypeNames[JsonTypes::Id]] = toId(i);
+		segmentation[JsonTypeNames[JsonTypes::Features]] = makeFeatures(3, 0.5 * i);
+		segmentation[JsonTypeNames[JsonTypes::AppearanceFeatures]] = makeFeatures(3, 1.0);
+		segmentation[JsonTypeNames[JsonTypes::DisappearanceFeatures]] = makeFeatures(3, 2.0);
+		segmentations.append(segmentation);
+	}
+	for(size_t i = 0; i < numPerFrame; ++i)
+	{
+		size_t next = i + numPerFrame;
+		size_t neighbor = (i + 1) % numPerFrame + numPerFrame;
+		for(size_t dest : {next, neighbor})
+		{
+			Json::Value link;
+			link[JsonTypeNames[JsonTypes::SrcId]] = toId(i);
+			link[JsonTypeNames[JsonTypes::DestId]] = toId(dest);
+			link[JsonTypeNames[JsonTypes::Features]] = makeFeatures(3, 0.25 * dest);
+			links.append(link);
+		}
+
+		Json::Value division;
+		division[JsonTypeNames[JsonTypes::Parent]] = toId(i);
+		division[JsonTypeNames[JsonTypes::Children]].append(toId(next));
+		division[JsonTypeNames[JsonTypes::Children]].append(toId(neighbor));
+		division[JsonTypeNames[JsonTypes::Features]] = makeFeatures(2, -1.0);
+		divisions.append(division);
+	}
+
+	std::ofstream file(filename);
+	file << root;
+}
+
+class LossModel : public JsonModel
+{
+public:
+	const GraphicalModelType& getOpenGMModel() const { return model_; }
+
+	/**
+	 * @return the loss weight of the settings for the class of every OpenGM variable
+	 */
+	std::vector<double> getClassLossWeights() const
+	{
+		const std::map<VariableClass, double> weights = {
+			{VariableClass::Detection, 2.0},
+			{VariableClass::Link, 0.0},
+			{VariableClass::Division, 3.0},
+			{VariableClass::ExternalDivision, 3.0},
+			{VariableClass::Appearance, 0.5},
+			{VariableClass::Disappearance, 4.0}};
+
+		std::vector<double> lossWeights;
+		for(VariableClass variableClass : variableClasses_)
+			lossWeights.push_back(weights.at(variableClass));
+		return lossWeights;
+	}
+};
+
+/**
+ * @brief a labeling of all variables of the model, which does not need to be a valid solution
+ */
+Solution makeLabeling(const GraphicalModelType& model, size_t seed)
+{
+	Solution labeling(model.numberOfVariables());
+	for(size_t variable = 0; variable < labeling.size(); ++variable)
+		labeling[variable] = (variable * 7 + seed + variable / 5) % model.numberOfLabels(variable);
+	return labeling;
+}
+
+void initializeModel(LossModel& model, bool trackingAwareLoss)
+{
+	writeModel("trackinglossmodel.json", trackingAwareLoss);
+	model.readFromJson("trackinglossmodel.json");
+	WeightsType weights(model.computeNumWeights());
+	for(size_t i = 0; i < weights.numberOfWeights(); ++i)
+		weights.setWeight(i, 0.5 - 0.25 * i);
+	model.initializeOpenGMModel(weights);
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( LossWeightsFromSettings )
+{
+	for(bool trackingAwareLoss : {false, true})
+	{
+		LossModel model;
+		initializeModel(model, trackingAwareLoss);
+
+		LossType::Parameter param = model.getLossParameter();
+		BOOST_CHECK_EQUAL(param.useStateDistance_, trackingAwareLoss);
+		std::vector<double> lossWeights = model.getClassLossWeights();
+		BOOST_REQUIRE_EQUAL(param.nodeLossMultiplier_.size(), lossWeights.size());
+		// 8 detections, appearances and disappearances, 8 links and 4 external divisions
+		BOOST_REQUIRE_EQUAL(lossWeights.size(), 3 * 8 + 8 + 4);
+		for(size_t variable = 0; variable < lossWeights.size(); ++variable)
+			BOOST_CHECK_EQUAL(param.getNodeLossMultiplier(variable), lossWeights[variable]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( StateDistance )
+{
+	LossType::Parameter param;
+	param.nodeLossMultiplier_ = {2.0, 0.0};
+	LossType hammingLoss(param);
+	param.useStateDistance_ = true;
+	LossType distanceLoss(param);
+
+	BOOST_CHECK_EQUAL(hammingLoss.variableLoss(0, 1, 1), 0.0);
+	BOOST_CHECK_EQUAL(hammingLoss.variableLoss(0, 0, 2), 2.0);
+	BOOST_CHECK_EQUAL(distanceLoss.variableLoss(0, 1, 1), 0.0);
+	BOOST_CHECK_EQUAL(distanceLoss.variableLoss(0, 0, 2), 4.0);
+	BOOST_CHECK_EQUAL(distanceLoss.variableLoss(0, 3, 2), 2.0);
+
+	// a multiplier of 0 ignores the variable, variables without multiplier count once
+	BOOST_CHECK_EQUAL(distanceLoss.variableLoss(1, 0, 2), 0.0);
+	BOOST_CHECK_EQUAL(hammingLoss.variableLoss(5, 0, 2), 1.0);
+	BOOST_CHECK_EQUAL(distanceLoss.variableLoss(5, 0, 2), 2.0);
+}
+
+BOOST_AUTO_TEST_CASE( LossAugmentationAddsNegativeLoss )
+{
+	for(bool trackingAwareLoss : {false, true})
+	{
+		LossModel model;
+		initializeModel(model, trackingAwareLoss);
+		const GraphicalModelType& gm = model.getOpenGMModel();
+		std::vector<double> lossWeights = model.getClassLossWeights();
+
+		Solution gt = makeLabeling(gm, 0);
+		LossType loss(model.getLossParameter());
+		GraphicalModelType augmented = gm;
+		loss.addLoss(augmented, gt.begin());
+
+		// one loss factor per variable, except for the links whose errors do not count
+		size_t numCounted = 0;
+		for(double lossWeight : lossWeights)
+			numCounted += lossWeight != 0.0;
+		BOOST_CHECK_EQUAL(augmented.numberOfFactors(), gm.numberOfFactors() + numCounted);
+
+		for(size_t seed = 0; seed < 5; ++seed)
+		{
+			Solution sol = makeLabeling(gm, seed);
+
+			double expected = 0.0;
+			for(size_t variable = 0; variable < sol.size(); ++variable)
+			{
+				if(sol[variable] == gt[variable])
+					continue;
+				double distance = trackingAwareLoss ? std::abs(double(sol[variable]) - double(gt[variable])) : 1.0;
+				expected += lossWeights[variable] * distance;
+			}
+			BOOST_CHECK_CLOSE(model.computeLoss(sol, gt), expected, 1e-9);
+			if(seed == 0)
+				BOOST_CHECK_EQUAL(expected, 0.0);
+			else
+				BOOST_CHECK_GT(expected, 0.0);
+
+			// the augmented model is lower by exactly the loss
+			double difference = augmented.evaluate(sol) - gm.evaluate(sol);
+			BOOST_CHECK_SMALL(difference + expected, 1e-9);
+		}
+	}
+}
@@ -0,0 +1,177 @@
+#define BOOST_TEST_MODULE unary_energies
+
+#include <fstream>
+#include <vector>
+#include <json/json.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "helpers.h"
+#include "jsonmodel.h"
+
+using namespace mht;
+using namespace helpers;
+
+namespace
+{
+
+/**
+ * @brief Write a model with several thousand variables, so that computeUnaryEnergies() splits them into several blocks
+ */
+void writeModel(const std::string& filename, bool statesShareWeights, int numFrames = 20)
+{
+	const int numPerFrame = 100;
+	auto features = [](int id, size_t numStates, size_t numFeatures)
+	{
+		Json::Value stateFeatures(Json::arrayValue);
+		for(size_t state = 0; state < numStates; ++state)
+		{
+			Json::Value values(Json::arrayValue);
+			for(size_t i = 0; i < numFeatures; ++i)
+				values.append(((id * 7 + state * 3 + i * 5) % 11) * 0.5 - 2.0);
+			stateFeatures.append(values);
+		}
+		return stateFeatures;
+	};
+
+	Json::Value root;
+	root[JsonTypeNames[JsonTypes::Settings]][JsonTypeNames[JsonTypes::StatesShareWeights]] = statesShareWeights;
+	// the lists are written even if they stay empty
+	Json::Value& segmentations = root[JsonTypeNames[JsonTypes::Segmentations]] = Json::Value(Json::arrayValue);
+	Json::Value& links = root[JsonTypeNames[JsonTypes::Links]] = Json::Value(Json::arrayValue);
+	Json::Value& divisions = root[JsonTypeNames[JsonTypes::Divisions]] = Json::Value(Json::arrayValue);
+	for(int frame = 0; frame < numFrames; ++frame)
+	{
+		for(int i = 0; i < numPerFrame; ++i)
+		{
+			int id = frame * numPerFrame + i + 1;
+			Json::Value segmentation;
+			segmentation[JsonTypeNames[JsonTypes::Id]] = id;
+			segmentation[JsonTypeNames[JsonTypes::Features]] = features(id, 3, 2);
+			segmentation[JsonTypeNames[JsonTypes::AppearanceFeatures]] = features(id + 1, 3, 1);
+			segmentation[JsonTypeNames[JsonTypes::DisappearanceFeatures]] = features(id + 2, 3, 1);
+			segmentations.append(segmentation);
+
+			if(frame + 1 == numFrames)
+				continue;
+			int next = id + numPerFrame;
+			int neighbor = frame * numPerFrame + (i + 1) % numPerFrame + numPerFrame + 1;
+			for(int dest : {next, neighbor})
+			{
+				Json::Value link;
+				link[JsonTypeNames[JsonTypes::SrcId]] = id;
+				link[JsonTypeNames[JsonTypes::DestId]] = dest;
+				link[JsonTypeNames[JsonTypes::Features]] = features(id + dest, 3, 3);
+				links.append(link);
+			}
+			if(i % 5 == 0)
+			{
+				// divisions are external, a model cannot also have division features in its segmentations
+				Json::Value division;
+				division[JsonTypeNames[JsonTypes::Parent]] = id;
+				division[JsonTypeNames[JsonTypes::Children]].append(next);
+				division[JsonTypeNames[JsonTypes::Children]].append(neighbor);
+				division[JsonTypeNames[JsonTypes::Features]] = features(id * 3, 2, 2);
+				divisions.append(division);
+			}
+		}
+	}
+
+	std::ofstream file(filename);
+	file << root;
+}
+
+class EnergyModel : public JsonModel
+{
+public:
+	/**
+	 * @brief check the energies of all variables against Variable::computeEnergies() with the weight ids of their class
+	 * @return the number of checked variables
+	 */
+	size_t checkEnergies(const UnaryEnergies& energies, const WeightsType& weights) const
+	{
+		size_t numChecked = 0;
+		auto check = [&](const Variable& variable, VariableClass variableClass)
+		{
+			int id = variable.getOpenGMVariableId();
+			if(id < 0)
+				return;
+
+			size_t numWeights = 0;
+			size_t firstWeight = getWeightRange(variableClass, numWeights);
+			std::vector<size_t> weightIds(numWeights);
+			for(size_t i = 0; i < numWeights; ++i)
+				weightIds[i] = firstWeight + i;
+
+			std::vector<ValueType> expected = variable.computeEnergies(settings_->statesShareWeights_, weights, weightIds);
+			BOOST_REQUIRE_EQUAL(energies.getNumStates(id), expected.size());
+			for(size_t state = 0; state < expected.size(); ++state)
+				BOOST_CHECK_EQUAL(energies.getEnergy(id, state), expected[state]);
+			numChecked++;
+		};
+
+		for(auto iter = linkingHypotheses_.begin(); iter != linkingHypotheses_.end(); ++iter)
+			check(iter->second->getVariable(), VariableClass::Link);
+		for(auto iter = divisionHypotheses_.begin(); iter != divisionHypotheses_.end(); ++iter)
+			check(iter->second->getVariable(), VariableClass::ExternalDivision);
+		for(auto iter = segmentationHypotheses_.begin(); iter != segmentationHypotheses_.end(); ++iter)
+		{
+			check(iter->second.getDetectionVariable(), VariableClass::Detection);
+			check(iter->second.getDivisionVariable(), VariableClass::Division);
+			check(iter->second.getAppearanceVariable(), VariableClass::Appearance);
+			check(iter->second.getDisappearanceVariable(), VariableClass::Disappearance);
+		}
+		return numChecked;
+	}
+};
+
+void checkModel(bool statesShareWeights)
+{
+	writeModel("unaryenergiesmodel.json", statesShareWeights);
+	EnergyModel model;
+	model.readFromJson("unaryenergiesmodel.json");
+
+	size_t numWeights = model.computeNumWeights();
+	WeightsType weights(numWeights);
+	std::vector<ValueType> weightValues(numWeights);
+	for(size_t i = 0; i < numWeights; ++i)
+	{
+		weightValues[i] = 0.25 * i - 1.5;
+		weights.setWeight(i, weightValues[i]);
+	}
+
+	BOOST_CHECK_THROW(model.computeUnaryEnergies(weightValues, 1), std::runtime_error);
+	model.initializeOpenGMModel(weights);
+	BOOST_CHECK_THROW(model.computeUnaryEnergies(std::vector<ValueType>(numWeights + 1), 1), std::runtime_error);
+
+	for(size_t numThreads : {1, 4})
+	{
+		UnaryEnergies energies = model.computeUnaryEnergies(weightValues, numThreads);
+		// more variables than fit in one block of computeUnaryEnergies()
+		BOOST_CHECK_GT(energies.getNumVariables(), 2 * 4096);
+		BOOST_CHECK_EQUAL(model.checkEnergies(energies, weights), energies.getNumVariables());
+	}
+}
+
+} // end anonymous namespace
+
+BOOST_AUTO_TEST_CASE( UnaryEnergiesMatchVariables )
+{
+	checkModel(false);
+}
+
+BOOST_AUTO_TEST_CASE( UnaryEnergiesMatchVariablesWithSharedWeights )
+{
+	checkModel(true);
+}
+
+BOOST_AUTO_TEST_CASE( UnaryEnergiesOfEmptyModel )
+{
+	writeModel("unaryenergiesmodel.json", false, 0);
+	EnergyModel model;
+	model.readFromJson("unaryenergiesmodel.json");
+
+	WeightsType weights(model.computeNumWeights());
+	model.initializeOpenGMModel(weights, true);
+	BOOST_CHECK_EQUAL(model.computeUnaryEnergies(std::vector<ValueType>(weights.numberOfWeights()), 1).getNumVariables(), 0);
+}